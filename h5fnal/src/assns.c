@@ -7,6 +7,7 @@
 
 #define H5FNAL_ASSNS_PAIR_DATASET_NAME          "pairs"
 #define H5FNAL_ASSNS_DATA_DATASET_NAME          "data"
+#define H5FNAL_ASSNS_DATA_TYPE_NAME             "data type"
 
 #define H5FNAL_LEFT_DATA_PRODUCT_NAME           "left data product"
 #define H5FNAL_RIGHT_DATA_PRODUCT_NAME          "right data product"
@@ -59,7 +60,7 @@ h5fnal_close_assns_on_err(h5fnal_assns_t *assns)
         H5E_BEGIN_TRY {
             H5Dclose(assns->pair_dset_id);
             H5Dclose(assns->data_dset_id);
-            H5Tclose(assns->pair_dtype_id);
+            h5fnal_release_type(assns->pair_dtype_id);
             H5Tclose(assns->data_dtype_id);
             H5Gclose(assns->top_level_group_id);
         } H5E_END_TRY;
@@ -70,6 +71,9 @@ h5fnal_close_assns_on_err(h5fnal_assns_t *assns)
         assns->data_dtype_id        = H5FNAL_BAD_HID_T;
         assns->top_level_group_id   = H5FNAL_BAD_HID_T;
 
+        h5fnal_free_append_buffer(&assns->pair_buffer);
+        h5fnal_free_append_buffer(&assns->data_buffer);
+
         free(assns->left);
         free(assns->right);
 
@@ -82,13 +86,9 @@ h5fnal_close_assns_on_err(h5fnal_assns_t *assns)
 
 herr_t
 h5fnal_create_assns(hid_t loc_id, const char *name, const char *left, const char *right, 
-        hid_t data_dtype_id, h5fnal_assns_t *assns)
+        hid_t data_dtype_id, const h5fnal_create_options_t *options, h5fnal_assns_t *assns)
 {
-    hid_t dcpl_id = -1;
-    hid_t sid = -1;
-    hsize_t chunk_dims[1];
-    hsize_t init_dims[1];
-    hsize_t max_dims[1];
+    hsize_t count = 0;
     size_t dp_len;
 
     if (loc_id < 0)
@@ -125,67 +125,54 @@ h5fnal_create_assns(hid_t loc_id, const char *name, const char *left, const char
         H5FNAL_PROGRAM_ERROR("could not get memory for right data product string");
     strcpy(assns->right, right);
 
-    /* Create the dataset creation property list */
-    if ((dcpl_id = H5Pcreate(H5P_DATASET_CREATE)) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Set up chunking (size is arbitrary for now) */
-    chunk_dims[0] = 1024;
-    if (H5Pset_chunk(dcpl_id, 1, chunk_dims) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Turn on compession */
-    if (H5Pset_shuffle(dcpl_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Pset_deflate(dcpl_id, 6) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Create the dataspace (set of points describing the data size, etc.) */
-    init_dims[0] = 0;
-    max_dims[0] = H5S_UNLIMITED;
-    if ((sid = H5Screate_simple(1, init_dims, max_dims)) < 0)
-        H5FNAL_HDF5_ERROR;
-
     /* Create the pair datatype */
-    if ((assns->pair_dtype_id = h5fnal_create_pair_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create pair datatype");
+    if ((assns->pair_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_PAIR)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get pair datatype");
 
-    /* Create the pair dataset */
-    if ((assns->pair_dset_id = H5Dcreate2(assns->top_level_group_id, H5FNAL_ASSNS_PAIR_DATASET_NAME,
-            assns->pair_dtype_id, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Store the 'extra' data datatype and create the associated dataset of that type.
+    /* Store the 'extra' data datatype, if there is one.
      *
      * We'll store a 'known invalid' value if the datatype is invalid (i.e.: not used)
      * to make things more consistent.
+     *
+     * The datatype is committed to the top-level group since the data
+     * dataset isn't created until there are pairs to write. That way
+     * an empty data product still has its data type when reopened.
      */
     if (data_dtype_id >= 0) {
         if((assns->data_dtype_id = H5Tcopy(data_dtype_id)) < 0)
             H5FNAL_HDF5_ERROR;
-        if ((assns->data_dset_id = H5Dcreate2(assns->top_level_group_id, H5FNAL_ASSNS_DATA_DATASET_NAME,
-                assns->data_dtype_id, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
+        if (H5Tcommit2(assns->top_level_group_id, H5FNAL_ASSNS_DATA_TYPE_NAME, assns->data_dtype_id,
+                H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT) < 0)
             H5FNAL_HDF5_ERROR;
     }
-    else {
+    else
         assns->data_dtype_id = H5FNAL_BAD_HID_T;
-        assns->data_dset_id = H5FNAL_BAD_HID_T;
-    }
 
-    /* close everything */
-    if (H5Pclose(dcpl_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sclose(sid) < 0)
-        H5FNAL_HDF5_ERROR;
+    /* Set up the append buffers. The datasets aren't created until
+     * there are pairs to write (see h5fnal_layout_t).
+     */
+    assns->pair_dset_id = H5FNAL_BAD_HID_T;
+    assns->data_dset_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_defer_append_buffer(assns->top_level_group_id, H5FNAL_ASSNS_PAIR_DATASET_NAME, assns->pair_dtype_id,
+            options, &assns->pair_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up pair append buffer");
+    if (assns->data_dtype_id >= 0)
+        if (h5fnal_defer_append_buffer(assns->top_level_group_id, H5FNAL_ASSNS_DATA_DATASET_NAME, assns->data_dtype_id,
+                options, &assns->data_buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up data append buffer");
+
+    /* No pairs yet */
+    if (h5fnal_set_hsize_attribute(assns->top_level_group_id, H5FNAL_COUNT_ATTR_NAME, 1, &count) < 0)
+        H5FNAL_PROGRAM_ERROR("could not add count attribute");
+
+    /* Compress the pairs in parallel if asked to */
+    if (options && options->parallel_compression)
+        if (h5fnal_use_compression_pool(&assns->pair_buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up parallel compression");
 
     return H5FNAL_SUCCESS;
 
 error:
-    H5E_BEGIN_TRY {
-        H5Sclose(sid);
-        H5Pclose(dcpl_id);
-    } H5E_END_TRY;
-
     if (assns)
         h5fnal_close_assns_on_err(assns);
 
@@ -195,7 +182,7 @@ error:
 herr_t
 h5fnal_open_assns(hid_t loc_id, const char *name, h5fnal_assns_t *assns)
 {
-    htri_t  data_dataset_exists;
+    htri_t exists;
 
     if (loc_id < 0)
         H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
@@ -207,9 +194,13 @@ h5fnal_open_assns(hid_t loc_id, const char *name, h5fnal_assns_t *assns)
     /* Initialize the data product struct */
     memset(assns, 0, sizeof(h5fnal_assns_t));
 
+    /* Make sure the in-tree compression filters are there for reads */
+    if (h5fnal_register_filters() < 0)
+        H5FNAL_PROGRAM_ERROR("could not register compression filters");
+
     /* Create datatype */
-    if ((assns->pair_dtype_id = h5fnal_create_pair_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create pair datatype");
+    if ((assns->pair_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_PAIR)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get pair datatype");
 
     /* Open top-level group */
     if ((assns->top_level_group_id = H5Gopen2(loc_id, name, H5P_DEFAULT)) < 0)
@@ -221,24 +212,42 @@ h5fnal_open_assns(hid_t loc_id, const char *name, h5fnal_assns_t *assns)
     if (h5fnal_get_string_attribute(assns->top_level_group_id, H5FNAL_RIGHT_DATA_PRODUCT_NAME, &(assns->right)) < 0)
         H5FNAL_PROGRAM_ERROR("could not get left data product name attribute");
 
-    /* Open pair dataset */
-    if ((assns->pair_dset_id = H5Dopen2(assns->top_level_group_id, H5FNAL_ASSNS_PAIR_DATASET_NAME, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
+    /* Open pair dataset (empty data products don't have one) */
+    if (h5fnal_open_optional_dset(assns->top_level_group_id, H5FNAL_ASSNS_PAIR_DATASET_NAME, &assns->pair_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open pair dataset");
 
-    /* Open data dataset and get its type, if it exists */
-    if ((data_dataset_exists = H5Lexists(assns->top_level_group_id, H5FNAL_ASSNS_DATA_DATASET_NAME, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (data_dataset_exists) {
-        if ((assns->data_dset_id = H5Dopen2(assns->top_level_group_id, H5FNAL_ASSNS_DATA_DATASET_NAME, H5P_DEFAULT)) < 0)
-            H5FNAL_HDF5_ERROR;
+    /* Open data dataset and get its type, if it exists
+     *
+     * Empty data products don't have a data dataset, but their data
+     * type is committed to the top-level group. (Files written before
+     * that was done have neither, so an empty data product there looks
+     * like it has no data.)
+     */
+    if (h5fnal_open_optional_dset(assns->top_level_group_id, H5FNAL_ASSNS_DATA_DATASET_NAME, &assns->data_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open data dataset");
+    assns->data_dtype_id = H5FNAL_BAD_HID_T;
+    if (assns->data_dset_id >= 0) {
         if ((assns->data_dtype_id = H5Dget_type(assns->data_dset_id)) < 0)
             H5FNAL_HDF5_ERROR;
     }
     else {
-        assns->data_dset_id = H5FNAL_BAD_HID_T;
-        assns->data_dtype_id = H5FNAL_BAD_HID_T;
+        if ((exists = H5Lexists(assns->top_level_group_id, H5FNAL_ASSNS_DATA_TYPE_NAME, H5P_DEFAULT)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (exists)
+            if ((assns->data_dtype_id = H5Topen2(assns->top_level_group_id, H5FNAL_ASSNS_DATA_TYPE_NAME,
+                    H5P_DEFAULT)) < 0)
+                H5FNAL_HDF5_ERROR;
     }
 
+    /* Set up the append buffers */
+    if (h5fnal_open_append_buffer(assns->top_level_group_id, H5FNAL_ASSNS_PAIR_DATASET_NAME, assns->pair_dset_id,
+            assns->pair_dtype_id, &assns->pair_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up pair append buffer");
+    if (assns->data_dtype_id >= 0)
+        if (h5fnal_open_append_buffer(assns->top_level_group_id, H5FNAL_ASSNS_DATA_DATASET_NAME, assns->data_dset_id,
+                assns->data_dtype_id, &assns->data_buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up data append buffer");
+
     return H5FNAL_SUCCESS;
 
 error:
@@ -254,6 +263,16 @@ h5fnal_close_assns(h5fnal_assns_t *assns)
     if (NULL == assns)
         H5FNAL_PROGRAM_ERROR("assns parameter cannot be NULL");
 
+    /* Keep the element count up to date */
+    if (h5fnal_update_count_attribute(assns->top_level_group_id, &assns->pair_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not update count attribute");
+
+    /* Write out anything still in the append buffers */
+    if (h5fnal_close_append_buffer(&assns->pair_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close pair append buffer");
+    if (h5fnal_close_append_buffer(&assns->data_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close data append buffer");
+
     free(assns->left);
     free(assns->right);
     assns->left = NULL;
@@ -262,10 +281,12 @@ h5fnal_close_assns(h5fnal_assns_t *assns)
     if (H5Gclose(assns->top_level_group_id) < 0)
         H5FNAL_HDF5_ERROR;
 
-    if (H5Dclose(assns->pair_dset_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Tclose(assns->pair_dtype_id) < 0)
-        H5FNAL_HDF5_ERROR;
+    if (assns->pair_dset_id >= 0)
+        if (H5Dclose(assns->pair_dset_id) < 0)
+            H5FNAL_HDF5_ERROR;
+    if (h5fnal_release_type(assns->pair_dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    assns->pair_dtype_id = H5FNAL_BAD_HID_T;
 
     /* Only close these if they were used */
     if (assns->data_dset_id >= 0)
@@ -294,131 +315,304 @@ error:
 herr_t
 h5fnal_append_assns(h5fnal_assns_t *assns, h5fnal_assns_data_t *data)
 {
-    hid_t file_sid = -1;                /* dataspace ID                             */
-    hid_t memory_sid = -1;              /* dataspace ID                             */
-    hsize_t curr_dims[1];               /* initial size of dataset                  */
-    hsize_t new_dims[1];                /* new size of data dataset             */
-    hsize_t start[1];
-    hsize_t stride[1];
-    hsize_t count[1];
-    hsize_t block[1];
-
-    /* Create the memory dataspace (set of points describing the data size, etc.) */
-    curr_dims[0] = data->n;
-    if ((memory_sid = H5Screate_simple(1, curr_dims, curr_dims)) < 0)
-        H5FNAL_HDF5_ERROR;
+    if (!assns)
+        H5FNAL_PROGRAM_ERROR("assns parameter cannot be NULL");
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
 
-    /* Get the size (current size only) of the dataset. Both datasets are the
-     * same size.
+    /* Trivial case of no pairs to append */
+    if (0 == data->n)
+        return H5FNAL_SUCCESS;
+
+    /* Append the pairs and, if necessary, the data. Both buffers see
+     * the same appends, so the two datasets stay the same size.
      */
-    if ((file_sid = H5Dget_space(assns->pair_dset_id)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sget_simple_extent_dims(file_sid, curr_dims, NULL) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sclose(file_sid) < 0)
-        H5FNAL_HDF5_ERROR;
+    if (h5fnal_buffered_append(&assns->pair_buffer, data->n, (const void *)data->pairs) < 0)
+        H5FNAL_PROGRAM_ERROR("could not append pairs");
+    if (assns->data_dtype_id >= 0)
+        if (h5fnal_buffered_append(&assns->data_buffer, data->n, (const void *)data->data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not append data");
 
-    /* Resize the datasets to hold the new data */
-    new_dims[0] = curr_dims[0] + data->n;
-    if (H5Dset_extent(assns->pair_dset_id, new_dims) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (assns->data_dset_id >= 0)
-        if (H5Dset_extent(assns->data_dset_id, new_dims) < 0)
-            H5FNAL_HDF5_ERROR;
+    /* Pick up the datasets if the appends created them */
+    if (h5fnal_claim_deferred_dset(&assns->pair_buffer, &assns->pair_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get pair dataset");
+    if (assns->data_dtype_id >= 0)
+        if (h5fnal_claim_deferred_dset(&assns->data_buffer, &assns->data_dset_id) < 0)
+            H5FNAL_PROGRAM_ERROR("could not get data dataset");
 
-    /* Get the resized file space */
-    if ((file_sid = H5Dget_space(assns->pair_dset_id)) < 0)
-        H5FNAL_HDF5_ERROR;
+    return H5FNAL_SUCCESS;
 
-    /* Create a hyperslab describing where the data should go */
-    start[0] = curr_dims[0];
-    stride[0] = 1;
-    count[0] = data->n;
-    block[0] = 1;
-    if (H5Sselect_hyperslab(file_sid, H5S_SELECT_SET, start, stride, count, block) < 0)
-        H5FNAL_HDF5_ERROR;
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_append_assns() */
 
-    /* Write the pairs to the dataset */
-    if (H5Dwrite(assns->pair_dset_id, assns->pair_dtype_id, memory_sid, file_sid, H5P_DEFAULT, data->pairs) < 0)
-        H5FNAL_HDF5_ERROR;
 
-    /* Write the data to the dataset, if necessary */
-    if (assns->data_dset_id >= 0)
-        if (H5Dwrite(assns->data_dset_id, assns->data_dtype_id, memory_sid, file_sid, H5P_DEFAULT, data->data) < 0)
-            H5FNAL_HDF5_ERROR;
+/************************************************************************
+ * h5fnal_get_assns_sizes()
+ *
+ * Sets the n field of data to the number of pairs stored in the data
+ * product. The arrays and capacity are not touched.
+ ************************************************************************/
+herr_t
+h5fnal_get_assns_sizes(h5fnal_assns_t *assns, h5fnal_assns_data_t *data)
+{
+    if (!assns)
+        H5FNAL_PROGRAM_ERROR("assns parameter cannot be NULL");
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
 
-    /* Close everything */
-    if (H5Sclose(file_sid) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sclose(memory_sid) < 0)
-        H5FNAL_HDF5_ERROR;
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_append_buffer(&assns->pair_buffer, &assns->pair_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush pair append buffer");
+    if (assns->data_dtype_id >= 0)
+        if (h5fnal_sync_append_buffer(&assns->data_buffer, &assns->data_dset_id) < 0)
+            H5FNAL_PROGRAM_ERROR("could not flush data append buffer");
+
+    /* Get the size of the datasets (both have the same size) from the
+     * buffer, which also knows it if the datasets don't exist
+     */
+    data->n = h5fnal_get_buffered_size(&assns->pair_buffer);
 
     return H5FNAL_SUCCESS;
 
 error:
-    H5E_BEGIN_TRY {
-        H5Sclose(file_sid);
-        H5Sclose(memory_sid);
-    } H5E_END_TRY;
-
     return H5FNAL_FAILURE;
-} /* end h5fnal_write_assns() */
+} /* end h5fnal_get_assns_sizes() */
 
 
+/************************************************************************
+ * h5fnal_reserve_assns_mem_data()
+ *
+ * Makes sure the arrays in data can hold at least n pairs (and n
+ * elements of associated data, if the data product has any), e.g. as
+ * set by h5fnal_get_assns_sizes(). The arrays must have been allocated
+ * by the library (or be NULL).
+ ************************************************************************/
 herr_t
-h5fnal_read_all_assns(h5fnal_assns_t *assns, h5fnal_assns_data_t *data)
+h5fnal_reserve_assns_mem_data(h5fnal_assns_t *assns, h5fnal_assns_data_t *data)
 {
-    hid_t       sid     = H5FNAL_BAD_HID_T;
+    size_t type_size = 0;
 
     if (!assns)
         H5FNAL_PROGRAM_ERROR("assns parameter cannot be NULL");
     if (!data)
         H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
 
-    /* Initialize the data struct */
-    memset(data, 0, sizeof(h5fnal_assns_data_t));
- 
-    /* Get the size of the datasets (both have the same size) */
-    if ((sid = H5Dget_space(assns->pair_dset_id)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((data->n = H5Sget_simple_extent_npoints(sid)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sclose(sid) < 0)
-        H5FNAL_HDF5_ERROR;
+    if (data->n <= data->capacity)
+        return H5FNAL_SUCCESS;
+
+    free(data->pairs);
+    free(data->data);
+    data->pairs = NULL;
+    data->data = NULL;
+    data->capacity = 0;
 
-    /* Generate a buffer for the pairs data and read it */
     if (NULL == (data->pairs = (h5fnal_pair_t *)calloc(data->n, sizeof(h5fnal_pair_t))))
         H5FNAL_PROGRAM_ERROR("could not allocate memory for pairs");
-    if (H5Dread(assns->pair_dset_id, assns->pair_dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data->pairs) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Read the 'extra' associated data, if it exists */
-    if (assns->data_dset_id >= 0) {
-        size_t type_size = 0;
-
+    if (assns->data_dtype_id >= 0) {
         /* Note that we can get the native type size from the HDF5 type */
         if (0 == (type_size = H5Tget_size(assns->data_dtype_id)))
             H5FNAL_HDF5_ERROR;
         if (NULL == (data->data = calloc(data->n, type_size)))
             H5FNAL_PROGRAM_ERROR("could not allocate memory for data");
-        if (H5Dread(assns->data_dset_id, assns->data_dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data->data) < 0)
-            H5FNAL_HDF5_ERROR;
     }
+    data->capacity = data->n;
 
     return H5FNAL_SUCCESS;
 
 error:
-    H5E_BEGIN_TRY {
-        H5Sclose(sid);
-    } H5E_END_TRY;
+    return H5FNAL_FAILURE;
+} /* end h5fnal_reserve_assns_mem_data() */
 
+
+/************************************************************************
+ * h5fnal_read_all_assns_into()
+ *
+ * Reads all the pairs (and associated data) into the arrays in data,
+ * which must be able to hold capacity elements. Nothing is allocated
+ * or freed.
+ *
+ * On return, n holds the number of pairs in the data product. If the
+ * arrays are too small, this fails without reading anything.
+ ************************************************************************/
+herr_t
+h5fnal_read_all_assns_into(h5fnal_assns_t *assns, h5fnal_assns_data_t *data)
+{
+    if (h5fnal_get_assns_sizes(assns, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get assns sizes");
+
+    if (data->n > data->capacity)
+        H5FNAL_PROGRAM_ERROR("assns data arrays are too small");
+
+    if (h5fnal_read_data(assns->pair_dset_id, assns->pair_dtype_id, data->n, data->pairs) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read pairs");
+
+    /* Read the 'extra' associated data, if it exists */
+    if (assns->data_dtype_id >= 0)
+        if (h5fnal_read_data(assns->data_dset_id, assns->data_dtype_id, data->n, data->data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read associated data");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_all_assns_into() */
+
+
+herr_t
+h5fnal_read_all_assns(h5fnal_assns_t *assns, h5fnal_assns_data_t *data)
+{
+    if (!assns)
+        H5FNAL_PROGRAM_ERROR("assns parameter cannot be NULL");
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    /* Initialize the data struct */
+    memset(data, 0, sizeof(h5fnal_assns_data_t));
+
+    /* Generate buffers for the pairs and data and read them */
+    if (h5fnal_get_assns_sizes(assns, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get assns sizes");
+    if (h5fnal_reserve_assns_mem_data(assns, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for assns data");
+    if (h5fnal_read_all_assns_into(assns, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read assns data");
+
+    return H5FNAL_SUCCESS;
+
+error:
     if (data)
         h5fnal_free_assns_mem_data(data);
 
     return H5FNAL_FAILURE;
-
 } /* end h5fnal_read_all_assns() */
 
+/************************************************************************
+ * h5fnal_read_pairs_range()
+ *
+ * Reads count pairs, starting at element start, into buf.
+ ************************************************************************/
+herr_t
+h5fnal_read_pairs_range(h5fnal_assns_t *assns, hsize_t start, hsize_t count, h5fnal_pair_t *buf)
+{
+    if (!assns)
+        H5FNAL_PROGRAM_ERROR("assns parameter cannot be NULL");
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_append_buffer(&assns->pair_buffer, &assns->pair_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush append buffer");
+
+    if (h5fnal_read_data_range(assns->pair_dset_id, assns->pair_dtype_id, start, count, buf) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read pairs");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_pairs_range() */
+
+/************************************************************************
+ * h5fnal_read_assns_data_range()
+ *
+ * Reads count elements of the associated data, starting at element
+ * start, into buf. Fails if the data product has no associated data.
+ ************************************************************************/
+herr_t
+h5fnal_read_assns_data_range(h5fnal_assns_t *assns, hsize_t start, hsize_t count, void *buf)
+{
+    if (!assns)
+        H5FNAL_PROGRAM_ERROR("assns parameter cannot be NULL");
+    if (assns->data_dtype_id < 0)
+        H5FNAL_PROGRAM_ERROR("assns has no associated data");
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_append_buffer(&assns->data_buffer, &assns->data_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush append buffer");
+
+    if (h5fnal_read_data_range(assns->data_dset_id, assns->data_dtype_id, start, count, buf) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read associated data");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_assns_data_range() */
+
+
+/************************************************************************
+ * h5fnal_append_event_assns()
+ *
+ * Flat layout append. Appends one event's pairs (and data) to a data
+ * product that holds every event in the file and adds the rows they
+ * went into to the event index.
+ ************************************************************************/
+herr_t
+h5fnal_append_event_assns(h5fnal_assns_t *assns, h5fnal_event_index_t *index,
+        unsigned run, unsigned subrun, unsigned event, h5fnal_assns_data_t *data)
+{
+    h5fnal_event_entry_t entry;
+
+    if (!assns)
+        H5FNAL_PROGRAM_ERROR("assns parameter cannot be NULL");
+    if (!index)
+        H5FNAL_PROGRAM_ERROR("index parameter cannot be NULL");
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    memset(&entry, 0, sizeof(h5fnal_event_entry_t));
+    entry.run = run;
+    entry.subrun = subrun;
+    entry.event = event;
+    entry.start[H5FNAL_ASSNS_RANGE_PAIRS] = h5fnal_get_buffered_size(&assns->pair_buffer);
+    entry.count[H5FNAL_ASSNS_RANGE_PAIRS] = data->n;
+
+    if (h5fnal_append_assns(assns, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not append assns data");
+    if (h5fnal_add_event_entry(index, &entry) < 0)
+        H5FNAL_PROGRAM_ERROR("could not add event index entry");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_append_event_assns() */
+
+
+/************************************************************************
+ * h5fnal_read_event_assns()
+ *
+ * Flat layout read. Reads one event's pairs (and data), as found with
+ * h5fnal_find_event(), into data, growing its arrays if needed.
+ ************************************************************************/
+herr_t
+h5fnal_read_event_assns(h5fnal_assns_t *assns, const h5fnal_event_entry_t *entry, h5fnal_assns_data_t *data)
+{
+    hsize_t start;
+
+    if (!assns)
+        H5FNAL_PROGRAM_ERROR("assns parameter cannot be NULL");
+    if (!entry)
+        H5FNAL_PROGRAM_ERROR("entry parameter cannot be NULL");
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    start = entry->start[H5FNAL_ASSNS_RANGE_PAIRS];
+    data->n = entry->count[H5FNAL_ASSNS_RANGE_PAIRS];
+    if (h5fnal_reserve_assns_mem_data(assns, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for assns data");
+
+    if (h5fnal_read_pairs_range(assns, start, data->n, data->pairs) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read pairs");
+    if (assns->data_dtype_id >= 0)
+        if (h5fnal_read_assns_data_range(assns, start, data->n, data->data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read data");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_event_assns() */
+
 /************************************************************************
  * h5fnal_free_assns_mem_data()
  *
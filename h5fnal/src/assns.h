@@ -28,11 +28,17 @@ typedef struct h5fnal_association_t {
  *
  * Note that the pairs and data arrays have the same number
  * of elements.
+ *
+ * capacity is the number of elements the arrays can hold.
+ * h5fnal_read_all_assns_into() reads into the arrays without
+ * allocating them, so one set of arrays can be reused for every
+ * event in a file.
  */
 typedef struct h5fnal_assns_data_t {
     h5fnal_pair_t       *pairs;
     void                *data;
     hsize_t             n;
+    hsize_t             capacity;
 } h5fnal_assns_data_t;
 
 /* Assns HDF5 data and related
@@ -42,6 +48,9 @@ typedef struct h5fnal_assns_data_t {
  *
  * left and right are the names of the data products on each side
  * of the pair.
+ *
+ * The append buffers hold pairs and data that have not been
+ * written to the datasets yet.
  */
 typedef struct h5fnal_assns_t {
     hid_t       top_level_group_id;
@@ -51,8 +60,15 @@ typedef struct h5fnal_assns_t {
     hid_t       data_dtype_id;
     char       *left;
     char       *right;
+    h5fnal_append_buffer_t  pair_buffer;
+    h5fnal_append_buffer_t  data_buffer;
 } h5fnal_assns_t;
 
+/* Event index slot for the pairs (and data) in this data product
+ * (flat layout)
+ */
+#define H5FNAL_ASSNS_RANGE_PAIRS    0
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -60,13 +76,22 @@ extern "C" {
 hid_t h5fnal_create_pair_type(void);
 
 herr_t h5fnal_create_assns(hid_t loc_id, const char *name, const char *left, const char *right,
-        hid_t data_datatype_id, h5fnal_assns_t *assns);
+        hid_t data_datatype_id, const h5fnal_create_options_t *options, h5fnal_assns_t *assns);
 herr_t h5fnal_open_assns(hid_t loc_id, const char *name, h5fnal_assns_t *assns);
 herr_t h5fnal_close_assns(h5fnal_assns_t *assns);
 
 herr_t h5fnal_append_assns(h5fnal_assns_t *assns, h5fnal_assns_data_t *data);
 herr_t h5fnal_read_all_assns(h5fnal_assns_t *assns, h5fnal_assns_data_t *data);
+herr_t h5fnal_read_all_assns_into(h5fnal_assns_t *assns, h5fnal_assns_data_t *data);
+herr_t h5fnal_get_assns_sizes(h5fnal_assns_t *assns, h5fnal_assns_data_t *data);
+herr_t h5fnal_read_pairs_range(h5fnal_assns_t *assns, hsize_t start, hsize_t count, h5fnal_pair_t *buf);
+herr_t h5fnal_read_assns_data_range(h5fnal_assns_t *assns, hsize_t start, hsize_t count, void *buf);
+
+herr_t h5fnal_append_event_assns(h5fnal_assns_t *assns, h5fnal_event_index_t *index,
+        unsigned run, unsigned subrun, unsigned event, h5fnal_assns_data_t *data);
+herr_t h5fnal_read_event_assns(h5fnal_assns_t *assns, const h5fnal_event_entry_t *entry, h5fnal_assns_data_t *data);
 
+herr_t h5fnal_reserve_assns_mem_data(h5fnal_assns_t *assns, h5fnal_assns_data_t *data);
 herr_t h5fnal_free_assns_mem_data(h5fnal_assns_data_t *data);
 
 #ifdef __cplusplus
@@ -0,0 +1,447 @@
+/* chunk_writer.c
+ *
+ * Parallel chunk compression and direct chunk writes.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "h5fnal.h"
+#include "chunk_writer.h"
+
+/* Maximum number of chunks in flight per worker thread and writer.
+ * The writer blocks on its oldest chunk when it has more than this.
+ */
+#define H5FNAL_CHUNKS_IN_FLIGHT_PER_THREAD  2
+
+struct h5fnal_chunk_job_t {
+    h5fnal_chunk_job_t             *next_queued;    /* next job in the pool queue       */
+    h5fnal_chunk_job_t             *next;           /* next job for the same writer     */
+    const h5fnal_filter_pipeline_t *pipeline;
+    hsize_t                         offset;         /* first element of the chunk       */
+    void                           *buf;
+    size_t                          buf_size;
+    size_t                          nbytes;         /* size of the (filtered) data      */
+    unsigned                        filter_mask;
+    herr_t                          status;
+    hbool_t                         done;
+};
+
+/* The worker pool
+ *
+ * Workers never call into the HDF5 library. The mutex protects the
+ * queue and the jobs' done/status fields.
+ */
+static struct {
+    pthread_mutex_t         mutex;
+    pthread_cond_t          work_cond;      /* signalled when jobs are queued   */
+    pthread_cond_t          done_cond;      /* signalled when jobs finish       */
+    pthread_t              *threads;
+    unsigned                n_threads;
+    hbool_t                 shutdown;
+    h5fnal_chunk_job_t     *queue_head;
+    h5fnal_chunk_job_t     *queue_tail;
+} h5fnal_pool_g = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    NULL, 0, FALSE, NULL, NULL
+};
+
+
+/************************************************************************
+ * h5fnal_compression_worker()
+ ************************************************************************/
+static void *
+h5fnal_compression_worker(void *arg)
+{
+    h5fnal_chunk_job_t *job;
+    herr_t status;
+
+    (void)arg;
+
+    pthread_mutex_lock(&h5fnal_pool_g.mutex);
+
+    while (1) {
+        while (NULL == h5fnal_pool_g.queue_head && !h5fnal_pool_g.shutdown)
+            pthread_cond_wait(&h5fnal_pool_g.work_cond, &h5fnal_pool_g.mutex);
+
+        /* Only quit once the queue is empty */
+        if (NULL == (job = h5fnal_pool_g.queue_head))
+            break;
+        h5fnal_pool_g.queue_head = job->next_queued;
+        if (NULL == h5fnal_pool_g.queue_head)
+            h5fnal_pool_g.queue_tail = NULL;
+
+        pthread_mutex_unlock(&h5fnal_pool_g.mutex);
+
+        status = h5fnal_filter_chunk(job->pipeline, &job->buf, &job->buf_size, &job->nbytes, &job->filter_mask);
+
+        pthread_mutex_lock(&h5fnal_pool_g.mutex);
+
+        job->status = status;
+        job->done = TRUE;
+        pthread_cond_broadcast(&h5fnal_pool_g.done_cond);
+    }
+
+    pthread_mutex_unlock(&h5fnal_pool_g.mutex);
+
+    return NULL;
+} /* end h5fnal_compression_worker() */
+
+
+/************************************************************************
+ * h5fnal_start_compression_pool()
+ *
+ * Starts n_threads compression worker threads. Chunk writers submit to
+ * the pool when it is running and compress in the calling thread when
+ * it isn't.
+ ************************************************************************/
+herr_t
+h5fnal_start_compression_pool(unsigned n_threads)
+{
+    unsigned u;
+
+    if (0 == n_threads)
+        H5FNAL_PROGRAM_ERROR("n_threads parameter cannot be zero");
+    if (h5fnal_pool_g.n_threads > 0)
+        H5FNAL_PROGRAM_ERROR("compression pool is already running");
+
+    if (NULL == (h5fnal_pool_g.threads = (pthread_t *)calloc(n_threads, sizeof(pthread_t))))
+        H5FNAL_PROGRAM_ERROR("could not get memory for compression threads");
+
+    h5fnal_pool_g.shutdown = FALSE;
+
+    for (u = 0; u < n_threads; u++) {
+        if (0 != pthread_create(&h5fnal_pool_g.threads[u], NULL, h5fnal_compression_worker, NULL))
+            H5FNAL_PROGRAM_ERROR("could not start compression thread");
+        h5fnal_pool_g.n_threads++;
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (h5fnal_pool_g.threads)
+        h5fnal_stop_compression_pool();
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_start_compression_pool() */
+
+
+/************************************************************************
+ * h5fnal_stop_compression_pool()
+ *
+ * Finishes all queued work and stops the worker threads. Chunks that
+ * were compressed but not yet written are written by their writers as
+ * usual.
+ ************************************************************************/
+herr_t
+h5fnal_stop_compression_pool(void)
+{
+    unsigned u;
+
+    pthread_mutex_lock(&h5fnal_pool_g.mutex);
+    h5fnal_pool_g.shutdown = TRUE;
+    pthread_cond_broadcast(&h5fnal_pool_g.work_cond);
+    pthread_mutex_unlock(&h5fnal_pool_g.mutex);
+
+    for (u = 0; u < h5fnal_pool_g.n_threads; u++)
+        pthread_join(h5fnal_pool_g.threads[u], NULL);
+
+    pthread_mutex_lock(&h5fnal_pool_g.mutex);
+    free(h5fnal_pool_g.threads);
+    h5fnal_pool_g.threads = NULL;
+    h5fnal_pool_g.n_threads = 0;
+    h5fnal_pool_g.shutdown = FALSE;
+    pthread_mutex_unlock(&h5fnal_pool_g.mutex);
+
+    return H5FNAL_SUCCESS;
+} /* end h5fnal_stop_compression_pool() */
+
+
+/************************************************************************
+ * h5fnal_get_compression_pool_size()
+ *
+ * Returns the number of compression worker threads (zero when the
+ * pool isn't running).
+ ************************************************************************/
+unsigned
+h5fnal_get_compression_pool_size(void)
+{
+    return h5fnal_pool_g.n_threads;
+} /* end h5fnal_get_compression_pool_size() */
+
+
+/************************************************************************
+ * h5fnal_create_chunk_writer()
+ *
+ * Creates a chunk writer for a chunked 1D dataset. *writer is set to
+ * NULL if the dataset can't be written this way (it isn't chunked, its
+ * filters aren't ones we can apply ourselves, or the memory datatype
+ * isn't the same as the dataset's datatype).
+ ************************************************************************/
+herr_t
+h5fnal_create_chunk_writer(hid_t did, hid_t tid, h5fnal_chunk_writer_t **writer)
+{
+    h5fnal_chunk_writer_t *new_writer = NULL;
+    hid_t dcpl_id = -1;
+    hid_t file_tid = -1;
+    htri_t usable;
+    size_t type_size;
+    hssize_t n;
+
+    if (did < 0)
+        H5FNAL_PROGRAM_ERROR("did parameter cannot be negative");
+    if (tid < 0)
+        H5FNAL_PROGRAM_ERROR("tid parameter cannot be negative");
+    if (NULL == writer)
+        H5FNAL_PROGRAM_ERROR("writer parameter cannot be NULL");
+
+    *writer = NULL;
+
+    if (NULL == (new_writer = (h5fnal_chunk_writer_t *)calloc(1, sizeof(h5fnal_chunk_writer_t))))
+        H5FNAL_PROGRAM_ERROR("could not get memory for chunk writer");
+    new_writer->did = did;
+
+    /* Chunks are stored as-is, so no datatype conversion is allowed */
+    if ((file_tid = H5Dget_type(did)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((usable = H5Tequal(file_tid, tid)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tclose(file_tid) < 0)
+        H5FNAL_HDF5_ERROR;
+    file_tid = H5FNAL_BAD_HID_T;
+
+    /* Get the chunk size and filters */
+    if ((dcpl_id = H5Dget_create_plist(did)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (usable > 0 && H5D_CHUNKED != H5Pget_layout(dcpl_id))
+        usable = FALSE;
+    if (usable > 0) {
+        if (H5Pget_chunk(dcpl_id, 1, &new_writer->chunk_dim) < 0)
+            H5FNAL_HDF5_ERROR;
+        if ((usable = h5fnal_get_filter_pipeline(dcpl_id, &new_writer->pipeline)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not get filter pipeline");
+    }
+    if (H5Pclose(dcpl_id) < 0)
+        H5FNAL_HDF5_ERROR;
+    dcpl_id = H5FNAL_BAD_HID_T;
+
+    if (usable <= 0) {
+        free(new_writer);
+        return H5FNAL_SUCCESS;
+    }
+
+    if (0 == (type_size = H5Tget_size(tid)))
+        H5FNAL_HDF5_ERROR;
+    new_writer->chunk_bytes = (size_t)new_writer->chunk_dim * type_size;
+
+    if ((n = h5fnal_get_dset_extent(did)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset extent");
+    new_writer->extent = (hsize_t)n;
+
+    *writer = new_writer;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Tclose(file_tid);
+        H5Pclose(dcpl_id);
+    } H5E_END_TRY;
+
+    free(new_writer);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_create_chunk_writer() */
+
+
+/************************************************************************
+ * h5fnal_write_oldest_chunk()
+ *
+ * Waits for the writer's oldest chunk to be compressed and stores it.
+ ************************************************************************/
+static herr_t
+h5fnal_write_oldest_chunk(h5fnal_chunk_writer_t *writer)
+{
+    h5fnal_chunk_job_t *job = writer->head;
+    hsize_t dims[1];
+    hsize_t offset[1];
+
+    pthread_mutex_lock(&h5fnal_pool_g.mutex);
+    while (!job->done)
+        pthread_cond_wait(&h5fnal_pool_g.done_cond, &h5fnal_pool_g.mutex);
+    pthread_mutex_unlock(&h5fnal_pool_g.mutex);
+
+    writer->head = job->next;
+    if (NULL == writer->head)
+        writer->tail = NULL;
+    writer->n_in_flight--;
+
+    if (job->status < 0)
+        H5FNAL_PROGRAM_ERROR("could not compress chunk");
+
+    /* The chunk has to be inside the dataset's extent */
+    if (job->offset + writer->chunk_dim > writer->extent) {
+        dims[0] = job->offset + writer->chunk_dim;
+        if (H5Dset_extent(writer->did, dims) < 0)
+            H5FNAL_HDF5_ERROR;
+        writer->extent = dims[0];
+    }
+
+    offset[0] = job->offset;
+    if (H5Dwrite_chunk(writer->did, H5P_DEFAULT, job->filter_mask, offset, job->nbytes, job->buf) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    free(job->buf);
+    free(job);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    free(job->buf);
+    free(job);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_write_oldest_chunk() */
+
+
+/************************************************************************
+ * h5fnal_submit_chunk()
+ *
+ * Queues a whole chunk of data for compression and writing. offset is
+ * the index of the chunk's first element and must be on a chunk
+ * boundary. The data is copied, so the caller can reuse its buffer.
+ *
+ * Chunks are written in the order they were submitted, by this call
+ * or by h5fnal_drain_chunk_writer().
+ ************************************************************************/
+herr_t
+h5fnal_submit_chunk(h5fnal_chunk_writer_t *writer, hsize_t offset, const void *data)
+{
+    h5fnal_chunk_job_t *job = NULL;
+    unsigned max_in_flight;
+
+    if (NULL == writer)
+        H5FNAL_PROGRAM_ERROR("writer parameter cannot be NULL");
+    if (NULL == data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+    if (0 != offset % writer->chunk_dim)
+        H5FNAL_PROGRAM_ERROR("chunk offset is not on a chunk boundary");
+
+    /* Set up the job */
+    if (NULL == (job = (h5fnal_chunk_job_t *)calloc(1, sizeof(h5fnal_chunk_job_t))))
+        H5FNAL_PROGRAM_ERROR("could not get memory for chunk job");
+    if (NULL == (job->buf = malloc(writer->chunk_bytes)))
+        H5FNAL_PROGRAM_ERROR("could not get memory for chunk");
+    memcpy(job->buf, data, writer->chunk_bytes);
+    job->buf_size = writer->chunk_bytes;
+    job->nbytes = writer->chunk_bytes;
+    job->pipeline = &writer->pipeline;
+    job->offset = offset;
+
+    /* Add it to the writer's list */
+    if (writer->tail)
+        writer->tail->next = job;
+    else
+        writer->head = job;
+    writer->tail = job;
+    writer->n_in_flight++;
+
+    /* Hand it to the pool, or compress it here if there is no pool */
+    pthread_mutex_lock(&h5fnal_pool_g.mutex);
+    if (h5fnal_pool_g.n_threads > 0 && !h5fnal_pool_g.shutdown) {
+        if (h5fnal_pool_g.queue_tail)
+            h5fnal_pool_g.queue_tail->next_queued = job;
+        else
+            h5fnal_pool_g.queue_head = job;
+        h5fnal_pool_g.queue_tail = job;
+        pthread_cond_signal(&h5fnal_pool_g.work_cond);
+        max_in_flight = H5FNAL_CHUNKS_IN_FLIGHT_PER_THREAD * h5fnal_pool_g.n_threads;
+        pthread_mutex_unlock(&h5fnal_pool_g.mutex);
+    }
+    else {
+        pthread_mutex_unlock(&h5fnal_pool_g.mutex);
+        job->status = h5fnal_filter_chunk(job->pipeline, &job->buf, &job->buf_size, &job->nbytes, &job->filter_mask);
+        job->done = TRUE;
+        max_in_flight = 0;
+    }
+
+    /* Write out finished chunks, blocking if too many are in flight */
+    while (writer->head) {
+        hbool_t done;
+
+        pthread_mutex_lock(&h5fnal_pool_g.mutex);
+        done = writer->head->done;
+        pthread_mutex_unlock(&h5fnal_pool_g.mutex);
+
+        if (!done && writer->n_in_flight <= max_in_flight)
+            break;
+        if (h5fnal_write_oldest_chunk(writer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write chunk");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (job && NULL == job->pipeline) {
+        free(job->buf);
+        free(job);
+    }
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_submit_chunk() */
+
+
+/************************************************************************
+ * h5fnal_drain_chunk_writer()
+ *
+ * Writes all chunks that are in flight.
+ ************************************************************************/
+herr_t
+h5fnal_drain_chunk_writer(h5fnal_chunk_writer_t *writer)
+{
+    herr_t ret_value = H5FNAL_SUCCESS;
+
+    if (NULL == writer)
+        return H5FNAL_SUCCESS;
+
+    /* Keep going after errors so nothing is left in flight */
+    while (writer->head)
+        if (h5fnal_write_oldest_chunk(writer) < 0)
+            ret_value = H5FNAL_FAILURE;
+
+    return ret_value;
+} /* end h5fnal_drain_chunk_writer() */
+
+
+/************************************************************************
+ * h5fnal_free_chunk_writer()
+ *
+ * Frees a chunk writer. Chunks still in flight are discarded (after
+ * the workers are done with them).
+ ************************************************************************/
+herr_t
+h5fnal_free_chunk_writer(h5fnal_chunk_writer_t *writer)
+{
+    h5fnal_chunk_job_t *job;
+
+    if (NULL == writer)
+        return H5FNAL_SUCCESS;
+
+    while (NULL != (job = writer->head)) {
+        pthread_mutex_lock(&h5fnal_pool_g.mutex);
+        while (!job->done)
+            pthread_cond_wait(&h5fnal_pool_g.done_cond, &h5fnal_pool_g.mutex);
+        pthread_mutex_unlock(&h5fnal_pool_g.mutex);
+
+        writer->head = job->next;
+        free(job->buf);
+        free(job);
+    }
+
+    free(writer);
+
+    return H5FNAL_SUCCESS;
+} /* end h5fnal_free_chunk_writer() */
@@ -0,0 +1,55 @@
+/* chunk_writer.h
+ *
+ * Parallel chunk compression and direct chunk writes.
+ *
+ * Whole chunks are handed to a chunk writer, which runs the dataset's
+ * filter pipeline on them in a pool of worker threads and stores the
+ * results with H5Dwrite_chunk(). Only the stores go through the HDF5
+ * library, so the slow part (compression) is no longer serialized by
+ * the library lock. The filter pipeline is the dataset's own, so the
+ * files are no different from ones written the normal way.
+ */
+
+#ifndef H5FNAL_CHUNK_WRITER_H
+#define H5FNAL_CHUNK_WRITER_H
+
+#include "h5fnal.h"
+
+/* A chunk waiting to be (or being) compressed */
+typedef struct h5fnal_chunk_job_t h5fnal_chunk_job_t;
+
+/* Chunk writer for a single 1D dataset
+ *
+ * The dataset ID is NOT owned by the writer.
+ */
+typedef struct h5fnal_chunk_writer_t {
+    hid_t                       did;
+    size_t                      chunk_bytes;    /* uncompressed size of a chunk     */
+    hsize_t                     chunk_dim;      /* elements in a chunk              */
+    hsize_t                     extent;         /* current extent of the dataset    */
+    h5fnal_filter_pipeline_t    pipeline;
+    h5fnal_chunk_job_t         *head;           /* oldest chunk in flight           */
+    h5fnal_chunk_job_t         *tail;           /* newest chunk in flight           */
+    unsigned                    n_in_flight;
+} h5fnal_chunk_writer_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Compression worker pool (shared by all chunk writers) */
+herr_t h5fnal_start_compression_pool(unsigned n_threads);
+herr_t h5fnal_stop_compression_pool(void);
+unsigned h5fnal_get_compression_pool_size(void);
+
+/* Chunk writers */
+herr_t h5fnal_create_chunk_writer(hid_t did, hid_t tid, h5fnal_chunk_writer_t **writer);
+herr_t h5fnal_submit_chunk(h5fnal_chunk_writer_t *writer, hsize_t offset, const void *data);
+herr_t h5fnal_drain_chunk_writer(h5fnal_chunk_writer_t *writer);
+herr_t h5fnal_free_chunk_writer(h5fnal_chunk_writer_t *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H5FNAL_CHUNK_WRITER_H */
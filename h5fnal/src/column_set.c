@@ -0,0 +1,670 @@
+/* column_set.c
+ *
+ * Column-split (struct-of-arrays) storage for compound datasets.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "h5fnal.h"
+
+/* Rounds n up to a multiple of m */
+#define H5FNAL_ALIGN_UP(n, m)   (((n) + (m) - 1) / (m) * (m))
+
+
+/************************************************************************
+ * h5fnal_is_column_set()
+ *
+ * Returns TRUE if name in loc_id is a column set (a group) and FALSE if
+ * it is anything else, or doesn't exist.
+ ************************************************************************/
+htri_t
+h5fnal_is_column_set(hid_t loc_id, const char *name)
+{
+#if H5_VERSION_GE(1, 12, 0)
+    H5O_info2_t info;
+#else
+    H5O_info_t info;
+#endif
+    htri_t exists;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == name)
+        H5FNAL_PROGRAM_ERROR("name parameter cannot be NULL");
+
+    if ((exists = H5Lexists(loc_id, name, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (!exists)
+        return FALSE;
+
+#if H5_VERSION_GE(1, 12, 0)
+    if (H5Oget_info_by_name3(loc_id, name, &info, H5O_INFO_BASIC, H5P_DEFAULT) < 0)
+        H5FNAL_HDF5_ERROR;
+#else
+    if (H5Oget_info_by_name2(loc_id, name, &info, H5O_INFO_BASIC, H5P_DEFAULT) < 0)
+        H5FNAL_HDF5_ERROR;
+#endif
+
+    return H5O_TYPE_GROUP == info.type ? TRUE : FALSE;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_is_column_set() */
+
+
+/************************************************************************
+ * h5fnal_init_columns()
+ *
+ * Sets up a column for each member of the compound datatype tid. The
+ * values of a member in consecutive rows are read straight into the
+ * caller's structs with a strided selection, so each member's offset
+ * and the struct size have to be multiples of the member's size. That
+ * is always the case for naturally aligned structs of scalars.
+ ************************************************************************/
+static herr_t
+h5fnal_init_columns(h5fnal_column_set_t *set, hid_t tid)
+{
+    int n_members;
+    unsigned u;
+
+    if (H5T_COMPOUND != H5Tget_class(tid))
+        H5FNAL_PROGRAM_ERROR("column sets need a compound datatype");
+    if (0 == (set->row_size = H5Tget_size(tid)))
+        H5FNAL_HDF5_ERROR;
+    if ((n_members = H5Tget_nmembers(tid)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (0 == n_members || n_members > H5FNAL_MAX_COLUMNS)
+        H5FNAL_PROGRAM_ERROR("bad number of compound members for a column set");
+
+    if (NULL == (set->columns = (h5fnal_column_t *)calloc((size_t)n_members, sizeof(h5fnal_column_t))))
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for columns");
+    for (u = 0; u < (unsigned)n_members; u++) {
+        set->columns[u].tid = H5FNAL_BAD_HID_T;
+        set->columns[u].did = H5FNAL_BAD_HID_T;
+        set->columns[u].buffer.did = H5FNAL_BAD_HID_T;
+        set->columns[u].buffer.tid = H5FNAL_BAD_HID_T;
+    }
+    set->n_columns = (unsigned)n_members;
+
+    for (u = 0; u < set->n_columns; u++) {
+        h5fnal_column_t *column = &set->columns[u];
+
+        if (NULL == (column->name = H5Tget_member_name(tid, u)))
+            H5FNAL_HDF5_ERROR;
+        column->offset = H5Tget_member_offset(tid, u);
+        if ((column->tid = H5Tget_member_type(tid, u)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (0 == (column->size = H5Tget_size(column->tid)))
+            H5FNAL_HDF5_ERROR;
+
+        if (column->offset % column->size != 0 || set->row_size % column->size != 0)
+            H5FNAL_PROGRAM_ERROR("compound member is not aligned for column storage");
+    }
+
+    if (NULL == (set->scratch = malloc(H5FNAL_COLUMN_SCRATCH_BYTES)))
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for column scratch buffer");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_init_columns() */
+
+
+/************************************************************************
+ * h5fnal_free_column_set()
+ *
+ * Closes everything in the set with no error checking and discards
+ * anything still in the append buffers. Used to clean up after errors.
+ * A set that was never set up (all zero) is left alone.
+ ************************************************************************/
+herr_t
+h5fnal_free_column_set(h5fnal_column_set_t *set)
+{
+    unsigned u;
+
+    if (NULL == set)
+        H5FNAL_PROGRAM_ERROR("set parameter cannot be NULL");
+
+    if (NULL == set->columns && set->gid <= 0)
+        return H5FNAL_SUCCESS;
+
+    for (u = 0; u < set->n_columns; u++) {
+        h5fnal_column_t *column = &set->columns[u];
+
+        h5fnal_free_append_buffer(&column->buffer);
+        H5E_BEGIN_TRY {
+            H5Dclose(column->did);
+            H5Tclose(column->tid);
+        } H5E_END_TRY;
+        H5free_memory(column->name);
+    }
+    H5E_BEGIN_TRY {
+        H5Gclose(set->gid);
+    } H5E_END_TRY;
+    free(set->columns);
+    free(set->scratch);
+
+    memset(set, 0, sizeof(h5fnal_column_set_t));
+    set->gid = H5FNAL_BAD_HID_T;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_free_column_set() */
+
+
+/************************************************************************
+ * h5fnal_create_column_set()
+ *
+ * Creates a column set for elements of the compound datatype tid (not
+ * owned by the set) as a group called name in loc_id. The column
+ * datasets are created with the given options as they are needed.
+ ************************************************************************/
+herr_t
+h5fnal_create_column_set(hid_t loc_id, const char *name, hid_t tid, const h5fnal_create_options_t *options,
+        h5fnal_column_set_t *set)
+{
+    unsigned u;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == name)
+        H5FNAL_PROGRAM_ERROR("name parameter cannot be NULL");
+    if (NULL == set)
+        H5FNAL_PROGRAM_ERROR("set parameter cannot be NULL");
+
+    memset(set, 0, sizeof(h5fnal_column_set_t));
+
+    if ((set->gid = H5Gcreate2(loc_id, name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (h5fnal_init_columns(set, tid) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up columns");
+
+    for (u = 0; u < set->n_columns; u++) {
+        h5fnal_column_t *column = &set->columns[u];
+
+        if (h5fnal_defer_append_buffer(set->gid, column->name, column->tid, options, &column->buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up column append buffer");
+        if (options && options->parallel_compression)
+            if (h5fnal_use_compression_pool(&column->buffer) < 0)
+                H5FNAL_PROGRAM_ERROR("could not set up parallel compression");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (set)
+        h5fnal_free_column_set(set);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_create_column_set() */
+
+
+/************************************************************************
+ * h5fnal_open_column_set()
+ *
+ * Opens the column set called name in loc_id, which holds elements of
+ * the compound datatype tid (not owned by the set).
+ ************************************************************************/
+herr_t
+h5fnal_open_column_set(hid_t loc_id, const char *name, hid_t tid, h5fnal_column_set_t *set)
+{
+    unsigned u;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == name)
+        H5FNAL_PROGRAM_ERROR("name parameter cannot be NULL");
+    if (NULL == set)
+        H5FNAL_PROGRAM_ERROR("set parameter cannot be NULL");
+
+    memset(set, 0, sizeof(h5fnal_column_set_t));
+
+    if ((set->gid = H5Gopen2(loc_id, name, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (h5fnal_init_columns(set, tid) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up columns");
+
+    for (u = 0; u < set->n_columns; u++) {
+        h5fnal_column_t *column = &set->columns[u];
+
+        if (h5fnal_open_optional_dset(set->gid, column->name, &column->did) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open column dataset");
+        if (h5fnal_open_append_buffer(set->gid, column->name, column->did, column->tid, &column->buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up column append buffer");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (set)
+        h5fnal_free_column_set(set);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_open_column_set() */
+
+
+/************************************************************************
+ * h5fnal_close_column_set()
+ *
+ * Writes out anything still in the append buffers and closes the set.
+ * A set that was never set up (all zero) is left alone, so the data
+ * products can close their column sets whatever their storage.
+ ************************************************************************/
+herr_t
+h5fnal_close_column_set(h5fnal_column_set_t *set)
+{
+    unsigned u;
+
+    if (NULL == set)
+        H5FNAL_PROGRAM_ERROR("set parameter cannot be NULL");
+
+    if (NULL == set->columns && set->gid <= 0)
+        return H5FNAL_SUCCESS;
+
+    for (u = 0; u < set->n_columns; u++) {
+        h5fnal_column_t *column = &set->columns[u];
+
+        if (h5fnal_close_append_buffer(&column->buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close column append buffer");
+        if (column->did >= 0)
+            if (H5Dclose(column->did) < 0)
+                H5FNAL_HDF5_ERROR;
+        column->did = H5FNAL_BAD_HID_T;
+        if (H5Tclose(column->tid) < 0)
+            H5FNAL_HDF5_ERROR;
+        column->tid = H5FNAL_BAD_HID_T;
+    }
+    if (H5Gclose(set->gid) < 0)
+        H5FNAL_HDF5_ERROR;
+    set->gid = H5FNAL_BAD_HID_T;
+
+    for (u = 0; u < set->n_columns; u++)
+        H5free_memory(set->columns[u].name);
+    free(set->columns);
+    free(set->scratch);
+
+    memset(set, 0, sizeof(h5fnal_column_set_t));
+    set->gid = H5FNAL_BAD_HID_T;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (set)
+        h5fnal_free_column_set(set);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_close_column_set() */
+
+
+/************************************************************************
+ * h5fnal_append_columns()
+ *
+ * Appends n_rows elements (C structs matching the compound datatype)
+ * to the columns. Each member is gathered into the scratch buffer, a
+ * piece at a time, and appended through its column's append buffer.
+ ************************************************************************/
+herr_t
+h5fnal_append_columns(h5fnal_column_set_t *set, hsize_t n_rows, const void *rows)
+{
+    const unsigned char *row;
+    unsigned char *value;
+    hsize_t done;
+    hsize_t n;
+    hsize_t r;
+    unsigned u;
+
+    if (NULL == set)
+        H5FNAL_PROGRAM_ERROR("set parameter cannot be NULL");
+
+    /* Trivial case of no elements */
+    if (0 == n_rows)
+        return H5FNAL_SUCCESS;
+
+    if (NULL == rows)
+        H5FNAL_PROGRAM_ERROR("rows parameter cannot be NULL");
+
+    for (u = 0; u < set->n_columns; u++) {
+        h5fnal_column_t *column = &set->columns[u];
+        hsize_t max_n = H5FNAL_COLUMN_SCRATCH_BYTES / column->size;
+
+        for (done = 0; done < n_rows; done += n) {
+            n = H5FNAL_MIN(n_rows - done, max_n);
+
+            row = (const unsigned char *)rows + done * set->row_size + column->offset;
+            value = (unsigned char *)set->scratch;
+            for (r = 0; r < n; r++, row += set->row_size, value += column->size)
+                memcpy(value, row, column->size);
+
+            if (h5fnal_buffered_append(&column->buffer, n, set->scratch) < 0)
+                H5FNAL_PROGRAM_ERROR("could not append column data");
+        }
+
+        /* Pick up the dataset if the appends created it */
+        if (h5fnal_claim_deferred_dset(&column->buffer, &column->did) < 0)
+            H5FNAL_PROGRAM_ERROR("could not get column dataset");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_append_columns() */
+
+
+/************************************************************************
+ * h5fnal_sync_column_set()
+ *
+ * Flushes the append buffers so the columns can be read from the
+ * datasets.
+ ************************************************************************/
+herr_t
+h5fnal_sync_column_set(h5fnal_column_set_t *set)
+{
+    unsigned u;
+
+    if (NULL == set)
+        H5FNAL_PROGRAM_ERROR("set parameter cannot be NULL");
+
+    for (u = 0; u < set->n_columns; u++)
+        if (h5fnal_sync_append_buffer(&set->columns[u].buffer, &set->columns[u].did) < 0)
+            H5FNAL_PROGRAM_ERROR("could not flush column append buffer");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_sync_column_set() */
+
+
+/************************************************************************
+ * h5fnal_get_column_set_size()
+ *
+ * Returns the number of elements in the set, including elements that
+ * are still in the append buffers.
+ ************************************************************************/
+hsize_t
+h5fnal_get_column_set_size(const h5fnal_column_set_t *set)
+{
+    if (NULL == set || 0 == set->n_columns)
+        return 0;
+
+    return h5fnal_get_buffered_size(&set->columns[0].buffer);
+} /* end h5fnal_get_column_set_size() */
+
+
+/************************************************************************
+ * h5fnal_pack_member()
+ *
+ * Places a member of member_size bytes after the ones already in a
+ * compact struct of *size bytes, at the next offset that is a multiple
+ * of its size, the way a C compiler lays out a struct of scalars.
+ * Updates *size and the struct's *alignment and returns the offset.
+ ************************************************************************/
+static size_t
+h5fnal_pack_member(size_t *size, size_t *alignment, size_t member_size)
+{
+    size_t offset = H5FNAL_ALIGN_UP(*size, member_size);
+
+    *size = offset + member_size;
+    if (member_size > *alignment)
+        *alignment = member_size;
+
+    return offset;
+} /* end h5fnal_pack_member() */
+
+
+/************************************************************************
+ * h5fnal_read_column()
+ *
+ * Reads count elements, starting at element start, of one column into
+ * rows, an array of structs of row_size bytes with the member at
+ * offset. The rows are seen as an array of the member's type, with the
+ * member's values every row_size bytes.
+ ************************************************************************/
+static herr_t
+h5fnal_read_column(h5fnal_column_t *column, hsize_t start, hsize_t count, size_t row_size, size_t offset,
+        void *rows)
+{
+    hid_t file_sid = -1;
+    hid_t memory_sid = -1;
+    hsize_t mem_dims[1];
+    hsize_t mem_start[1];
+    hsize_t mem_stride[1];
+
+    if (offset % column->size != 0 || row_size % column->size != 0)
+        H5FNAL_PROGRAM_ERROR("compound member is not aligned for column reads");
+
+    mem_dims[0] = count * (row_size / column->size);
+    mem_start[0] = offset / column->size;
+    mem_stride[0] = row_size / column->size;
+    if ((memory_sid = H5Screate_simple(1, mem_dims, NULL)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Sselect_hyperslab(memory_sid, H5S_SELECT_SET, mem_start, mem_stride, &count, NULL) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if ((file_sid = H5Dget_space(column->did)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Sselect_hyperslab(file_sid, H5S_SELECT_SET, &start, NULL, &count, NULL) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (H5Dread(column->did, column->tid, memory_sid, file_sid, H5P_DEFAULT, rows) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (H5Sclose(file_sid) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Sclose(memory_sid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Sclose(file_sid);
+        H5Sclose(memory_sid);
+    } H5E_END_TRY;
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_column() */
+
+
+/************************************************************************
+ * h5fnal_check_columns_range()
+ *
+ * Common argument checks for the column reads. Flushes any appended
+ * data and makes sure the range is in the set.
+ ************************************************************************/
+static herr_t
+h5fnal_check_columns_range(h5fnal_column_set_t *set, hsize_t start, hsize_t count, const void *rows)
+{
+    hsize_t size;
+
+    if (NULL == rows)
+        H5FNAL_PROGRAM_ERROR("rows parameter cannot be NULL");
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_column_set(set) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush column set");
+
+    size = h5fnal_get_column_set_size(set);
+    if (start > size || count > size - start)
+        H5FNAL_PROGRAM_ERROR("range is outside the column set");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_check_columns_range() */
+
+
+/************************************************************************
+ * h5fnal_read_columns_range()
+ *
+ * Reads count elements, starting at element start, of the members in
+ * the members mask into rows, an array of C structs matching the
+ * compound datatype. Only the selected columns are read, and the other
+ * members of the structs are left alone.
+ ************************************************************************/
+herr_t
+h5fnal_read_columns_range(h5fnal_column_set_t *set, unsigned members, hsize_t start, hsize_t count,
+        void *rows)
+{
+    unsigned u;
+
+    if (NULL == set)
+        H5FNAL_PROGRAM_ERROR("set parameter cannot be NULL");
+
+    /* Trivial case of no elements */
+    if (0 == count)
+        return H5FNAL_SUCCESS;
+
+    if (h5fnal_check_columns_range(set, start, count, rows) < 0)
+        H5FNAL_PROGRAM_ERROR("bad column range");
+
+    for (u = 0; u < set->n_columns; u++) {
+        h5fnal_column_t *column = &set->columns[u];
+
+        if (0 == (members & (1U << u)))
+            continue;
+
+        if (h5fnal_read_column(column, start, count, set->row_size, column->offset, rows) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read column");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_columns_range() */
+
+
+/************************************************************************
+ * h5fnal_read_columns_projected()
+ *
+ * Like h5fnal_read_columns_range(), but rows is an array of compact
+ * structs holding only the members in the members mask, laid out like
+ * h5fnal_create_projection_type() does.
+ ************************************************************************/
+herr_t
+h5fnal_read_columns_projected(h5fnal_column_set_t *set, unsigned members, hsize_t start, hsize_t count,
+        void *rows)
+{
+    size_t offsets[H5FNAL_MAX_COLUMNS];
+    size_t row_size = 0;
+    size_t alignment = 1;
+    unsigned u;
+
+    if (NULL == set)
+        H5FNAL_PROGRAM_ERROR("set parameter cannot be NULL");
+
+    /* Lay out the compact struct */
+    for (u = 0; u < set->n_columns; u++) {
+        if (0 == (members & (1U << u)))
+            continue;
+        offsets[u] = h5fnal_pack_member(&row_size, &alignment, set->columns[u].size);
+    }
+    if (0 == row_size)
+        H5FNAL_PROGRAM_ERROR("no compound members selected");
+    row_size = H5FNAL_ALIGN_UP(row_size, alignment);
+
+    /* Trivial case of no elements */
+    if (0 == count)
+        return H5FNAL_SUCCESS;
+
+    if (h5fnal_check_columns_range(set, start, count, rows) < 0)
+        H5FNAL_PROGRAM_ERROR("bad column range");
+
+    for (u = 0; u < set->n_columns; u++) {
+        if (0 == (members & (1U << u)))
+            continue;
+
+        if (h5fnal_read_column(&set->columns[u], start, count, row_size, offsets[u], rows) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read column");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_columns_projected() */
+
+
+/************************************************************************
+ * h5fnal_create_projection_type()
+ *
+ * Creates and returns a compound datatype with only the members of tid
+ * in the members mask, packed in member order at the offsets a C
+ * compiler would give them. It describes a compact struct declaring
+ * just those members in the same order, so reading a row dataset with
+ * it only converts and stores the selected members.
+ ************************************************************************/
+hid_t
+h5fnal_create_projection_type(hid_t tid, unsigned members)
+{
+    hid_t projection_tid = H5FNAL_BAD_HID_T;
+    hid_t member_tid = H5FNAL_BAD_HID_T;
+    char *name = NULL;
+    size_t offsets[H5FNAL_MAX_COLUMNS];
+    size_t size = 0;
+    size_t alignment = 1;
+    size_t member_size;
+    int n_members;
+    unsigned u;
+
+    if (H5T_COMPOUND != H5Tget_class(tid))
+        H5FNAL_PROGRAM_ERROR("projection types need a compound datatype");
+    if ((n_members = H5Tget_nmembers(tid)) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    /* Lay out the compact struct */
+    for (u = 0; u < (unsigned)n_members && u < H5FNAL_MAX_COLUMNS; u++) {
+        if (0 == (members & (1U << u)))
+            continue;
+
+        if ((member_tid = H5Tget_member_type(tid, u)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (0 == (member_size = H5Tget_size(member_tid)))
+            H5FNAL_HDF5_ERROR;
+        if (H5Tclose(member_tid) < 0)
+            H5FNAL_HDF5_ERROR;
+        member_tid = H5FNAL_BAD_HID_T;
+
+        offsets[u] = h5fnal_pack_member(&size, &alignment, member_size);
+    }
+    if (0 == size)
+        H5FNAL_PROGRAM_ERROR("no compound members selected");
+
+    if ((projection_tid = H5Tcreate(H5T_COMPOUND, H5FNAL_ALIGN_UP(size, alignment))) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    for (u = 0; u < (unsigned)n_members && u < H5FNAL_MAX_COLUMNS; u++) {
+        if (0 == (members & (1U << u)))
+            continue;
+
+        if (NULL == (name = H5Tget_member_name(tid, u)))
+            H5FNAL_HDF5_ERROR;
+        if ((member_tid = H5Tget_member_type(tid, u)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (H5Tinsert(projection_tid, name, offsets[u], member_tid) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (H5Tclose(member_tid) < 0)
+            H5FNAL_HDF5_ERROR;
+        member_tid = H5FNAL_BAD_HID_T;
+        H5free_memory(name);
+        name = NULL;
+    }
+
+    return projection_tid;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Tclose(member_tid);
+        H5Tclose(projection_tid);
+    } H5E_END_TRY;
+    H5free_memory(name);
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_create_projection_type() */
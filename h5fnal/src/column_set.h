@@ -0,0 +1,87 @@
+/* column_set.h
+ *
+ * Column-split (struct-of-arrays) storage for compound datasets.
+ *
+ * A column set stores each member of a compound datatype as its own 1D
+ * dataset, named after the member, in a group. Readers that only need
+ * a few of the members only read and decompress those, and each
+ * dataset holds values of a single type, which the shuffle filter
+ * handles much better than interleaved rows. Elements still go in and
+ * come out as arrays of the compound's C struct.
+ *
+ * Members are selected with a bit mask, where bit i is member i of
+ * the compound datatype.
+ *
+ * Projected reads fill in compact structs that only declare the
+ * selected members, in the compound's member order. They work on both
+ * column sets and, through h5fnal_create_projection_type(), ordinary
+ * row datasets.
+ */
+
+#ifndef H5FNAL_COLUMN_SET_H
+#define H5FNAL_COLUMN_SET_H
+
+#include "h5fnal.h"
+
+/* Most members a compound datatype can have to be stored as columns
+ * (one bit of the member mask each)
+ */
+#define H5FNAL_MAX_COLUMNS          32
+
+/* All the members of a compound datatype */
+#define H5FNAL_ALL_MEMBERS          0xFFFFFFFFU
+
+/* Size of the buffer columns are gathered into for appends */
+#define H5FNAL_COLUMN_SCRATCH_BYTES 65536
+
+/* One member of the compound datatype and its dataset */
+typedef struct h5fnal_column_t {
+    char                   *name;       /* member (and dataset) name            */
+    size_t                  offset;     /* of the member in the C struct        */
+    size_t                  size;       /* of the member                        */
+    hid_t                   tid;        /* member datatype                      */
+    hid_t                   did;        /* dataset (negative until created)     */
+    h5fnal_append_buffer_t  buffer;
+} h5fnal_column_t;
+
+/* Column set
+ *
+ * The column datasets are created as they are needed, like any other
+ * appended dataset (see h5fnal_defer_append_buffer()), so every column
+ * has the same number of elements. The group ID is owned by the set.
+ */
+typedef struct h5fnal_column_set_t {
+    hid_t               gid;            /* group holding the column datasets    */
+    size_t              row_size;       /* size of the compound datatype        */
+    unsigned            n_columns;
+    h5fnal_column_t    *columns;
+    void               *scratch;        /* H5FNAL_COLUMN_SCRATCH_BYTES          */
+} h5fnal_column_set_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+htri_t h5fnal_is_column_set(hid_t loc_id, const char *name);
+
+herr_t h5fnal_create_column_set(hid_t loc_id, const char *name, hid_t tid, const h5fnal_create_options_t *options,
+        h5fnal_column_set_t *set);
+herr_t h5fnal_open_column_set(hid_t loc_id, const char *name, hid_t tid, h5fnal_column_set_t *set);
+herr_t h5fnal_close_column_set(h5fnal_column_set_t *set);
+herr_t h5fnal_free_column_set(h5fnal_column_set_t *set);
+
+herr_t h5fnal_append_columns(h5fnal_column_set_t *set, hsize_t n_rows, const void *rows);
+herr_t h5fnal_sync_column_set(h5fnal_column_set_t *set);
+hsize_t h5fnal_get_column_set_size(const h5fnal_column_set_t *set);
+herr_t h5fnal_read_columns_range(h5fnal_column_set_t *set, unsigned members, hsize_t start, hsize_t count,
+        void *rows);
+herr_t h5fnal_read_columns_projected(h5fnal_column_set_t *set, unsigned members, hsize_t start, hsize_t count,
+        void *rows);
+
+hid_t h5fnal_create_projection_type(hid_t tid, unsigned members);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H5FNAL_COLUMN_SET_H */
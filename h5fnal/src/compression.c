@@ -0,0 +1,590 @@
+/* compression.c
+ *
+ * Compression profiles and the in-tree LZ4 and Zstandard filters.
+ *
+ * The LZ4 and Zstandard filters are only compiled in when the library
+ * is built with H5FNAL_HAVE_LZ4 / H5FNAL_HAVE_ZSTD (see the Makefile).
+ * They write the same byte streams as the HDF Group's plugins for the
+ * same filter IDs.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#ifdef H5FNAL_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef H5FNAL_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "h5fnal.h"
+
+#ifdef H5FNAL_HAVE_LZ4
+
+/* LZ4 data is compressed in blocks of at most this many bytes */
+#define H5FNAL_LZ4_DEFAULT_BLOCK_SIZE   (1U << 30)
+
+/* Big-endian integer encode/decode for the LZ4 stream headers */
+static void
+h5fnal_encode_be(unsigned char *p, unsigned long long value, int n_bytes)
+{
+    int i;
+
+    for (i = n_bytes - 1; i >= 0; i--) {
+        p[i] = (unsigned char)(value & 0xFF);
+        value >>= 8;
+    }
+
+    return;
+} /* end h5fnal_encode_be() */
+
+static unsigned long long
+h5fnal_decode_be(const unsigned char *p, int n_bytes)
+{
+    unsigned long long value = 0;
+    int i;
+
+    for (i = 0; i < n_bytes; i++)
+        value = (value << 8) | p[i];
+
+    return value;
+} /* end h5fnal_decode_be() */
+
+/************************************************************************
+ * h5fnal_filter_lz4()
+ *
+ * Stream layout (all integers big-endian):
+ *
+ *      8 bytes     uncompressed size
+ *      4 bytes     block size
+ *      per block:  4 byte compressed block size, then the block
+ *
+ * A block whose compressed size equals its uncompressed size is stored
+ * as-is.
+ ************************************************************************/
+static size_t
+h5fnal_filter_lz4(unsigned int flags, size_t cd_nelmts, const unsigned int cd_values[],
+        size_t nbytes, size_t *buf_size, void **buf)
+{
+    const unsigned char *in = (const unsigned char *)*buf;
+    unsigned char *out = NULL;
+    unsigned char *pos;
+    size_t out_size;
+    size_t block_size;
+    size_t done;
+
+    if (flags & H5Z_FLAG_REVERSE) {
+        const unsigned char *end = in + nbytes;
+        size_t orig_size;
+
+        if (nbytes < 12)
+            goto error;
+
+        orig_size = (size_t)h5fnal_decode_be(in, 8);
+        block_size = (size_t)h5fnal_decode_be(in + 8, 4);
+        if (block_size > orig_size)
+            block_size = orig_size;
+        in += 12;
+
+        if (NULL == (out = (unsigned char *)malloc(orig_size > 0 ? orig_size : 1)))
+            goto error;
+
+        done = 0;
+        while (done < orig_size) {
+            size_t comp_size;
+
+            if (orig_size - done < block_size)
+                block_size = orig_size - done;
+
+            if ((size_t)(end - in) < 4)
+                goto error;
+            comp_size = (size_t)h5fnal_decode_be(in, 4);
+            in += 4;
+            if ((size_t)(end - in) < comp_size)
+                goto error;
+
+            if (comp_size == block_size)
+                memcpy(out + done, in, block_size);
+            else if (LZ4_decompress_safe((const char *)in, (char *)out + done, (int)comp_size, (int)block_size) != (int)block_size)
+                goto error;
+
+            in += comp_size;
+            done += block_size;
+        }
+
+        out_size = orig_size;
+    }
+    else {
+        size_t n_blocks;
+        size_t max_size;
+
+        block_size = H5FNAL_LZ4_DEFAULT_BLOCK_SIZE;
+        if (cd_nelmts > 0 && cd_values[0] > 0)
+            block_size = cd_values[0];
+        if (block_size > nbytes)
+            block_size = nbytes;
+        n_blocks = block_size > 0 ? (nbytes + block_size - 1) / block_size : 0;
+
+        max_size = 12 + n_blocks * (4 + (size_t)LZ4_compressBound((int)block_size));
+        if (NULL == (out = (unsigned char *)malloc(max_size)))
+            goto error;
+
+        h5fnal_encode_be(out, (unsigned long long)nbytes, 8);
+        h5fnal_encode_be(out + 8, (unsigned long long)block_size, 4);
+        pos = out + 12;
+
+        done = 0;
+        while (done < nbytes) {
+            int comp_size;
+
+            if (nbytes - done < block_size)
+                block_size = nbytes - done;
+
+            comp_size = LZ4_compress_default((const char *)in + done, (char *)pos + 4,
+                    (int)block_size, LZ4_compressBound((int)block_size));
+            if (comp_size <= 0)
+                goto error;
+
+            /* Store incompressible blocks as-is */
+            if ((size_t)comp_size >= block_size) {
+                memcpy(pos + 4, in + done, block_size);
+                comp_size = (int)block_size;
+            }
+
+            h5fnal_encode_be(pos, (unsigned long long)comp_size, 4);
+            pos += 4 + comp_size;
+            done += block_size;
+        }
+
+        out_size = (size_t)(pos - out);
+    }
+
+    free(*buf);
+    *buf = out;
+    *buf_size = out_size;
+
+    return out_size;
+
+error:
+    free(out);
+    return 0;
+} /* end h5fnal_filter_lz4() */
+
+static const H5Z_class2_t H5FNAL_LZ4_FILTER[1] = {{
+    H5Z_CLASS_T_VERS,
+    (H5Z_filter_t)H5FNAL_FILTER_LZ4,
+    1, 1,
+    "HDF5 lz4 filter; see http://www.hdfgroup.org/services/contributions.html",
+    NULL,
+    NULL,
+    (H5Z_func_t)h5fnal_filter_lz4
+}};
+
+#endif /* H5FNAL_HAVE_LZ4 */
+
+#ifdef H5FNAL_HAVE_ZSTD
+
+/************************************************************************
+ * h5fnal_filter_zstd()
+ *
+ * Chunks are stored as a single Zstandard frame. cd_values[0] is the
+ * compression level.
+ ************************************************************************/
+static size_t
+h5fnal_filter_zstd(unsigned int flags, size_t cd_nelmts, const unsigned int cd_values[],
+        size_t nbytes, size_t *buf_size, void **buf)
+{
+    void *out = NULL;
+    size_t out_size;
+
+    if (flags & H5Z_FLAG_REVERSE) {
+        unsigned long long orig_size;
+
+        orig_size = ZSTD_getFrameContentSize(*buf, nbytes);
+        if (ZSTD_CONTENTSIZE_ERROR == orig_size || ZSTD_CONTENTSIZE_UNKNOWN == orig_size)
+            goto error;
+
+        if (NULL == (out = malloc(orig_size > 0 ? (size_t)orig_size : 1)))
+            goto error;
+
+        out_size = ZSTD_decompress(out, (size_t)orig_size, *buf, nbytes);
+        if (ZSTD_isError(out_size))
+            goto error;
+    }
+    else {
+        int level = H5FNAL_DEFAULT_ZSTD_LEVEL;
+        size_t max_size;
+
+        if (cd_nelmts > 0 && cd_values[0] > 0)
+            level = (int)cd_values[0];
+
+        max_size = ZSTD_compressBound(nbytes);
+        if (NULL == (out = malloc(max_size)))
+            goto error;
+
+        out_size = ZSTD_compress(out, max_size, *buf, nbytes, level);
+        if (ZSTD_isError(out_size))
+            goto error;
+    }
+
+    free(*buf);
+    *buf = out;
+    *buf_size = out_size;
+
+    return out_size;
+
+error:
+    free(out);
+    return 0;
+} /* end h5fnal_filter_zstd() */
+
+static const H5Z_class2_t H5FNAL_ZSTD_FILTER[1] = {{
+    H5Z_CLASS_T_VERS,
+    (H5Z_filter_t)H5FNAL_FILTER_ZSTD,
+    1, 1,
+    "Zstandard compression: http://www.zstd.net",
+    NULL,
+    NULL,
+    (H5Z_func_t)h5fnal_filter_zstd
+}};
+
+#endif /* H5FNAL_HAVE_ZSTD */
+
+
+/************************************************************************
+ * h5fnal_register_filters()
+ *
+ * Registers the in-tree LZ4 and Zstandard filters with HDF5 unless a
+ * filter with the same ID (e.g. a plugin) is already available. This
+ * needs to happen before datasets using those filters are created or
+ * read and is cheap to call more than once.
+ ************************************************************************/
+herr_t
+h5fnal_register_filters(void)
+{
+#if defined(H5FNAL_HAVE_LZ4) || defined(H5FNAL_HAVE_ZSTD)
+    htri_t avail;
+#endif
+
+#ifdef H5FNAL_HAVE_LZ4
+    H5E_BEGIN_TRY {
+        avail = H5Zfilter_avail(H5FNAL_FILTER_LZ4);
+    } H5E_END_TRY;
+    if (avail <= 0)
+        if (H5Zregister(H5FNAL_LZ4_FILTER) < 0)
+            H5FNAL_HDF5_ERROR;
+#endif
+#ifdef H5FNAL_HAVE_ZSTD
+    H5E_BEGIN_TRY {
+        avail = H5Zfilter_avail(H5FNAL_FILTER_ZSTD);
+    } H5E_END_TRY;
+    if (avail <= 0)
+        if (H5Zregister(H5FNAL_ZSTD_FILTER) < 0)
+            H5FNAL_HDF5_ERROR;
+#endif
+
+    return H5FNAL_SUCCESS;
+
+#if defined(H5FNAL_HAVE_LZ4) || defined(H5FNAL_HAVE_ZSTD)
+error:
+    return H5FNAL_FAILURE;
+#endif
+} /* end h5fnal_register_filters() */
+
+
+/************************************************************************
+ * h5fnal_compression_available()
+ *
+ * Returns TRUE if datasets can be written with the given compression
+ * method, either via an HDF5 plugin or the in-tree filters.
+ ************************************************************************/
+hbool_t
+h5fnal_compression_available(h5fnal_compression_method_t method)
+{
+    H5Z_filter_t filter;
+    htri_t avail;
+
+    switch (method) {
+        case H5FNAL_COMPRESSION_NONE:
+            return TRUE;
+        case H5FNAL_COMPRESSION_DEFLATE:
+            filter = H5Z_FILTER_DEFLATE;
+            break;
+        case H5FNAL_COMPRESSION_LZ4:
+            filter = H5FNAL_FILTER_LZ4;
+            break;
+        case H5FNAL_COMPRESSION_ZSTD:
+            filter = H5FNAL_FILTER_ZSTD;
+            break;
+        default:
+            return FALSE;
+    }
+
+    if (h5fnal_register_filters() < 0)
+        return FALSE;
+
+    H5E_BEGIN_TRY {
+        avail = H5Zfilter_avail(filter);
+    } H5E_END_TRY;
+
+    return avail > 0 ? TRUE : FALSE;
+} /* end h5fnal_compression_available() */
+
+
+/************************************************************************
+ * h5fnal_set_compression()
+ *
+ * Sets up the filter chain for a compression profile on a dataset
+ * creation property list. type_size is the size of the dataset's
+ * datatype and is used to decide if shuffling is worthwhile.
+ ************************************************************************/
+herr_t
+h5fnal_set_compression(hid_t dcpl_id, const h5fnal_compression_t *compression, size_t type_size)
+{
+    h5fnal_compression_method_t method;
+    unsigned int cd_values[1];
+    int level;
+
+    if (dcpl_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid dcpl_id parameter");
+    if (NULL == compression)
+        H5FNAL_PROGRAM_ERROR("compression parameter cannot be NULL");
+
+    method = compression->method;
+    level = compression->level;
+
+    /* Fall back to deflate when the requested filter can't be used */
+    if (!h5fnal_compression_available(method)) {
+        method = H5FNAL_COMPRESSION_DEFLATE;
+        level = H5FNAL_DEFAULT_DEFLATE_LEVEL;
+    }
+
+    if (H5FNAL_COMPRESSION_NONE == method)
+        return H5FNAL_SUCCESS;
+
+    /* Shuffling single bytes doesn't do anything */
+    if (compression->shuffle && type_size > 1)
+        if (H5Pset_shuffle(dcpl_id) < 0)
+            H5FNAL_HDF5_ERROR;
+
+    switch (method) {
+        case H5FNAL_COMPRESSION_DEFLATE:
+            if (level <= 0)
+                level = H5FNAL_DEFAULT_DEFLATE_LEVEL;
+            if (level > 9)
+                level = 9;
+            if (H5Pset_deflate(dcpl_id, (unsigned)level) < 0)
+                H5FNAL_HDF5_ERROR;
+            break;
+
+        case H5FNAL_COMPRESSION_LZ4:
+            if (H5Pset_filter(dcpl_id, H5FNAL_FILTER_LZ4, H5Z_FLAG_OPTIONAL, 0, NULL) < 0)
+                H5FNAL_HDF5_ERROR;
+            break;
+
+        case H5FNAL_COMPRESSION_ZSTD:
+            cd_values[0] = (unsigned int)(level > 0 ? level : H5FNAL_DEFAULT_ZSTD_LEVEL);
+            if (H5Pset_filter(dcpl_id, H5FNAL_FILTER_ZSTD, H5Z_FLAG_OPTIONAL, 1, cd_values) < 0)
+                H5FNAL_HDF5_ERROR;
+            break;
+
+        case H5FNAL_COMPRESSION_NONE:
+        default:
+            H5FNAL_PROGRAM_ERROR("invalid compression method");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_set_compression() */
+
+
+/************************************************************************
+ * h5fnal_get_filter_pipeline()
+ *
+ * Copies the filter pipeline from a dataset creation property list.
+ * Returns FALSE if the pipeline contains a filter that
+ * h5fnal_filter_chunk() can't apply.
+ *
+ * The property list should come from H5Dget_create_plist() so that the
+ * filters' local parameters (e.g. the shuffle element size) are set.
+ ************************************************************************/
+htri_t
+h5fnal_get_filter_pipeline(hid_t dcpl_id, h5fnal_filter_pipeline_t *pipeline)
+{
+    int n_filters;
+    int i;
+
+    if (dcpl_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid dcpl_id parameter");
+    if (NULL == pipeline)
+        H5FNAL_PROGRAM_ERROR("pipeline parameter cannot be NULL");
+
+    memset(pipeline, 0, sizeof(h5fnal_filter_pipeline_t));
+
+    if ((n_filters = H5Pget_nfilters(dcpl_id)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (n_filters > H5FNAL_MAX_PIPELINE_FILTERS)
+        return FALSE;
+
+    for (i = 0; i < n_filters; i++) {
+        h5fnal_pipeline_filter_t *filter = &pipeline->filters[i];
+
+        filter->cd_nelmts = H5FNAL_MAX_FILTER_CD_VALUES;
+        if ((filter->id = H5Pget_filter2(dcpl_id, (unsigned)i, &filter->flags, &filter->cd_nelmts,
+                filter->cd_values, 0, NULL, NULL)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (filter->cd_nelmts > H5FNAL_MAX_FILTER_CD_VALUES)
+            return FALSE;
+
+        switch (filter->id) {
+            case H5Z_FILTER_SHUFFLE:
+            case H5Z_FILTER_DEFLATE:
+#ifdef H5FNAL_HAVE_LZ4
+            case H5FNAL_FILTER_LZ4:
+#endif
+#ifdef H5FNAL_HAVE_ZSTD
+            case H5FNAL_FILTER_ZSTD:
+#endif
+                break;
+            default:
+                return FALSE;
+        }
+    }
+
+    pipeline->n_filters = n_filters;
+
+    return TRUE;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_get_filter_pipeline() */
+
+
+/* Byte shuffle, as done by the HDF5 shuffle filter */
+static size_t
+h5fnal_filter_shuffle(size_t elem_size, size_t nbytes, size_t *buf_size, void **buf)
+{
+    const unsigned char *in = (const unsigned char *)*buf;
+    unsigned char *out = NULL;
+    size_t n_elements;
+    size_t leftover;
+    size_t i;
+    size_t j;
+
+    n_elements = elem_size > 0 ? nbytes / elem_size : 0;
+
+    /* Nothing to do */
+    if (elem_size <= 1 || n_elements <= 1)
+        return nbytes;
+
+    if (NULL == (out = (unsigned char *)malloc(nbytes)))
+        return 0;
+
+    for (i = 0; i < elem_size; i++)
+        for (j = 0; j < n_elements; j++)
+            out[i * n_elements + j] = in[j * elem_size + i];
+
+    /* Bytes that don't make up a whole element are copied as-is */
+    leftover = nbytes % elem_size;
+    if (leftover > 0)
+        memcpy(out + nbytes - leftover, in + nbytes - leftover, leftover);
+
+    free(*buf);
+    *buf = out;
+    *buf_size = nbytes;
+
+    return nbytes;
+} /* end h5fnal_filter_shuffle() */
+
+
+/* zlib compression, as done by the HDF5 deflate filter */
+static size_t
+h5fnal_filter_deflate(int level, size_t nbytes, size_t *buf_size, void **buf)
+{
+    unsigned char *out = NULL;
+    uLongf out_size;
+
+    out_size = compressBound((uLong)nbytes);
+    if (NULL == (out = (unsigned char *)malloc((size_t)out_size)))
+        return 0;
+
+    if (Z_OK != compress2(out, &out_size, (const Bytef *)*buf, (uLong)nbytes, level)) {
+        free(out);
+        return 0;
+    }
+
+    free(*buf);
+    *buf = out;
+    *buf_size = (size_t)out_size;
+
+    return (size_t)out_size;
+} /* end h5fnal_filter_deflate() */
+
+
+/************************************************************************
+ * h5fnal_filter_chunk()
+ *
+ * Runs a chunk's worth of data through a filter pipeline without going
+ * through the HDF5 library, so it can be called from several threads
+ * at once. The result can be stored with H5Dwrite_chunk().
+ *
+ * *buf must be malloc()ed and may be replaced. On entry *nbytes is the
+ * size of the data and on exit it's the size of the filtered data.
+ * Optional filters that fail are skipped and marked in *filter_mask,
+ * the same way the library does it.
+ ************************************************************************/
+herr_t
+h5fnal_filter_chunk(const h5fnal_filter_pipeline_t *pipeline, void **buf, size_t *buf_size,
+        size_t *nbytes, unsigned *filter_mask)
+{
+    int i;
+
+    if (NULL == pipeline || NULL == buf || NULL == *buf || NULL == buf_size || NULL == nbytes || NULL == filter_mask)
+        return H5FNAL_FAILURE;
+
+    *filter_mask = 0;
+
+    for (i = 0; i < pipeline->n_filters; i++) {
+        const h5fnal_pipeline_filter_t *filter = &pipeline->filters[i];
+        size_t ret = 0;
+
+        switch (filter->id) {
+            case H5Z_FILTER_SHUFFLE:
+                ret = h5fnal_filter_shuffle(filter->cd_nelmts > 0 ? filter->cd_values[0] : 1,
+                        *nbytes, buf_size, buf);
+                break;
+            case H5Z_FILTER_DEFLATE:
+                ret = h5fnal_filter_deflate(filter->cd_nelmts > 0 ? (int)filter->cd_values[0] : H5FNAL_DEFAULT_DEFLATE_LEVEL,
+                        *nbytes, buf_size, buf);
+                break;
+#ifdef H5FNAL_HAVE_LZ4
+            case H5FNAL_FILTER_LZ4:
+                ret = h5fnal_filter_lz4(0, filter->cd_nelmts, filter->cd_values, *nbytes, buf_size, buf);
+                break;
+#endif
+#ifdef H5FNAL_HAVE_ZSTD
+            case H5FNAL_FILTER_ZSTD:
+                ret = h5fnal_filter_zstd(0, filter->cd_nelmts, filter->cd_values, *nbytes, buf_size, buf);
+                break;
+#endif
+            default:
+                return H5FNAL_FAILURE;
+        }
+
+        if (0 == ret) {
+            if (filter->flags & H5Z_FLAG_OPTIONAL)
+                *filter_mask |= 1U << i;
+            else
+                return H5FNAL_FAILURE;
+        }
+        else
+            *nbytes = ret;
+    }
+
+    return H5FNAL_SUCCESS;
+} /* end h5fnal_filter_chunk() */
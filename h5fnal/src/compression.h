@@ -0,0 +1,88 @@
+/* compression.h
+ *
+ * Compression profiles and the in-tree LZ4 and Zstandard filters.
+ */
+
+#ifndef H5FNAL_COMPRESSION_H
+#define H5FNAL_COMPRESSION_H
+
+#include "h5fnal.h"
+
+/* Registered HDF5 filter IDs for the optional compressors. These are
+ * the IDs the HDF Group assigned to the LZ4 and Zstandard plugins, so
+ * files written with the in-tree filters can be read with the stock
+ * plugins and vice versa.
+ */
+#define H5FNAL_FILTER_LZ4       32004
+#define H5FNAL_FILTER_ZSTD      32015
+
+/* Default compression levels */
+#define H5FNAL_DEFAULT_DEFLATE_LEVEL    6
+#define H5FNAL_DEFAULT_ZSTD_LEVEL       3
+
+typedef enum h5fnal_compression_method_t {
+    H5FNAL_COMPRESSION_NONE = 0,
+    H5FNAL_COMPRESSION_DEFLATE,
+    H5FNAL_COMPRESSION_LZ4,
+    H5FNAL_COMPRESSION_ZSTD
+} h5fnal_compression_method_t;
+
+/* Compression profile
+ *
+ * level is the deflate (0-9) or Zstandard (1-22) level and is ignored
+ * for the other methods. A level of zero or less picks the method's
+ * default. Shuffle is only applied when there is a compressor after
+ * it and the datatype is wider than one byte.
+ *
+ * If LZ4 or Zstandard is requested but neither an HDF5 plugin nor the
+ * in-tree filter is available, the dataset falls back to deflate.
+ */
+typedef struct h5fnal_compression_t {
+    h5fnal_compression_method_t method;
+    int                         level;
+    hbool_t                     shuffle;
+} h5fnal_compression_t;
+
+/* Compression profile for a single dataset in a data product,
+ * overriding the product-wide profile.
+ */
+typedef struct h5fnal_dset_compression_t {
+    const char                 *dset_name;
+    h5fnal_compression_t        compression;
+} h5fnal_dset_compression_t;
+
+/* A dataset's filter pipeline, for filtering chunks outside the
+ * HDF5 library (see h5fnal_filter_chunk()).
+ */
+#define H5FNAL_MAX_PIPELINE_FILTERS     4
+#define H5FNAL_MAX_FILTER_CD_VALUES     8
+
+typedef struct h5fnal_pipeline_filter_t {
+    H5Z_filter_t    id;
+    unsigned int    flags;
+    size_t          cd_nelmts;
+    unsigned int    cd_values[H5FNAL_MAX_FILTER_CD_VALUES];
+} h5fnal_pipeline_filter_t;
+
+typedef struct h5fnal_filter_pipeline_t {
+    int                         n_filters;
+    h5fnal_pipeline_filter_t    filters[H5FNAL_MAX_PIPELINE_FILTERS];
+} h5fnal_filter_pipeline_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+herr_t h5fnal_register_filters(void);
+hbool_t h5fnal_compression_available(h5fnal_compression_method_t method);
+herr_t h5fnal_set_compression(hid_t dcpl_id, const h5fnal_compression_t *compression, size_t type_size);
+
+htri_t h5fnal_get_filter_pipeline(hid_t dcpl_id, h5fnal_filter_pipeline_t *pipeline);
+herr_t h5fnal_filter_chunk(const h5fnal_filter_pipeline_t *pipeline, void **buf, size_t *buf_size,
+        size_t *nbytes, unsigned *filter_mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H5FNAL_COMPRESSION_H */
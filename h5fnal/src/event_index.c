@@ -0,0 +1,713 @@
+/* event_index.c
+ *
+ * Event index for the flat file layout.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "h5fnal.h"
+
+#define INITIAL_N_ENTRIES   64
+
+
+/************************************************************************
+ * h5fnal_create_event_entry_type()
+ *
+ * Creates and returns an HDF5 compound datatype that represents an
+ * event index entry. The row ranges are stored as fixed-size arrays.
+ ************************************************************************/
+hid_t
+h5fnal_create_event_entry_type(void)
+{
+    hid_t tid = H5FNAL_BAD_HID_T;
+    hid_t range_tid = H5FNAL_BAD_HID_T;
+    hsize_t dim = H5FNAL_MAX_EVENT_RANGES;
+
+    if ((tid = H5Tcreate(H5T_COMPOUND, sizeof(h5fnal_event_entry_t))) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((range_tid = H5Tarray_create2(H5T_NATIVE_HSIZE, 1, &dim)) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (H5Tinsert(tid, "run", HOFFSET(h5fnal_event_entry_t, run), H5T_NATIVE_UINT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "subrun", HOFFSET(h5fnal_event_entry_t, subrun), H5T_NATIVE_UINT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "event", HOFFSET(h5fnal_event_entry_t, event), H5T_NATIVE_UINT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "start", HOFFSET(h5fnal_event_entry_t, start), range_tid) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "count", HOFFSET(h5fnal_event_entry_t, count), range_tid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (H5Tclose(range_tid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return tid;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Tclose(range_tid);
+        H5Tclose(tid);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_create_event_entry_type() */
+
+
+/************************************************************************
+ * h5fnal_create_event_addr_type()
+ *
+ * Creates and returns an HDF5 compound datatype that represents an
+ * event lookup entry.
+ ************************************************************************/
+hid_t
+h5fnal_create_event_addr_type(void)
+{
+    hid_t tid = H5FNAL_BAD_HID_T;
+
+    if ((tid = H5Tcreate(H5T_COMPOUND, sizeof(h5fnal_event_addr_t))) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (H5Tinsert(tid, "run", HOFFSET(h5fnal_event_addr_t, run), H5T_NATIVE_UINT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "subrun", HOFFSET(h5fnal_event_addr_t, subrun), H5T_NATIVE_UINT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "event", HOFFSET(h5fnal_event_addr_t, event), H5T_NATIVE_UINT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "addr", HOFFSET(h5fnal_event_addr_t, addr), H5T_NATIVE_HADDR) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return tid;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Tclose(tid);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_create_event_addr_type() */
+
+
+/************************************************************************
+ * h5fnal_compare_event_keys()
+ *
+ * qsort() comparison function for anything that starts with an
+ * h5fnal_event_key_t.
+ ************************************************************************/
+int
+h5fnal_compare_event_keys(const void *a, const void *b)
+{
+    const h5fnal_event_key_t *ka = (const h5fnal_event_key_t *)a;
+    const h5fnal_event_key_t *kb = (const h5fnal_event_key_t *)b;
+
+    if (ka->run != kb->run)
+        return ka->run < kb->run ? -1 : 1;
+    if (ka->subrun != kb->subrun)
+        return ka->subrun < kb->subrun ? -1 : 1;
+    if (ka->event != kb->event)
+        return ka->event < kb->event ? -1 : 1;
+    return 0;
+} /* end h5fnal_compare_event_keys() */
+
+
+/************************************************************************
+ * h5fnal_search_events()
+ *
+ * Binary search of n sorted entries of the given size for an event.
+ * Returns the position of the first entry that isn't less than the
+ * event, which is where the event is if *found is set, and where it
+ * would be inserted otherwise.
+ ************************************************************************/
+hsize_t
+h5fnal_search_events(const void *entries, hsize_t n, size_t size, const h5fnal_event_key_t *key, hbool_t *found)
+{
+    hsize_t lo = 0;
+    hsize_t hi = n;
+
+    while (lo < hi) {
+        hsize_t mid = lo + (hi - lo) / 2;
+
+        if (h5fnal_compare_event_keys((const char *)entries + mid * size, key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *found = (lo < n && 0 == h5fnal_compare_event_keys((const char *)entries + lo * size, key)) ? TRUE : FALSE;
+
+    return lo;
+} /* end h5fnal_search_events() */
+
+
+/************************************************************************
+ * h5fnal_events_are_sorted()
+ ************************************************************************/
+hbool_t
+h5fnal_events_are_sorted(const void *entries, hsize_t n, size_t size)
+{
+    hsize_t u;
+
+    for (u = 1; u < n; u++)
+        if (h5fnal_compare_event_keys((const char *)entries + (u - 1) * size, (const char *)entries + u * size) > 0)
+            return FALSE;
+
+    return TRUE;
+} /* end h5fnal_events_are_sorted() */
+
+
+/************************************************************************
+ * h5fnal_close_index_on_err()
+ ************************************************************************/
+static void
+h5fnal_close_index_on_err(h5fnal_event_index_t *index)
+{
+    if (index) {
+        H5E_BEGIN_TRY {
+            H5Dclose(index->dset_id);
+            h5fnal_release_type(index->dtype_id);
+        } H5E_END_TRY;
+
+        h5fnal_free_append_buffer(&index->buffer);
+        free(index->entries);
+
+        memset(index, 0, sizeof(h5fnal_event_index_t));
+        index->dset_id = H5FNAL_BAD_HID_T;
+        index->dtype_id = H5FNAL_BAD_HID_T;
+    }
+
+    return;
+} /* end h5fnal_close_index_on_err() */
+
+
+/************************************************************************
+ * h5fnal_reserve_event_entries()
+ *
+ * Grows an array of entries of the given size so it can hold at least
+ * n of them.
+ ************************************************************************/
+herr_t
+h5fnal_reserve_event_entries(void **entries, hsize_t *n_allocated, hsize_t n, size_t size)
+{
+    void *new_entries = NULL;
+    hsize_t new_n_allocated;
+
+    if (n <= *n_allocated)
+        return H5FNAL_SUCCESS;
+
+    new_n_allocated = H5FNAL_MAX(*n_allocated, INITIAL_N_ENTRIES);
+    while (new_n_allocated < n)
+        new_n_allocated *= 2;
+
+    if (NULL == (new_entries = realloc(*entries, new_n_allocated * size)))
+        H5FNAL_PROGRAM_ERROR("could not reallocate memory for event entries");
+
+    *entries = new_entries;
+    *n_allocated = new_n_allocated;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_reserve_event_entries() */
+
+
+/************************************************************************
+ * h5fnal_create_event_index()
+ *
+ * Creates an empty event index in loc_id (normally a data product's
+ * top-level group). As with the data products, the dataset is created
+ * when the first entry is added.
+ ************************************************************************/
+herr_t
+h5fnal_create_event_index(hid_t loc_id, const h5fnal_create_options_t *options, h5fnal_event_index_t *index)
+{
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == index)
+        H5FNAL_PROGRAM_ERROR("index parameter cannot be NULL");
+
+    memset(index, 0, sizeof(h5fnal_event_index_t));
+    index->dset_id = H5FNAL_BAD_HID_T;
+
+    if ((index->dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_EVENT_ENTRY)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get event index entry datatype");
+
+    if (h5fnal_defer_append_buffer(loc_id, H5FNAL_EVENT_INDEX_NAME, index->dtype_id, options, &index->buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up event index append buffer");
+    index->sorted = TRUE;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    h5fnal_close_index_on_err(index);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_create_event_index() */
+
+
+/************************************************************************
+ * h5fnal_open_event_index()
+ *
+ * Opens the event index in loc_id and reads all its entries into
+ * memory. A missing index is treated as an empty one. Indexes that
+ * weren't stored in sorted order are sorted in memory.
+ ************************************************************************/
+herr_t
+h5fnal_open_event_index(hid_t loc_id, h5fnal_event_index_t *index)
+{
+    hsize_t n;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == index)
+        H5FNAL_PROGRAM_ERROR("index parameter cannot be NULL");
+
+    memset(index, 0, sizeof(h5fnal_event_index_t));
+    index->dset_id = H5FNAL_BAD_HID_T;
+
+    if ((index->dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_EVENT_ENTRY)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get event index entry datatype");
+
+    if (h5fnal_open_optional_dset(loc_id, H5FNAL_EVENT_INDEX_NAME, &index->dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open event index dataset");
+    if (h5fnal_open_append_buffer(loc_id, H5FNAL_EVENT_INDEX_NAME, index->dset_id, index->dtype_id, &index->buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up event index append buffer");
+
+    /* Load the entries */
+    n = h5fnal_get_buffered_size(&index->buffer);
+    if (h5fnal_reserve_event_entries((void **)&index->entries, &index->n_allocated, n, sizeof(h5fnal_event_entry_t)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for event index entries");
+    if (h5fnal_read_data(index->dset_id, index->dtype_id, n, index->entries) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read event index entries");
+    index->n_entries = n;
+
+    index->sorted = h5fnal_events_are_sorted(index->entries, n, sizeof(h5fnal_event_entry_t));
+    if (!index->sorted)
+        qsort(index->entries, (size_t)n, sizeof(h5fnal_event_entry_t), h5fnal_compare_event_keys);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    h5fnal_close_index_on_err(index);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_open_event_index() */
+
+
+/************************************************************************
+ * h5fnal_close_event_index()
+ *
+ * Closes the event index. If anything was added to it, and it isn't in
+ * sorted order in the file, the dataset is rewritten sorted.
+ ************************************************************************/
+herr_t
+h5fnal_close_event_index(h5fnal_event_index_t *index)
+{
+    hbool_t rewrite;
+
+    if (NULL == index)
+        H5FNAL_PROGRAM_ERROR("index parameter cannot be NULL");
+
+    rewrite = (index->buffer.appended || index->buffer.n_buffered > 0) && !index->sorted;
+
+    if (h5fnal_close_append_buffer(&index->buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close event index append buffer");
+
+    /* The entries in memory are always sorted */
+    if (rewrite)
+        if (H5Dwrite(index->dset_id, index->dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, index->entries) < 0)
+            H5FNAL_HDF5_ERROR;
+
+    if (index->dset_id >= 0)
+        if (H5Dclose(index->dset_id) < 0)
+            H5FNAL_HDF5_ERROR;
+    index->dset_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_release_type(index->dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    index->dtype_id = H5FNAL_BAD_HID_T;
+
+    free(index->entries);
+    index->entries = NULL;
+    index->n_entries = 0;
+    index->n_allocated = 0;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    h5fnal_close_index_on_err(index);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_close_event_index() */
+
+
+/************************************************************************
+ * h5fnal_add_event_entry()
+ *
+ * Adds an entry to the index. The data products' h5fnal_append_event_*()
+ * calls fill in the entry and call this, so it shouldn't normally be
+ * needed.
+ *
+ * Events added in order are just appended. Others are inserted in
+ * place in memory and the dataset is sorted when the index is closed.
+ ************************************************************************/
+herr_t
+h5fnal_add_event_entry(h5fnal_event_index_t *index, const h5fnal_event_entry_t *entry)
+{
+    hsize_t pos;
+    hbool_t found;
+
+    if (NULL == index)
+        H5FNAL_PROGRAM_ERROR("index parameter cannot be NULL");
+    if (NULL == entry)
+        H5FNAL_PROGRAM_ERROR("entry parameter cannot be NULL");
+
+    if (index->dset_id < 0)
+        if (h5fnal_create_deferred_dset(&index->buffer, &index->dset_id) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create event index dataset");
+
+    if (h5fnal_reserve_event_entries((void **)&index->entries, &index->n_allocated, index->n_entries + 1,
+                sizeof(h5fnal_event_entry_t)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for event index entries");
+    if (h5fnal_buffered_append(&index->buffer, 1, (const void *)entry) < 0)
+        H5FNAL_PROGRAM_ERROR("could not append event index entry");
+
+    /* Keep the entries in memory sorted */
+    if (index->n_entries > 0 && h5fnal_compare_event_keys(&index->entries[index->n_entries - 1], entry) > 0) {
+        pos = h5fnal_search_events(index->entries, index->n_entries, sizeof(h5fnal_event_entry_t),
+                (const h5fnal_event_key_t *)entry, &found);
+        memmove(&index->entries[pos + 1], &index->entries[pos], (index->n_entries - pos) * sizeof(h5fnal_event_entry_t));
+        index->sorted = FALSE;
+    }
+    else
+        pos = index->n_entries;
+    index->entries[pos] = *entry;
+    index->n_entries++;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_add_event_entry() */
+
+
+/************************************************************************
+ * h5fnal_find_event()
+ *
+ * Looks up an event in the index with a binary search. Returns TRUE and
+ * copies the entry to *entry if the event is there, FALSE if it isn't.
+ ************************************************************************/
+htri_t
+h5fnal_find_event(const h5fnal_event_index_t *index, unsigned run, unsigned subrun, unsigned event,
+        /*OUT*/ h5fnal_event_entry_t *entry)
+{
+    h5fnal_event_key_t key;
+    hsize_t pos;
+    hbool_t found;
+
+    if (NULL == index)
+        H5FNAL_PROGRAM_ERROR("index parameter cannot be NULL");
+    if (NULL == entry)
+        H5FNAL_PROGRAM_ERROR("entry parameter cannot be NULL");
+
+    key.run = run;
+    key.subrun = subrun;
+    key.event = event;
+    pos = h5fnal_search_events(index->entries, index->n_entries, sizeof(h5fnal_event_entry_t), &key, &found);
+    if (!found)
+        return FALSE;
+
+    *entry = index->entries[pos];
+
+    return TRUE;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_find_event() */
+
+
+/************************************************************************
+ * h5fnal_close_lookup_on_err()
+ ************************************************************************/
+static void
+h5fnal_close_lookup_on_err(h5fnal_event_lookup_t *lookup)
+{
+    if (lookup) {
+        h5fnal_release_type(lookup->dtype_id);
+        free(lookup->entries);
+
+        memset(lookup, 0, sizeof(h5fnal_event_lookup_t));
+        lookup->loc_id = H5FNAL_BAD_HID_T;
+        lookup->dtype_id = H5FNAL_BAD_HID_T;
+    }
+
+    return;
+} /* end h5fnal_close_lookup_on_err() */
+
+
+/************************************************************************
+ * h5fnal_create_event_lookup()
+ *
+ * Sets up an empty event lookup. The dataset is written in loc_id
+ * (normally the master run container) when the lookup is closed.
+ ************************************************************************/
+herr_t
+h5fnal_create_event_lookup(hid_t loc_id, h5fnal_event_lookup_t *lookup)
+{
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == lookup)
+        H5FNAL_PROGRAM_ERROR("lookup parameter cannot be NULL");
+
+    memset(lookup, 0, sizeof(h5fnal_event_lookup_t));
+    lookup->loc_id = loc_id;
+
+    if ((lookup->dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_EVENT_ADDR)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get event lookup entry datatype");
+
+    /* Write the (empty) lookup on close even if no events are added */
+    lookup->modified = TRUE;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    h5fnal_close_lookup_on_err(lookup);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_create_event_lookup() */
+
+
+/************************************************************************
+ * h5fnal_open_event_lookup()
+ *
+ * Reads the event lookup in loc_id into memory. A file without one
+ * gets an empty lookup (so callers can fall back to opening the run,
+ * sub-run and event groups by name).
+ ************************************************************************/
+herr_t
+h5fnal_open_event_lookup(hid_t loc_id, h5fnal_event_lookup_t *lookup)
+{
+    hid_t did = H5FNAL_BAD_HID_T;
+    hssize_t n;
+    htri_t exists;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == lookup)
+        H5FNAL_PROGRAM_ERROR("lookup parameter cannot be NULL");
+
+    memset(lookup, 0, sizeof(h5fnal_event_lookup_t));
+    lookup->loc_id = loc_id;
+
+    if ((lookup->dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_EVENT_ADDR)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get event lookup entry datatype");
+
+    if ((exists = H5Lexists(loc_id, H5FNAL_EVENT_LOOKUP_NAME, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (!exists)
+        return H5FNAL_SUCCESS;
+
+    if ((did = H5Dopen2(loc_id, H5FNAL_EVENT_LOOKUP_NAME, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((n = h5fnal_get_dset_extent(did)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get event lookup size");
+    if (h5fnal_reserve_event_entries((void **)&lookup->entries, &lookup->n_allocated, (hsize_t)n, sizeof(h5fnal_event_addr_t)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for event lookup entries");
+    if (h5fnal_read_data(did, lookup->dtype_id, (hsize_t)n, lookup->entries) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read event lookup entries");
+    lookup->n_entries = (hsize_t)n;
+    if (H5Dclose(did) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (!h5fnal_events_are_sorted(lookup->entries, lookup->n_entries, sizeof(h5fnal_event_addr_t)))
+        qsort(lookup->entries, (size_t)lookup->n_entries, sizeof(h5fnal_event_addr_t), h5fnal_compare_event_keys);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Dclose(did);
+    } H5E_END_TRY;
+    h5fnal_close_lookup_on_err(lookup);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_open_event_lookup() */
+
+
+/************************************************************************
+ * h5fnal_close_event_lookup()
+ *
+ * Writes the sorted lookup to the file if events were added to it
+ * (replacing any lookup that was already there) and frees it.
+ ************************************************************************/
+herr_t
+h5fnal_close_event_lookup(h5fnal_event_lookup_t *lookup)
+{
+    hid_t sid = H5FNAL_BAD_HID_T;
+    hid_t did = H5FNAL_BAD_HID_T;
+    hsize_t dims[1];
+    htri_t exists;
+
+    if (NULL == lookup)
+        H5FNAL_PROGRAM_ERROR("lookup parameter cannot be NULL");
+
+    if (lookup->modified) {
+        if ((exists = H5Lexists(lookup->loc_id, H5FNAL_EVENT_LOOKUP_NAME, H5P_DEFAULT)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (exists)
+            if (H5Ldelete(lookup->loc_id, H5FNAL_EVENT_LOOKUP_NAME, H5P_DEFAULT) < 0)
+                H5FNAL_HDF5_ERROR;
+
+        /* The size is known, so a contiguous dataset will do */
+        dims[0] = lookup->n_entries;
+        if ((sid = H5Screate_simple(1, dims, NULL)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if ((did = H5Dcreate2(lookup->loc_id, H5FNAL_EVENT_LOOKUP_NAME, lookup->dtype_id, sid,
+                H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (lookup->n_entries > 0)
+            if (H5Dwrite(did, lookup->dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, lookup->entries) < 0)
+                H5FNAL_HDF5_ERROR;
+        if (H5Dclose(did) < 0)
+            H5FNAL_HDF5_ERROR;
+        did = H5FNAL_BAD_HID_T;
+        if (H5Sclose(sid) < 0)
+            H5FNAL_HDF5_ERROR;
+        sid = H5FNAL_BAD_HID_T;
+    }
+
+    if (h5fnal_release_type(lookup->dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    lookup->dtype_id = H5FNAL_BAD_HID_T;
+
+    free(lookup->entries);
+    memset(lookup, 0, sizeof(h5fnal_event_lookup_t));
+    lookup->loc_id = H5FNAL_BAD_HID_T;
+    lookup->dtype_id = H5FNAL_BAD_HID_T;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Dclose(did);
+        H5Sclose(sid);
+    } H5E_END_TRY;
+    h5fnal_close_lookup_on_err(lookup);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_close_event_lookup() */
+
+
+/************************************************************************
+ * h5fnal_add_event_to_lookup()
+ *
+ * Records the address of an event's group (e.g. as returned by
+ * h5fnal_create_event()) in the lookup.
+ ************************************************************************/
+herr_t
+h5fnal_add_event_to_lookup(h5fnal_event_lookup_t *lookup, unsigned run, unsigned subrun, unsigned event,
+        hid_t event_id)
+{
+    h5fnal_event_addr_t entry;
+#if H5_VERSION_GE(1, 12, 0)
+    H5O_info2_t info;
+#else
+    H5O_info_t info;
+#endif
+    hsize_t pos;
+    hbool_t found;
+
+    if (NULL == lookup)
+        H5FNAL_PROGRAM_ERROR("lookup parameter cannot be NULL");
+    if (event_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid event_id parameter");
+
+    entry.run = run;
+    entry.subrun = subrun;
+    entry.event = event;
+
+    /* 1.12 identifies objects with tokens, which the native file format
+     * maps one-to-one to addresses, so the lookup keeps storing addresses
+     */
+#if H5_VERSION_GE(1, 12, 0)
+    if (H5Oget_info3(event_id, &info, H5O_INFO_BASIC) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5VLnative_token_to_addr(event_id, info.token, &entry.addr) < 0)
+        H5FNAL_HDF5_ERROR;
+#else
+    if (H5Oget_info2(event_id, &info, H5O_INFO_BASIC) < 0)
+        H5FNAL_HDF5_ERROR;
+    entry.addr = info.addr;
+#endif
+
+    if (h5fnal_reserve_event_entries((void **)&lookup->entries, &lookup->n_allocated, lookup->n_entries + 1,
+                sizeof(h5fnal_event_addr_t)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for event lookup entries");
+
+    /* Events normally arrive in order, so this is usually an append */
+    if (lookup->n_entries > 0 && h5fnal_compare_event_keys(&lookup->entries[lookup->n_entries - 1], &entry) > 0) {
+        pos = h5fnal_search_events(lookup->entries, lookup->n_entries, sizeof(h5fnal_event_addr_t),
+                (const h5fnal_event_key_t *)&entry, &found);
+        memmove(&lookup->entries[pos + 1], &lookup->entries[pos], (lookup->n_entries - pos) * sizeof(h5fnal_event_addr_t));
+    }
+    else
+        pos = lookup->n_entries;
+    lookup->entries[pos] = entry;
+    lookup->n_entries++;
+    lookup->modified = TRUE;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_add_event_to_lookup() */
+
+
+/************************************************************************
+ * h5fnal_open_event_by_number()
+ *
+ * Opens an event's group directly by its address, found with a binary
+ * search of the lookup. Returns TRUE and sets *event_id if the event is
+ * in the lookup, FALSE if it isn't. Close the event with
+ * h5fnal_close_event().
+ ************************************************************************/
+htri_t
+h5fnal_open_event_by_number(const h5fnal_event_lookup_t *lookup, unsigned run, unsigned subrun, unsigned event,
+        /*OUT*/ hid_t *event_id)
+{
+    h5fnal_event_key_t key;
+#if H5_VERSION_GE(1, 12, 0)
+    H5O_token_t token;
+#endif
+    hsize_t pos;
+    hbool_t found;
+
+    if (NULL == lookup)
+        H5FNAL_PROGRAM_ERROR("lookup parameter cannot be NULL");
+    if (NULL == event_id)
+        H5FNAL_PROGRAM_ERROR("event_id parameter cannot be NULL");
+
+    *event_id = H5FNAL_BAD_HID_T;
+
+    key.run = run;
+    key.subrun = subrun;
+    key.event = event;
+    pos = h5fnal_search_events(lookup->entries, lookup->n_entries, sizeof(h5fnal_event_addr_t), &key, &found);
+    if (!found)
+        return FALSE;
+
+#if H5_VERSION_GE(1, 12, 0)
+    if (H5VLnative_addr_to_token(lookup->loc_id, lookup->entries[pos].addr, &token) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((*event_id = H5Oopen_by_token(lookup->loc_id, token)) < 0)
+        H5FNAL_HDF5_ERROR;
+#else
+    if ((*event_id = H5Oopen_by_addr(lookup->loc_id, lookup->entries[pos].addr)) < 0)
+        H5FNAL_HDF5_ERROR;
+#endif
+
+    return TRUE;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_open_event_by_number() */
@@ -0,0 +1,142 @@
+/* event_index.h
+ *
+ * Public header file for the event index used by the flat file
+ * layout.
+ *
+ * In the flat layout, each data product is stored once per file
+ * instead of once per event, and every event's elements are appended
+ * as a contiguous block of rows to each of the product's datasets.
+ * The event index is a dataset in the product's top-level group that
+ * maps (run, sub-run, event) to those blocks of rows.
+ *
+ * The event lookup does the same job for the layout with a group per
+ * event. It maps (run, sub-run, event) to the address of the event's
+ * group, so an event can be opened without walking the run and sub-run
+ * groups.
+ *
+ * Both are kept sorted by (run, sub-run, event), so events are found
+ * with a binary search. The helpers for sorted tables of entries that
+ * start with an h5fnal_event_key_t are shared with the event summary
+ * table (see event_summary.h).
+ *
+ * The event lookup needs HDF5 1.10.3 or later (for H5Oget_info2()). It
+ * builds against 1.12 and later too, where objects are identified by
+ * tokens, including builds without the deprecated symbols. Addresses
+ * are only meaningful in the native file format, so the lookup doesn't
+ * work with other VOL connectors.
+ */
+
+#ifndef H5FNAL_EVENT_INDEX_H
+#define H5FNAL_EVENT_INDEX_H
+
+#include "h5fnal.h"
+
+/* Name of the event index dataset in a data product's top-level group */
+#define H5FNAL_EVENT_INDEX_NAME     "event_index"
+
+/* Name of the event lookup dataset (normally in the master run container) */
+#define H5FNAL_EVENT_LOOKUP_NAME    "event_lookup"
+
+/* Largest number of datasets a data product can have */
+#define H5FNAL_MAX_EVENT_RANGES     5
+
+/* The (run, sub-run, event) numbers that all the sorted event table
+ * entries start with
+ */
+typedef struct h5fnal_event_key_t {
+    unsigned    run;
+    unsigned    subrun;
+    unsigned    event;
+} h5fnal_event_key_t;
+
+/* Event index entry
+ *
+ * start and count give the rows that hold the event's elements in
+ * each of the data product's datasets. Which dataset goes with which
+ * slot is up to the data product (see the h5fnal_append_event_*()
+ * calls). Unused slots are zero.
+ */
+typedef struct h5fnal_event_entry_t {
+    unsigned    run;
+    unsigned    subrun;
+    unsigned    event;
+    hsize_t     start[H5FNAL_MAX_EVENT_RANGES];
+    hsize_t     count[H5FNAL_MAX_EVENT_RANGES];
+} h5fnal_event_entry_t;
+
+/* Event index HDF5 data and related
+ *
+ * All the entries are kept in memory for lookups. New entries are
+ * also written to the dataset through the append buffer. If events
+ * are added out of order, the dataset is rewritten in sorted order
+ * when the index is closed.
+ */
+typedef struct h5fnal_event_index_t {
+    hid_t                       dset_id;
+    hid_t                       dtype_id;
+    h5fnal_append_buffer_t      buffer;
+    h5fnal_event_entry_t       *entries;
+    hsize_t                     n_entries;
+    hsize_t                     n_allocated;
+    hbool_t                     sorted;
+} h5fnal_event_index_t;
+
+/* Event lookup entry */
+typedef struct h5fnal_event_addr_t {
+    unsigned    run;
+    unsigned    subrun;
+    unsigned    event;
+    haddr_t     addr;       /* of the event's group */
+} h5fnal_event_addr_t;
+
+/* Event lookup
+ *
+ * The entries are collected in memory as events are created and the
+ * dataset is written, sorted, when the lookup is closed. loc_id is
+ * not owned by the lookup and must stay open while it is in use.
+ */
+typedef struct h5fnal_event_lookup_t {
+    hid_t                       loc_id;
+    hid_t                       dtype_id;
+    h5fnal_event_addr_t        *entries;
+    hsize_t                     n_entries;
+    hsize_t                     n_allocated;
+    hbool_t                     modified;
+} h5fnal_event_lookup_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+hid_t h5fnal_create_event_entry_type(void);
+hid_t h5fnal_create_event_addr_type(void);
+
+/* Sorted event tables */
+int h5fnal_compare_event_keys(const void *a, const void *b);
+hsize_t h5fnal_search_events(const void *entries, hsize_t n, size_t size, const h5fnal_event_key_t *key,
+        /*OUT*/ hbool_t *found);
+hbool_t h5fnal_events_are_sorted(const void *entries, hsize_t n, size_t size);
+herr_t h5fnal_reserve_event_entries(void **entries, hsize_t *n_allocated, hsize_t n, size_t size);
+
+herr_t h5fnal_create_event_index(hid_t loc_id, const h5fnal_create_options_t *options, h5fnal_event_index_t *index);
+herr_t h5fnal_open_event_index(hid_t loc_id, h5fnal_event_index_t *index);
+herr_t h5fnal_close_event_index(h5fnal_event_index_t *index);
+
+herr_t h5fnal_add_event_entry(h5fnal_event_index_t *index, const h5fnal_event_entry_t *entry);
+htri_t h5fnal_find_event(const h5fnal_event_index_t *index, unsigned run, unsigned subrun, unsigned event,
+        /*OUT*/ h5fnal_event_entry_t *entry);
+
+herr_t h5fnal_create_event_lookup(hid_t loc_id, h5fnal_event_lookup_t *lookup);
+herr_t h5fnal_open_event_lookup(hid_t loc_id, h5fnal_event_lookup_t *lookup);
+herr_t h5fnal_close_event_lookup(h5fnal_event_lookup_t *lookup);
+
+herr_t h5fnal_add_event_to_lookup(h5fnal_event_lookup_t *lookup, unsigned run, unsigned subrun, unsigned event,
+        hid_t event_id);
+htri_t h5fnal_open_event_by_number(const h5fnal_event_lookup_t *lookup, unsigned run, unsigned subrun, unsigned event,
+        /*OUT*/ hid_t *event_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H5FNAL_EVENT_INDEX_H */
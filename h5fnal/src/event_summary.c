@@ -0,0 +1,540 @@
+/* event_summary.c
+ *
+ * Per-event summaries and skims.
+ */
+
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "h5fnal.h"
+
+
+/************************************************************************
+ * h5fnal_create_event_summary_type()
+ *
+ * Creates and returns an HDF5 compound datatype that represents an
+ * event summary.
+ ************************************************************************/
+hid_t
+h5fnal_create_event_summary_type(void)
+{
+    hid_t tid = H5FNAL_BAD_HID_T;
+
+    if ((tid = H5Tcreate(H5T_COMPOUND, sizeof(h5fnal_event_summary_t))) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (H5Tinsert(tid, "run", HOFFSET(h5fnal_event_summary_t, run), H5T_NATIVE_UINT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "subrun", HOFFSET(h5fnal_event_summary_t, subrun), H5T_NATIVE_UINT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "event", HOFFSET(h5fnal_event_summary_t, event), H5T_NATIVE_UINT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "origin_mask", HOFFSET(h5fnal_event_summary_t, origin_mask), H5T_NATIVE_UINT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "n_hits", HOFFSET(h5fnal_event_summary_t, n_hits), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "n_hit_collections", HOFFSET(h5fnal_event_summary_t, n_hit_collections), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "n_truths", HOFFSET(h5fnal_event_summary_t, n_truths), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "n_particles", HOFFSET(h5fnal_event_summary_t, n_particles), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "n_neutrinos", HOFFSET(h5fnal_event_summary_t, n_neutrinos), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "n_pairs", HOFFSET(h5fnal_event_summary_t, n_pairs), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "total_charge", HOFFSET(h5fnal_event_summary_t, total_charge), H5T_NATIVE_DOUBLE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "min_hit_time", HOFFSET(h5fnal_event_summary_t, min_hit_time), H5T_NATIVE_FLOAT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "max_hit_time", HOFFSET(h5fnal_event_summary_t, max_hit_time), H5T_NATIVE_FLOAT) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return tid;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Tclose(tid);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_create_event_summary_type() */
+
+
+/************************************************************************
+ * h5fnal_init_event_summary()
+ *
+ * Sets up an empty summary for an event. The h5fnal_summarize_*()
+ * calls then add each of the event's data products to it.
+ ************************************************************************/
+herr_t
+h5fnal_init_event_summary(h5fnal_event_summary_t *summary, unsigned run, unsigned subrun, unsigned event)
+{
+    if (NULL == summary)
+        H5FNAL_PROGRAM_ERROR("summary parameter cannot be NULL");
+
+    memset(summary, 0, sizeof(h5fnal_event_summary_t));
+    summary->run = run;
+    summary->subrun = subrun;
+    summary->event = event;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_init_event_summary() */
+
+
+/************************************************************************
+ * h5fnal_summarize_hits()
+ *
+ * Adds an event's hits to its summary.
+ ************************************************************************/
+herr_t
+h5fnal_summarize_hits(h5fnal_event_summary_t *summary, const h5fnal_vect_hitcoll_data_t *data)
+{
+    hsize_t u;
+
+    if (NULL == summary)
+        H5FNAL_PROGRAM_ERROR("summary parameter cannot be NULL");
+    if (NULL == data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    for (u = 0; u < data->n_hits; u++) {
+        const h5fnal_hit_t *hit = &data->hits[u];
+
+        if (0 == summary->n_hits && 0 == u) {
+            summary->min_hit_time = hit->signal_time;
+            summary->max_hit_time = hit->signal_time;
+        }
+        else {
+            summary->min_hit_time = H5FNAL_MIN(summary->min_hit_time, hit->signal_time);
+            summary->max_hit_time = H5FNAL_MAX(summary->max_hit_time, hit->signal_time);
+        }
+        summary->total_charge += hit->charge;
+    }
+
+    summary->n_hits += data->n_hits;
+    summary->n_hit_collections += data->n_hit_collections;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_summarize_hits() */
+
+
+/************************************************************************
+ * h5fnal_summarize_truths()
+ *
+ * Adds an event's MC truths to its summary.
+ ************************************************************************/
+herr_t
+h5fnal_summarize_truths(h5fnal_event_summary_t *summary, const h5fnal_vect_truth_data_t *data)
+{
+    hsize_t u;
+
+    if (NULL == summary)
+        H5FNAL_PROGRAM_ERROR("summary parameter cannot be NULL");
+    if (NULL == data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    for (u = 0; u < data->n_truths; u++)
+        if ((unsigned)data->truths[u].origin < 8 * sizeof(summary->origin_mask))
+            summary->origin_mask |= 1U << (unsigned)data->truths[u].origin;
+
+    summary->n_truths += data->n_truths;
+    summary->n_particles += data->n_particles;
+    summary->n_neutrinos += data->n_neutrinos;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_summarize_truths() */
+
+
+/************************************************************************
+ * h5fnal_summarize_assns()
+ *
+ * Adds an event's associations to its summary.
+ ************************************************************************/
+herr_t
+h5fnal_summarize_assns(h5fnal_event_summary_t *summary, const h5fnal_assns_data_t *data)
+{
+    if (NULL == summary)
+        H5FNAL_PROGRAM_ERROR("summary parameter cannot be NULL");
+    if (NULL == data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    summary->n_pairs += data->n;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_summarize_assns() */
+
+
+/************************************************************************
+ * h5fnal_close_summary_table_on_err()
+ ************************************************************************/
+static void
+h5fnal_close_summary_table_on_err(h5fnal_summary_table_t *table)
+{
+    if (table) {
+        h5fnal_release_type(table->dtype_id);
+        free(table->entries);
+
+        memset(table, 0, sizeof(h5fnal_summary_table_t));
+        table->loc_id = H5FNAL_BAD_HID_T;
+        table->dtype_id = H5FNAL_BAD_HID_T;
+    }
+
+    return;
+} /* end h5fnal_close_summary_table_on_err() */
+
+
+/************************************************************************
+ * h5fnal_create_summary_table()
+ *
+ * Sets up an empty summary table. The dataset is written in loc_id
+ * (normally the master run container) when the table is closed.
+ ************************************************************************/
+herr_t
+h5fnal_create_summary_table(hid_t loc_id, h5fnal_summary_table_t *table)
+{
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == table)
+        H5FNAL_PROGRAM_ERROR("table parameter cannot be NULL");
+
+    memset(table, 0, sizeof(h5fnal_summary_table_t));
+    table->loc_id = loc_id;
+
+    if ((table->dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_EVENT_SUMMARY)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get event summary datatype");
+
+    /* Write the (empty) table on close even if no events are added */
+    table->modified = TRUE;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    h5fnal_close_summary_table_on_err(table);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_create_summary_table() */
+
+
+/************************************************************************
+ * h5fnal_open_summary_table()
+ *
+ * Reads the summary table in loc_id into memory. A file without one
+ * gets an empty table.
+ ************************************************************************/
+herr_t
+h5fnal_open_summary_table(hid_t loc_id, h5fnal_summary_table_t *table)
+{
+    hid_t did = H5FNAL_BAD_HID_T;
+    hssize_t n;
+    htri_t exists;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == table)
+        H5FNAL_PROGRAM_ERROR("table parameter cannot be NULL");
+
+    memset(table, 0, sizeof(h5fnal_summary_table_t));
+    table->loc_id = loc_id;
+
+    if ((table->dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_EVENT_SUMMARY)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get event summary datatype");
+
+    if ((exists = H5Lexists(loc_id, H5FNAL_EVENT_SUMMARY_NAME, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (!exists)
+        return H5FNAL_SUCCESS;
+
+    if ((did = H5Dopen2(loc_id, H5FNAL_EVENT_SUMMARY_NAME, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((n = h5fnal_get_dset_extent(did)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get summary table size");
+    if (h5fnal_reserve_event_entries((void **)&table->entries, &table->n_allocated, (hsize_t)n,
+                sizeof(h5fnal_event_summary_t)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for event summaries");
+    if (h5fnal_read_data(did, table->dtype_id, (hsize_t)n, table->entries) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read event summaries");
+    table->n_entries = (hsize_t)n;
+    if (H5Dclose(did) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (!h5fnal_events_are_sorted(table->entries, table->n_entries, sizeof(h5fnal_event_summary_t)))
+        qsort(table->entries, (size_t)table->n_entries, sizeof(h5fnal_event_summary_t), h5fnal_compare_event_keys);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Dclose(did);
+    } H5E_END_TRY;
+    h5fnal_close_summary_table_on_err(table);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_open_summary_table() */
+
+
+/************************************************************************
+ * h5fnal_close_summary_table()
+ *
+ * Writes the sorted table to the file if summaries were added to it
+ * (replacing any table that was already there) and frees it.
+ ************************************************************************/
+herr_t
+h5fnal_close_summary_table(h5fnal_summary_table_t *table)
+{
+    hid_t sid = H5FNAL_BAD_HID_T;
+    hid_t did = H5FNAL_BAD_HID_T;
+    hsize_t dims[1];
+    htri_t exists;
+
+    if (NULL == table)
+        H5FNAL_PROGRAM_ERROR("table parameter cannot be NULL");
+
+    if (table->modified) {
+        if ((exists = H5Lexists(table->loc_id, H5FNAL_EVENT_SUMMARY_NAME, H5P_DEFAULT)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (exists)
+            if (H5Ldelete(table->loc_id, H5FNAL_EVENT_SUMMARY_NAME, H5P_DEFAULT) < 0)
+                H5FNAL_HDF5_ERROR;
+
+        /* The size is known, so a contiguous dataset will do */
+        dims[0] = table->n_entries;
+        if ((sid = H5Screate_simple(1, dims, NULL)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if ((did = H5Dcreate2(table->loc_id, H5FNAL_EVENT_SUMMARY_NAME, table->dtype_id, sid,
+                H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (table->n_entries > 0)
+            if (H5Dwrite(did, table->dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, table->entries) < 0)
+                H5FNAL_HDF5_ERROR;
+        if (H5Dclose(did) < 0)
+            H5FNAL_HDF5_ERROR;
+        did = H5FNAL_BAD_HID_T;
+        if (H5Sclose(sid) < 0)
+            H5FNAL_HDF5_ERROR;
+        sid = H5FNAL_BAD_HID_T;
+    }
+
+    if (h5fnal_release_type(table->dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    table->dtype_id = H5FNAL_BAD_HID_T;
+
+    free(table->entries);
+    memset(table, 0, sizeof(h5fnal_summary_table_t));
+    table->loc_id = H5FNAL_BAD_HID_T;
+    table->dtype_id = H5FNAL_BAD_HID_T;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Dclose(did);
+        H5Sclose(sid);
+    } H5E_END_TRY;
+    h5fnal_close_summary_table_on_err(table);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_close_summary_table() */
+
+
+/************************************************************************
+ * h5fnal_add_event_summary()
+ *
+ * Adds an event's summary to the table, replacing the event's old
+ * summary if it already has one.
+ ************************************************************************/
+herr_t
+h5fnal_add_event_summary(h5fnal_summary_table_t *table, const h5fnal_event_summary_t *summary)
+{
+    hsize_t pos;
+    hbool_t found;
+
+    if (NULL == table)
+        H5FNAL_PROGRAM_ERROR("table parameter cannot be NULL");
+    if (NULL == summary)
+        H5FNAL_PROGRAM_ERROR("summary parameter cannot be NULL");
+
+    if (h5fnal_reserve_event_entries((void **)&table->entries, &table->n_allocated, table->n_entries + 1,
+                sizeof(h5fnal_event_summary_t)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for event summaries");
+
+    /* Events normally arrive in order, so this is usually an append */
+    if (table->n_entries > 0 && h5fnal_compare_event_keys(&table->entries[table->n_entries - 1], summary) >= 0) {
+        pos = h5fnal_search_events(table->entries, table->n_entries, sizeof(h5fnal_event_summary_t),
+                (const h5fnal_event_key_t *)summary, &found);
+        if (!found) {
+            memmove(&table->entries[pos + 1], &table->entries[pos],
+                    (table->n_entries - pos) * sizeof(h5fnal_event_summary_t));
+            table->n_entries++;
+        }
+    }
+    else
+        pos = table->n_entries++;
+    table->entries[pos] = *summary;
+    table->modified = TRUE;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_add_event_summary() */
+
+
+/************************************************************************
+ * h5fnal_find_event_summary()
+ *
+ * Looks up an event's summary with a binary search. Returns TRUE and
+ * copies the summary into *summary if the event is in the table, FALSE
+ * if it isn't.
+ ************************************************************************/
+htri_t
+h5fnal_find_event_summary(const h5fnal_summary_table_t *table, unsigned run, unsigned subrun, unsigned event,
+        /*OUT*/ h5fnal_event_summary_t *summary)
+{
+    h5fnal_event_key_t key;
+    hsize_t pos;
+    hbool_t found;
+
+    if (NULL == table)
+        H5FNAL_PROGRAM_ERROR("table parameter cannot be NULL");
+    if (NULL == summary)
+        H5FNAL_PROGRAM_ERROR("summary parameter cannot be NULL");
+
+    key.run = run;
+    key.subrun = subrun;
+    key.event = event;
+    pos = h5fnal_search_events(table->entries, table->n_entries, sizeof(h5fnal_event_summary_t), &key, &found);
+    if (!found)
+        return FALSE;
+
+    *summary = table->entries[pos];
+
+    return TRUE;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_find_event_summary() */
+
+
+/************************************************************************
+ * h5fnal_init_skim_criteria()
+ *
+ * Sets up skim criteria that every event passes, to be narrowed down
+ * by the caller.
+ ************************************************************************/
+herr_t
+h5fnal_init_skim_criteria(h5fnal_skim_criteria_t *criteria)
+{
+    if (NULL == criteria)
+        H5FNAL_PROGRAM_ERROR("criteria parameter cannot be NULL");
+
+    memset(criteria, 0, sizeof(h5fnal_skim_criteria_t));
+
+    criteria->max_hits = H5FNAL_SKIM_NO_LIMIT;
+    criteria->max_particles = H5FNAL_SKIM_NO_LIMIT;
+    criteria->max_pairs = H5FNAL_SKIM_NO_LIMIT;
+    criteria->min_total_charge = -DBL_MAX;
+    criteria->min_hit_time = -FLT_MAX;
+    criteria->max_hit_time = FLT_MAX;
+    criteria->origin_mask = 0;
+    criteria->neutrino = H5FNAL_SKIM_ANY_NEUTRINO;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_init_skim_criteria() */
+
+
+/************************************************************************
+ * h5fnal_passes_skim()
+ *
+ * Returns TRUE if an event's summary meets the skim criteria.
+ ************************************************************************/
+hbool_t
+h5fnal_passes_skim(const h5fnal_event_summary_t *summary, const h5fnal_skim_criteria_t *criteria)
+{
+    if (summary->n_hits < criteria->min_hits || summary->n_hits > criteria->max_hits)
+        return FALSE;
+    if (summary->n_particles < criteria->min_particles || summary->n_particles > criteria->max_particles)
+        return FALSE;
+    if (summary->n_pairs < criteria->min_pairs || summary->n_pairs > criteria->max_pairs)
+        return FALSE;
+    if (summary->total_charge < criteria->min_total_charge)
+        return FALSE;
+
+    /* Only a restricted time window rules out events without hits */
+    if (criteria->min_hit_time > -FLT_MAX || criteria->max_hit_time < FLT_MAX) {
+        if (0 == summary->n_hits)
+            return FALSE;
+        if (summary->max_hit_time < criteria->min_hit_time || summary->min_hit_time > criteria->max_hit_time)
+            return FALSE;
+    }
+
+    if (criteria->origin_mask && 0 == (summary->origin_mask & criteria->origin_mask))
+        return FALSE;
+
+    if (H5FNAL_SKIM_WITH_NEUTRINO == criteria->neutrino && 0 == summary->n_neutrinos)
+        return FALSE;
+    if (H5FNAL_SKIM_WITHOUT_NEUTRINO == criteria->neutrino && summary->n_neutrinos > 0)
+        return FALSE;
+
+    return TRUE;
+} /* end h5fnal_passes_skim() */
+
+
+/************************************************************************
+ * h5fnal_skim_events()
+ *
+ * Selects the events in the summary table that pass the skim criteria.
+ * *selected is set to a newly allocated array (free it with free())
+ * holding the selected events' summaries, in (run, sub-run, event)
+ * order, or NULL if no event passes.
+ ************************************************************************/
+herr_t
+h5fnal_skim_events(const h5fnal_summary_table_t *table, const h5fnal_skim_criteria_t *criteria,
+        /*OUT*/ h5fnal_event_summary_t **selected, /*OUT*/ hsize_t *n_selected)
+{
+    h5fnal_event_summary_t *out = NULL;
+    hsize_t n_allocated = 0;
+    hsize_t n = 0;
+    hsize_t u;
+
+    if (NULL == table)
+        H5FNAL_PROGRAM_ERROR("table parameter cannot be NULL");
+    if (NULL == criteria)
+        H5FNAL_PROGRAM_ERROR("criteria parameter cannot be NULL");
+    if (NULL == selected)
+        H5FNAL_PROGRAM_ERROR("selected parameter cannot be NULL");
+    if (NULL == n_selected)
+        H5FNAL_PROGRAM_ERROR("n_selected parameter cannot be NULL");
+
+    for (u = 0; u < table->n_entries; u++)
+        if (h5fnal_passes_skim(&table->entries[u], criteria)) {
+            if (h5fnal_reserve_event_entries((void **)&out, &n_allocated, n + 1, sizeof(h5fnal_event_summary_t)) < 0)
+                H5FNAL_PROGRAM_ERROR("could not allocate memory for selected events");
+            out[n++] = table->entries[u];
+        }
+
+    *selected = out;
+    *n_selected = n;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    free(out);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_skim_events() */
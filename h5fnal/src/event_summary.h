@@ -0,0 +1,129 @@
+/* event_summary.h
+ *
+ * Per-event summaries and skims.
+ *
+ * The writers record a summary of each event (element counts, total
+ * hit charge, hit time range, truth origins) in a summary table, a
+ * dataset in the master run container that is sorted by (run, sub-run,
+ * event) like the event lookup. The whole table is read in one go, so
+ * events can be selected by their summaries without opening any event
+ * groups or data product datasets.
+ */
+
+#ifndef H5FNAL_EVENT_SUMMARY_H
+#define H5FNAL_EVENT_SUMMARY_H
+
+#include "h5fnal.h"
+
+/* Name of the summary table dataset (normally in the master run container) */
+#define H5FNAL_EVENT_SUMMARY_NAME   "event_summary"
+
+/* Event summary
+ *
+ * The counts are totals over all of the event's data products of each
+ * kind. origin_mask has bit (1 << origin) set for each origin among the
+ * event's truths. The hit times are only meaningful if n_hits is not
+ * zero.
+ */
+typedef struct h5fnal_event_summary_t {
+    unsigned    run;
+    unsigned    subrun;
+    unsigned    event;
+    unsigned    origin_mask;
+    hsize_t     n_hits;
+    hsize_t     n_hit_collections;
+    hsize_t     n_truths;
+    hsize_t     n_particles;
+    hsize_t     n_neutrinos;
+    hsize_t     n_pairs;
+    double      total_charge;
+    float       min_hit_time;
+    float       max_hit_time;
+} h5fnal_event_summary_t;
+
+/* Summary table
+ *
+ * Works like the event lookup: the entries are kept sorted in memory
+ * and the dataset is written when the table is closed. loc_id is not
+ * owned by the table and must stay open while it is in use.
+ */
+typedef struct h5fnal_summary_table_t {
+    hid_t                       loc_id;
+    hid_t                       dtype_id;
+    h5fnal_event_summary_t     *entries;
+    hsize_t                     n_entries;
+    hsize_t                     n_allocated;
+    hbool_t                     modified;
+} h5fnal_summary_table_t;
+
+/* Neutrino requirement for skims */
+typedef enum h5fnal_skim_neutrino_t {
+    H5FNAL_SKIM_ANY_NEUTRINO = 0,   /* don't care                           */
+    H5FNAL_SKIM_WITH_NEUTRINO,      /* at least one neutrino                */
+    H5FNAL_SKIM_WITHOUT_NEUTRINO    /* no neutrinos                         */
+} h5fnal_skim_neutrino_t;
+
+/* No upper limit on a skim count */
+#define H5FNAL_SKIM_NO_LIMIT    ((hsize_t)(-1))
+
+/* Skim criteria
+ *
+ * An event passes if all its counts are in their [min, max] ranges,
+ * its total charge is at least min_total_charge, one of its hits is
+ * in [min_hit_time, max_hit_time] (as far as the summary's time range
+ * can tell), it has one of the origins in origin_mask (if not zero)
+ * and it meets the neutrino requirement.
+ *
+ * h5fnal_init_skim_criteria() sets up criteria every event passes.
+ */
+typedef struct h5fnal_skim_criteria_t {
+    hsize_t                 min_hits;
+    hsize_t                 max_hits;
+    hsize_t                 min_particles;
+    hsize_t                 max_particles;
+    hsize_t                 min_pairs;
+    hsize_t                 max_pairs;
+    double                  min_total_charge;
+    float                   min_hit_time;
+    float                   max_hit_time;
+    unsigned                origin_mask;
+    h5fnal_skim_neutrino_t  neutrino;
+} h5fnal_skim_criteria_t;
+
+/* The product headers may not have been read yet when this one is */
+struct h5fnal_vect_hitcoll_data_t;
+struct h5fnal_vect_truth_data_t;
+struct h5fnal_assns_data_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+hid_t h5fnal_create_event_summary_type(void);
+
+/* Building summaries */
+herr_t h5fnal_init_event_summary(h5fnal_event_summary_t *summary, unsigned run, unsigned subrun, unsigned event);
+herr_t h5fnal_summarize_hits(h5fnal_event_summary_t *summary, const struct h5fnal_vect_hitcoll_data_t *data);
+herr_t h5fnal_summarize_truths(h5fnal_event_summary_t *summary, const struct h5fnal_vect_truth_data_t *data);
+herr_t h5fnal_summarize_assns(h5fnal_event_summary_t *summary, const struct h5fnal_assns_data_t *data);
+
+/* Summary table */
+herr_t h5fnal_create_summary_table(hid_t loc_id, h5fnal_summary_table_t *table);
+herr_t h5fnal_open_summary_table(hid_t loc_id, h5fnal_summary_table_t *table);
+herr_t h5fnal_close_summary_table(h5fnal_summary_table_t *table);
+
+herr_t h5fnal_add_event_summary(h5fnal_summary_table_t *table, const h5fnal_event_summary_t *summary);
+htri_t h5fnal_find_event_summary(const h5fnal_summary_table_t *table, unsigned run, unsigned subrun, unsigned event,
+        /*OUT*/ h5fnal_event_summary_t *summary);
+
+/* Skims */
+herr_t h5fnal_init_skim_criteria(h5fnal_skim_criteria_t *criteria);
+hbool_t h5fnal_passes_skim(const h5fnal_event_summary_t *summary, const h5fnal_skim_criteria_t *criteria);
+herr_t h5fnal_skim_events(const h5fnal_summary_table_t *table, const h5fnal_skim_criteria_t *criteria,
+        /*OUT*/ h5fnal_event_summary_t **selected, /*OUT*/ hsize_t *n_selected);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H5FNAL_EVENT_SUMMARY_H */
@@ -0,0 +1,274 @@
+/* file.c
+ *
+ * Creating and opening HDF5 files with performance profiles.
+ */
+
+#include <string.h>
+
+#include "h5fnal.h"
+
+#define KiB     ((hsize_t)1024)
+#define MiB     (1024 * KiB)
+
+/* The profiles' settings, in h5fnal_file_profile_t order */
+static const h5fnal_file_settings_t h5fnal_file_profiles_g[H5FNAL_N_FILE_PROFILES] = {
+    /* DEFAULT */
+    {FALSE, 0, 0, 0, 0, 0, 0, 0, 0},
+
+    /* STREAMING_WRITE: 1 MiB pages. The page buffer and metadata cache
+     * hold a few pages' worth of new objects so they go out in whole
+     * pages.
+     */
+    {TRUE, 1 * MiB, 0, 0, 0, 0, 16 * MiB, 4 * MiB, 32 * MiB},
+
+    /* BULK_READ: metadata and small raw data are aggregated into 4 MiB
+     * blocks so they are read in large pieces, and chunk-sized or
+     * larger objects are aligned to 4 KiB file system blocks.
+     */
+    {FALSE, 0, 4 * MiB, 4 * MiB, 64 * KiB, 4 * KiB, 16 * MiB, 16 * MiB, 64 * MiB},
+
+    /* RANDOM_READ: 64 KiB pages (the default chunk size), so an event's
+     * objects are in a few pages, with a page buffer to keep them.
+     */
+    {TRUE, 64 * KiB, 0, 0, 0, 0, 16 * MiB, 8 * MiB, 64 * MiB}
+};
+
+
+/************************************************************************
+ * h5fnal_get_file_settings()
+ *
+ * Gets the settings a profile uses, e.g. to adjust them and pass them
+ * to h5fnal_create_fcpl() and h5fnal_create_fapl().
+ ************************************************************************/
+herr_t
+h5fnal_get_file_settings(h5fnal_file_profile_t profile, h5fnal_file_settings_t *settings)
+{
+    if (profile < 0 || profile >= H5FNAL_N_FILE_PROFILES)
+        H5FNAL_PROGRAM_ERROR("invalid file profile");
+    if (NULL == settings)
+        H5FNAL_PROGRAM_ERROR("settings parameter cannot be NULL");
+
+    *settings = h5fnal_file_profiles_g[profile];
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_get_file_settings() */
+
+
+/************************************************************************
+ * h5fnal_create_fcpl()
+ *
+ * Creates a file creation property list with the given settings.
+ ************************************************************************/
+hid_t
+h5fnal_create_fcpl(const h5fnal_file_settings_t *settings)
+{
+    hid_t fcpl_id = H5FNAL_BAD_HID_T;
+
+    if (NULL == settings)
+        H5FNAL_PROGRAM_ERROR("settings parameter cannot be NULL");
+
+    if ((fcpl_id = H5Pcreate(H5P_FILE_CREATE)) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (settings->paged) {
+        if (H5Pset_file_space_strategy(fcpl_id, H5F_FSPACE_STRATEGY_PAGE, FALSE, (hsize_t)1) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (settings->page_size > 0)
+            if (H5Pset_file_space_page_size(fcpl_id, settings->page_size) < 0)
+                H5FNAL_HDF5_ERROR;
+    }
+
+    return fcpl_id;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Pclose(fcpl_id);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_create_fcpl() */
+
+
+/************************************************************************
+ * h5fnal_create_fapl()
+ *
+ * Creates a file access property list with the given settings. The
+ * file format is always the latest one.
+ ************************************************************************/
+hid_t
+h5fnal_create_fapl(const h5fnal_file_settings_t *settings)
+{
+    hid_t fapl_id = H5FNAL_BAD_HID_T;
+    H5AC_cache_config_t mdc_config;
+
+    if (NULL == settings)
+        H5FNAL_PROGRAM_ERROR("settings parameter cannot be NULL");
+
+    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Pset_libver_bounds(fapl_id, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    /* Aggregation and alignment only matter when the file is created,
+     * but they are file access properties
+     */
+    if (!settings->paged) {
+        if (settings->meta_block_size > 0)
+            if (H5Pset_meta_block_size(fapl_id, settings->meta_block_size) < 0)
+                H5FNAL_HDF5_ERROR;
+        if (settings->small_data_block_size > 0)
+            if (H5Pset_small_data_block_size(fapl_id, settings->small_data_block_size) < 0)
+                H5FNAL_HDF5_ERROR;
+        if (settings->alignment > 0)
+            if (H5Pset_alignment(fapl_id, settings->alignment_threshold, settings->alignment) < 0)
+                H5FNAL_HDF5_ERROR;
+    }
+
+    if (settings->page_buffer_size > 0)
+        if (H5Pset_page_buffer_size(fapl_id, settings->page_buffer_size, 0, 0) < 0)
+            H5FNAL_HDF5_ERROR;
+
+    if (settings->mdc_initial_size > 0 || settings->mdc_max_size > 0) {
+        memset(&mdc_config, 0, sizeof(H5AC_cache_config_t));
+        mdc_config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+        if (H5Pget_mdc_config(fapl_id, &mdc_config) < 0)
+            H5FNAL_HDF5_ERROR;
+
+        if (settings->mdc_max_size > 0)
+            mdc_config.max_size = settings->mdc_max_size;
+        if (settings->mdc_initial_size > 0) {
+            mdc_config.set_initial_size = TRUE;
+            mdc_config.initial_size = settings->mdc_initial_size;
+        }
+        mdc_config.max_size = H5FNAL_MAX(mdc_config.max_size, mdc_config.initial_size);
+        mdc_config.min_size = H5FNAL_MIN(mdc_config.min_size, mdc_config.initial_size);
+
+        if (H5Pset_mdc_config(fapl_id, &mdc_config) < 0)
+            H5FNAL_HDF5_ERROR;
+    }
+
+    return fapl_id;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Pclose(fapl_id);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_create_fapl() */
+
+
+/************************************************************************
+ * h5fnal_create_file()
+ *
+ * Creates (or truncates) an HDF5 file set up for the given profile.
+ ************************************************************************/
+hid_t
+h5fnal_create_file(const char *name, h5fnal_file_profile_t profile)
+{
+    h5fnal_file_settings_t settings;
+    hid_t fcpl_id = H5FNAL_BAD_HID_T;
+    hid_t fapl_id = H5FNAL_BAD_HID_T;
+    hid_t fid = H5FNAL_BAD_HID_T;
+
+    if (NULL == name)
+        H5FNAL_PROGRAM_ERROR("name parameter cannot be NULL");
+
+    if (h5fnal_get_file_settings(profile, &settings) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get file profile settings");
+    if ((fcpl_id = h5fnal_create_fcpl(&settings)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create file creation property list");
+    if ((fapl_id = h5fnal_create_fapl(&settings)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create file access property list");
+
+    if ((fid = H5Fcreate(name, H5F_ACC_TRUNC, fcpl_id, fapl_id)) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (H5Pclose(fcpl_id) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Pclose(fapl_id) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return fid;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Fclose(fid);
+        H5Pclose(fcpl_id);
+        H5Pclose(fapl_id);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_create_file() */
+
+
+/************************************************************************
+ * h5fnal_open_file()
+ *
+ * Opens an existing HDF5 file with the given profile's access
+ * properties. flags are the H5Fopen() flags.
+ ************************************************************************/
+hid_t
+h5fnal_open_file(const char *name, unsigned flags, h5fnal_file_profile_t profile)
+{
+    h5fnal_file_settings_t settings;
+    hid_t fapl_id = H5FNAL_BAD_HID_T;
+    hid_t fid = H5FNAL_BAD_HID_T;
+
+    if (NULL == name)
+        H5FNAL_PROGRAM_ERROR("name parameter cannot be NULL");
+
+    if (h5fnal_get_file_settings(profile, &settings) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get file profile settings");
+    if ((fapl_id = h5fnal_create_fapl(&settings)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create file access property list");
+
+    /* HDF5 won't open a file that wasn't created with paged file space
+     * with a page buffer, so try again without one
+     */
+    if (settings.page_buffer_size > 0) {
+        H5E_BEGIN_TRY {
+            fid = H5Fopen(name, flags, fapl_id);
+        } H5E_END_TRY;
+
+        if (fid < 0) {
+            if (H5Pset_page_buffer_size(fapl_id, 0, 0, 0) < 0)
+                H5FNAL_HDF5_ERROR;
+        }
+    }
+    if (fid < 0)
+        if ((fid = H5Fopen(name, flags, fapl_id)) < 0)
+            H5FNAL_HDF5_ERROR;
+
+    if (H5Pclose(fapl_id) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return fid;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Fclose(fid);
+        H5Pclose(fapl_id);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_open_file() */
+
+
+/************************************************************************
+ * h5fnal_close_file()
+ ************************************************************************/
+herr_t
+h5fnal_close_file(hid_t fid)
+{
+    if (H5Fclose(fid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_close_file() */
@@ -0,0 +1,75 @@
+/* file.h
+ *
+ * Creating and opening HDF5 files with performance profiles.
+ */
+
+#ifndef H5FNAL_FILE_H
+#define H5FNAL_FILE_H
+
+#include "h5fnal.h"
+
+/* File profiles
+ *
+ * Each profile sets the file creation and access properties that suit
+ * a workload. The creation properties describe how the file will be
+ * used after it is written, so a file that will mostly be read event
+ * by event can be created with H5FNAL_PROFILE_RANDOM_READ, too. Only
+ * the access properties matter when opening an existing file.
+ *
+ *  DEFAULT           latest file format, otherwise the HDF5 defaults
+ *  STREAMING_WRITE   large file space pages, so metadata and small raw
+ *                    data writes are gathered into page-sized blocks
+ *  BULK_READ         large metadata cache and aggregation blocks, and
+ *                    large objects aligned to file system blocks
+ *  RANDOM_READ       small file space pages and a page buffer, so an
+ *                    event's metadata and data come in a few reads
+ */
+typedef enum h5fnal_file_profile_t {
+    H5FNAL_PROFILE_DEFAULT = 0,
+    H5FNAL_PROFILE_STREAMING_WRITE,
+    H5FNAL_PROFILE_BULK_READ,
+    H5FNAL_PROFILE_RANDOM_READ,
+    H5FNAL_N_FILE_PROFILES
+} h5fnal_file_profile_t;
+
+/* File settings
+ *
+ * The HDF5 knobs a profile sets. Zero means the HDF5 default.
+ *
+ * With paged set, file space is managed in page_size pages and the
+ * block sizes and alignment are ignored (pages are already aligned).
+ * The page buffer only works with files that were created paged, so
+ * h5fnal_open_file() drops it for files that weren't.
+ */
+typedef struct h5fnal_file_settings_t {
+    /* creation */
+    hbool_t     paged;
+    hsize_t     page_size;
+    hsize_t     meta_block_size;
+    hsize_t     small_data_block_size;
+    hsize_t     alignment_threshold;
+    hsize_t     alignment;
+
+    /* access */
+    size_t      page_buffer_size;
+    size_t      mdc_initial_size;
+    size_t      mdc_max_size;
+} h5fnal_file_settings_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+herr_t h5fnal_get_file_settings(h5fnal_file_profile_t profile, h5fnal_file_settings_t *settings);
+hid_t h5fnal_create_fcpl(const h5fnal_file_settings_t *settings);
+hid_t h5fnal_create_fapl(const h5fnal_file_settings_t *settings);
+
+hid_t h5fnal_create_file(const char *name, h5fnal_file_profile_t profile);
+hid_t h5fnal_open_file(const char *name, unsigned flags, h5fnal_file_profile_t profile);
+herr_t h5fnal_close_file(hid_t fid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H5FNAL_FILE_H */
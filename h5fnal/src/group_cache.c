@@ -0,0 +1,199 @@
+/* group_cache.c
+ *
+ * Cache of open run and sub-run group handles for the read path.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "h5fnal.h"
+
+
+/************************************************************************
+ * h5fnal_create_group_cache()
+ *
+ * Sets up an empty cache of groups under loc_id (normally the master
+ * run container). A max_groups of zero gets the default size.
+ ************************************************************************/
+herr_t
+h5fnal_create_group_cache(hid_t loc_id, unsigned max_groups, h5fnal_group_cache_t *cache)
+{
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == cache)
+        H5FNAL_PROGRAM_ERROR("cache parameter cannot be NULL");
+
+    memset(cache, 0, sizeof(h5fnal_group_cache_t));
+    cache->loc_id = loc_id;
+    cache->max_groups = max_groups > 0 ? max_groups : H5FNAL_DEFAULT_GROUP_CACHE_SIZE;
+
+    if (NULL == (cache->groups = (h5fnal_cached_group_t *)calloc(cache->max_groups, sizeof(h5fnal_cached_group_t))))
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for group cache");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_create_group_cache() */
+
+
+/************************************************************************
+ * h5fnal_close_group_cache()
+ *
+ * Closes all the cached groups and frees the cache.
+ ************************************************************************/
+herr_t
+h5fnal_close_group_cache(h5fnal_group_cache_t *cache)
+{
+    herr_t ret = H5FNAL_SUCCESS;
+    unsigned u;
+
+    if (NULL == cache)
+        H5FNAL_PROGRAM_ERROR("cache parameter cannot be NULL");
+
+    /* Close everything, even if something fails */
+    for (u = 0; u < cache->n_groups; u++) {
+        if (H5Gclose(cache->groups[u].gid) < 0)
+            ret = H5FNAL_FAILURE;
+        free(cache->groups[u].path);
+    }
+    free(cache->groups);
+
+    memset(cache, 0, sizeof(h5fnal_group_cache_t));
+    cache->loc_id = H5FNAL_BAD_HID_T;
+
+    return ret;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_close_group_cache() */
+
+
+/************************************************************************
+ * h5fnal_get_cached_group()
+ *
+ * Returns the group at path (relative to the cache's location),
+ * opening it if it isn't in the cache. A group that has to be opened
+ * is opened from its parent, which goes through the cache, too.
+ *
+ * The handle belongs to the cache. Don't close it, and don't use it
+ * after the next call, which might evict it.
+ ************************************************************************/
+hid_t
+h5fnal_get_cached_group(h5fnal_group_cache_t *cache, const char *path)
+{
+    h5fnal_cached_group_t *entry;
+    char *parent = NULL;
+    char *path_copy = NULL;
+    const char *slash;
+    hid_t parent_id;
+    hid_t gid = H5FNAL_BAD_HID_T;
+    hid_t victim_id = H5FNAL_BAD_HID_T;
+    hbool_t cached = FALSE;
+    unsigned u;
+
+    if (NULL == cache)
+        H5FNAL_PROGRAM_ERROR("cache parameter cannot be NULL");
+    if (NULL == path)
+        H5FNAL_PROGRAM_ERROR("path parameter cannot be NULL");
+
+    for (u = 0; u < cache->n_groups; u++)
+        if (0 == strcmp(cache->groups[u].path, path)) {
+            cache->groups[u].last_used = ++cache->tick;
+            cache->hits++;
+            return cache->groups[u].gid;
+        }
+
+    cache->misses++;
+
+    if (NULL == (path_copy = strdup(path)))
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for group path");
+
+    if (NULL != (slash = strrchr(path, '/')) && slash != path) {
+        if (NULL == (parent = strdup(path)))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for group path");
+        parent[slash - path] = '\0';
+
+        if ((parent_id = h5fnal_get_cached_group(cache, parent)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not get parent group");
+        if ((gid = H5Gopen2(parent_id, slash + 1, H5P_DEFAULT)) < 0)
+            H5FNAL_HDF5_ERROR;
+
+        free(parent);
+        parent = NULL;
+    }
+    else if ((gid = H5Gopen2(cache->loc_id, path, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    /* Replace the least recently used group if the cache is full. The
+     * victim is closed after the new group is opened, since it may be
+     * the new group's parent.
+     */
+    if (cache->n_groups < cache->max_groups)
+        entry = &cache->groups[cache->n_groups++];
+    else {
+        entry = &cache->groups[0];
+        for (u = 1; u < cache->n_groups; u++)
+            if (cache->groups[u].last_used < entry->last_used)
+                entry = &cache->groups[u];
+
+        victim_id = entry->gid;
+        free(entry->path);
+    }
+
+    entry->path = path_copy;
+    entry->gid = gid;
+    entry->last_used = ++cache->tick;
+    cached = TRUE;
+
+    if (victim_id >= 0)
+        if (H5Gclose(victim_id) < 0)
+            H5FNAL_HDF5_ERROR;
+
+    return gid;
+
+error:
+    if (!cached) {
+        H5E_BEGIN_TRY {
+            H5Gclose(gid);
+        } H5E_END_TRY;
+        free(path_copy);
+    }
+    free(parent);
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_get_cached_group() */
+
+
+/************************************************************************
+ * h5fnal_open_cached_event()
+ *
+ * Opens an event in the run/sub-run/event group layout, with the run
+ * and sub-run groups coming from the cache. Close the event with
+ * h5fnal_close_event().
+ ************************************************************************/
+hid_t
+h5fnal_open_cached_event(h5fnal_group_cache_t *cache, unsigned run, unsigned subrun, unsigned event)
+{
+    char path[64];
+    char name[32];
+    hid_t subrun_id;
+    hid_t event_id = H5FNAL_BAD_HID_T;
+
+    if (NULL == cache)
+        H5FNAL_PROGRAM_ERROR("cache parameter cannot be NULL");
+
+    snprintf(path, sizeof(path), "%u/%u", run, subrun);
+    snprintf(name, sizeof(name), "%u", event);
+
+    if ((subrun_id = h5fnal_get_cached_group(cache, path)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get sub-run group");
+    if ((event_id = h5fnal_open_event(subrun_id, name)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open event");
+
+    return event_id;
+
+error:
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_open_cached_event() */
@@ -0,0 +1,54 @@
+/* group_cache.h
+ *
+ * Cache of open run and sub-run group handles for the read path.
+ *
+ * Reading event after event re-opens the same run and sub-run groups
+ * over and over. The cache keeps the most recently used groups open,
+ * keyed by their path from the cache's location, and closes the least
+ * recently used one when it is full.
+ */
+
+#ifndef H5FNAL_GROUP_CACHE_H
+#define H5FNAL_GROUP_CACHE_H
+
+#include "h5fnal.h"
+
+/* Default number of open groups (a run and a few of its sub-runs) */
+#define H5FNAL_DEFAULT_GROUP_CACHE_SIZE     4
+
+typedef struct h5fnal_cached_group_t {
+    char           *path;
+    hid_t           gid;
+    unsigned long   last_used;
+} h5fnal_cached_group_t;
+
+/* Group cache
+ *
+ * loc_id is not owned by the cache and must stay open while it is in
+ * use. The hits and misses counts are for tuning.
+ */
+typedef struct h5fnal_group_cache_t {
+    hid_t                   loc_id;
+    h5fnal_cached_group_t  *groups;
+    unsigned                n_groups;
+    unsigned                max_groups;
+    unsigned long           tick;
+    unsigned long           hits;
+    unsigned long           misses;
+} h5fnal_group_cache_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+herr_t h5fnal_create_group_cache(hid_t loc_id, unsigned max_groups, h5fnal_group_cache_t *cache);
+herr_t h5fnal_close_group_cache(h5fnal_group_cache_t *cache);
+
+hid_t h5fnal_get_cached_group(h5fnal_group_cache_t *cache, const char *path);
+hid_t h5fnal_open_cached_event(h5fnal_group_cache_t *cache, unsigned run, unsigned subrun, unsigned event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H5FNAL_GROUP_CACHE_H */
@@ -141,3 +141,39 @@ error:
     return H5FNAL_FAILURE;
 } /* end h5fnal_close_event() */
 
+
+/************************************************************************
+ * h5fnal_get_product_count()
+ *
+ * Gets the number of elements (hit collections, truths or pairs) in the
+ * named data product without opening it, so empty data products can be
+ * skipped cheaply.
+ ************************************************************************/
+herr_t
+h5fnal_get_product_count(hid_t loc_id, const char *name, hsize_t *count)
+{
+    hid_t gid = -1;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == name)
+        H5FNAL_PROGRAM_ERROR("name parameter cannot be NULL");
+    if (NULL == count)
+        H5FNAL_PROGRAM_ERROR("count parameter cannot be NULL");
+
+    if ((gid = H5Gopen2(loc_id, name, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (h5fnal_get_hsize_attribute(gid, H5FNAL_COUNT_ATTR_NAME, 1, count) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get count attribute");
+    if (H5Gclose(gid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Gclose(gid);
+    } H5E_END_TRY;
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_get_product_count() */
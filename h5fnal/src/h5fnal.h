@@ -28,6 +28,9 @@
 #define TRUE    1
 #define FALSE   0
 
+#define H5FNAL_MIN(a, b)    (((a) < (b)) ? (a) : (b))
+#define H5FNAL_MAX(a, b)    (((a) > (b)) ? (a) : (b))
+
 /* An invalid HDF5 ID */
 #define H5FNAL_BAD_HID_T    H5I_INVALID_HID
 
@@ -38,11 +41,20 @@ typedef struct h5fnal_product_id_t {
 } h5fnal_product_id_t;
 
 /* Data type headers */
+#include "compression.h"
+#include "chunk_writer.h"
+#include "file.h"
+#include "group_cache.h"
 #include "util.h"
+#include "column_set.h"
+#include "registry.h"
+#include "event_index.h"
 #include "string_dictionary.h"
+#include "particle_graph.h"
 #include "v_mc_hit_collection.h"
 #include "v_mc_truth.h"
 #include "assns.h"
+#include "event_summary.h"
 
 /* h5fnal API */
 
@@ -60,6 +72,9 @@ hid_t h5fnal_create_event(hid_t loc_id, const char *name, hbool_t compress_names
 hid_t h5fnal_open_event(hid_t loc_id, const char *name);
 herr_t h5fnal_close_event(hid_t loc_id);
 
+/* Data products */
+herr_t h5fnal_get_product_count(hid_t loc_id, const char *name, hsize_t *count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,992 @@
+/* particle_graph.c
+ *
+ * Parent/daughter index for the MC truth particle graph.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "h5fnal.h"
+
+/* Names of the graph datasets, by H5FNAL_GRAPH_* index */
+static const char *const h5fnal_graph_dset_names_g[H5FNAL_GRAPH_N_DSETS] = {
+    "nodes",
+    "daughter_rows",
+    "preorder",
+    "track_ids"
+};
+
+/* Mother loop detection states (see h5fnal_break_mother_loops()) */
+#define H5FNAL_NODE_NEW         0
+#define H5FNAL_NODE_ON_PATH     1
+#define H5FNAL_NODE_DONE        2
+
+
+hid_t
+h5fnal_create_particle_node_type(void)
+{
+    hid_t tid = -1;
+
+    if ((tid = H5Tcreate(H5T_COMPOUND, sizeof(h5fnal_particle_node_t))) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "mother_row", HOFFSET(h5fnal_particle_node_t, mother_row), H5T_NATIVE_HSSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "primary_row", HOFFSET(h5fnal_particle_node_t, primary_row), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "daughter_start", HOFFSET(h5fnal_particle_node_t, daughter_start), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "n_daughters", HOFFSET(h5fnal_particle_node_t, n_daughters), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "preorder_index", HOFFSET(h5fnal_particle_node_t, preorder_index), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "n_descendants", HOFFSET(h5fnal_particle_node_t, n_descendants), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "depth", HOFFSET(h5fnal_particle_node_t, depth), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return tid;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Tclose(tid);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_create_particle_node_type() */
+
+
+hid_t
+h5fnal_create_track_entry_type(void)
+{
+    hid_t tid = -1;
+
+    if ((tid = H5Tcreate(H5T_COMPOUND, sizeof(h5fnal_track_entry_t))) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "track_id", HOFFSET(h5fnal_track_entry_t, track_id), H5T_NATIVE_INT) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "row", HOFFSET(h5fnal_track_entry_t, row), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return tid;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Tclose(tid);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_create_track_entry_type() */
+
+
+/************************************************************************
+ * h5fnal_reserve_particle_graph()
+ *
+ * Makes sure the graph's arrays can hold n_particles particles and
+ * n_links daughter rows. Arrays that are already large enough are
+ * left alone.
+ ************************************************************************/
+static herr_t
+h5fnal_reserve_particle_graph(h5fnal_particle_graph_t *graph)
+{
+    hsize_t n = graph->n_particles;
+
+    if (n > graph->particles_capacity) {
+        free(graph->nodes);
+        free(graph->preorder);
+        free(graph->track_ids);
+        free(graph->state);
+        graph->preorder = NULL;
+        graph->track_ids = NULL;
+        graph->state = NULL;
+        graph->particles_capacity = 0;
+        if (NULL == (graph->nodes = (h5fnal_particle_node_t *)calloc(n, sizeof(h5fnal_particle_node_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for particle nodes");
+        if (NULL == (graph->preorder = (hsize_t *)calloc(n, sizeof(hsize_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for particle preorder");
+        if (NULL == (graph->track_ids = (h5fnal_track_entry_t *)calloc(n, sizeof(h5fnal_track_entry_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for track ID map");
+        if (NULL == (graph->state = (unsigned char *)calloc(n, sizeof(unsigned char))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for particle graph scratch space");
+        graph->particles_capacity = n;
+    }
+    if (graph->n_links > graph->links_capacity) {
+        free(graph->daughter_rows);
+        graph->links_capacity = 0;
+        if (NULL == (graph->daughter_rows = (hsize_t *)calloc(graph->n_links, sizeof(hsize_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for daughter rows");
+        graph->links_capacity = graph->n_links;
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_reserve_particle_graph() */
+
+
+/************************************************************************
+ * h5fnal_compare_track_entries()
+ *
+ * qsort() comparison for track ID map entries: by track ID, then row.
+ ************************************************************************/
+static int
+h5fnal_compare_track_entries(const void *a, const void *b)
+{
+    const h5fnal_track_entry_t *ea = (const h5fnal_track_entry_t *)a;
+    const h5fnal_track_entry_t *eb = (const h5fnal_track_entry_t *)b;
+
+    if (ea->track_id != eb->track_id)
+        return ea->track_id < eb->track_id ? -1 : 1;
+    if (ea->row != eb->row)
+        return ea->row < eb->row ? -1 : 1;
+    return 0;
+} /* end h5fnal_compare_track_entries() */
+
+
+/************************************************************************
+ * h5fnal_search_track_ids()
+ *
+ * Binary search for track_id among count sorted map entries. Sets *row
+ * to the first particle with that track ID and returns TRUE if there is
+ * one.
+ ************************************************************************/
+static hbool_t
+h5fnal_search_track_ids(const h5fnal_track_entry_t *entries, hsize_t count, int track_id, hsize_t *row)
+{
+    hsize_t lo = 0;
+    hsize_t hi = count;
+    hsize_t mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (entries[mid].track_id < track_id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == count || entries[lo].track_id != track_id)
+        return FALSE;
+
+    *row = entries[lo].row;
+    return TRUE;
+} /* end h5fnal_search_track_ids() */
+
+
+/************************************************************************
+ * h5fnal_resolve_mothers()
+ *
+ * Sorts the track ID map within each truth's particle range and looks
+ * up each particle's mother there. Ranges have to be in order and not
+ * overlap (as the writers make them). Any other range is skipped, so
+ * the particles in it keep their singleton map entries and have no
+ * mother.
+ ************************************************************************/
+static void
+h5fnal_resolve_mothers(const h5fnal_vect_truth_data_t *data, h5fnal_particle_graph_t *graph)
+{
+    hssize_t next = 0;
+    hsize_t start;
+    hsize_t count;
+    hsize_t row;
+    hsize_t r;
+    hsize_t u;
+
+    for (u = 0; u < data->n_truths; u++) {
+        const h5fnal_truth_t *t = &data->truths[u];
+
+        if (t->particle_start_index < next || t->particle_end_index < t->particle_start_index
+                || t->particle_end_index >= (hssize_t)graph->n_particles)
+            continue;
+
+        start = (hsize_t)t->particle_start_index;
+        count = (hsize_t)(t->particle_end_index - t->particle_start_index) + 1;
+        qsort(&graph->track_ids[start], (size_t)count, sizeof(h5fnal_track_entry_t), h5fnal_compare_track_entries);
+
+        for (r = start; r < start + count; r++)
+            if (h5fnal_search_track_ids(&graph->track_ids[start], count, data->particles[r].mother, &row))
+                graph->nodes[r].mother_row = (hssize_t)row;
+
+        next = t->particle_end_index + 1;
+    }
+
+    return;
+} /* end h5fnal_resolve_mothers() */
+
+
+/************************************************************************
+ * h5fnal_break_mother_loops()
+ *
+ * Follows every particle's mothers up to a primary. A chain that comes
+ * back to a particle already on it is a loop, which is broken by
+ * making the last particle reached a primary. Each particle is only
+ * followed once.
+ ************************************************************************/
+static void
+h5fnal_break_mother_loops(h5fnal_particle_graph_t *graph)
+{
+    h5fnal_particle_node_t *nodes = graph->nodes;
+    unsigned char *state = graph->state;
+    hssize_t r;
+    hssize_t last;
+    hsize_t u;
+
+    memset(state, H5FNAL_NODE_NEW, (size_t)graph->n_particles);
+
+    for (u = 0; u < graph->n_particles; u++) {
+        last = -1;
+        for (r = (hssize_t)u; r >= 0 && H5FNAL_NODE_NEW == state[r]; r = nodes[r].mother_row) {
+            state[r] = H5FNAL_NODE_ON_PATH;
+            last = r;
+        }
+        if (r >= 0 && H5FNAL_NODE_ON_PATH == state[r])
+            nodes[last].mother_row = -1;
+
+        for (r = (hssize_t)u; r >= 0 && H5FNAL_NODE_ON_PATH == state[r]; r = nodes[r].mother_row)
+            state[r] = H5FNAL_NODE_DONE;
+    }
+
+    return;
+} /* end h5fnal_break_mother_loops() */
+
+
+/************************************************************************
+ * h5fnal_link_daughters()
+ *
+ * Fills in the daughter rows (compressed sparse rows, daughters in
+ * particle order) from the mothers. n_descendants is used to count the
+ * daughters placed so far and left zeroed.
+ ************************************************************************/
+static herr_t
+h5fnal_link_daughters(h5fnal_particle_graph_t *graph)
+{
+    h5fnal_particle_node_t *nodes = graph->nodes;
+    hsize_t start = 0;
+    hsize_t u;
+
+    graph->n_links = 0;
+    for (u = 0; u < graph->n_particles; u++)
+        if (nodes[u].mother_row >= 0) {
+            nodes[nodes[u].mother_row].n_daughters++;
+            graph->n_links++;
+        }
+
+    if (h5fnal_reserve_particle_graph(graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for daughter rows");
+
+    for (u = 0; u < graph->n_particles; u++) {
+        nodes[u].daughter_start = start;
+        start += nodes[u].n_daughters;
+    }
+    for (u = 0; u < graph->n_particles; u++)
+        if (nodes[u].mother_row >= 0) {
+            h5fnal_particle_node_t *mother = &nodes[nodes[u].mother_row];
+
+            graph->daughter_rows[mother->daughter_start + mother->n_descendants++] = u;
+        }
+    for (u = 0; u < graph->n_particles; u++)
+        nodes[u].n_descendants = 0;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_link_daughters() */
+
+
+/************************************************************************
+ * h5fnal_order_particles()
+ *
+ * Walks the graph depth first from each primary, in particle order,
+ * to fill in the preorder and each particle's depth, primary and
+ * number of descendants. The end of the preorder array holds the stack
+ * of particles still to visit: a particle is either visited or on the
+ * stack, never both, so the two can't run into each other.
+ ************************************************************************/
+static void
+h5fnal_order_particles(h5fnal_particle_graph_t *graph)
+{
+    h5fnal_particle_node_t *nodes = graph->nodes;
+    hsize_t *preorder = graph->preorder;
+    hsize_t n = graph->n_particles;
+    hsize_t n_visited = 0;
+    hsize_t n_stacked;
+    hsize_t r;
+    hsize_t d;
+    hsize_t u;
+
+    for (u = 0; u < n; u++) {
+        if (nodes[u].mother_row >= 0)
+            continue;
+
+        preorder[n - 1] = u;
+        n_stacked = 1;
+        while (n_stacked > 0) {
+            h5fnal_particle_node_t *node;
+
+            r = preorder[n - n_stacked];
+            n_stacked--;
+
+            node = &nodes[r];
+            node->preorder_index = n_visited;
+            preorder[n_visited++] = r;
+            if (node->mother_row >= 0) {
+                node->depth = nodes[node->mother_row].depth + 1;
+                node->primary_row = nodes[node->mother_row].primary_row;
+            }
+            else {
+                node->depth = 0;
+                node->primary_row = r;
+            }
+
+            /* Push the daughters so they come off in particle order */
+            for (d = node->n_daughters; d > 0; d--)
+                preorder[n - ++n_stacked] = graph->daughter_rows[node->daughter_start + d - 1];
+        }
+    }
+
+    /* Daughters come after their mothers in the preorder */
+    for (u = n; u > 0; u--) {
+        r = preorder[u - 1];
+        if (nodes[r].mother_row >= 0)
+            nodes[nodes[r].mother_row].n_descendants += nodes[r].n_descendants + 1;
+    }
+
+    return;
+} /* end h5fnal_order_particles() */
+
+
+/************************************************************************
+ * h5fnal_build_particle_graph()
+ *
+ * Builds the graph of the particles in data, using the truths' particle
+ * ranges to find the mothers. Rows are indices into data's particle
+ * array.
+ ************************************************************************/
+herr_t
+h5fnal_build_particle_graph(const h5fnal_vect_truth_data_t *data, h5fnal_particle_graph_t *graph)
+{
+    hsize_t u;
+
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+    if (!graph)
+        H5FNAL_PROGRAM_ERROR("graph parameter cannot be NULL");
+
+    graph->n_particles = data->n_particles;
+    graph->n_links = 0;
+    if (0 == graph->n_particles)
+        return H5FNAL_SUCCESS;
+    if (h5fnal_reserve_particle_graph(graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for particle graph");
+
+    for (u = 0; u < graph->n_particles; u++) {
+        memset(&graph->nodes[u], 0, sizeof(h5fnal_particle_node_t));
+        graph->nodes[u].mother_row = -1;
+        graph->track_ids[u].track_id = data->particles[u].track_id;
+        graph->track_ids[u].row = u;
+    }
+
+    h5fnal_resolve_mothers(data, graph);
+    h5fnal_break_mother_loops(graph);
+    if (h5fnal_link_daughters(graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not link daughters");
+    h5fnal_order_particles(graph);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_build_particle_graph() */
+
+
+/* Important in case the library and application use a different
+ * memory allocator.
+ */
+herr_t
+h5fnal_free_particle_graph(h5fnal_particle_graph_t *graph)
+{
+    if (!graph)
+        H5FNAL_PROGRAM_ERROR("graph parameter cannot be NULL");
+
+    free(graph->nodes);
+    free(graph->daughter_rows);
+    free(graph->preorder);
+    free(graph->track_ids);
+    free(graph->state);
+
+    memset(graph, 0, sizeof(h5fnal_particle_graph_t));
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_free_particle_graph() */
+
+
+/************************************************************************
+ * h5fnal_find_particle_row()
+ *
+ * Looks up the particle with track_id among the truth's particles.
+ * Returns TRUE and sets *row if there is one, FALSE if not. The truth's
+ * particle indices have to be rows in the same graph (e.g. both read
+ * for the same event).
+ ************************************************************************/
+htri_t
+h5fnal_find_particle_row(const h5fnal_particle_graph_t *graph, const h5fnal_truth_t *truth, int track_id,
+        hsize_t *row)
+{
+    hsize_t start;
+
+    if (!graph)
+        H5FNAL_PROGRAM_ERROR("graph parameter cannot be NULL");
+    if (!truth)
+        H5FNAL_PROGRAM_ERROR("truth parameter cannot be NULL");
+    if (!row)
+        H5FNAL_PROGRAM_ERROR("row parameter cannot be NULL");
+
+    if (truth->particle_start_index < 0 || truth->particle_end_index < truth->particle_start_index
+            || truth->particle_end_index >= (hssize_t)graph->n_particles)
+        return FALSE;
+
+    start = (hsize_t)truth->particle_start_index;
+
+    return h5fnal_search_track_ids(&graph->track_ids[start],
+            (hsize_t)(truth->particle_end_index - truth->particle_start_index) + 1, track_id, row);
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_find_particle_row() */
+
+
+/************************************************************************
+ * h5fnal_get_mother_row()
+ *
+ * Returns the row of the particle's mother, or -1 if it is a primary
+ * (or row is not in the graph).
+ ************************************************************************/
+hssize_t
+h5fnal_get_mother_row(const h5fnal_particle_graph_t *graph, hsize_t row)
+{
+    if (!graph || row >= graph->n_particles)
+        return -1;
+
+    return graph->nodes[row].mother_row;
+} /* end h5fnal_get_mother_row() */
+
+
+/************************************************************************
+ * h5fnal_get_primary_row()
+ *
+ * Returns the row of the primary the particle descends from (the
+ * particle itself for primaries), or -1 if row is not in the graph.
+ ************************************************************************/
+hssize_t
+h5fnal_get_primary_row(const h5fnal_particle_graph_t *graph, hsize_t row)
+{
+    if (!graph || row >= graph->n_particles)
+        return -1;
+
+    return (hssize_t)graph->nodes[row].primary_row;
+} /* end h5fnal_get_primary_row() */
+
+
+/************************************************************************
+ * h5fnal_get_daughter_rows()
+ *
+ * Returns the rows of the particle's daughters, in particle order, and
+ * sets *n to the number of them. The array belongs to the graph.
+ ************************************************************************/
+const hsize_t *
+h5fnal_get_daughter_rows(const h5fnal_particle_graph_t *graph, hsize_t row, hsize_t *n)
+{
+    if (!n)
+        return NULL;
+    *n = 0;
+    if (!graph || row >= graph->n_particles)
+        return NULL;
+
+    *n = graph->nodes[row].n_daughters;
+    return graph->daughter_rows + graph->nodes[row].daughter_start;
+} /* end h5fnal_get_daughter_rows() */
+
+
+/************************************************************************
+ * h5fnal_get_descendant_rows()
+ *
+ * Returns the rows of all the particle's descendants, depth first, and
+ * sets *n to the number of them. The array belongs to the graph.
+ ************************************************************************/
+const hsize_t *
+h5fnal_get_descendant_rows(const h5fnal_particle_graph_t *graph, hsize_t row, hsize_t *n)
+{
+    if (!n)
+        return NULL;
+    *n = 0;
+    if (!graph || row >= graph->n_particles)
+        return NULL;
+
+    *n = graph->nodes[row].n_descendants;
+    return graph->preorder + graph->nodes[row].preorder_index + 1;
+} /* end h5fnal_get_descendant_rows() */
+
+
+/************************************************************************
+ * h5fnal_get_ancestor_rows()
+ *
+ * Stores the rows of up to max of the particle's ancestors in rows,
+ * mother first, and returns the number of ancestors it has (its
+ * depth), which can be more than max.
+ ************************************************************************/
+hsize_t
+h5fnal_get_ancestor_rows(const h5fnal_particle_graph_t *graph, hsize_t row, hsize_t *rows, hsize_t max)
+{
+    hssize_t r;
+    hsize_t u;
+
+    if (!graph || row >= graph->n_particles)
+        return 0;
+
+    if (rows)
+        for (u = 0, r = graph->nodes[row].mother_row; u < max && r >= 0; u++, r = graph->nodes[r].mother_row)
+            rows[u] = (hsize_t)r;
+
+    return graph->nodes[row].depth;
+} /* end h5fnal_get_ancestor_rows() */
+
+
+/************************************************************************
+ * h5fnal_is_descendant()
+ *
+ * Returns TRUE if the particle at row descends from the one at
+ * ancestor_row.
+ ************************************************************************/
+hbool_t
+h5fnal_is_descendant(const h5fnal_particle_graph_t *graph, hsize_t row, hsize_t ancestor_row)
+{
+    const h5fnal_particle_node_t *ancestor;
+    hsize_t index;
+
+    if (!graph || row >= graph->n_particles || ancestor_row >= graph->n_particles)
+        return FALSE;
+
+    ancestor = &graph->nodes[ancestor_row];
+    index = graph->nodes[row].preorder_index;
+
+    return index > ancestor->preorder_index && index <= ancestor->preorder_index + ancestor->n_descendants;
+} /* end h5fnal_is_descendant() */
+
+
+/************************************************************************
+ * h5fnal_shift_graph_rows()
+ *
+ * Adds row_offset to all the particle rows in the graph and
+ * link_offset to the indices into the daughter rows.
+ ************************************************************************/
+static void
+h5fnal_shift_graph_rows(h5fnal_particle_graph_t *graph, hssize_t row_offset, hssize_t link_offset)
+{
+    hsize_t u;
+
+    for (u = 0; u < graph->n_particles; u++) {
+        h5fnal_particle_node_t *node = &graph->nodes[u];
+
+        if (node->mother_row >= 0)
+            node->mother_row += row_offset;
+        node->primary_row = (hsize_t)((hssize_t)node->primary_row + row_offset);
+        node->preorder_index = (hsize_t)((hssize_t)node->preorder_index + row_offset);
+        node->daughter_start = (hsize_t)((hssize_t)node->daughter_start + link_offset);
+
+        graph->preorder[u] = (hsize_t)((hssize_t)graph->preorder[u] + row_offset);
+        graph->track_ids[u].row = (hsize_t)((hssize_t)graph->track_ids[u].row + row_offset);
+    }
+    for (u = 0; u < graph->n_links; u++)
+        graph->daughter_rows[u] = (hsize_t)((hssize_t)graph->daughter_rows[u] + row_offset);
+
+    return;
+} /* end h5fnal_shift_graph_rows() */
+
+
+/************************************************************************
+ * h5fnal_is_self_contained()
+ *
+ * Returns TRUE if all the rows in a graph read from the particles
+ * [start, start + n_particles) and the daughter rows
+ * [link_start, link_start + n_links) (before they are shifted) are in
+ * those ranges, i.e. the range didn't split a truth.
+ ************************************************************************/
+static hbool_t
+h5fnal_is_self_contained(const h5fnal_particle_graph_t *graph, hsize_t start, hsize_t link_start)
+{
+    hsize_t end = start + graph->n_particles;
+    hsize_t link_end = link_start + graph->n_links;
+    hsize_t u;
+
+    for (u = 0; u < graph->n_particles; u++) {
+        const h5fnal_particle_node_t *node = &graph->nodes[u];
+
+        if (node->mother_row >= 0 && ((hsize_t)node->mother_row < start || (hsize_t)node->mother_row >= end))
+            return FALSE;
+        if (node->primary_row < start || node->primary_row >= end)
+            return FALSE;
+        if (node->preorder_index < start || node->preorder_index >= end)
+            return FALSE;
+        if (node->daughter_start < link_start || node->daughter_start > link_end
+                || node->n_daughters > link_end - node->daughter_start)
+            return FALSE;
+        if (graph->preorder[u] < start || graph->preorder[u] >= end)
+            return FALSE;
+        if (graph->track_ids[u].row < start || graph->track_ids[u].row >= end)
+            return FALSE;
+    }
+    for (u = 0; u < graph->n_links; u++)
+        if (graph->daughter_rows[u] < start || graph->daughter_rows[u] >= end)
+            return FALSE;
+
+    return TRUE;
+} /* end h5fnal_is_self_contained() */
+
+
+/************************************************************************
+ * h5fnal_get_graph_type()
+ *
+ * Returns the datatype of one of the graph datasets.
+ ************************************************************************/
+static hid_t
+h5fnal_get_graph_type(const h5fnal_graph_store_t *store, int i)
+{
+    if (H5FNAL_GRAPH_NODES == i)
+        return store->node_tid;
+    if (H5FNAL_GRAPH_TRACK_IDS == i)
+        return store->entry_tid;
+    return H5T_NATIVE_HSIZE;
+} /* end h5fnal_get_graph_type() */
+
+
+/************************************************************************
+ * h5fnal_free_graph_store()
+ *
+ * Closes everything in the store with no error checking and discards
+ * anything still in the append buffers. Used to clean up after errors.
+ * A store that was never set up (all zero) is left alone.
+ ************************************************************************/
+herr_t
+h5fnal_free_graph_store(h5fnal_graph_store_t *store)
+{
+    int i;
+
+    if (NULL == store)
+        H5FNAL_PROGRAM_ERROR("store parameter cannot be NULL");
+
+    if (store->gid > 0) {
+        for (i = 0; i < H5FNAL_GRAPH_N_DSETS; i++) {
+            h5fnal_free_append_buffer(&store->buffers[i]);
+            H5E_BEGIN_TRY {
+                H5Dclose(store->dids[i]);
+            } H5E_END_TRY;
+        }
+        H5E_BEGIN_TRY {
+            h5fnal_release_type(store->node_tid);
+            h5fnal_release_type(store->entry_tid);
+            H5Gclose(store->gid);
+        } H5E_END_TRY;
+    }
+    h5fnal_free_particle_graph(&store->scratch);
+
+    memset(store, 0, sizeof(h5fnal_graph_store_t));
+    store->gid = H5FNAL_BAD_HID_T;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_free_graph_store() */
+
+
+/************************************************************************
+ * h5fnal_init_graph_store()
+ *
+ * Gets the datatypes for a store whose group is open.
+ ************************************************************************/
+static herr_t
+h5fnal_init_graph_store(h5fnal_graph_store_t *store)
+{
+    int i;
+
+    for (i = 0; i < H5FNAL_GRAPH_N_DSETS; i++)
+        store->dids[i] = H5FNAL_BAD_HID_T;
+    store->node_tid = H5FNAL_BAD_HID_T;
+    store->entry_tid = H5FNAL_BAD_HID_T;
+
+    if ((store->node_tid = h5fnal_acquire_type(H5FNAL_TYPE_PARTICLE_NODE)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get particle node datatype");
+    if ((store->entry_tid = h5fnal_acquire_type(H5FNAL_TYPE_TRACK_ENTRY)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get track ID map datatype");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_init_graph_store() */
+
+
+/************************************************************************
+ * h5fnal_create_graph_store()
+ *
+ * Creates the graph group in loc_id (an MC truth data product's
+ * top-level group) if the options ask for a particle graph. The
+ * datasets are created with the given options as they are needed.
+ * Otherwise the store is left unused (gid is negative).
+ ************************************************************************/
+herr_t
+h5fnal_create_graph_store(hid_t loc_id, const h5fnal_create_options_t *options, h5fnal_graph_store_t *store)
+{
+    int i;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == store)
+        H5FNAL_PROGRAM_ERROR("store parameter cannot be NULL");
+
+    memset(store, 0, sizeof(h5fnal_graph_store_t));
+    store->gid = H5FNAL_BAD_HID_T;
+
+    if (NULL == options || !options->particle_graph)
+        return H5FNAL_SUCCESS;
+
+    if ((store->gid = H5Gcreate2(loc_id, H5FNAL_PARTICLE_GRAPH_GROUP_NAME, H5P_DEFAULT, H5P_DEFAULT,
+            H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (h5fnal_init_graph_store(store) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up graph store");
+
+    for (i = 0; i < H5FNAL_GRAPH_N_DSETS; i++)
+        if (h5fnal_defer_append_buffer(store->gid, h5fnal_graph_dset_names_g[i], h5fnal_get_graph_type(store, i),
+                options, &store->buffers[i]) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up graph append buffer");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (store)
+        h5fnal_free_graph_store(store);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_create_graph_store() */
+
+
+/************************************************************************
+ * h5fnal_open_graph_store()
+ *
+ * Opens the graph group in loc_id, if there is one. If not, the store
+ * is left unused (gid is negative).
+ ************************************************************************/
+herr_t
+h5fnal_open_graph_store(hid_t loc_id, h5fnal_graph_store_t *store)
+{
+    htri_t exists;
+    int i;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == store)
+        H5FNAL_PROGRAM_ERROR("store parameter cannot be NULL");
+
+    memset(store, 0, sizeof(h5fnal_graph_store_t));
+    store->gid = H5FNAL_BAD_HID_T;
+
+    if ((exists = H5Lexists(loc_id, H5FNAL_PARTICLE_GRAPH_GROUP_NAME, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (!exists)
+        return H5FNAL_SUCCESS;
+
+    if ((store->gid = H5Gopen2(loc_id, H5FNAL_PARTICLE_GRAPH_GROUP_NAME, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (h5fnal_init_graph_store(store) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up graph store");
+
+    for (i = 0; i < H5FNAL_GRAPH_N_DSETS; i++) {
+        if (h5fnal_open_optional_dset(store->gid, h5fnal_graph_dset_names_g[i], &store->dids[i]) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open graph dataset");
+        if (h5fnal_open_append_buffer(store->gid, h5fnal_graph_dset_names_g[i], store->dids[i],
+                h5fnal_get_graph_type(store, i), &store->buffers[i]) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up graph append buffer");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (store)
+        h5fnal_free_graph_store(store);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_open_graph_store() */
+
+
+/************************************************************************
+ * h5fnal_close_graph_store()
+ *
+ * Writes out anything still in the append buffers and closes the
+ * store. An unused store is left alone.
+ ************************************************************************/
+herr_t
+h5fnal_close_graph_store(h5fnal_graph_store_t *store)
+{
+    int i;
+
+    if (NULL == store)
+        H5FNAL_PROGRAM_ERROR("store parameter cannot be NULL");
+
+    if (store->gid > 0) {
+        for (i = 0; i < H5FNAL_GRAPH_N_DSETS; i++) {
+            if (h5fnal_close_append_buffer(&store->buffers[i]) < 0)
+                H5FNAL_PROGRAM_ERROR("could not close graph append buffer");
+            if (store->dids[i] >= 0)
+                if (H5Dclose(store->dids[i]) < 0)
+                    H5FNAL_HDF5_ERROR;
+            store->dids[i] = H5FNAL_BAD_HID_T;
+        }
+        if (h5fnal_release_type(store->node_tid) < 0)
+            H5FNAL_PROGRAM_ERROR("could not release datatype");
+        store->node_tid = H5FNAL_BAD_HID_T;
+        if (h5fnal_release_type(store->entry_tid) < 0)
+            H5FNAL_PROGRAM_ERROR("could not release datatype");
+        store->entry_tid = H5FNAL_BAD_HID_T;
+        if (H5Gclose(store->gid) < 0)
+            H5FNAL_HDF5_ERROR;
+    }
+    if (h5fnal_free_particle_graph(&store->scratch) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free particle graph");
+
+    memset(store, 0, sizeof(h5fnal_graph_store_t));
+    store->gid = H5FNAL_BAD_HID_T;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (store)
+        h5fnal_free_graph_store(store);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_close_graph_store() */
+
+
+/************************************************************************
+ * h5fnal_append_graph()
+ *
+ * Builds the graph of the particles in data, whose indices are relative
+ * to data's own arrays, and appends it after the particles already in
+ * the store. Does nothing for an unused store.
+ ************************************************************************/
+herr_t
+h5fnal_append_graph(h5fnal_graph_store_t *store, const h5fnal_vect_truth_data_t *data)
+{
+    h5fnal_particle_graph_t *graph;
+    const void *arrays[H5FNAL_GRAPH_N_DSETS];
+    hsize_t counts[H5FNAL_GRAPH_N_DSETS];
+    int i;
+
+    if (NULL == store)
+        H5FNAL_PROGRAM_ERROR("store parameter cannot be NULL");
+    if (NULL == data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    if (store->gid < 0 || 0 == data->n_particles)
+        return H5FNAL_SUCCESS;
+
+    graph = &store->scratch;
+    if (h5fnal_build_particle_graph(data, graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not build particle graph");
+    h5fnal_shift_graph_rows(graph, (hssize_t)h5fnal_get_buffered_size(&store->buffers[H5FNAL_GRAPH_NODES]),
+            (hssize_t)h5fnal_get_buffered_size(&store->buffers[H5FNAL_GRAPH_DAUGHTER_ROWS]));
+
+    arrays[H5FNAL_GRAPH_NODES] = graph->nodes;
+    counts[H5FNAL_GRAPH_NODES] = graph->n_particles;
+    arrays[H5FNAL_GRAPH_DAUGHTER_ROWS] = graph->daughter_rows;
+    counts[H5FNAL_GRAPH_DAUGHTER_ROWS] = graph->n_links;
+    arrays[H5FNAL_GRAPH_PREORDER] = graph->preorder;
+    counts[H5FNAL_GRAPH_PREORDER] = graph->n_particles;
+    arrays[H5FNAL_GRAPH_TRACK_IDS] = graph->track_ids;
+    counts[H5FNAL_GRAPH_TRACK_IDS] = graph->n_particles;
+
+    for (i = 0; i < H5FNAL_GRAPH_N_DSETS; i++) {
+        if (h5fnal_buffered_append(&store->buffers[i], counts[i], arrays[i]) < 0)
+            H5FNAL_PROGRAM_ERROR("could not append graph data");
+        if (h5fnal_claim_deferred_dset(&store->buffers[i], &store->dids[i]) < 0)
+            H5FNAL_PROGRAM_ERROR("could not get graph dataset");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_append_graph() */
+
+
+/************************************************************************
+ * h5fnal_read_graph_range()
+ *
+ * Reads the graph of count particles, starting at particle start, into
+ * graph, growing its arrays if needed. Rows are made relative to start.
+ * The range has to hold whole truths.
+ *
+ * Returns TRUE if the graph was read and FALSE, leaving graph alone,
+ * if the store is unused (the data product has no graph).
+ ************************************************************************/
+htri_t
+h5fnal_read_graph_range(h5fnal_graph_store_t *store, hsize_t start, hsize_t count, h5fnal_particle_graph_t *graph)
+{
+    const h5fnal_particle_node_t *last;
+    hsize_t link_start;
+    int i;
+
+    if (NULL == store)
+        H5FNAL_PROGRAM_ERROR("store parameter cannot be NULL");
+    if (NULL == graph)
+        H5FNAL_PROGRAM_ERROR("graph parameter cannot be NULL");
+    if (store->gid < 0)
+        return FALSE;
+
+    /* Make sure any appended data is in the file */
+    for (i = 0; i < H5FNAL_GRAPH_N_DSETS; i++)
+        if (h5fnal_sync_append_buffer(&store->buffers[i], &store->dids[i]) < 0)
+            H5FNAL_PROGRAM_ERROR("could not flush graph append buffer");
+
+    graph->n_particles = count;
+    graph->n_links = 0;
+    if (h5fnal_reserve_particle_graph(graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for particle graph");
+    if (0 == count)
+        return TRUE;
+
+    if (h5fnal_read_data_range(store->dids[H5FNAL_GRAPH_NODES], store->node_tid, start, count, graph->nodes) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read particle nodes");
+
+    /* The daughter rows of the particles are all together */
+    link_start = graph->nodes[0].daughter_start;
+    last = &graph->nodes[count - 1];
+    if (last->daughter_start < link_start || last->n_daughters > HSIZE_UNDEF - last->daughter_start)
+        H5FNAL_PROGRAM_ERROR("bad daughter rows in particle graph");
+    graph->n_links = last->daughter_start + last->n_daughters - link_start;
+    if (h5fnal_reserve_particle_graph(graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for daughter rows");
+
+    if (h5fnal_read_data_range(store->dids[H5FNAL_GRAPH_DAUGHTER_ROWS], H5T_NATIVE_HSIZE, link_start, graph->n_links,
+            graph->daughter_rows) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read daughter rows");
+    if (h5fnal_read_data_range(store->dids[H5FNAL_GRAPH_PREORDER], H5T_NATIVE_HSIZE, start, count,
+            graph->preorder) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read particle preorder");
+    if (h5fnal_read_data_range(store->dids[H5FNAL_GRAPH_TRACK_IDS], store->entry_tid, start, count,
+            graph->track_ids) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read track ID map");
+
+    if (!h5fnal_is_self_contained(graph, start, link_start))
+        H5FNAL_PROGRAM_ERROR("particle range does not hold whole truths");
+    h5fnal_shift_graph_rows(graph, -(hssize_t)start, -(hssize_t)link_start);
+
+    return TRUE;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_graph_range() */
@@ -0,0 +1,143 @@
+/* particle_graph.h
+ *
+ * Parent/daughter index for the MC truth particle graph.
+ *
+ * Particles only refer to their mother and daughters by Geant/generator
+ * track ID, which has to be looked up among the particles of the same
+ * truth. When asked to (the particle_graph creation option), the MC
+ * truth writer resolves those IDs once, when the truths are appended,
+ * and stores the graph with row indices into the particle dataset in a
+ * "particle_graph" group next to the particles:
+ *
+ *  - nodes:            one h5fnal_particle_node_t per particle
+ *  - daughter_rows:    the daughters of every particle, in particle
+ *                      order (compressed sparse rows, see the nodes'
+ *                      daughter_start and n_daughters)
+ *  - preorder:         particle rows in depth-first order, so the
+ *                      descendants of a particle directly follow it
+ *  - track_ids:        (track ID, row) pairs, sorted by track ID within
+ *                      each truth's particle range
+ *
+ * The links are built from each particle's mother. A mother that is
+ * not among the particles of the same truth makes the particle a
+ * primary. The daughter track IDs are not used, so daughters that were
+ * not stored don't show up in the graph. Particles that are not in a
+ * (valid) truth particle range are primaries without daughters, and
+ * mother loops are broken by making one of their particles a primary.
+ *
+ * Once read (or built) into an h5fnal_particle_graph_t, the mother,
+ * primary, daughters and descendants of a particle and whether one
+ * particle descends from another are all found in constant time, and
+ * ancestors in constant time per generation.
+ */
+
+#ifndef H5FNAL_PARTICLE_GRAPH_H
+#define H5FNAL_PARTICLE_GRAPH_H
+
+#include "h5fnal.h"
+
+/* Name of the group that holds the graph datasets */
+#define H5FNAL_PARTICLE_GRAPH_GROUP_NAME    "particle_graph"
+
+/* Graph datasets */
+#define H5FNAL_GRAPH_NODES          0
+#define H5FNAL_GRAPH_DAUGHTER_ROWS  1
+#define H5FNAL_GRAPH_PREORDER       2
+#define H5FNAL_GRAPH_TRACK_IDS      3
+#define H5FNAL_GRAPH_N_DSETS        4
+
+/* A particle's place in the graph
+ *
+ * All rows are particle rows. The daughters are daughter_rows
+ * [daughter_start, daughter_start + n_daughters) and the descendants
+ * are preorder [preorder_index + 1, preorder_index + n_descendants].
+ */
+typedef struct h5fnal_particle_node_t {
+    hssize_t    mother_row;         /* -1 for primaries                     */
+    hsize_t     primary_row;        /* the particle itself for primaries    */
+    hsize_t     daughter_start;
+    hsize_t     n_daughters;
+    hsize_t     preorder_index;
+    hsize_t     n_descendants;
+    hsize_t     depth;              /* number of ancestors                  */
+} h5fnal_particle_node_t;
+
+/* Track ID map entry */
+typedef struct h5fnal_track_entry_t {
+    int         track_id;
+    hsize_t     row;
+} h5fnal_track_entry_t;
+
+/* In-memory particle graph
+ *
+ * Start with a zeroed struct. The arrays grow as needed and can be
+ * reused for every event in a file, like the truth data arrays. Free
+ * them with h5fnal_free_particle_graph().
+ */
+typedef struct h5fnal_particle_graph_t {
+    hsize_t                     n_particles;
+    hsize_t                     n_links;            /* particles with a mother  */
+    h5fnal_particle_node_t     *nodes;
+    hsize_t                    *daughter_rows;
+    hsize_t                    *preorder;
+    h5fnal_track_entry_t       *track_ids;
+    unsigned char              *state;              /* scratch for building     */
+    hsize_t                     particles_capacity;
+    hsize_t                     links_capacity;
+} h5fnal_particle_graph_t;
+
+/* Graph datasets of an MC truth data product
+ *
+ * gid is negative if the data product has no graph (it was created
+ * without the particle_graph option, or before the graph was added),
+ * in which case appends leave it alone. The group ID is owned by the
+ * store.
+ */
+typedef struct h5fnal_graph_store_t {
+    hid_t                       gid;
+    hid_t                       node_tid;
+    hid_t                       entry_tid;
+    hid_t                       dids[H5FNAL_GRAPH_N_DSETS];
+    h5fnal_append_buffer_t      buffers[H5FNAL_GRAPH_N_DSETS];
+    h5fnal_particle_graph_t     scratch;            /* graph being appended     */
+} h5fnal_graph_store_t;
+
+/* The product headers may not have been read yet when this one is */
+struct h5fnal_truth_t;
+struct h5fnal_vect_truth_data_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+hid_t h5fnal_create_particle_node_type(void);
+hid_t h5fnal_create_track_entry_type(void);
+
+/* Building and freeing graphs */
+herr_t h5fnal_build_particle_graph(const struct h5fnal_vect_truth_data_t *data, h5fnal_particle_graph_t *graph);
+herr_t h5fnal_free_particle_graph(h5fnal_particle_graph_t *graph);
+
+/* Traversal */
+htri_t h5fnal_find_particle_row(const h5fnal_particle_graph_t *graph, const struct h5fnal_truth_t *truth,
+        int track_id, /*OUT*/ hsize_t *row);
+hssize_t h5fnal_get_mother_row(const h5fnal_particle_graph_t *graph, hsize_t row);
+hssize_t h5fnal_get_primary_row(const h5fnal_particle_graph_t *graph, hsize_t row);
+const hsize_t *h5fnal_get_daughter_rows(const h5fnal_particle_graph_t *graph, hsize_t row, /*OUT*/ hsize_t *n);
+const hsize_t *h5fnal_get_descendant_rows(const h5fnal_particle_graph_t *graph, hsize_t row, /*OUT*/ hsize_t *n);
+hsize_t h5fnal_get_ancestor_rows(const h5fnal_particle_graph_t *graph, hsize_t row, hsize_t *rows, hsize_t max);
+hbool_t h5fnal_is_descendant(const h5fnal_particle_graph_t *graph, hsize_t row, hsize_t ancestor_row);
+
+/* Stored graphs (used by the MC truth data product) */
+herr_t h5fnal_create_graph_store(hid_t loc_id, const h5fnal_create_options_t *options, h5fnal_graph_store_t *store);
+herr_t h5fnal_open_graph_store(hid_t loc_id, h5fnal_graph_store_t *store);
+herr_t h5fnal_close_graph_store(h5fnal_graph_store_t *store);
+herr_t h5fnal_free_graph_store(h5fnal_graph_store_t *store);
+herr_t h5fnal_append_graph(h5fnal_graph_store_t *store, const struct h5fnal_vect_truth_data_t *data);
+htri_t h5fnal_read_graph_range(h5fnal_graph_store_t *store, hsize_t start, hsize_t count,
+        h5fnal_particle_graph_t *graph);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H5FNAL_PARTICLE_GRAPH_H */
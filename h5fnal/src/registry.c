@@ -0,0 +1,340 @@
+/* registry.c
+ *
+ * Process-wide datatype registry and dataset creation property list
+ * cache.
+ */
+
+#include <pthread.h>
+
+#include "h5fnal.h"
+#include "registry.h"
+
+/* Functions that build each of the registered datatypes */
+static hid_t (*const h5fnal_type_builders_g[H5FNAL_N_REGISTERED_TYPES])(void) = {
+    h5fnal_create_hit_type,
+    h5fnal_create_hitcoll_type,
+    h5fnal_create_origin_type,
+    h5fnal_create_neutrino_type,
+    h5fnal_create_particle_type,
+    h5fnal_create_daughter_type,
+    h5fnal_create_trajectory_type,
+    h5fnal_create_trajectory_delta_type,
+    h5fnal_create_trajectory_delta_float32_type,
+    h5fnal_create_truth_type,
+    h5fnal_create_particle_node_type,
+    h5fnal_create_track_entry_type,
+    h5fnal_create_pair_type,
+    h5fnal_create_event_entry_type,
+    h5fnal_create_event_addr_type,
+    h5fnal_create_event_summary_type
+};
+
+/* A cached dataset creation property list
+ *
+ * Entries with a reference count of zero can be evicted (least
+ * recently used first) when a new property list is needed.
+ */
+typedef struct h5fnal_dcpl_entry_t {
+    hid_t                   dcpl_id;
+    hsize_t                 chunk_dim;
+    size_t                  type_size;
+    h5fnal_compression_t    compression;
+    unsigned                n_refs;
+    unsigned long           last_used;
+} h5fnal_dcpl_entry_t;
+
+/* The registry
+ *
+ * The mutex protects the tables here and nothing else. HDF5 calls are
+ * made with it held, but that doesn't make them thread-safe: the
+ * library is built against serial HDF5, so callers still have to keep
+ * HDF5 calls from different threads apart.
+ */
+static struct {
+    pthread_mutex_t         mutex;
+    hid_t                   types[H5FNAL_N_REGISTERED_TYPES];
+    h5fnal_dcpl_entry_t     dcpls[H5FNAL_DCPL_CACHE_SIZE];
+    unsigned                n_dcpls;
+    unsigned long           tick;
+} h5fnal_registry_g = {
+    PTHREAD_MUTEX_INITIALIZER
+};
+
+
+/************************************************************************
+ * h5fnal_is_valid_id()
+ *
+ * Registry IDs go stale if the HDF5 library is shut down and
+ * restarted, so they are checked before they are handed out.
+ ************************************************************************/
+static hbool_t
+h5fnal_is_valid_id(hid_t id)
+{
+    htri_t valid;
+
+    if (id <= 0)
+        return FALSE;
+
+    H5E_BEGIN_TRY {
+        valid = H5Iis_valid(id);
+    } H5E_END_TRY;
+
+    return valid > 0 ? TRUE : FALSE;
+} /* end h5fnal_is_valid_id() */
+
+
+/************************************************************************
+ * h5fnal_acquire_type()
+ *
+ * Returns the shared, locked datatype for one of the data product
+ * types, building it on first use. Release it with
+ * h5fnal_release_type(), not H5Tclose().
+ ************************************************************************/
+hid_t
+h5fnal_acquire_type(h5fnal_registered_type_t type)
+{
+    hid_t tid = H5FNAL_BAD_HID_T;
+    hbool_t locked = FALSE;
+
+    if (type < 0 || type >= H5FNAL_N_REGISTERED_TYPES)
+        H5FNAL_PROGRAM_ERROR("invalid type parameter");
+
+    if (pthread_mutex_lock(&h5fnal_registry_g.mutex) != 0)
+        H5FNAL_PROGRAM_ERROR("could not lock registry mutex");
+    locked = TRUE;
+
+    if (!h5fnal_is_valid_id(h5fnal_registry_g.types[type])) {
+        h5fnal_registry_g.types[type] = H5FNAL_BAD_HID_T;
+        if ((tid = h5fnal_type_builders_g[type]()) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create datatype");
+        if (H5Tlock(tid) < 0)
+            H5FNAL_HDF5_ERROR;
+        h5fnal_registry_g.types[type] = tid;
+    }
+
+    tid = h5fnal_registry_g.types[type];
+    if (H5Iinc_ref(tid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    locked = FALSE;
+    if (pthread_mutex_unlock(&h5fnal_registry_g.mutex) != 0)
+        H5FNAL_PROGRAM_ERROR("could not unlock registry mutex");
+
+    return tid;
+
+error:
+    /* A type that failed to lock can still be closed */
+    if (tid >= 0 && tid != h5fnal_registry_g.types[type])
+        H5E_BEGIN_TRY {
+            H5Tclose(tid);
+        } H5E_END_TRY;
+    if (locked)
+        pthread_mutex_unlock(&h5fnal_registry_g.mutex);
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_acquire_type() */
+
+
+/************************************************************************
+ * h5fnal_release_type()
+ *
+ * Drops a reference taken by h5fnal_acquire_type(). Negative IDs are
+ * ignored so this can be used on partially set up data products.
+ ************************************************************************/
+herr_t
+h5fnal_release_type(hid_t tid)
+{
+    if (tid < 0)
+        return H5FNAL_SUCCESS;
+
+    if (H5Idec_ref(tid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_release_type() */
+
+
+/************************************************************************
+ * h5fnal_same_compression()
+ ************************************************************************/
+static hbool_t
+h5fnal_same_compression(const h5fnal_compression_t *a, const h5fnal_compression_t *b)
+{
+    if (a->method != b->method)
+        return FALSE;
+    if (H5FNAL_COMPRESSION_NONE == a->method)
+        return TRUE;
+    return a->level == b->level && (a->shuffle ? TRUE : FALSE) == (b->shuffle ? TRUE : FALSE);
+} /* end h5fnal_same_compression() */
+
+
+/************************************************************************
+ * h5fnal_build_dcpl()
+ ************************************************************************/
+static hid_t
+h5fnal_build_dcpl(hsize_t chunk_dim, size_t type_size, const h5fnal_compression_t *compression)
+{
+    hid_t dcpl_id = H5FNAL_BAD_HID_T;
+
+    if ((dcpl_id = H5Pcreate(H5P_DATASET_CREATE)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Pset_chunk(dcpl_id, 1, &chunk_dim) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (h5fnal_set_compression(dcpl_id, compression, type_size) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up compression");
+
+    return dcpl_id;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Pclose(dcpl_id);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_build_dcpl() */
+
+
+/************************************************************************
+ * h5fnal_acquire_dcpl()
+ *
+ * Returns a shared dataset creation property list with the given chunk
+ * size and compression, building it if it isn't in the cache. The
+ * property list must not be modified. Release it with
+ * h5fnal_release_dcpl(), not H5Pclose().
+ ************************************************************************/
+hid_t
+h5fnal_acquire_dcpl(hsize_t chunk_dim, size_t type_size, const h5fnal_compression_t *compression)
+{
+    h5fnal_dcpl_entry_t *entry = NULL;
+    h5fnal_dcpl_entry_t *victim = NULL;
+    hid_t dcpl_id = H5FNAL_BAD_HID_T;
+    hbool_t locked = FALSE;
+    unsigned u;
+
+    if (!compression)
+        H5FNAL_PROGRAM_ERROR("compression parameter cannot be NULL");
+
+    if (pthread_mutex_lock(&h5fnal_registry_g.mutex) != 0)
+        H5FNAL_PROGRAM_ERROR("could not lock registry mutex");
+    locked = TRUE;
+
+    h5fnal_registry_g.tick++;
+
+    /* Look for a match, dropping stale entries on the way */
+    for (u = 0; u < h5fnal_registry_g.n_dcpls; u++) {
+        h5fnal_dcpl_entry_t *e = &h5fnal_registry_g.dcpls[u];
+
+        if (0 == e->n_refs && !h5fnal_is_valid_id(e->dcpl_id)) {
+            *e = h5fnal_registry_g.dcpls[--h5fnal_registry_g.n_dcpls];
+            u--;
+            continue;
+        }
+        if (e->chunk_dim == chunk_dim && e->type_size == type_size
+                && h5fnal_same_compression(&e->compression, compression)) {
+            entry = e;
+            break;
+        }
+        if (0 == e->n_refs && (!victim || e->last_used < victim->last_used))
+            victim = e;
+    }
+
+    if (!entry) {
+        if ((dcpl_id = h5fnal_build_dcpl(chunk_dim, type_size, compression)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create dataset creation property list");
+
+        if (h5fnal_registry_g.n_dcpls < H5FNAL_DCPL_CACHE_SIZE)
+            entry = &h5fnal_registry_g.dcpls[h5fnal_registry_g.n_dcpls++];
+        else if (victim) {
+            if (H5Pclose(victim->dcpl_id) < 0)
+                H5FNAL_HDF5_ERROR;
+            entry = victim;
+        }
+        else {
+            /* Everything is in use, so hand out an uncached list
+             * (h5fnal_release_dcpl() closes lists it doesn't know)
+             */
+            locked = FALSE;
+            if (pthread_mutex_unlock(&h5fnal_registry_g.mutex) != 0)
+                H5FNAL_PROGRAM_ERROR("could not unlock registry mutex");
+            return dcpl_id;
+        }
+
+        entry->dcpl_id = dcpl_id;
+        entry->chunk_dim = chunk_dim;
+        entry->type_size = type_size;
+        entry->compression = *compression;
+        entry->n_refs = 0;
+        dcpl_id = H5FNAL_BAD_HID_T;
+    }
+
+    entry->n_refs++;
+    entry->last_used = h5fnal_registry_g.tick;
+
+    locked = FALSE;
+    if (pthread_mutex_unlock(&h5fnal_registry_g.mutex) != 0)
+        H5FNAL_PROGRAM_ERROR("could not unlock registry mutex");
+
+    return entry->dcpl_id;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Pclose(dcpl_id);
+    } H5E_END_TRY;
+    if (locked)
+        pthread_mutex_unlock(&h5fnal_registry_g.mutex);
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_acquire_dcpl() */
+
+
+/************************************************************************
+ * h5fnal_release_dcpl()
+ *
+ * Drops a reference taken by h5fnal_acquire_dcpl(). The property list
+ * stays in the cache. Lists that aren't in the cache (handed out when
+ * it was full) are closed. Releasing a cached list more often than it
+ * was acquired is an error.
+ ************************************************************************/
+herr_t
+h5fnal_release_dcpl(hid_t dcpl_id)
+{
+    hbool_t locked = FALSE;
+    hbool_t cached = FALSE;
+    unsigned u;
+
+    if (dcpl_id < 0)
+        return H5FNAL_SUCCESS;
+
+    if (pthread_mutex_lock(&h5fnal_registry_g.mutex) != 0)
+        H5FNAL_PROGRAM_ERROR("could not lock registry mutex");
+    locked = TRUE;
+
+    for (u = 0; u < h5fnal_registry_g.n_dcpls; u++)
+        if (h5fnal_registry_g.dcpls[u].dcpl_id == dcpl_id) {
+            if (0 == h5fnal_registry_g.dcpls[u].n_refs)
+                H5FNAL_PROGRAM_ERROR("dataset creation property list released more often than acquired");
+            h5fnal_registry_g.dcpls[u].n_refs--;
+            cached = TRUE;
+            break;
+        }
+
+    locked = FALSE;
+    if (pthread_mutex_unlock(&h5fnal_registry_g.mutex) != 0)
+        H5FNAL_PROGRAM_ERROR("could not unlock registry mutex");
+
+    /* Not one of ours */
+    if (!cached)
+        if (H5Pclose(dcpl_id) < 0)
+            H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (locked)
+        pthread_mutex_unlock(&h5fnal_registry_g.mutex);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_release_dcpl() */
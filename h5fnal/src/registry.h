@@ -0,0 +1,57 @@
+/* registry.h
+ *
+ * Process-wide registry of the data product datatypes and a cache of
+ * dataset creation property lists.
+ *
+ * The datatypes are built the first time they are asked for, locked
+ * (so they can't be modified or closed by mistake) and then shared by
+ * every data product in the process. The registry holds one reference
+ * to each type and every h5fnal_acquire_type() call adds another, which
+ * h5fnal_release_type() drops again.
+ */
+
+#ifndef H5FNAL_REGISTRY_H
+#define H5FNAL_REGISTRY_H
+
+#include "h5fnal.h"
+
+typedef enum h5fnal_registered_type_t {
+    H5FNAL_TYPE_HIT = 0,
+    H5FNAL_TYPE_HITCOLL,
+    H5FNAL_TYPE_ORIGIN,
+    H5FNAL_TYPE_NEUTRINO,
+    H5FNAL_TYPE_PARTICLE,
+    H5FNAL_TYPE_DAUGHTER,
+    H5FNAL_TYPE_TRAJECTORY,
+    H5FNAL_TYPE_TRAJECTORY_DELTA,
+    H5FNAL_TYPE_TRAJECTORY_DELTA_FLOAT32,
+    H5FNAL_TYPE_TRUTH,
+    H5FNAL_TYPE_PARTICLE_NODE,
+    H5FNAL_TYPE_TRACK_ENTRY,
+    H5FNAL_TYPE_PAIR,
+    H5FNAL_TYPE_EVENT_ENTRY,
+    H5FNAL_TYPE_EVENT_ADDR,
+    H5FNAL_TYPE_EVENT_SUMMARY,
+    H5FNAL_N_REGISTERED_TYPES
+} h5fnal_registered_type_t;
+
+/* Number of dataset creation property lists kept in the cache */
+#define H5FNAL_DCPL_CACHE_SIZE  32
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Shared, locked datatypes */
+hid_t h5fnal_acquire_type(h5fnal_registered_type_t type);
+herr_t h5fnal_release_type(hid_t tid);
+
+/* Shared dataset creation property lists for chunked, 1D datasets */
+hid_t h5fnal_acquire_dcpl(hsize_t chunk_dim, size_t type_size, const h5fnal_compression_t *compression);
+herr_t h5fnal_release_dcpl(hid_t dcpl_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H5FNAL_REGISTRY_H */
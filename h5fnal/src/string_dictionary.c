@@ -14,6 +14,13 @@
 #define INITIAL_N_STRINGS   16
 #define CONCAT_STRING_INCR  4096
 
+/* The hash index is grown to keep it at most half full */
+#define INITIAL_N_HASH_SLOTS    (2 * INITIAL_N_STRINGS)
+
+/* 32-bit FNV-1a parameters */
+#define FNV_OFFSET_BASIS    2166136261U
+#define FNV_PRIME           16777619U
+
 /* Dataset names for the string collection */
 #define H5FNAL_STRINGS_DATASET_NAME     "dict_strings"
 #define H5FNAL_INDICES_DATASET_NAME     "dict_indices"
@@ -46,6 +53,111 @@ error:
 } /* create_index_type */
 
 
+/************************************************************************
+ * hash_string()
+ *
+ * 32-bit FNV-1a hash of a string.
+ ************************************************************************/
+static unsigned
+hash_string(const char *s)
+{
+    unsigned h = FNV_OFFSET_BASIS;
+
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= FNV_PRIME;
+    }
+
+    return h;
+} /* end hash_string() */
+
+
+/************************************************************************
+ * find_hash_slot()
+ *
+ * Returns the hash slot that holds s, or the empty slot where s would
+ * go if it isn't in the dictionary.
+ ************************************************************************/
+static unsigned
+find_hash_slot(const string_dictionary_t *dict, const char *s)
+{
+    unsigned mask = dict->n_hash_slots - 1;
+    unsigned slot = hash_string(s) & mask;
+
+    while (dict->hash_slots[slot] != 0) {
+        const char *dict_s = dict->concat_strings + dict->indices[dict->hash_slots[slot] - 1].start;
+
+        if (!strcmp(s, dict_s))
+            break;
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+} /* end find_hash_slot() */
+
+
+/************************************************************************
+ * build_hash_index()
+ *
+ * (Re)builds the hash index with room for at least n_strings strings.
+ * When a string was added more than once, the index points to the
+ * first copy, like the linear search it replaces.
+ ************************************************************************/
+static herr_t
+build_hash_index(string_dictionary_t *dict, unsigned n_strings)
+{
+    unsigned n_slots = INITIAL_N_HASH_SLOTS;
+    unsigned u;
+
+    while (n_slots < 2 * n_strings)
+        n_slots *= 2;
+
+    free(dict->hash_slots);
+    if (NULL == (dict->hash_slots = (unsigned *)calloc((size_t)n_slots, sizeof(unsigned))))
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for hash index");
+    dict->n_hash_slots = n_slots;
+
+    for (u = 0; u < dict->n_strings; u++) {
+        unsigned slot = find_hash_slot(dict, dict->concat_strings + dict->indices[u].start);
+
+        if (0 == dict->hash_slots[slot])
+            dict->hash_slots[slot] = u + 1;
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    dict->n_hash_slots = 0;
+
+    return H5FNAL_FAILURE;
+} /* end build_hash_index() */
+
+
+/************************************************************************
+ * free_dict_mem()
+ ************************************************************************/
+static void
+free_dict_mem(string_dictionary_t *dict)
+{
+    free(dict->indices);
+    free(dict->concat_strings);
+    free(dict->hash_slots);
+    free(dict->blocks_loaded);
+
+    dict->indices = NULL;
+    dict->concat_strings = NULL;
+    dict->hash_slots = NULL;
+    dict->blocks_loaded = NULL;
+    dict->n_strings = 0;
+    dict->n_allocated = 0;
+    dict->total_string_size = 0;
+    dict->total_string_alloc = 0;
+    dict->n_hash_slots = 0;
+
+    return;
+} /* end free_dict_mem() */
+
+
 /************************************************************************
  * close_dict_on_err()
  ************************************************************************/
@@ -64,6 +176,8 @@ close_dict_on_err(string_dictionary_t *dict)
         dict->indices_dset_id   = H5FNAL_BAD_HID_T;
         dict->strings_dtype_id   = H5FNAL_BAD_HID_T;
         dict->indices_dtype_id   = H5FNAL_BAD_HID_T;
+
+        free_dict_mem(dict);
     }
 
     return;
@@ -107,10 +221,8 @@ error:
  * create_string_dictionary()
  ************************************************************************/
 herr_t
-create_string_dictionary(hid_t loc_id, string_dictionary_t *dict)
+create_string_dictionary(hid_t loc_id, const h5fnal_create_options_t *options, string_dictionary_t *dict)
 {
-    hsize_t chunk_dim;
-
     if (loc_id < 0)
         H5FNAL_PROGRAM_ERROR("loc_id parameter cannot be negative");
     if (!dict)
@@ -137,10 +249,9 @@ create_string_dictionary(hid_t loc_id, string_dictionary_t *dict)
         H5FNAL_PROGRAM_ERROR("could not create datatype");
 
     /* Create the HDF5 datasets that will store the string data */
-    chunk_dim = 1024; /* arbitrary */
-    if (h5fnal_create_1D_dset(loc_id, H5FNAL_STRINGS_DATASET_NAME, dict->strings_dtype_id, chunk_dim, &(dict->strings_dset_id)) < 0)
+    if (h5fnal_create_1D_dset(loc_id, H5FNAL_STRINGS_DATASET_NAME, dict->strings_dtype_id, options, &(dict->strings_dset_id)) < 0)
         H5FNAL_PROGRAM_ERROR("could not create dataset");
-    if (h5fnal_create_1D_dset(loc_id, H5FNAL_INDICES_DATASET_NAME, dict->indices_dtype_id, chunk_dim, &(dict->indices_dset_id)) < 0)
+    if (h5fnal_create_1D_dset(loc_id, H5FNAL_INDICES_DATASET_NAME, dict->indices_dtype_id, options, &(dict->indices_dset_id)) < 0)
         H5FNAL_PROGRAM_ERROR("could not create dataset");
 
     /* Add the empty string as the first string */
@@ -159,60 +270,170 @@ error:
 } /* end create_string_dictionary() */
 
 /************************************************************************
- * read_all_strings()
+ * get_dict_sizes()
+ *
+ * Gets the number of strings and the size of the strings from the
+ * dataset extents, without reading anything, and picks the size of the
+ * blocks the strings are read in (the strings dataset's chunk size).
  ************************************************************************/
 static herr_t
-read_all_strings(string_dictionary_t *dict)
+get_dict_sizes(string_dictionary_t *dict)
 {
-    hid_t       sid     = H5FNAL_BAD_HID_T;
-
-    if (!dict)
-        H5FNAL_PROGRAM_ERROR("dict parameter cannot be NULL")
+    hid_t       dcpl_id = H5FNAL_BAD_HID_T;
+    hsize_t     chunk_dims[1];
+    hssize_t    n       = -1;
 
     /* Get the size of the indices dataset */
-    if ((sid = H5Dget_space(dict->indices_dset_id)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((dict->n_strings = H5Sget_simple_extent_npoints(sid)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sclose(sid) < 0)
-        H5FNAL_HDF5_ERROR;
+    if ((n = h5fnal_get_dset_size(dict->indices_dset_id)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get indices dataset size");
+    dict->n_strings = (unsigned)n;
 
     /* Get the size of the strings dataset */
-    if ((sid = H5Dget_space(dict->strings_dset_id)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((dict->total_string_size = H5Sget_simple_extent_npoints(sid)) < 0)
+    if ((n = h5fnal_get_dset_size(dict->strings_dset_id)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get strings dataset size");
+    dict->total_string_size = (size_t)n;
+
+    /* Read the strings a chunk at a time */
+    if ((dcpl_id = H5Dget_create_plist(dict->strings_dset_id)) < 0)
         H5FNAL_HDF5_ERROR;
-    if (H5Sclose(sid) < 0)
+    dict->block_size = CONCAT_STRING_INCR;
+    if (H5D_CHUNKED == H5Pget_layout(dcpl_id)) {
+        if (H5Pget_chunk(dcpl_id, 1, chunk_dims) < 0)
+            H5FNAL_HDF5_ERROR;
+        dict->block_size = (size_t)chunk_dims[0];
+    }
+    if (H5Pclose(dcpl_id) < 0)
         H5FNAL_HDF5_ERROR;
 
-    /* Generate buffers for reading the indices and strings */
-    dict->n_allocated = dict->n_strings;
-    dict->total_string_alloc = dict->total_string_size;
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Pclose(dcpl_id);
+    } H5E_END_TRY;
+
+    return H5FNAL_FAILURE;
+} /* end get_dict_sizes() */
+
+
+/************************************************************************
+ * load_indices()
+ *
+ * Reads the string indices, if they haven't been read yet.
+ ************************************************************************/
+static herr_t
+load_indices(string_dictionary_t *dict)
+{
+    if (dict->indices)
+        return H5FNAL_SUCCESS;
+
+    dict->n_allocated = H5FNAL_MAX(dict->n_strings, 1);
     if (NULL == (dict->indices = (dict_index_t *)calloc(dict->n_allocated, sizeof(dict_index_t))))
         H5FNAL_PROGRAM_ERROR("could not allocate memory for indices");
-    if (NULL == (dict->concat_strings = (char *)calloc(dict->total_string_alloc, sizeof(char))))
-        H5FNAL_PROGRAM_ERROR("could not allocate memory for strings");
 
-    /* Read the data from the datasets */
-    if (H5Dread(dict->indices_dset_id, dict->indices_dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, dict->indices) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Dread(dict->strings_dset_id, dict->strings_dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, dict->concat_strings) < 0)
-        H5FNAL_HDF5_ERROR;
+    if (h5fnal_read_data(dict->indices_dset_id, dict->indices_dtype_id, dict->n_strings, dict->indices) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read indices");
 
     return H5FNAL_SUCCESS;
 
 error:
-    H5E_BEGIN_TRY {
-        H5Sclose(sid);
-    } H5E_END_TRY;
+    free(dict->indices);
+    dict->indices = NULL;
+    dict->n_allocated = 0;
 
     return H5FNAL_FAILURE;
-    
-} /* end read_all_strings() */
+} /* end load_indices() */
+
+
+/************************************************************************
+ * load_strings()
+ *
+ * Reads the blocks of the strings dataset that hold bytes start
+ * through end, if they haven't been read yet. Runs of blocks that
+ * haven't been read are read together.
+ ************************************************************************/
+static herr_t
+load_strings(string_dictionary_t *dict, size_t start, size_t end)
+{
+    size_t n_blocks;
+    size_t first;
+    size_t last;
+    size_t b;
+
+    if (NULL == dict->blocks_loaded)
+        return H5FNAL_SUCCESS;
+
+    n_blocks = (dict->total_string_size + dict->block_size - 1) / dict->block_size;
+    first = start / dict->block_size;
+    last = H5FNAL_MIN(end / dict->block_size, n_blocks - 1);
+
+    for (b = first; b <= last; b++) {
+        size_t run_end;
+        size_t offset;
+        size_t count;
+
+        if (dict->blocks_loaded[b])
+            continue;
+
+        for (run_end = b; run_end < last && !dict->blocks_loaded[run_end + 1]; run_end++)
+            ;
+
+        offset = b * dict->block_size;
+        count = H5FNAL_MIN((run_end + 1) * dict->block_size, dict->total_string_size) - offset;
+        if (h5fnal_read_data_range(dict->strings_dset_id, dict->strings_dtype_id, (hsize_t)offset, (hsize_t)count,
+                    dict->concat_strings + offset) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read strings");
+
+        memset(&dict->blocks_loaded[b], 1, run_end - b + 1);
+        b = run_end;
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end load_strings() */
+
+
+/************************************************************************
+ * load_all_strings()
+ *
+ * Reads whatever hasn't been read of a lazily opened dictionary and
+ * indexes the strings. Lookups by string and adding strings need the
+ * whole dictionary.
+ ************************************************************************/
+static herr_t
+load_all_strings(string_dictionary_t *dict)
+{
+    if (NULL == dict->blocks_loaded)
+        return H5FNAL_SUCCESS;
+
+    if (load_indices(dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not load indices");
+    if (dict->total_string_size > 0)
+        if (load_strings(dict, 0, dict->total_string_size - 1) < 0)
+            H5FNAL_PROGRAM_ERROR("could not load strings");
+
+    /* Index the strings for lookups */
+    if (build_hash_index(dict, dict->n_strings) < 0)
+        H5FNAL_PROGRAM_ERROR("could not build hash index");
+
+    free(dict->blocks_loaded);
+    dict->blocks_loaded = NULL;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end load_all_strings() */
+
 
 herr_t
 open_string_dictionary(hid_t loc_id, string_dictionary_t *dict)
 {
+    hid_t fid = H5FNAL_BAD_HID_T;
+    unsigned intent;
+
     if (loc_id < 0)
         H5FNAL_PROGRAM_ERROR("loc_id parameter cannot be negative");
     if (!dict)
@@ -221,6 +442,10 @@ open_string_dictionary(hid_t loc_id, string_dictionary_t *dict)
     /* Initialize the data product struct */
     memset(dict, 0, sizeof(string_dictionary_t));
 
+    /* Make sure the in-tree compression filters are there for reads */
+    if (h5fnal_register_filters() < 0)
+        H5FNAL_PROGRAM_ERROR("could not register compression filters");
+
     /* Create HDF5 types */
     if ((dict->strings_dtype_id = H5Tcopy(H5T_NATIVE_CHAR)) < 0)
         H5FNAL_HDF5_ERROR;
@@ -233,16 +458,40 @@ open_string_dictionary(hid_t loc_id, string_dictionary_t *dict)
     if ((dict->indices_dset_id = H5Dopen2(loc_id, H5FNAL_INDICES_DATASET_NAME, H5P_DEFAULT)) < 0)
         H5FNAL_HDF5_ERROR;
 
-    /* Read all the string data */
-    if (read_all_strings(dict) < 0)
-        H5FNAL_PROGRAM_ERROR("could not strings after open");
+    /* Nothing is read until it's needed. Everything in the datasets is
+     * already in the file.
+     */
+    if (get_dict_sizes(dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get string dictionary sizes");
+    dict->n_strings_written = dict->n_strings;
+    dict->string_size_written = dict->total_string_size;
 
-    /* Set the 'save on close' flag */
-    dict->save_on_close = FALSE;
+    /* The string buffer is filled in as blocks are read */
+    dict->total_string_alloc = H5FNAL_MAX(dict->total_string_size, 1);
+    if (NULL == (dict->concat_strings = (char *)calloc(dict->total_string_alloc, sizeof(char))))
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for strings");
+    if (NULL == (dict->blocks_loaded = (unsigned char *)calloc(
+                    (dict->total_string_size + dict->block_size - 1) / dict->block_size + 1, sizeof(unsigned char))))
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for string blocks");
+
+    /* Strings added to a dictionary in a file that was opened read-write
+     * are appended to it
+     */
+    if ((fid = H5Iget_file_id(loc_id)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Fget_intent(fid, &intent) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Fclose(fid) < 0)
+        H5FNAL_HDF5_ERROR;
+    fid = H5FNAL_BAD_HID_T;
+    dict->save_on_close = (intent & H5F_ACC_RDWR) ? TRUE : FALSE;
 
     return H5FNAL_SUCCESS;
 
 error:
+    H5E_BEGIN_TRY {
+        H5Fclose(fid);
+    } H5E_END_TRY;
     if (dict)
         close_dict_on_err(dict);
     return H5FNAL_FAILURE;
@@ -250,25 +499,85 @@ error:
 
 
 
+/************************************************************************
+ * write_new_strings()
+ *
+ * Appends the strings added since the last write to the datasets.
+ ************************************************************************/
+static herr_t
+write_new_strings(string_dictionary_t *dict)
+{
+    /* The strings go first, so the indices in the file never point
+     * past the end of the strings.
+     */
+    if (h5fnal_append_data(dict->strings_dset_id, dict->strings_dtype_id,
+                (hsize_t)(dict->total_string_size - dict->string_size_written),
+                (const void *)(dict->concat_strings + dict->string_size_written)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write strings");
+    dict->string_size_written = dict->total_string_size;
+
+    if (h5fnal_append_data(dict->indices_dset_id, dict->indices_dtype_id,
+                (hsize_t)(dict->n_strings - dict->n_strings_written),
+                (const void *)(dict->indices + dict->n_strings_written)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write indices");
+    dict->n_strings_written = dict->n_strings;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end write_new_strings() */
+
+
+/************************************************************************
+ * flush_string_dictionary()
+ *
+ * Writes the strings added since the last flush and flushes the
+ * datasets to the file, so a long conversion can save the dictionary
+ * as it goes instead of only at close. Does nothing if no strings were
+ * added.
+ ************************************************************************/
 herr_t
-close_string_dictionary(string_dictionary_t *dict)
+flush_string_dictionary(string_dictionary_t *dict)
 {
     if (!dict)
         H5FNAL_PROGRAM_ERROR("dict parameter cannot be NULL");
+    if (!dict->save_on_close)
+        H5FNAL_PROGRAM_ERROR("dictionary is read-only");
 
-    if (dict->save_on_close) {
-        /* Write out the indices */
-        if (h5fnal_append_data(dict->indices_dset_id, dict->indices_dtype_id, dict->n_strings, (const void *)dict->indices) < 0)
-            H5FNAL_PROGRAM_ERROR("could not write indices");
+    if (dict->n_strings == dict->n_strings_written)
+        return H5FNAL_SUCCESS;
 
-        /* Write the strings to the file */
-        if (h5fnal_append_data(dict->strings_dset_id, dict->strings_dtype_id, (hsize_t)dict->total_string_size, (const void *)dict->concat_strings) < 0)
-            H5FNAL_PROGRAM_ERROR("could not write strings");
-    }
+    if (write_new_strings(dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write new strings");
+
+    if (H5Dflush(dict->strings_dset_id) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Dflush(dict->indices_dset_id) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end flush_string_dictionary() */
+
+
+herr_t
+close_string_dictionary(string_dictionary_t *dict)
+{
+    if (!dict)
+        H5FNAL_PROGRAM_ERROR("dict parameter cannot be NULL");
+
+    if (dict->save_on_close)
+        if (write_new_strings(dict) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write new strings");
 
     /* Shut down the HDF5 IDs */
     if (close_dict_hdf5_ids(dict) < 0)
         H5FNAL_PROGRAM_ERROR("could not close string dictionary HDF5 IDs");
+
+    free_dict_mem(dict);
      return H5FNAL_SUCCESS;
 
 error:
@@ -282,6 +591,7 @@ herr_t
 add_string_to_dictionary(const char *s, string_dictionary_t *dict)
 {
     unsigned u;
+    unsigned slot;
     size_t len;
 
     if (!s)
@@ -289,21 +599,27 @@ add_string_to_dictionary(const char *s, string_dictionary_t *dict)
     if (!dict)
         H5FNAL_PROGRAM_ERROR("dict parameter cannot be NULL");
 
+    /* New strings go after (and are checked against) all the others */
+    if (load_all_strings(dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not load string dictionary");
+
     /* Get the length of the new string.
      * We'll be storing the terminal \0, so add one for that.
      */
     len = strlen(s) + 1;
 
-    /* Increase the indices array size, if necessary */
+    /* Increase the indices array size, if necessary. The arrays double
+     * so that adding n strings costs O(n) copying.
+     */
     if (dict->n_strings == dict->n_allocated) {
-        dict->n_allocated += INITIAL_N_STRINGS;
+        dict->n_allocated = dict->n_allocated > 0 ? 2 * dict->n_allocated : INITIAL_N_STRINGS;
         if (NULL == (dict->indices = (dict_index_t *)realloc((void *)dict->indices, dict->n_allocated * sizeof(dict_index_t))))
             H5FNAL_PROGRAM_ERROR("could not reallocate memory for string indices expansion");
     }
 
     /* Increase the strings array size, if necessary */
     if (dict->total_string_size + len > dict->total_string_alloc) {
-        dict->total_string_alloc += CONCAT_STRING_INCR;
+        dict->total_string_alloc = H5FNAL_MAX(2 * dict->total_string_alloc, dict->total_string_size + len + CONCAT_STRING_INCR);
         if (NULL == (dict->concat_strings = (char *)realloc((void *)dict->concat_strings, dict->total_string_alloc * sizeof(char))))
             H5FNAL_PROGRAM_ERROR("could not reallocate memory for string array expansion");
     }
@@ -320,6 +636,17 @@ add_string_to_dictionary(const char *s, string_dictionary_t *dict)
     strcpy(&(dict->concat_strings[u]), s);
     dict->total_string_size += len;
 
+    /* Index the string, growing the hash index if it's half full */
+    if (2 * dict->n_strings > dict->n_hash_slots) {
+        if (build_hash_index(dict, dict->n_strings) < 0)
+            H5FNAL_PROGRAM_ERROR("could not grow hash index");
+    }
+    else {
+        slot = find_hash_slot(dict, s);
+        if (0 == dict->hash_slots[slot])
+            dict->hash_slots[slot] = dict->n_strings;
+    }
+
     return H5FNAL_SUCCESS;
 
 error:
@@ -329,7 +656,7 @@ error:
 herr_t
 get_string_index(const char *s, string_dictionary_t *dict, /*OUT*/ hbool_t *found, /*OUT*/ unsigned *index)
 {
-    unsigned u;
+    unsigned slot;
 
     if (!s)
         H5FNAL_PROGRAM_ERROR("s parameter cannot be NULL (the string dictionary never contains NULL)");
@@ -340,20 +667,19 @@ get_string_index(const char *s, string_dictionary_t *dict, /*OUT*/ hbool_t *foun
     if (!index)
         H5FNAL_PROGRAM_ERROR("index parameter cannot be NULL");
 
+    if (load_all_strings(dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not load string dictionary");
+
     *found = FALSE;
     *index = dict->n_strings; // Where the next string will go if not found.
 
-    /* Wildly inefficient. Should be a hash table. */
-    for (u = 0; u < dict->n_strings; u++) {
-        /* Point to the beginning of the next string */
-        char *dict_s = dict->concat_strings + dict->indices[u].start;
+    if (0 == dict->n_strings)
+        return H5FNAL_SUCCESS;
 
-        /* Same? */
-        if (!strcmp(s, dict_s)) {
-            *found = TRUE;
-            *index = u;
-            break;
-        }
+    slot = find_hash_slot(dict, s);
+    if (dict->hash_slots[slot] != 0) {
+        *found = TRUE;
+        *index = dict->hash_slots[slot] - 1;
     }
 
     return H5FNAL_SUCCESS;
@@ -376,6 +702,12 @@ get_string(string_dictionary_t *dict, unsigned index, /*OUT*/ char **s)
     if (!s)
         H5FNAL_PROGRAM_ERROR("s parameter cannot be NULL");
 
+    /* Read the string, if it hasn't been read */
+    if (load_indices(dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not load indices");
+    if (load_strings(dict, (size_t)dict->indices[index].start, (size_t)dict->indices[index].end) < 0)
+        H5FNAL_PROGRAM_ERROR("could not load string");
+
     /* Allocate a buffer for the string */
     len = 1 + (dict->indices[index].end - dict->indices[index].start);
     if (NULL == (out = (char *)calloc(len, sizeof(char))))
@@ -395,3 +727,30 @@ error:
     return H5FNAL_FAILURE;
 } /* end get_string() */
 
+herr_t
+get_string_view(string_dictionary_t *dict, unsigned index, /*OUT*/ const char **s, /*OUT*/ size_t *len)
+{
+    if (!dict)
+        H5FNAL_PROGRAM_ERROR("dict parameter cannot be NULL");
+    if (index >= dict->n_strings)
+        H5FNAL_PROGRAM_ERROR("index is larger than the number of strings in the dictionary");
+    if (!s)
+        H5FNAL_PROGRAM_ERROR("s parameter cannot be NULL");
+    if (!len)
+        H5FNAL_PROGRAM_ERROR("len parameter cannot be NULL");
+
+    /* Read the string, if it hasn't been read */
+    if (load_indices(dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not load indices");
+    if (load_strings(dict, (size_t)dict->indices[index].start, (size_t)dict->indices[index].end) < 0)
+        H5FNAL_PROGRAM_ERROR("could not load string");
+
+    /* end is the offset of the string's terminal \0 */
+    *s = dict->concat_strings + dict->indices[index].start;
+    *len = (size_t)(dict->indices[index].end - dict->indices[index].start);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end get_string_view() */
@@ -8,6 +8,10 @@
 
 #include "h5fnal.h"
 
+#if defined(__cplusplus) && __cplusplus >= 201703L
+#include <string_view>
+#endif
+
 typedef struct dict_index_t {
     hsize_t     start;
     hsize_t     end;
@@ -30,10 +34,30 @@ typedef struct string_dictionary_t {
     size_t total_string_alloc;
     char *concat_strings;
 
-    /* The string collection is (cheaply) implements as write-once,
-     * read-many, so we keep a 'created' flag to know if we need
-     * to store the data on close.
+    /* hash index over the strings (open addressing, linear probing).
+     * Each slot holds a string's index + 1, or 0 if the slot is empty.
+     * n_hash_slots is a power of two.
+     */
+    unsigned n_hash_slots;
+    unsigned *hash_slots;
+
+    /* An opened dictionary is read lazily: the indices on first use and
+     * the strings in blocks of block_size bytes as they are asked for.
+     * blocks_loaded flags the blocks that have been read, and is NULL
+     * once everything is in memory (and in the hash index).
      */
+    size_t block_size;
+    unsigned char *blocks_loaded;
+
+    /* Strings are appended to the datasets incrementally. The first
+     * n_strings_written strings (string_size_written bytes) are
+     * already in the file, and the rest are written by the next flush
+     * or the close. save_on_close is set for new dictionaries and for
+     * dictionaries opened in files opened read-write, which can gain
+     * new strings.
+     */
+    unsigned n_strings_written;
+    size_t string_size_written;
     hbool_t save_on_close;
 } string_dictionary_t;
 
@@ -41,9 +65,10 @@ typedef struct string_dictionary_t {
 extern "C" {
 #endif
 
-herr_t create_string_dictionary(hid_t loc_id, string_dictionary_t *dict);
+herr_t create_string_dictionary(hid_t loc_id, const h5fnal_create_options_t *options, string_dictionary_t *dict);
 herr_t open_string_dictionary(hid_t loc_id, string_dictionary_t *dict);
 herr_t close_string_dictionary(string_dictionary_t *dict);
+herr_t flush_string_dictionary(string_dictionary_t *dict);
 
 herr_t add_string_to_dictionary(const char *s, string_dictionary_t *dict);
 
@@ -51,9 +76,32 @@ herr_t get_string_index(const char *s, string_dictionary_t *dict, /*OUT*/ hbool_
 
 herr_t get_string(string_dictionary_t *dict, unsigned index, /*OUT*/ char **s);
 
+/* Zero-copy access: *s points into the dictionary's string storage and
+ * is valid until the dictionary is closed or another string is added.
+ * Don't free it.
+ */
+herr_t get_string_view(string_dictionary_t *dict, unsigned index, /*OUT*/ const char **s, /*OUT*/ size_t *len);
+
 #ifdef __cplusplus
 }
 #endif
 
+#if defined(__cplusplus) && __cplusplus >= 201703L
+/* C++17 version of get_string_view(), with the same lifetime rules */
+inline herr_t
+get_string_view(string_dictionary_t *dict, unsigned index, /*OUT*/ std::string_view *sv)
+{
+    const char *s;
+    size_t len;
+
+    if (!sv || get_string_view(dict, index, &s, &len) < 0)
+        return H5FNAL_FAILURE;
+
+    *sv = std::string_view(s, len);
+
+    return H5FNAL_SUCCESS;
+}
+#endif
+
 #endif /* H5FNAL_STRING_DICTIONARY_H */
 
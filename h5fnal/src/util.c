@@ -6,6 +6,14 @@
 #include "h5fnal.h"
 #include "util.h"
 
+/* Attribute that records how a dataset's chunk size was picked */
+#define H5FNAL_CHUNK_POLICY_ATTR_NAME   "chunk policy"
+
+/* Attribute that holds the number of elements in a dataset whose
+ * extent has been grown past its data
+ */
+#define H5FNAL_LOGICAL_SIZE_ATTR_NAME   "logical size"
+
 herr_t
 h5fnal_add_string_attribute(hid_t loc_id, const char *name, const char *value)
 {
@@ -121,8 +129,14 @@ error:
 
 } /* end h5fnal_get_string_attribute() */
 
+/************************************************************************
+ * h5fnal_get_dset_extent()
+ *
+ * Returns the current extent of a 1D dataset. This can be larger than
+ * the number of elements stored in it (see h5fnal_get_dset_size()).
+ ************************************************************************/
 hssize_t
-h5fnal_get_dset_size(hid_t did)
+h5fnal_get_dset_extent(hid_t did)
 {
     hid_t sid = H5FNAL_BAD_HID_T;
     hssize_t n = -1;
@@ -145,19 +159,299 @@ error:
         H5Sclose(sid);
     } H5E_END_TRY;
 
+    return -1;
+} /* end h5fnal_get_dset_extent() */
+
+
+/************************************************************************
+ * h5fnal_get_dset_size()
+ *
+ * Returns the number of elements stored in a 1D dataset. This is the
+ * dataset's logical size attribute if it has one (the extent is grown
+ * ahead of the data while it's being appended to) and the extent
+ * otherwise.
+ ************************************************************************/
+hssize_t
+h5fnal_get_dset_size(hid_t did)
+{
+    hssize_t n = -1;
+    hsize_t logical_size;
+    htri_t exists;
+
+    if ((n = h5fnal_get_dset_extent(did)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset extent");
+
+    if ((exists = H5Aexists(did, H5FNAL_LOGICAL_SIZE_ATTR_NAME)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (exists) {
+        if (h5fnal_get_hsize_attribute(did, H5FNAL_LOGICAL_SIZE_ATTR_NAME, 1, &logical_size) < 0)
+            H5FNAL_PROGRAM_ERROR("could not get logical size attribute");
+        if ((hsize_t)n > logical_size)
+            n = (hssize_t)logical_size;
+    }
+
+    return n;
+
+error:
     return -1;
 } /* end h5fnal_get_dset_size() */
 
 
-/* Create an empty, chunked, 1D dataset */
+
+herr_t
+h5fnal_add_hsize_attribute(hid_t loc_id, const char *name, size_t n, const hsize_t *values)
+{
+    hid_t aid = -1;
+    hid_t sid = -1;
+    hsize_t dims;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == name)
+        H5FNAL_PROGRAM_ERROR("name parameter cannot be NULL");
+    if (0 == n)
+        H5FNAL_PROGRAM_ERROR("n parameter cannot be zero");
+    if (NULL == values)
+        H5FNAL_PROGRAM_ERROR("values parameter cannot be NULL");
+
+    /* Create a dataspace for the attribute */
+    dims = (hsize_t)n;
+    if ((sid = H5Screate_simple(1, &dims, NULL)) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    /* Create the attribute and write the values */
+    if ((aid = H5Acreate(loc_id, name, H5T_STD_U64LE, sid, H5P_DEFAULT, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Awrite(aid, H5T_NATIVE_HSIZE, values) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    /* Close IDs */
+    if (H5Aclose(aid) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Sclose(sid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Aclose(aid);
+        H5Sclose(sid);
+    } H5E_END_TRY;
+
+    return H5FNAL_FAILURE;
+
+} /* end h5fnal_add_hsize_attribute() */
+
+
+herr_t
+h5fnal_get_hsize_attribute(hid_t loc_id, const char *name, size_t n, hsize_t *values)
+{
+    hid_t aid = -1;
+    hid_t sid = -1;
+    hssize_t n_stored;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == name)
+        H5FNAL_PROGRAM_ERROR("name parameter cannot be NULL");
+    if (NULL == values)
+        H5FNAL_PROGRAM_ERROR("values parameter cannot be NULL");
+
+    /* Open the attribute */
+    if ((aid = H5Aopen(loc_id, name, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    /* Make sure the caller's buffer is the right size */
+    if ((sid = H5Aget_space(aid)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((n_stored = H5Sget_simple_extent_npoints(sid)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((size_t)n_stored != n)
+        H5FNAL_PROGRAM_ERROR("attribute does not have the expected number of values");
+
+    /* Read the attribute */
+    if (H5Aread(aid, H5T_NATIVE_HSIZE, values) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    /* Close IDs */
+    if (H5Aclose(aid) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Sclose(sid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Aclose(aid);
+        H5Sclose(sid);
+    } H5E_END_TRY;
+
+    return H5FNAL_FAILURE;
+
+} /* end h5fnal_get_hsize_attribute() */
+
+
+/************************************************************************
+ * h5fnal_set_hsize_attribute()
+ *
+ * Like h5fnal_add_hsize_attribute(), but overwrites the values if the
+ * attribute already exists.
+ ************************************************************************/
+herr_t
+h5fnal_set_hsize_attribute(hid_t loc_id, const char *name, size_t n, const hsize_t *values)
+{
+    hid_t aid = -1;
+    htri_t exists;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
+    if (NULL == name)
+        H5FNAL_PROGRAM_ERROR("name parameter cannot be NULL");
+    if (NULL == values)
+        H5FNAL_PROGRAM_ERROR("values parameter cannot be NULL");
+
+    if ((exists = H5Aexists(loc_id, name)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (!exists)
+        return h5fnal_add_hsize_attribute(loc_id, name, n, values);
+
+    /* NOTE: The number of values has to match the stored attribute */
+    if ((aid = H5Aopen(loc_id, name, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Awrite(aid, H5T_NATIVE_HSIZE, values) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Aclose(aid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Aclose(aid);
+    } H5E_END_TRY;
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_set_hsize_attribute() */
+
+
+/************************************************************************
+ * h5fnal_init_create_options()
+ *
+ * Fills in the default data product creation options.
+ ************************************************************************/
+herr_t
+h5fnal_init_create_options(h5fnal_create_options_t *options)
+{
+    if (NULL == options)
+        H5FNAL_PROGRAM_ERROR("options parameter cannot be NULL");
+
+    memset(options, 0, sizeof(h5fnal_create_options_t));
+
+    options->chunk_policy.target_bytes = H5FNAL_DEFAULT_CHUNK_BYTES;
+    options->chunk_policy.expected_elements = 0;
+
+    options->compression.method = H5FNAL_COMPRESSION_DEFLATE;
+    options->compression.level = H5FNAL_DEFAULT_DEFLATE_LEVEL;
+    options->compression.shuffle = TRUE;
+
+    options->dset_compression = NULL;
+    options->n_dset_compression = 0;
+
+    options->parallel_compression = FALSE;
+
+    options->growth = H5FNAL_DEFAULT_GROWTH;
+
+    options->layout = H5FNAL_DEFAULT_LAYOUT;
+
+    options->storage = H5FNAL_DEFAULT_STORAGE;
+
+    options->trajectory_encoding = H5FNAL_DEFAULT_TRAJECTORY_ENCODING;
+
+    options->particle_graph = FALSE;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_init_create_options() */
+
+
+/************************************************************************
+ * h5fnal_get_chunk_dim()
+ *
+ * Returns the number of elements of size type_size that go in a chunk
+ * under the given policy. This is never less than one.
+ ************************************************************************/
+hsize_t
+h5fnal_get_chunk_dim(const h5fnal_chunk_policy_t *policy, size_t type_size)
+{
+    size_t target_bytes = H5FNAL_DEFAULT_CHUNK_BYTES;
+    hsize_t chunk_dim;
+
+    if (policy && policy->target_bytes > 0)
+        target_bytes = policy->target_bytes;
+    if (0 == type_size)
+        type_size = 1;
+
+    chunk_dim = (hsize_t)(target_bytes / type_size);
+
+    /* No point in a chunk bigger than the whole dataset */
+    if (policy && policy->expected_elements > 0 && policy->expected_elements < chunk_dim)
+        chunk_dim = policy->expected_elements;
+
+    /* HDF5 chunks are limited to 4 GiB */
+    if (chunk_dim > (hsize_t)(0xFFFFFFFFU / type_size))
+        chunk_dim = (hsize_t)(0xFFFFFFFFU / type_size);
+
+    if (chunk_dim < 1)
+        chunk_dim = 1;
+
+    return chunk_dim;
+} /* end h5fnal_get_chunk_dim() */
+
+
+/************************************************************************
+ * h5fnal_get_dset_compression()
+ *
+ * Returns the compression profile for the named dataset: its own
+ * profile if the options have one and the default one otherwise.
+ ************************************************************************/
+static const h5fnal_compression_t *
+h5fnal_get_dset_compression(const h5fnal_create_options_t *options, const char *name)
+{
+    size_t u;
+
+    for (u = 0; u < options->n_dset_compression; u++)
+        if (options->dset_compression[u].dset_name && !strcmp(options->dset_compression[u].dset_name, name))
+            return &options->dset_compression[u].compression;
+
+    return &options->compression;
+} /* end h5fnal_get_dset_compression() */
+
+
+/************************************************************************
+ * h5fnal_create_1D_dset()
+ *
+ * Create an empty, chunked, 1D dataset. The chunk size and filters
+ * come from the options (defaults if options is NULL). The chunk size
+ * choice is recorded in an attribute on the dataset as (target bytes,
+ * expected elements, chunk elements).
+ ************************************************************************/
 herr_t
-h5fnal_create_1D_dset(hid_t loc_id, const char *name, hid_t tid, hsize_t chunk_dim, /*OUT*/ hid_t *did)
+h5fnal_create_1D_dset(hid_t loc_id, const char *name, hid_t tid, const h5fnal_create_options_t *options, /*OUT*/ hid_t *did)
 {
+    h5fnal_create_options_t default_options;
+    const h5fnal_compression_t *compression;
+    hid_t dset_id = -1;
     hid_t dcpl_id = -1;
     hid_t sid = -1;
+    size_t type_size;
     hsize_t chunk_dims[1];
     hsize_t init_dims[1];
     hsize_t max_dims[1];
+    hsize_t policy_values[3];
 
     if (loc_id < 0)
         H5FNAL_PROGRAM_ERROR("loc_id parameter cannot be negative");
@@ -168,20 +462,21 @@ h5fnal_create_1D_dset(hid_t loc_id, const char *name, hid_t tid, hsize_t chunk_d
     if (!did)
         H5FNAL_PROGRAM_ERROR("did parameter cannot be NULL");
 
-    /* Create the dataset creation property list */
-    if ((dcpl_id = H5Pcreate(H5P_DATASET_CREATE)) < 0)
-        H5FNAL_HDF5_ERROR;
+    if (NULL == options) {
+        if (h5fnal_init_create_options(&default_options) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up default creation options");
+        options = &default_options;
+    }
 
-    /* Set up chunking */
-    chunk_dims[0] = chunk_dim;
-    if (H5Pset_chunk(dcpl_id, 1, chunk_dims) < 0)
+    /* Pick the chunk size and the compression filters */
+    if (0 == (type_size = H5Tget_size(tid)))
         H5FNAL_HDF5_ERROR;
+    chunk_dims[0] = h5fnal_get_chunk_dim(&options->chunk_policy, type_size);
+    compression = h5fnal_get_dset_compression(options, name);
 
-    /* Turn on compession */
-    if (H5Pset_shuffle(dcpl_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Pset_deflate(dcpl_id, 6) < 0)
-        H5FNAL_HDF5_ERROR;
+    /* Get a (shared) dataset creation property list */
+    if ((dcpl_id = h5fnal_acquire_dcpl(chunk_dims[0], type_size, compression)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset creation property list");
 
     /* Create the dataspace */
     init_dims[0] = 0;
@@ -190,21 +485,33 @@ h5fnal_create_1D_dset(hid_t loc_id, const char *name, hid_t tid, hsize_t chunk_d
         H5FNAL_HDF5_ERROR;
 
     /* Create datasets */
-    if ((*did = H5Dcreate2(loc_id, name, tid, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
+    if ((dset_id = H5Dcreate2(loc_id, name, tid, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
         H5FNAL_HDF5_ERROR;
 
+    /* Record the chunk size choice */
+    policy_values[0] = (hsize_t)(options->chunk_policy.target_bytes > 0
+            ? options->chunk_policy.target_bytes : H5FNAL_DEFAULT_CHUNK_BYTES);
+    policy_values[1] = options->chunk_policy.expected_elements;
+    policy_values[2] = chunk_dims[0];
+    if (h5fnal_add_hsize_attribute(dset_id, H5FNAL_CHUNK_POLICY_ATTR_NAME, 3, policy_values) < 0)
+        H5FNAL_PROGRAM_ERROR("could not add chunk policy attribute");
+
     /* close everything */
-    if (H5Pclose(dcpl_id) < 0)
-        H5FNAL_HDF5_ERROR;
+    if (h5fnal_release_dcpl(dcpl_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release dataset creation property list");
+    dcpl_id = -1;
     if (H5Sclose(sid) < 0)
         H5FNAL_HDF5_ERROR;
 
+    *did = dset_id;
+
     return H5FNAL_SUCCESS;
 
 error:
     H5E_BEGIN_TRY {
         H5Sclose(sid);
-        H5Pclose(dcpl_id);
+        h5fnal_release_dcpl(dcpl_id);
+        H5Dclose(dset_id);
     } H5E_END_TRY;
 
     if (did)
@@ -214,48 +521,68 @@ error:
 
 } /* end h5fnal_create_1D_dset() */
 
+
+/************************************************************************
+ * h5fnal_open_optional_dset()
+ *
+ * Opens a dataset that may not have been created (see
+ * h5fnal_defer_append_buffer()). *did is set to H5FNAL_BAD_HID_T if
+ * the dataset isn't there.
+ ************************************************************************/
 herr_t
-h5fnal_append_data(hid_t did, hid_t tid, hsize_t n_elements, const void *data)
+h5fnal_open_optional_dset(hid_t loc_id, const char *name, /*OUT*/ hid_t *did)
+{
+    htri_t exists;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("loc_id parameter cannot be negative");
+    if (!name)
+        H5FNAL_PROGRAM_ERROR("name parameter cannot be NULL");
+    if (!did)
+        H5FNAL_PROGRAM_ERROR("did parameter cannot be NULL");
+
+    *did = H5FNAL_BAD_HID_T;
+
+    if ((exists = H5Lexists(loc_id, name, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (exists)
+        if ((*did = H5Dopen2(loc_id, name, H5P_DEFAULT)) < 0)
+            H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_open_optional_dset() */
+
+/************************************************************************
+ * h5fnal_write_elements()
+ *
+ * Writes n_elements to a 1D dataset, starting at element offset. The
+ * dataset's extent must already cover the elements.
+ ************************************************************************/
+static herr_t
+h5fnal_write_elements(hid_t did, hid_t tid, hsize_t offset, hsize_t n_elements, const void *data)
 {
     hid_t file_sid = -1;                /* dataspace ID                             */
     hid_t memory_sid = -1;              /* dataspace ID                             */
-    hsize_t curr_dims[1];               /* initial size of dataset                  */
-    hsize_t new_dims[1];                /* new size of data dataset                 */
+    hsize_t mem_dims[1];                /* size of the data in memory               */
     hsize_t start[1];
     hsize_t stride[1];
     hsize_t count[1];
     hsize_t block[1];
 
-    /* NOTE: no parameter check on data parameter to make it easier on higher-level code */
-
-    /* Trivial case of no elements */
-    if (0 == n_elements)
-        return H5FNAL_SUCCESS;
-
     /* Create the memory dataspace (set of points describing the data size, etc.) */
-    curr_dims[0] = n_elements;
-    if ((memory_sid = H5Screate_simple(1, curr_dims, curr_dims)) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Get the size (current size only) of the dataset */
-    if ((file_sid = H5Dget_space(did)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sget_simple_extent_dims(file_sid, curr_dims, NULL) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sclose(file_sid) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Resize the dataset to hold the new data */
-    new_dims[0] = curr_dims[0] + n_elements;
-    if (H5Dset_extent(did, new_dims) < 0)
+    mem_dims[0] = n_elements;
+    if ((memory_sid = H5Screate_simple(1, mem_dims, mem_dims)) < 0)
         H5FNAL_HDF5_ERROR;
 
-    /* Get the resized file space */
+    /* Get the file space */
     if ((file_sid = H5Dget_space(did)) < 0)
         H5FNAL_HDF5_ERROR;
 
     /* Create a hyperslab describing where the data should go */
-    start[0] = curr_dims[0];
+    start[0] = offset;
     stride[0] = 1;
     count[0] = n_elements;
     block[0] = 1;
@@ -280,6 +607,911 @@ error:
         H5Sclose(memory_sid);
     } H5E_END_TRY;
 
+    return H5FNAL_FAILURE;
+} /* end h5fnal_write_elements() */
+
+herr_t
+h5fnal_append_data(hid_t did, hid_t tid, hsize_t n_elements, const void *data)
+{
+    hssize_t n;
+    hsize_t new_dims[1];
+
+    /* NOTE: no parameter check on data parameter to make it easier on higher-level code */
+
+    /* Trivial case of no elements */
+    if (0 == n_elements)
+        return H5FNAL_SUCCESS;
+
+    /* Get the size (current size only) of the dataset */
+    if ((n = h5fnal_get_dset_extent(did)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset size");
+
+    /* Resize the dataset to hold the new data */
+    new_dims[0] = (hsize_t)n + n_elements;
+    if (H5Dset_extent(did, new_dims) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    /* Write the data past the old end of the dataset */
+    if (h5fnal_write_elements(did, tid, (hsize_t)n, n_elements, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write data");
+
+    return H5FNAL_SUCCESS;
+
+error:
     return H5FNAL_FAILURE;
 } /* end h5fnal_append_data() */
 
+
+/************************************************************************
+ * h5fnal_read_data_range()
+ *
+ * Reads count elements of a 1D dataset, starting at element start,
+ * using a hyperslab selection. The range has to be inside the
+ * dataset's (logical) size.
+ ************************************************************************/
+herr_t
+h5fnal_read_data_range(hid_t did, hid_t tid, hsize_t start, hsize_t count, void *data)
+{
+    hid_t file_sid = -1;
+    hid_t memory_sid = -1;
+    hssize_t size;
+
+    /* Trivial case of no elements (which is all a dataset that was
+     * never created has)
+     */
+    if (0 == count)
+        return H5FNAL_SUCCESS;
+
+    if (did < 0)
+        H5FNAL_PROGRAM_ERROR("did parameter cannot be negative");
+    if (tid < 0)
+        H5FNAL_PROGRAM_ERROR("tid parameter cannot be negative");
+    if (NULL == data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    if ((size = h5fnal_get_dset_size(did)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset size");
+    if (start > (hsize_t)size || count > (hsize_t)size - start)
+        H5FNAL_PROGRAM_ERROR("range is outside the dataset");
+
+    if ((memory_sid = H5Screate_simple(1, &count, NULL)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((file_sid = H5Dget_space(did)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Sselect_hyperslab(file_sid, H5S_SELECT_SET, &start, NULL, &count, NULL) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (H5Dread(did, tid, memory_sid, file_sid, H5P_DEFAULT, data) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (H5Sclose(file_sid) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Sclose(memory_sid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Sclose(file_sid);
+        H5Sclose(memory_sid);
+    } H5E_END_TRY;
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_data_range() */
+
+
+/************************************************************************
+ * h5fnal_read_data()
+ *
+ * Reads the first n_elements elements of a 1D dataset. Use this
+ * instead of an H5S_ALL read since the extent can be larger than the
+ * data (see h5fnal_get_dset_size()).
+ ************************************************************************/
+herr_t
+h5fnal_read_data(hid_t did, hid_t tid, hsize_t n_elements, void *data)
+{
+    return h5fnal_read_data_range(did, tid, 0, n_elements, data);
+} /* end h5fnal_read_data() */
+
+
+/************************************************************************
+ * h5fnal_init_append_buffer()
+ *
+ * Sets up a write-behind buffer for appending to an existing 1D
+ * dataset. The buffer memory is not allocated until it is needed.
+ ************************************************************************/
+herr_t
+h5fnal_init_append_buffer(hid_t did, hid_t tid, h5fnal_growth_t growth, h5fnal_append_buffer_t *buffer)
+{
+    hid_t dcpl_id = -1;
+    hssize_t n;
+    htri_t exists;
+
+    if (did < 0)
+        H5FNAL_PROGRAM_ERROR("did parameter cannot be negative");
+    if (tid < 0)
+        H5FNAL_PROGRAM_ERROR("tid parameter cannot be negative");
+    if (!buffer)
+        H5FNAL_PROGRAM_ERROR("buffer parameter cannot be NULL");
+
+    memset(buffer, 0, sizeof(h5fnal_append_buffer_t));
+
+    buffer->did = did;
+    buffer->tid = tid;
+    buffer->file_tid = H5FNAL_BAD_HID_T;
+    buffer->growth = growth;
+    if (0 == (buffer->type_size = H5Tget_size(tid)))
+        H5FNAL_HDF5_ERROR;
+
+    /* Elements already in the dataset (non-zero when re-opened) */
+    if ((n = h5fnal_get_dset_size(did)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset size");
+    buffer->n_written = (hsize_t)n;
+    if ((n = h5fnal_get_dset_extent(did)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset extent");
+    buffer->extent = (hsize_t)n;
+    if ((exists = H5Aexists(did, H5FNAL_LOGICAL_SIZE_ATTR_NAME)) < 0)
+        H5FNAL_HDF5_ERROR;
+    buffer->has_logical_size = exists > 0 ? TRUE : FALSE;
+
+    /* Flushes happen in units of the dataset's chunk size. Anything
+     * else can't be extended, so there's no point in buffering it.
+     */
+    if ((dcpl_id = H5Dget_create_plist(did)) < 0)
+        H5FNAL_HDF5_ERROR;
+    buffer->chunk_dim = 1;
+    if (H5D_CHUNKED == H5Pget_layout(dcpl_id))
+        if (H5Pget_chunk(dcpl_id, 1, &(buffer->chunk_dim)) < 0)
+            H5FNAL_HDF5_ERROR;
+    if (H5Pclose(dcpl_id) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Pclose(dcpl_id);
+    } H5E_END_TRY;
+
+    if (buffer) {
+        memset(buffer, 0, sizeof(h5fnal_append_buffer_t));
+        buffer->did = H5FNAL_BAD_HID_T;
+        buffer->tid = H5FNAL_BAD_HID_T;
+        buffer->file_tid = H5FNAL_BAD_HID_T;
+    }
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_init_append_buffer() */
+
+
+/************************************************************************
+ * h5fnal_defer_append_buffer()
+ *
+ * Sets up an append buffer for a dataset that hasn't been created yet.
+ * Nothing is written to the file until the dataset is needed (see
+ * h5fnal_layout_t) or h5fnal_create_deferred_dset() is called, so
+ * datasets that never get any elements don't exist at all.
+ *
+ * The creation options are copied (with the dataset's compression
+ * profile picked out), so they don't have to outlive this call.
+ ************************************************************************/
+herr_t
+h5fnal_defer_append_buffer(hid_t loc_id, const char *name, hid_t tid, const h5fnal_create_options_t *options,
+        h5fnal_append_buffer_t *buffer)
+{
+    h5fnal_create_options_t default_options;
+
+    if (loc_id < 0)
+        H5FNAL_PROGRAM_ERROR("loc_id parameter cannot be negative");
+    if (!name)
+        H5FNAL_PROGRAM_ERROR("name parameter cannot be NULL");
+    if (tid < 0)
+        H5FNAL_PROGRAM_ERROR("tid parameter cannot be negative");
+    if (!buffer)
+        H5FNAL_PROGRAM_ERROR("buffer parameter cannot be NULL");
+
+    memset(buffer, 0, sizeof(h5fnal_append_buffer_t));
+    buffer->did = H5FNAL_BAD_HID_T;
+    buffer->tid = tid;
+    buffer->file_tid = H5FNAL_BAD_HID_T;
+
+    if (NULL == options) {
+        if (h5fnal_init_create_options(&default_options) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up default creation options");
+        options = &default_options;
+    }
+
+    buffer->loc_id = loc_id;
+    if (NULL == (buffer->name = strdup(name)))
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for dataset name");
+    buffer->options = *options;
+    buffer->options.compression = *h5fnal_get_dset_compression(options, name);
+    buffer->options.dset_compression = NULL;
+    buffer->options.n_dset_compression = 0;
+
+    buffer->growth = options->growth;
+    if (0 == (buffer->type_size = H5Tget_size(tid)))
+        H5FNAL_HDF5_ERROR;
+    buffer->chunk_dim = h5fnal_get_chunk_dim(&options->chunk_policy, buffer->type_size);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (buffer) {
+        free(buffer->name);
+        memset(buffer, 0, sizeof(h5fnal_append_buffer_t));
+        buffer->did = H5FNAL_BAD_HID_T;
+        buffer->tid = H5FNAL_BAD_HID_T;
+        buffer->file_tid = H5FNAL_BAD_HID_T;
+    }
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_defer_append_buffer() */
+
+
+/************************************************************************
+ * h5fnal_set_deferred_file_type()
+ *
+ * Makes a buffer set up by h5fnal_defer_append_buffer() create its
+ * dataset with file_tid instead of the memory datatype, e.g. a more
+ * compact one that HDF5 converts to and from. The chunk size is
+ * picked again for the new datatype. The ID is not owned by the
+ * buffer. Buffers that write through the compression pool lose it,
+ * since the pool can't convert datatypes.
+ ************************************************************************/
+herr_t
+h5fnal_set_deferred_file_type(h5fnal_append_buffer_t *buffer, hid_t file_tid)
+{
+    size_t file_type_size;
+
+    if (!buffer)
+        H5FNAL_PROGRAM_ERROR("buffer parameter cannot be NULL");
+    if (file_tid < 0)
+        H5FNAL_PROGRAM_ERROR("file_tid parameter cannot be negative");
+    if (buffer->did >= 0 || !buffer->name)
+        H5FNAL_PROGRAM_ERROR("append buffer has no dataset to create");
+
+    if (0 == (file_type_size = H5Tget_size(file_tid)))
+        H5FNAL_HDF5_ERROR;
+    buffer->file_tid = file_tid;
+    buffer->chunk_dim = h5fnal_get_chunk_dim(&buffer->options.chunk_policy, file_type_size);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_set_deferred_file_type() */
+
+
+/************************************************************************
+ * h5fnal_create_deferred_dset()
+ *
+ * Creates the dataset for a buffer set up by
+ * h5fnal_defer_append_buffer(), if that hasn't happened yet, and
+ * returns its ID in *did. The dataset is extendible and chunked. The
+ * ID is owned by the caller, as with h5fnal_init_append_buffer().
+ ************************************************************************/
+herr_t
+h5fnal_create_deferred_dset(h5fnal_append_buffer_t *buffer, /*OUT*/ hid_t *did)
+{
+    hid_t dset_id = H5FNAL_BAD_HID_T;
+
+    if (!buffer)
+        H5FNAL_PROGRAM_ERROR("buffer parameter cannot be NULL");
+    if (!did)
+        H5FNAL_PROGRAM_ERROR("did parameter cannot be NULL");
+
+    if (buffer->did >= 0) {
+        *did = buffer->did;
+        buffer->owns_did = FALSE;
+        return H5FNAL_SUCCESS;
+    }
+    if (!buffer->name)
+        H5FNAL_PROGRAM_ERROR("append buffer has no dataset to create");
+
+    if (h5fnal_create_1D_dset(buffer->loc_id, buffer->name, buffer->file_tid >= 0 ? buffer->file_tid : buffer->tid,
+            &buffer->options, &dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create dataset");
+    buffer->did = dset_id;
+
+    /* The options' chunk size and this one are the same */
+    if (buffer->use_pool)
+        if (h5fnal_create_chunk_writer(buffer->did, buffer->tid, &buffer->writer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create chunk writer");
+
+    free(buffer->name);
+    buffer->name = NULL;
+
+    *did = dset_id;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (buffer && dset_id >= 0) {
+        H5E_BEGIN_TRY {
+            H5Dclose(dset_id);
+        } H5E_END_TRY;
+        buffer->did = H5FNAL_BAD_HID_T;
+    }
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_create_deferred_dset() */
+
+
+/************************************************************************
+ * h5fnal_claim_deferred_dset()
+ *
+ * Hands the ID of a dataset the buffer created on its own over to the
+ * caller in *did. *did is left alone if the dataset hasn't been
+ * created (yet).
+ ************************************************************************/
+herr_t
+h5fnal_claim_deferred_dset(h5fnal_append_buffer_t *buffer, /*OUT*/ hid_t *did)
+{
+    if (!buffer)
+        H5FNAL_PROGRAM_ERROR("buffer parameter cannot be NULL");
+    if (!did)
+        H5FNAL_PROGRAM_ERROR("did parameter cannot be NULL");
+
+    if (buffer->did >= 0) {
+        *did = buffer->did;
+        buffer->owns_did = FALSE;
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_claim_deferred_dset() */
+
+
+/************************************************************************
+ * h5fnal_create_appended_dset()
+ *
+ * Creates a deferred dataset that is about to be written to. The
+ * buffer owns the ID until it is claimed.
+ ************************************************************************/
+static herr_t
+h5fnal_create_appended_dset(h5fnal_append_buffer_t *buffer)
+{
+    hid_t did;
+
+    if (h5fnal_create_deferred_dset(buffer, &did) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create dataset");
+    buffer->owns_did = TRUE;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_create_appended_dset() */
+
+
+/************************************************************************
+ * h5fnal_create_fixed_dset()
+ *
+ * Creates a deferred dataset whose elements are all in the buffer,
+ * at its final size, and writes them. The layout is compact for small
+ * datasets, contiguous for uncompressed ones and a single chunk
+ * otherwise (see h5fnal_layout_t). The buffer owns the ID.
+ ************************************************************************/
+static herr_t
+h5fnal_create_fixed_dset(h5fnal_append_buffer_t *buffer)
+{
+    hid_t dset_id = H5FNAL_BAD_HID_T;
+    hid_t dcpl_id = H5FNAL_BAD_HID_T;
+    hid_t sid = H5FNAL_BAD_HID_T;
+    hid_t file_tid;
+    hbool_t shared_dcpl = FALSE;
+    hsize_t dims[1];
+    size_t file_type_size;
+    size_t n_bytes;
+
+    file_tid = buffer->file_tid >= 0 ? buffer->file_tid : buffer->tid;
+    if (0 == (file_type_size = H5Tget_size(file_tid)))
+        H5FNAL_HDF5_ERROR;
+
+    dims[0] = buffer->n_buffered;
+    n_bytes = (size_t)dims[0] * file_type_size;
+
+    /* Compact and contiguous datasets can't have filters. A single
+     * chunk with fixed dimensions doesn't need a chunk index.
+     */
+    if (n_bytes <= H5FNAL_COMPACT_MAX_BYTES || H5FNAL_COMPRESSION_NONE == buffer->options.compression.method) {
+        if ((dcpl_id = H5Pcreate(H5P_DATASET_CREATE)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (H5Pset_layout(dcpl_id, n_bytes <= H5FNAL_COMPACT_MAX_BYTES ? H5D_COMPACT : H5D_CONTIGUOUS) < 0)
+            H5FNAL_HDF5_ERROR;
+    }
+    else {
+        if ((dcpl_id = h5fnal_acquire_dcpl(dims[0], file_type_size, &buffer->options.compression)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not get dataset creation property list");
+        shared_dcpl = TRUE;
+    }
+
+    if ((sid = H5Screate_simple(1, dims, NULL)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((dset_id = H5Dcreate2(buffer->loc_id, buffer->name, file_tid, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Dwrite(dset_id, buffer->tid, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer->buf) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    if (shared_dcpl) {
+        if (h5fnal_release_dcpl(dcpl_id) < 0)
+            H5FNAL_PROGRAM_ERROR("could not release dataset creation property list");
+    }
+    else if (H5Pclose(dcpl_id) < 0)
+        H5FNAL_HDF5_ERROR;
+    dcpl_id = H5FNAL_BAD_HID_T;
+    if (H5Sclose(sid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    buffer->did = dset_id;
+    buffer->owns_did = TRUE;
+    buffer->appended = TRUE;
+    buffer->n_written = dims[0];
+    buffer->extent = dims[0];
+    buffer->n_buffered = 0;
+
+    free(buffer->name);
+    buffer->name = NULL;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        if (shared_dcpl)
+            h5fnal_release_dcpl(dcpl_id);
+        else
+            H5Pclose(dcpl_id);
+        H5Sclose(sid);
+        H5Dclose(dset_id);
+    } H5E_END_TRY;
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_create_fixed_dset() */
+
+
+/************************************************************************
+ * h5fnal_open_append_buffer()
+ *
+ * Sets up the append buffer for a dataset in a re-opened data product:
+ * a normal buffer if the dataset (did) exists and a deferred one, with
+ * the default creation options, if it was never created.
+ ************************************************************************/
+herr_t
+h5fnal_open_append_buffer(hid_t loc_id, const char *name, hid_t did, hid_t tid, h5fnal_append_buffer_t *buffer)
+{
+    if (did >= 0) {
+        if (h5fnal_init_append_buffer(did, tid, H5FNAL_DEFAULT_GROWTH, buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up append buffer");
+    }
+    else {
+        if (h5fnal_defer_append_buffer(loc_id, name, tid, NULL, buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up deferred append buffer");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_open_append_buffer() */
+
+
+/************************************************************************
+ * h5fnal_update_count_attribute()
+ *
+ * Stores the number of elements in the buffer's dataset in the count
+ * attribute on loc_id (a data product's top-level group) if anything
+ * has been appended through the buffer. Call this before the buffer is
+ * closed.
+ ************************************************************************/
+herr_t
+h5fnal_update_count_attribute(hid_t loc_id, const h5fnal_append_buffer_t *buffer)
+{
+    hsize_t count;
+
+    if (!buffer)
+        H5FNAL_PROGRAM_ERROR("buffer parameter cannot be NULL");
+
+    /* Leave data products we haven't written to alone (the file may
+     * be read-only)
+     */
+    if (!buffer->appended && 0 == buffer->n_buffered)
+        return H5FNAL_SUCCESS;
+
+    count = h5fnal_get_buffered_size(buffer);
+    if (h5fnal_set_hsize_attribute(loc_id, H5FNAL_COUNT_ATTR_NAME, 1, &count) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write count attribute");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_update_count_attribute() */
+
+
+/************************************************************************
+ * h5fnal_record_logical_size()
+ *
+ * Stores the number of elements written so far in the dataset's
+ * logical size attribute, creating it if needed.
+ ************************************************************************/
+static herr_t
+h5fnal_record_logical_size(h5fnal_append_buffer_t *buffer)
+{
+    if (h5fnal_set_hsize_attribute(buffer->did, H5FNAL_LOGICAL_SIZE_ATTR_NAME, 1, &buffer->n_written) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write logical size attribute");
+    buffer->has_logical_size = TRUE;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_record_logical_size() */
+
+
+/************************************************************************
+ * h5fnal_reserve_extent()
+ *
+ * Makes sure the dataset's extent covers the first n_elements
+ * elements, growing it according to the buffer's growth mode.
+ *
+ * When the extent is grown past the data, the logical size attribute
+ * is updated first so readers never see elements that haven't been
+ * written.
+ ************************************************************************/
+static herr_t
+h5fnal_reserve_extent(h5fnal_append_buffer_t *buffer, hsize_t n_elements)
+{
+    hsize_t new_dims[1];
+
+    if (n_elements <= buffer->extent)
+        return H5FNAL_SUCCESS;
+
+    switch (buffer->growth) {
+        case H5FNAL_GROWTH_CHUNK:
+            new_dims[0] = ((n_elements + buffer->chunk_dim - 1) / buffer->chunk_dim) * buffer->chunk_dim;
+            break;
+        case H5FNAL_GROWTH_GEOMETRIC:
+            new_dims[0] = ((n_elements + buffer->chunk_dim - 1) / buffer->chunk_dim) * buffer->chunk_dim;
+            if (new_dims[0] < 2 * buffer->extent)
+                new_dims[0] = 2 * buffer->extent;
+            break;
+        case H5FNAL_GROWTH_EXACT:
+        default:
+            new_dims[0] = n_elements;
+            break;
+    }
+
+    if (new_dims[0] > n_elements || buffer->has_logical_size)
+        if (h5fnal_record_logical_size(buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not record logical size");
+
+    if (H5Dset_extent(buffer->did, new_dims) < 0)
+        H5FNAL_HDF5_ERROR;
+    buffer->extent = new_dims[0];
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_reserve_extent() */
+
+
+/************************************************************************
+ * h5fnal_use_compression_pool()
+ *
+ * Sends whole chunks through a chunk writer, so they are compressed
+ * by the compression pool and stored with direct chunk writes. Does
+ * nothing if the pool isn't running or the dataset can't be written
+ * that way.
+ ************************************************************************/
+herr_t
+h5fnal_use_compression_pool(h5fnal_append_buffer_t *buffer)
+{
+    if (!buffer)
+        H5FNAL_PROGRAM_ERROR("buffer parameter cannot be NULL");
+
+    if (buffer->writer || 0 == h5fnal_get_compression_pool_size())
+        return H5FNAL_SUCCESS;
+
+    /* Datasets that haven't been created yet get their writer when
+     * they are
+     */
+    if (buffer->did < 0) {
+        buffer->use_pool = TRUE;
+        return H5FNAL_SUCCESS;
+    }
+
+    if (h5fnal_create_chunk_writer(buffer->did, buffer->tid, &buffer->writer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create chunk writer");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_use_compression_pool() */
+
+
+/************************************************************************
+ * h5fnal_write_appended()
+ *
+ * Writes n_elements at the end of the buffer's dataset. Writes made up
+ * of whole chunks go through the chunk writer if there is one.
+ ************************************************************************/
+static herr_t
+h5fnal_write_appended(h5fnal_append_buffer_t *buffer, hsize_t n_elements, const void *data)
+{
+    const char *in = (const char *)data;
+    hsize_t u;
+
+    if (buffer->did < 0)
+        if (h5fnal_create_appended_dset(buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create dataset");
+
+    buffer->appended = TRUE;
+
+    if (h5fnal_reserve_extent(buffer, buffer->n_written + n_elements) < 0)
+        H5FNAL_PROGRAM_ERROR("could not extend dataset");
+    if (buffer->writer)
+        buffer->writer->extent = buffer->extent;
+
+    if (buffer->writer && 0 == buffer->n_written % buffer->chunk_dim && 0 == n_elements % buffer->chunk_dim) {
+        for (u = 0; u < n_elements; u += buffer->chunk_dim)
+            if (h5fnal_submit_chunk(buffer->writer, buffer->n_written + u, in + u * buffer->type_size) < 0)
+                H5FNAL_PROGRAM_ERROR("could not submit chunk");
+    }
+    else {
+        /* Chunks in flight have to land first, in case they extend the dataset */
+        if (h5fnal_drain_chunk_writer(buffer->writer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write chunks");
+        if (h5fnal_write_elements(buffer->did, buffer->tid, buffer->n_written, n_elements, data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write elements");
+    }
+
+    buffer->n_written += n_elements;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_write_appended() */
+
+
+/************************************************************************
+ * h5fnal_buffered_append()
+ *
+ * Appends elements through the write-behind buffer.
+ *
+ * Data is only written once it reaches a chunk boundary in the
+ * dataset. A single append that spans several chunks is written
+ * straight from the caller's buffer in one call (after topping up
+ * and writing any partially filled buffer), and only the trailing
+ * partial chunk is copied into the buffer.
+ ************************************************************************/
+herr_t
+h5fnal_buffered_append(h5fnal_append_buffer_t *buffer, hsize_t n_elements, const void *data)
+{
+    const char *in = (const char *)data;
+    hsize_t end;
+    hsize_t boundary;
+    hsize_t n;
+
+    if (!buffer)
+        H5FNAL_PROGRAM_ERROR("buffer parameter cannot be NULL");
+
+    /* NOTE: no parameter check on data parameter to make it easier on higher-level code */
+
+    /* Trivial case of no elements */
+    if (0 == n_elements)
+        return H5FNAL_SUCCESS;
+
+    /* Chunked datasets are created by the first non-empty append.
+     * Others wait until their final size is known or they outgrow
+     * the buffer.
+     */
+    if (buffer->did < 0 && H5FNAL_LAYOUT_CHUNKED == buffer->options.layout)
+        if (h5fnal_create_appended_dset(buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create dataset");
+
+    /* Last chunk boundary at or before the end of the new data */
+    end = buffer->n_written + buffer->n_buffered + n_elements;
+    boundary = (end / buffer->chunk_dim) * buffer->chunk_dim;
+
+    /* Fill up the buffered chunk and write it out if we crossed into
+     * a new chunk.
+     */
+    if (boundary > buffer->n_written && buffer->n_buffered > 0) {
+        n = buffer->chunk_dim - ((buffer->n_written + buffer->n_buffered) % buffer->chunk_dim);
+        memcpy((char *)buffer->buf + buffer->n_buffered * buffer->type_size, in, n * buffer->type_size);
+        buffer->n_buffered += n;
+        in += n * buffer->type_size;
+        n_elements -= n;
+
+        if (h5fnal_write_appended(buffer, buffer->n_buffered, buffer->buf) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write buffered elements");
+        buffer->n_buffered = 0;
+    }
+
+    /* Write any whole chunks directly from the caller's data */
+    if (boundary > buffer->n_written) {
+        n = boundary - buffer->n_written;
+        if (h5fnal_write_appended(buffer, n, in) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write elements");
+        in += n * buffer->type_size;
+        n_elements -= n;
+    }
+
+    /* Buffer the rest */
+    if (n_elements > 0) {
+        if (NULL == buffer->buf)
+            if (NULL == (buffer->buf = malloc(buffer->chunk_dim * buffer->type_size)))
+                H5FNAL_PROGRAM_ERROR("could not allocate memory for append buffer");
+        memcpy((char *)buffer->buf + buffer->n_buffered * buffer->type_size, in, n_elements * buffer->type_size);
+        buffer->n_buffered += n_elements;
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_buffered_append() */
+
+
+/************************************************************************
+ * h5fnal_flush_append_buffer()
+ *
+ * Writes any buffered elements to the dataset, creating it (chunked)
+ * if it was deferred.
+ ************************************************************************/
+herr_t
+h5fnal_flush_append_buffer(h5fnal_append_buffer_t *buffer)
+{
+    if (!buffer)
+        H5FNAL_PROGRAM_ERROR("buffer parameter cannot be NULL");
+
+    if (buffer->n_buffered > 0) {
+        if (h5fnal_write_appended(buffer, buffer->n_buffered, buffer->buf) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write buffered elements");
+        buffer->n_buffered = 0;
+    }
+
+    if (h5fnal_drain_chunk_writer(buffer->writer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write chunks");
+
+    /* Let readers know where the data ends */
+    if (buffer->has_logical_size)
+        if (h5fnal_record_logical_size(buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not record logical size");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_flush_append_buffer() */
+
+
+/************************************************************************
+ * h5fnal_sync_append_buffer()
+ *
+ * Flushes the buffer so its elements can be read from the dataset and
+ * hands over the dataset's ID in *did if the buffer created it (see
+ * h5fnal_claim_deferred_dset()). The data products call this before
+ * reading.
+ ************************************************************************/
+herr_t
+h5fnal_sync_append_buffer(h5fnal_append_buffer_t *buffer, /*OUT*/ hid_t *did)
+{
+    if (h5fnal_flush_append_buffer(buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush append buffer");
+    if (h5fnal_claim_deferred_dset(buffer, did) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_sync_append_buffer() */
+
+
+/************************************************************************
+ * h5fnal_close_append_buffer()
+ *
+ * Flushes the buffer, trims the dataset's extent back to the number of
+ * elements written (removing the logical size attribute) and frees
+ * the buffer. A deferred dataset whose elements are all still in the
+ * buffer is created here, with a layout that suits its size.
+ ************************************************************************/
+herr_t
+h5fnal_close_append_buffer(h5fnal_append_buffer_t *buffer)
+{
+    hsize_t dims[1];
+
+    if (!buffer)
+        H5FNAL_PROGRAM_ERROR("buffer parameter cannot be NULL");
+
+    /* Deferred datasets that never outgrew the buffer */
+    if (buffer->did < 0 && buffer->name && buffer->n_buffered > 0)
+        if (h5fnal_create_fixed_dset(buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create dataset");
+
+    /* Buffers that were never set up (e.g. optional datasets) or
+     * whose dataset was never created
+     */
+    if (buffer->did < 0)
+        return h5fnal_free_append_buffer(buffer);
+
+    if (h5fnal_flush_append_buffer(buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush append buffer");
+
+    /* Leave datasets we haven't written to alone (the file may be
+     * read-only)
+     */
+    if (buffer->appended && buffer->extent > buffer->n_written) {
+        dims[0] = buffer->n_written;
+        if (H5Dset_extent(buffer->did, dims) < 0)
+            H5FNAL_HDF5_ERROR;
+        buffer->extent = buffer->n_written;
+    }
+    if (buffer->appended && buffer->has_logical_size) {
+        if (H5Adelete(buffer->did, H5FNAL_LOGICAL_SIZE_ATTR_NAME) < 0)
+            H5FNAL_HDF5_ERROR;
+        buffer->has_logical_size = FALSE;
+    }
+
+    if (h5fnal_free_append_buffer(buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free append buffer");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_close_append_buffer() */
+
+
+/************************************************************************
+ * h5fnal_free_append_buffer()
+ *
+ * Releases the buffer memory and closes the dataset if the buffer owns
+ * it. Any unflushed elements are discarded.
+ ************************************************************************/
+herr_t
+h5fnal_free_append_buffer(h5fnal_append_buffer_t *buffer)
+{
+    if (!buffer)
+        H5FNAL_PROGRAM_ERROR("buffer parameter cannot be NULL");
+
+    free(buffer->buf);
+    free(buffer->name);
+    if (h5fnal_free_chunk_writer(buffer->writer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free chunk writer");
+    if (buffer->owns_did)
+        if (H5Dclose(buffer->did) < 0)
+            H5FNAL_HDF5_ERROR;
+
+    memset(buffer, 0, sizeof(h5fnal_append_buffer_t));
+    buffer->did = H5FNAL_BAD_HID_T;
+    buffer->tid = H5FNAL_BAD_HID_T;
+    buffer->file_tid = H5FNAL_BAD_HID_T;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_free_append_buffer() */
+
+
+/************************************************************************
+ * h5fnal_get_buffered_size()
+ *
+ * Returns the logical size of the dataset, including elements that
+ * are still in the buffer.
+ ************************************************************************/
+hsize_t
+h5fnal_get_buffered_size(const h5fnal_append_buffer_t *buffer)
+{
+    return buffer->n_written + buffer->n_buffered;
+} /* end h5fnal_get_buffered_size() */
+
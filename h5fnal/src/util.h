@@ -8,6 +8,187 @@
 
 #include "h5fnal.h"
 
+/* Default number of bytes of (uncompressed) data per chunk */
+#define H5FNAL_DEFAULT_CHUNK_BYTES      65536
+
+/* Default memory bound for the data product cursors */
+#define H5FNAL_DEFAULT_CURSOR_BYTES     (64 * 1024 * 1024)
+
+/* Chunk sizing policy
+ *
+ * Chunks are sized to hold about target_bytes of data. If the caller
+ * knows how many elements a dataset will end up holding, that can be
+ * passed in expected_elements and chunks will be no larger than that,
+ * so small datasets don't get large, mostly empty chunks. Zero means
+ * no hint.
+ */
+typedef struct h5fnal_chunk_policy_t {
+    size_t      target_bytes;
+    hsize_t     expected_elements;
+} h5fnal_chunk_policy_t;
+
+/* How a dataset's extent grows as elements are appended to it
+ *
+ * With the chunk and geometric modes the extent runs ahead of the data
+ * and the number of elements actually written is kept in a "logical
+ * size" attribute until the data product is closed, when the extent is
+ * trimmed back and the attribute removed.
+ */
+typedef enum h5fnal_growth_t {
+    H5FNAL_GROWTH_EXACT = 0,    /* to exactly the number of elements        */
+    H5FNAL_GROWTH_CHUNK,        /* to the next whole chunk                  */
+    H5FNAL_GROWTH_GEOMETRIC     /* by doubling, in whole chunks             */
+} h5fnal_growth_t;
+
+#define H5FNAL_DEFAULT_GROWTH   H5FNAL_GROWTH_GEOMETRIC
+
+/* How datasets are laid out in the file
+ *
+ * With the automatic layout, a dataset is only created when its
+ * elements no longer fit in the append buffer (one chunk) or when
+ * they are read back. Datasets whose elements all fit in the buffer
+ * are created when the data product is closed, at their final size:
+ * compact (stored in the object header) if they hold at most
+ * H5FNAL_COMPACT_MAX_BYTES, contiguous if they aren't compressed and
+ * a single, fixed-size chunk otherwise. Only datasets that grow past
+ * a chunk get the usual extendible, chunked layout.
+ *
+ * The chunked layout always makes extendible, chunked datasets, created
+ * by the first non-empty append. It is the default.
+ *
+ * Datasets given a compact, contiguous or single-chunk layout can't be
+ * extended, so the automatic layout is only for data products that
+ * won't be appended to after they are re-opened.
+ */
+typedef enum h5fnal_layout_t {
+    H5FNAL_LAYOUT_CHUNKED = 0,  /* always chunked and extendible            */
+    H5FNAL_LAYOUT_AUTO          /* picked from the final size               */
+} h5fnal_layout_t;
+
+#define H5FNAL_DEFAULT_LAYOUT       H5FNAL_LAYOUT_CHUNKED
+
+/* How the bulk datasets of a data product (hits and particles) are
+ * stored
+ *
+ * With the column storage each member of the element datatype gets its
+ * own dataset (see column_set.h), so readers can pick the members they
+ * need. The other datasets are always stored as rows.
+ */
+typedef enum h5fnal_storage_t {
+    H5FNAL_STORAGE_ROWS = 0,    /* one compound dataset                     */
+    H5FNAL_STORAGE_COLUMNS      /* one dataset per compound member          */
+} h5fnal_storage_t;
+
+#define H5FNAL_DEFAULT_STORAGE      H5FNAL_STORAGE_ROWS
+
+/* How MC trajectory points are encoded in the file
+ *
+ * The delta encodings store each position, time and momentum as the
+ * difference between its bit pattern and that of the same value in the
+ * previous point, as an unsigned integer. This is lossless, and the
+ * mostly zero high bytes compress much better after the shuffle. The
+ * coding restarts (the value itself is stored) every chunk's worth of
+ * points, so range reads only decode the chunks they read anyway. The
+ * float32 encoding also rounds the values to the nearest float first,
+ * so values with magnitudes between 1.2e-38 and 3.4e38 have a relative
+ * error of at most 2^-24 (6e-8). Smaller magnitudes have an absolute
+ * error of at most 7e-46. Particle indices are stored exactly, and
+ * reads decode back to h5fnal_trajectory_t either way.
+ *
+ * The coding is done by the library, so the trajectory dataset only
+ * has the usual filters and can be read by any HDF5 tool, as integers.
+ * Its "encoding" attribute holds "delta" or "delta_float32" and its
+ * "encoding block" attribute the number of points between restarts.
+ * Plain datasets don't have these attributes.
+ */
+typedef enum h5fnal_encoding_t {
+    H5FNAL_ENCODING_PLAIN = 0,      /* doubles, as in memory                */
+    H5FNAL_ENCODING_DELTA,          /* doubles, delta coded                 */
+    H5FNAL_ENCODING_DELTA_FLOAT32   /* floats, delta coded                  */
+} h5fnal_encoding_t;
+
+#define H5FNAL_DEFAULT_TRAJECTORY_ENCODING  H5FNAL_ENCODING_PLAIN
+
+/* Largest dataset (in bytes) given the compact layout. Compact data
+ * goes in the object header, which is limited to 64 KiB.
+ */
+#define H5FNAL_COMPACT_MAX_BYTES    (16 * 1024)
+
+/* Data product creation options
+ *
+ * Passed to the h5fnal_create_*() calls and used for all the datasets
+ * in the data product. A NULL pointer gets the defaults set by
+ * h5fnal_init_create_options().
+ *
+ * The compression profile applies to every dataset unless the dataset
+ * is named in the dset_compression array, which is owned by the caller.
+ *
+ * With parallel_compression set, whole chunks are compressed by the
+ * compression pool (see chunk_writer.h) and stored with direct chunk
+ * writes. This has no effect unless the pool has been started.
+ *
+ * With particle_graph set, MC truth data products also store the
+ * parent/daughter index of their particles (see particle_graph.h),
+ * which takes about 88 bytes per particle. Other data products ignore
+ * it.
+ */
+typedef struct h5fnal_create_options_t {
+    h5fnal_chunk_policy_t           chunk_policy;
+    h5fnal_compression_t            compression;
+    const h5fnal_dset_compression_t *dset_compression;
+    size_t                          n_dset_compression;
+    hbool_t                         parallel_compression;
+    h5fnal_growth_t                 growth;
+    h5fnal_layout_t                 layout;
+    h5fnal_storage_t                storage;
+    h5fnal_encoding_t               trajectory_encoding;
+    hbool_t                         particle_graph;
+} h5fnal_create_options_t;
+
+/* Attribute on a data product's top-level group that holds the number
+ * of elements in the data product, so empty products can be spotted
+ * without opening (or having) any datasets
+ */
+#define H5FNAL_COUNT_ATTR_NAME  "count"
+
+/* Write-behind append buffer
+ *
+ * Appended elements are held in memory and only written to the
+ * dataset in whole-chunk units, so most appends cost a memcpy
+ * instead of an extent change and a partial chunk write. Whatever
+ * is left in the buffer is written by h5fnal_flush_append_buffer().
+ * The data products call h5fnal_close_append_buffer() when they are
+ * closed, which also trims the dataset's extent.
+ *
+ * The dataset and datatype IDs are NOT owned by the buffer.
+ *
+ * A buffer can also be set up before its dataset exists (see
+ * h5fnal_defer_append_buffer()), in which case did is negative and
+ * the buffer holds what is needed to create the dataset later. A
+ * dataset the buffer creates on its own is owned by the buffer until
+ * it is handed over by h5fnal_claim_deferred_dset().
+ */
+typedef struct h5fnal_append_buffer_t {
+    hid_t       did;            /* dataset the elements are appended to     */
+    hid_t       tid;            /* memory datatype of the elements          */
+    hid_t       file_tid;       /* deferred dataset's datatype, if not tid  */
+    size_t      type_size;      /* size of one element in memory            */
+    hsize_t     chunk_dim;      /* number of elements in a dataset chunk    */
+    hsize_t     n_written;      /* number of elements stored in the dataset */
+    hsize_t     extent;         /* current extent of the dataset            */
+    h5fnal_growth_t growth;     /* how the extent grows                     */
+    hbool_t     has_logical_size;   /* dataset has a logical size attribute */
+    hbool_t     appended;       /* something was written through the buffer */
+    hsize_t     n_buffered;     /* number of elements waiting in buf        */
+    void       *buf;            /* holds at most chunk_dim elements         */
+    h5fnal_chunk_writer_t *writer;  /* writes whole chunks when not NULL    */
+    hbool_t     use_pool;       /* create a chunk writer with the dataset   */
+    hbool_t     owns_did;       /* the buffer created did and closes it     */
+    hid_t       loc_id;         /* where the deferred dataset goes          */
+    char       *name;           /* deferred dataset name (NULL if none)     */
+    h5fnal_create_options_t options;    /* deferred dataset options         */
+} h5fnal_append_buffer_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,15 +197,49 @@ extern "C" {
 herr_t h5fnal_add_string_attribute(hid_t loc_id, const char *name, const char *value);
 herr_t h5fnal_get_string_attribute(hid_t loc_id, const char *name, char **value);
 
+/* Add and get small arrays of hsize_t values as attributes */
+herr_t h5fnal_add_hsize_attribute(hid_t loc_id, const char *name, size_t n, const hsize_t *values);
+herr_t h5fnal_get_hsize_attribute(hid_t loc_id, const char *name, size_t n, hsize_t *values);
+herr_t h5fnal_set_hsize_attribute(hid_t loc_id, const char *name, size_t n, const hsize_t *values);
+
+/* Data product creation options */
+herr_t h5fnal_init_create_options(h5fnal_create_options_t *options);
+hsize_t h5fnal_get_chunk_dim(const h5fnal_chunk_policy_t *policy, size_t type_size);
+
 /* Get the size of a 1D dataset */
 hssize_t h5fnal_get_dset_size(hid_t did);
+hssize_t h5fnal_get_dset_extent(hid_t did);
 
 /* Create an empty, chunked, 1D dataset */
-herr_t h5fnal_create_1D_dset(hid_t loc_id, const char *name, hid_t tid, hsize_t chunk_dim, /*OUT*/ hid_t *did);
+herr_t h5fnal_create_1D_dset(hid_t loc_id, const char *name, hid_t tid, const h5fnal_create_options_t *options, /*OUT*/ hid_t *did);
+
+/* Open a 1D dataset that may not exist */
+herr_t h5fnal_open_optional_dset(hid_t loc_id, const char *name, /*OUT*/ hid_t *did);
+
+/* Read the data in a 1D dataset */
+herr_t h5fnal_read_data(hid_t did, hid_t tid, hsize_t n_elements, void *data);
+herr_t h5fnal_read_data_range(hid_t did, hid_t tid, hsize_t start, hsize_t count, void *data);
 
 /* Append data to a 1D dataset */
 herr_t h5fnal_append_data(hid_t did, hid_t tid, hsize_t n_elements, const void *data);
 
+/* Buffered (write-behind) appends to a 1D dataset */
+herr_t h5fnal_init_append_buffer(hid_t did, hid_t tid, h5fnal_growth_t growth, h5fnal_append_buffer_t *buffer);
+herr_t h5fnal_defer_append_buffer(hid_t loc_id, const char *name, hid_t tid, const h5fnal_create_options_t *options,
+        h5fnal_append_buffer_t *buffer);
+herr_t h5fnal_set_deferred_file_type(h5fnal_append_buffer_t *buffer, hid_t file_tid);
+herr_t h5fnal_create_deferred_dset(h5fnal_append_buffer_t *buffer, /*OUT*/ hid_t *did);
+herr_t h5fnal_claim_deferred_dset(h5fnal_append_buffer_t *buffer, /*OUT*/ hid_t *did);
+herr_t h5fnal_open_append_buffer(hid_t loc_id, const char *name, hid_t did, hid_t tid, h5fnal_append_buffer_t *buffer);
+herr_t h5fnal_update_count_attribute(hid_t loc_id, const h5fnal_append_buffer_t *buffer);
+herr_t h5fnal_use_compression_pool(h5fnal_append_buffer_t *buffer);
+herr_t h5fnal_buffered_append(h5fnal_append_buffer_t *buffer, hsize_t n_elements, const void *data);
+herr_t h5fnal_flush_append_buffer(h5fnal_append_buffer_t *buffer);
+herr_t h5fnal_sync_append_buffer(h5fnal_append_buffer_t *buffer, /*OUT*/ hid_t *did);
+herr_t h5fnal_close_append_buffer(h5fnal_append_buffer_t *buffer);
+herr_t h5fnal_free_append_buffer(h5fnal_append_buffer_t *buffer);
+hsize_t h5fnal_get_buffered_size(const h5fnal_append_buffer_t *buffer);
+
 #ifdef __cplusplus
 }
 #endif
@@ -106,12 +106,16 @@ h5fnal_close_vector_on_err(h5fnal_vect_hitcoll_t *vector)
     if (vector) {
         H5E_BEGIN_TRY {
             H5Dclose(vector->hit_dset_id);
-            H5Tclose(vector->hit_dtype_id);
+            h5fnal_release_type(vector->hit_dtype_id);
             H5Dclose(vector->hitcoll_dset_id);
-            H5Tclose(vector->hitcoll_dtype_id);
+            h5fnal_release_type(vector->hitcoll_dtype_id);
             H5Gclose(vector->top_level_group_id);
         } H5E_END_TRY;
 
+        h5fnal_free_append_buffer(&vector->hit_buffer);
+        h5fnal_free_append_buffer(&vector->hitcoll_buffer);
+        h5fnal_free_column_set(&vector->hit_columns);
+
         vector->hit_dset_id         = H5FNAL_BAD_HID_T;
         vector->hit_dtype_id        = H5FNAL_BAD_HID_T;
         vector->hitcoll_dset_id     = H5FNAL_BAD_HID_T;
@@ -123,17 +127,121 @@ h5fnal_close_vector_on_err(h5fnal_vect_hitcoll_t *vector)
 } /* end h5fnal_close_vector_on_err() */
 
 
+/************************************************************************
+ * h5fnal_init_hit_storage()
+ *
+ * Sets up the append buffer or, with column storage, the column set
+ * the hits are written through. For a new data product (create is
+ * TRUE) nothing is created in the file until there are hits to write.
+ * Otherwise the storage is picked up from the file: hits stored as
+ * columns are in a group instead of a dataset.
+ ************************************************************************/
+static herr_t
+h5fnal_init_hit_storage(h5fnal_vect_hitcoll_t *vector, hbool_t create, const h5fnal_create_options_t *options)
+{
+    htri_t is_columns;
+
+    vector->hit_dset_id = H5FNAL_BAD_HID_T;
+    vector->hit_columns.gid = H5FNAL_BAD_HID_T;
+
+    if (create)
+        vector->hit_storage = options ? options->storage : H5FNAL_DEFAULT_STORAGE;
+    else {
+        if ((is_columns = h5fnal_is_column_set(vector->top_level_group_id, H5FNAL_HIT_DATASET_NAME)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not check hit storage");
+        vector->hit_storage = is_columns ? H5FNAL_STORAGE_COLUMNS : H5FNAL_STORAGE_ROWS;
+    }
+
+    if (H5FNAL_STORAGE_COLUMNS == vector->hit_storage) {
+        /* The hit append buffer isn't used */
+        vector->hit_buffer.did = H5FNAL_BAD_HID_T;
+        vector->hit_buffer.tid = H5FNAL_BAD_HID_T;
+
+        if (create) {
+            if (h5fnal_create_column_set(vector->top_level_group_id, H5FNAL_HIT_DATASET_NAME, vector->hit_dtype_id,
+                    options, &vector->hit_columns) < 0)
+                H5FNAL_PROGRAM_ERROR("could not create hit columns");
+        }
+        else {
+            if (h5fnal_open_column_set(vector->top_level_group_id, H5FNAL_HIT_DATASET_NAME, vector->hit_dtype_id,
+                    &vector->hit_columns) < 0)
+                H5FNAL_PROGRAM_ERROR("could not open hit columns");
+        }
+    }
+    else if (create) {
+        if (h5fnal_defer_append_buffer(vector->top_level_group_id, H5FNAL_HIT_DATASET_NAME, vector->hit_dtype_id,
+                options, &vector->hit_buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up hit append buffer");
+
+        /* The hits are the bulk of the data, so compress them in
+         * parallel if asked to (column sets take care of this
+         * themselves).
+         */
+        if (options && options->parallel_compression)
+            if (h5fnal_use_compression_pool(&vector->hit_buffer) < 0)
+                H5FNAL_PROGRAM_ERROR("could not set up parallel compression");
+    }
+    else {
+        if (h5fnal_open_optional_dset(vector->top_level_group_id, H5FNAL_HIT_DATASET_NAME, &vector->hit_dset_id) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open hit dataset");
+        if (h5fnal_open_append_buffer(vector->top_level_group_id, H5FNAL_HIT_DATASET_NAME, vector->hit_dset_id,
+                vector->hit_dtype_id, &vector->hit_buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up hit append buffer");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_init_hit_storage() */
+
+
+/************************************************************************
+ * h5fnal_get_n_hits()
+ *
+ * Returns the number of hits in the data product, including hits that
+ * are still in the append buffers.
+ ************************************************************************/
+static hsize_t
+h5fnal_get_n_hits(const h5fnal_vect_hitcoll_t *vector)
+{
+    if (H5FNAL_STORAGE_COLUMNS == vector->hit_storage)
+        return h5fnal_get_column_set_size(&vector->hit_columns);
+
+    return h5fnal_get_buffered_size(&vector->hit_buffer);
+} /* end h5fnal_get_n_hits() */
+
+
+/************************************************************************
+ * h5fnal_sync_hits()
+ *
+ * Makes sure any appended hits are in the file.
+ ************************************************************************/
+static herr_t
+h5fnal_sync_hits(h5fnal_vect_hitcoll_t *vector)
+{
+    if (H5FNAL_STORAGE_COLUMNS == vector->hit_storage) {
+        if (h5fnal_sync_column_set(&vector->hit_columns) < 0)
+            H5FNAL_PROGRAM_ERROR("could not flush hit columns");
+    }
+    else if (h5fnal_sync_append_buffer(&vector->hit_buffer, &vector->hit_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush hit append buffer");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_sync_hits() */
+
+
 /************************************************************************
  * h5fnal_create_v_mc_hit_collection()
  ************************************************************************/
 herr_t
-h5fnal_create_v_mc_hit_collection(hid_t loc_id, const char *name, h5fnal_vect_hitcoll_t *vector)
+h5fnal_create_v_mc_hit_collection(hid_t loc_id, const char *name, const h5fnal_create_options_t *options,
+        h5fnal_vect_hitcoll_t *vector)
 {
-    hid_t dcpl_id = -1;
-    hid_t sid = -1;
-    hsize_t chunk_dims[1];
-    hsize_t init_dims[1];
-    hsize_t max_dims[1];
+    hsize_t count = 0;
 
     if (loc_id < 0)
         H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
@@ -149,53 +257,29 @@ h5fnal_create_v_mc_hit_collection(hid_t loc_id, const char *name, h5fnal_vect_hi
     if ((vector->top_level_group_id = H5Gcreate2(loc_id, name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0)
         H5FNAL_HDF5_ERROR;
 
-    /* Create the dataset creation property list */
-    if ((dcpl_id = H5Pcreate(H5P_DATASET_CREATE)) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Set up chunking (size is arbitrary for now) */
-    chunk_dims[0] = 1024;
-    if (H5Pset_chunk(dcpl_id, 1, chunk_dims) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Turn on compession */
-    if (H5Pset_shuffle(dcpl_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Pset_deflate(dcpl_id, 6) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Create the dataspace (set of points describing the data size, etc.) */
-    init_dims[0] = 0;
-    max_dims[0] = H5S_UNLIMITED;
-    if ((sid = H5Screate_simple(1, init_dims, max_dims)) < 0)
-        H5FNAL_HDF5_ERROR;
-
     /* Create datatypes */
-    if ((vector->hit_dtype_id = h5fnal_create_hit_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create hit datatype");
-    if ((vector->hitcoll_dtype_id = h5fnal_create_hitcoll_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create hitcoll datatype");
+    if ((vector->hit_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_HIT)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit datatype");
+    if ((vector->hitcoll_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_HITCOLL)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit collection datatype");
 
-    /* Create datasets */
-    if ((vector->hit_dset_id = H5Dcreate2(vector->top_level_group_id, H5FNAL_HIT_DATASET_NAME, vector->hit_dtype_id, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((vector->hitcoll_dset_id = H5Dcreate2(vector->top_level_group_id, H5FNAL_HITCOLL_DATASET_NAME, vector->hitcoll_dtype_id, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
+    /* Set up the append buffers. The datasets aren't created until
+     * there are elements to write (see h5fnal_layout_t).
+     */
+    vector->hitcoll_dset_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_init_hit_storage(vector, TRUE, options) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up hit storage");
+    if (h5fnal_defer_append_buffer(vector->top_level_group_id, H5FNAL_HITCOLL_DATASET_NAME, vector->hitcoll_dtype_id,
+            options, &vector->hitcoll_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up hit collection append buffer");
 
-    /* close everything */
-    if (H5Pclose(dcpl_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sclose(sid) < 0)
-        H5FNAL_HDF5_ERROR;
+    /* No hit collections yet */
+    if (h5fnal_set_hsize_attribute(vector->top_level_group_id, H5FNAL_COUNT_ATTR_NAME, 1, &count) < 0)
+        H5FNAL_PROGRAM_ERROR("could not add count attribute");
 
     return H5FNAL_SUCCESS;
 
 error:
-    H5E_BEGIN_TRY {
-        H5Sclose(sid);
-        H5Pclose(dcpl_id);
-    } H5E_END_TRY;
-
     if (vector)
         h5fnal_close_vector_on_err(vector);
 
@@ -219,21 +303,30 @@ h5fnal_open_v_mc_hit_collection(hid_t loc_id, const char *name, h5fnal_vect_hitc
     /* Initialize the data product struct */
     memset(vector, 0, sizeof(h5fnal_vect_hitcoll_t));
 
+    /* Make sure the in-tree compression filters are there for reads */
+    if (h5fnal_register_filters() < 0)
+        H5FNAL_PROGRAM_ERROR("could not register compression filters");
+
     /* Open top-level group */
     if ((vector->top_level_group_id = H5Gopen2(loc_id, name, H5P_DEFAULT)) < 0)
         H5FNAL_HDF5_ERROR;
 
     /* Create datatypes */
-    if ((vector->hit_dtype_id = h5fnal_create_hit_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create hit datatype");
-    if ((vector->hitcoll_dtype_id = h5fnal_create_hitcoll_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create hitcoll datatype");
+    if ((vector->hit_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_HIT)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit datatype");
+    if ((vector->hitcoll_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_HITCOLL)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit collection datatype");
 
-    /* Open datasets */
-    if ((vector->hit_dset_id = H5Dopen2(vector->top_level_group_id, H5FNAL_HIT_DATASET_NAME, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((vector->hitcoll_dset_id = H5Dopen2(vector->top_level_group_id, H5FNAL_HITCOLL_DATASET_NAME, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
+    /* Open datasets (empty data products don't have them) and set up
+     * the append buffers
+     */
+    if (h5fnal_init_hit_storage(vector, FALSE, NULL) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up hit storage");
+    if (h5fnal_open_optional_dset(vector->top_level_group_id, H5FNAL_HITCOLL_DATASET_NAME, &vector->hitcoll_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open hit collection dataset");
+    if (h5fnal_open_append_buffer(vector->top_level_group_id, H5FNAL_HITCOLL_DATASET_NAME, vector->hitcoll_dset_id,
+            vector->hitcoll_dtype_id, &vector->hitcoll_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up hit collection append buffer");
 
     return H5FNAL_SUCCESS;
 
@@ -254,14 +347,32 @@ h5fnal_close_v_mc_hit_collection(h5fnal_vect_hitcoll_t *vector)
     if (NULL == vector)
         H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL")
 
-    if (H5Dclose(vector->hit_dset_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Tclose(vector->hit_dtype_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Dclose(vector->hitcoll_dset_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Tclose(vector->hitcoll_dtype_id) < 0)
-        H5FNAL_HDF5_ERROR;
+    /* Keep the element count up to date */
+    if (h5fnal_update_count_attribute(vector->top_level_group_id, &vector->hitcoll_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not update count attribute");
+
+    /* Write out anything still in the append buffers */
+    if (h5fnal_close_append_buffer(&vector->hit_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close hit append buffer");
+    if (h5fnal_close_append_buffer(&vector->hitcoll_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close hit collection append buffer");
+    if (h5fnal_close_column_set(&vector->hit_columns) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close hit columns");
+
+    if (vector->hit_dset_id >= 0)
+        if (H5Dclose(vector->hit_dset_id) < 0)
+            H5FNAL_HDF5_ERROR;
+    vector->hit_dset_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_release_type(vector->hit_dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    vector->hit_dtype_id = H5FNAL_BAD_HID_T;
+    if (vector->hitcoll_dset_id >= 0)
+        if (H5Dclose(vector->hitcoll_dset_id) < 0)
+            H5FNAL_HDF5_ERROR;
+    vector->hitcoll_dset_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_release_type(vector->hitcoll_dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    vector->hitcoll_dtype_id = H5FNAL_BAD_HID_T;
     if (H5Gclose(vector->top_level_group_id) < 0)
         H5FNAL_HDF5_ERROR;
 
@@ -287,7 +398,6 @@ error:
 herr_t
 h5fnal_append_hits(h5fnal_vect_hitcoll_t *vector, h5fnal_vect_hitcoll_data_t *data)
 {
-    hid_t       sid     = H5FNAL_BAD_HID_T;
     hsize_t     offset;
     hsize_t     u;
 
@@ -301,92 +411,540 @@ h5fnal_append_hits(h5fnal_vect_hitcoll_t *vector, h5fnal_vect_hitcoll_data_t *da
      * When appending hits and hit collections to non-empty datasets,
      * the 'start' references in the incoming data will have to be
      * modified so that they refer to the correct elements in the dataset. 
+     * Hits that are still in the append buffer count towards the offset.
      */
-    if ((sid = H5Dget_space(vector->hit_dset_id)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((offset = H5Sget_simple_extent_npoints(sid)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sclose(sid) < 0)
-        H5FNAL_HDF5_ERROR;
+    offset = h5fnal_get_n_hits(vector);
     if (offset > 0)
         for (u = 0; u < data->n_hit_collections; u++)
             if (data->hit_collections[u].count > 0)
                 data->hit_collections[u].start += offset;
 
     /* append data */
-    if (h5fnal_append_data(vector->hit_dset_id, vector->hit_dtype_id, data->n_hits, (const void *)data->hits) < 0)
+    if (H5FNAL_STORAGE_COLUMNS == vector->hit_storage) {
+        if (h5fnal_append_columns(&vector->hit_columns, data->n_hits, (const void *)data->hits) < 0)
+            H5FNAL_PROGRAM_ERROR("could not append hit data");
+    }
+    else if (h5fnal_buffered_append(&vector->hit_buffer, data->n_hits, (const void *)data->hits) < 0)
         H5FNAL_PROGRAM_ERROR("could not append hit data");
-    if (h5fnal_append_data(vector->hitcoll_dset_id, vector->hitcoll_dtype_id, data->n_hit_collections, (const void *)data->hit_collections) < 0)
+    if (h5fnal_buffered_append(&vector->hitcoll_buffer, data->n_hit_collections, (const void *)data->hit_collections) < 0)
         H5FNAL_PROGRAM_ERROR("could not append hit collection data");
 
+    /* Pick up the datasets if the appends created them */
+    if (h5fnal_claim_deferred_dset(&vector->hit_buffer, &vector->hit_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit dataset");
+    if (h5fnal_claim_deferred_dset(&vector->hitcoll_buffer, &vector->hitcoll_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit collection dataset");
+
     return H5FNAL_SUCCESS;
 
 error:
-    H5E_BEGIN_TRY {
-        H5Sclose(sid);
-    } H5E_END_TRY;
-
     return H5FNAL_FAILURE;
 } /* end h5fnal_append_hits() */
 
 
+/************************************************************************
+ * h5fnal_get_hitcoll_sizes()
+ *
+ * Sets the n_hits and n_hit_collections fields of data to the number
+ * of elements stored in the data product. The arrays and capacities
+ * are not touched.
+ ************************************************************************/
+herr_t
+h5fnal_get_hitcoll_sizes(h5fnal_vect_hitcoll_t *vector, h5fnal_vect_hitcoll_data_t *data)
+{
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL")
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL")
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_hits(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush hits");
+    if (h5fnal_sync_append_buffer(&vector->hitcoll_buffer, &vector->hitcoll_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush hit collection append buffer");
+
+    /* The buffers know the dataset sizes, including for datasets
+     * that don't exist
+     */
+    data->n_hits = h5fnal_get_n_hits(vector);
+    data->n_hit_collections = h5fnal_get_buffered_size(&vector->hitcoll_buffer);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_get_hitcoll_sizes() */
+
+
+/************************************************************************
+ * h5fnal_reserve_hitcoll_mem_data()
+ *
+ * Makes sure the arrays in data can hold at least n_hits and
+ * n_hit_collections elements (e.g. as set by h5fnal_get_hitcoll_sizes()).
+ * Arrays that are already large enough are left alone, so the same data
+ * struct can be reused for every event. The arrays must have been
+ * allocated by the library (or be NULL).
+ ************************************************************************/
+herr_t
+h5fnal_reserve_hitcoll_mem_data(h5fnal_vect_hitcoll_data_t *data)
+{
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL")
+
+    if (data->n_hits > data->hits_capacity) {
+        free(data->hits);
+        data->hits_capacity = 0;
+        if (NULL == (data->hits = (h5fnal_hit_t *)calloc(data->n_hits, sizeof(h5fnal_hit_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for hits");
+        data->hits_capacity = data->n_hits;
+    }
+    if (data->n_hit_collections > data->hit_collections_capacity) {
+        free(data->hit_collections);
+        data->hit_collections_capacity = 0;
+        if (NULL == (data->hit_collections = (h5fnal_hitcoll_t *)calloc(data->n_hit_collections, sizeof(h5fnal_hitcoll_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for hit collections");
+        data->hit_collections_capacity = data->n_hit_collections;
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_reserve_hitcoll_mem_data() */
+
+
+/************************************************************************
+ * h5fnal_read_all_hits_into()
+ *
+ * Reads all the hits and hit collections into the arrays in data,
+ * which must be large enough to hold them (see the capacity fields).
+ * Nothing is allocated or freed.
+ *
+ * On return, n_hits and n_hit_collections hold the number of elements
+ * in the data product. If an array is too small, this fails without
+ * reading anything and the caller can use those sizes to grow it.
+ ************************************************************************/
+herr_t
+h5fnal_read_all_hits_into(h5fnal_vect_hitcoll_t *vector, h5fnal_vect_hitcoll_data_t *data)
+{
+    if (h5fnal_get_hitcoll_sizes(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit collection sizes");
+
+    if (data->n_hits > data->hits_capacity || data->n_hit_collections > data->hit_collections_capacity)
+        H5FNAL_PROGRAM_ERROR("hit collection data arrays are too small");
+
+    /* Read the data from the datasets */
+    if (H5FNAL_STORAGE_COLUMNS == vector->hit_storage) {
+        if (h5fnal_read_columns_range(&vector->hit_columns, H5FNAL_ALL_MEMBERS, 0, data->n_hits, data->hits) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read hits");
+    }
+    else if (h5fnal_read_data(vector->hit_dset_id, vector->hit_dtype_id, data->n_hits, data->hits) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hits");
+    if (h5fnal_read_data(vector->hitcoll_dset_id, vector->hitcoll_dtype_id, data->n_hit_collections, data->hit_collections) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collections");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_all_hits_into() */
+
+
 /************************************************************************
  * h5fnal_read_all_hits()
+ *
+ * Allocates arrays for, and reads, all the hits and hit collections.
+ * Free the arrays with h5fnal_free_hitcoll_mem_data().
  ************************************************************************/
 herr_t
 h5fnal_read_all_hits(h5fnal_vect_hitcoll_t *vector, h5fnal_vect_hitcoll_data_t *data)
 {
-    hid_t       sid     = H5FNAL_BAD_HID_T;
-
     if (!data)
         H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL")
 
     /* Initialize the data struct */
     memset(data, 0, sizeof(h5fnal_vect_hitcoll_data_t));
 
-    /* Get the size of the hits dataset */
-    if ((sid = H5Dget_space(vector->hit_dset_id)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((data->n_hits = H5Sget_simple_extent_npoints(sid)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sclose(sid) < 0)
-        H5FNAL_HDF5_ERROR;
+    /* Generate buffers for reading the hits */
+    if (h5fnal_get_hitcoll_sizes(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit collection sizes");
+    if (h5fnal_reserve_hitcoll_mem_data(data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for hit collection data");
 
-    /* Get the size of the hit collections dataset */
-    if ((sid = H5Dget_space(vector->hitcoll_dset_id)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((data->n_hit_collections = H5Sget_simple_extent_npoints(sid)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sclose(sid) < 0)
-        H5FNAL_HDF5_ERROR;
+    if (h5fnal_read_all_hits_into(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collection data");
 
-    /* Generate buffers for reading the hits */
-    if (NULL == (data->hits = (h5fnal_hit_t *)calloc(data->n_hits, sizeof(h5fnal_hit_t))))
-        H5FNAL_PROGRAM_ERROR("could not allocate memory for hits");
-    if (NULL == (data->hit_collections = (h5fnal_hitcoll_t *)calloc(data->n_hit_collections, sizeof(h5fnal_hitcoll_t))))
-        H5FNAL_PROGRAM_ERROR("could not allocate memory for hit collections");
+    return H5FNAL_SUCCESS;
 
-    /* Read the data from the datasets */
-    if (H5Dread(vector->hit_dset_id, vector->hit_dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data->hits) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Dread(vector->hitcoll_dset_id, vector->hitcoll_dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data->hit_collections) < 0)
-        H5FNAL_HDF5_ERROR;
+error:
+    if (data)
+        h5fnal_free_hitcoll_mem_data(data);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_all_hits() */
+
+/************************************************************************
+ * h5fnal_read_hits_range()
+ *
+ * Reads count hits, starting at element start, into buf.
+ ************************************************************************/
+herr_t
+h5fnal_read_hits_range(h5fnal_vect_hitcoll_t *vector, hsize_t start, hsize_t count, h5fnal_hit_t *buf)
+{
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_hits(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush hits");
+
+    if (H5FNAL_STORAGE_COLUMNS == vector->hit_storage) {
+        if (h5fnal_read_columns_range(&vector->hit_columns, H5FNAL_ALL_MEMBERS, start, count, buf) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read hit columns");
+    }
+    else {
+        if (h5fnal_read_data_range(vector->hit_dset_id, vector->hit_dtype_id, start, count, buf) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read hits");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_hits_range() */
+
+/************************************************************************
+ * h5fnal_read_hit_projection_range()
+ *
+ * Reads the fields in the fields mask of count hits, starting at
+ * element start, into buf, an array of compact structs that declare
+ * only those fields, in h5fnal_hit_t order (e.g. struct { float charge; int part_track_id; } for
+ * H5FNAL_HIT_CHARGE | H5FNAL_HIT_PART_TRACK_ID).
+ * Only the selected fields are converted and stored, so buf can be
+ * much smaller than an array of h5fnal_hit_t.
+ ************************************************************************/
+herr_t
+h5fnal_read_hit_projection_range(h5fnal_vect_hitcoll_t *vector, unsigned fields, hsize_t start, hsize_t count,
+        void *buf)
+{
+    hid_t tid = H5FNAL_BAD_HID_T;
+
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+    if (0 == (fields & H5FNAL_HIT_ALL_FIELDS))
+        H5FNAL_PROGRAM_ERROR("no hit fields selected");
+    fields &= H5FNAL_HIT_ALL_FIELDS;
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_hits(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush hits");
+
+    if (H5FNAL_STORAGE_COLUMNS == vector->hit_storage) {
+        if (h5fnal_read_columns_projected(&vector->hit_columns, fields, start, count, buf) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read hit columns");
+    }
+    else {
+        /* HDF5 converts just the members in the projection type */
+        if ((tid = h5fnal_create_projection_type(vector->hit_dtype_id, fields)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create hit projection datatype");
+        if (h5fnal_read_data_range(vector->hit_dset_id, tid, start, count, buf) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read hits");
+        if (H5Tclose(tid) < 0)
+            H5FNAL_HDF5_ERROR;
+        tid = H5FNAL_BAD_HID_T;
+    }
 
     return H5FNAL_SUCCESS;
 
 error:
     H5E_BEGIN_TRY {
-        H5Sclose(sid);
+        H5Tclose(tid);
     } H5E_END_TRY;
 
-    if (data)
-        h5fnal_free_hitcoll_mem_data(data);
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_hit_projection_range() */
 
+/************************************************************************
+ * h5fnal_read_hit_collections_range()
+ *
+ * Reads count hit collections, starting at element start, into buf.
+ ************************************************************************/
+herr_t
+h5fnal_read_hit_collections_range(h5fnal_vect_hitcoll_t *vector, hsize_t start, hsize_t count, h5fnal_hitcoll_t *buf)
+{
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_append_buffer(&vector->hitcoll_buffer, &vector->hitcoll_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush append buffer");
+
+    if (h5fnal_read_data_range(vector->hitcoll_dset_id, vector->hitcoll_dtype_id, start, count, buf) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collections");
+
+    return H5FNAL_SUCCESS;
+
+error:
     return H5FNAL_FAILURE;
-    
-} /* end h5fnal_read_all_hits() */
+} /* end h5fnal_read_hit_collections_range() */
 
 
+/************************************************************************
+ * h5fnal_append_event_hits()
+ *
+ * Flat layout append. Appends one event's hits and hit collections to
+ * a data product that holds every event in the file and adds the rows
+ * they went into to the event index.
+ ************************************************************************/
+herr_t
+h5fnal_append_event_hits(h5fnal_vect_hitcoll_t *vector, h5fnal_event_index_t *index,
+        unsigned run, unsigned subrun, unsigned event, h5fnal_vect_hitcoll_data_t *data)
+{
+    h5fnal_event_entry_t entry;
+
+    if (NULL == vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+    if (NULL == index)
+        H5FNAL_PROGRAM_ERROR("index parameter cannot be NULL");
+    if (NULL == data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    memset(&entry, 0, sizeof(h5fnal_event_entry_t));
+    entry.run = run;
+    entry.subrun = subrun;
+    entry.event = event;
+    entry.start[H5FNAL_HITCOLL_RANGE_HIT_COLLECTIONS] = h5fnal_get_buffered_size(&vector->hitcoll_buffer);
+    entry.count[H5FNAL_HITCOLL_RANGE_HIT_COLLECTIONS] = data->n_hit_collections;
+    entry.start[H5FNAL_HITCOLL_RANGE_HITS] = h5fnal_get_n_hits(vector);
+    entry.count[H5FNAL_HITCOLL_RANGE_HITS] = data->n_hits;
+
+    if (h5fnal_append_hits(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not append hit collection data");
+    if (h5fnal_add_event_entry(index, &entry) < 0)
+        H5FNAL_PROGRAM_ERROR("could not add event index entry");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_append_event_hits() */
+
+
+/************************************************************************
+ * h5fnal_read_event_hits()
+ *
+ * Flat layout read. Reads one event's hits and hit collections (as
+ * found with h5fnal_find_event()) into data, growing its arrays if
+ * needed, so the same data struct can be reused for every event. The
+ * start fields index into the event's hits, as they did when the event
+ * was appended.
+ ************************************************************************/
+herr_t
+h5fnal_read_event_hits(h5fnal_vect_hitcoll_t *vector, const h5fnal_event_entry_t *entry,
+        h5fnal_vect_hitcoll_data_t *data)
+{
+    hsize_t first_hit;
+    hsize_t u;
+
+    if (NULL == vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+    if (NULL == entry)
+        H5FNAL_PROGRAM_ERROR("entry parameter cannot be NULL");
+    if (NULL == data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    data->n_hit_collections = entry->count[H5FNAL_HITCOLL_RANGE_HIT_COLLECTIONS];
+    data->n_hits = entry->count[H5FNAL_HITCOLL_RANGE_HITS];
+    if (h5fnal_reserve_hitcoll_mem_data(data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for hit collection data");
+
+    if (h5fnal_read_hit_collections_range(vector, entry->start[H5FNAL_HITCOLL_RANGE_HIT_COLLECTIONS],
+            data->n_hit_collections, data->hit_collections) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collections");
+    first_hit = entry->start[H5FNAL_HITCOLL_RANGE_HITS];
+    if (h5fnal_read_hits_range(vector, first_hit, data->n_hits, data->hits) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hits");
+
+    for (u = 0; u < data->n_hit_collections; u++)
+        if (data->hit_collections[u].count > 0)
+            data->hit_collections[u].start -= first_hit;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_event_hits() */
+
+
+/************************************************************************
+ * h5fnal_open_hitcoll_cursor()
+ *
+ * Sets up a cursor over the hit collections in a data product. A
+ * max_bytes of zero uses H5FNAL_DEFAULT_CURSOR_BYTES.
+ *
+ * A quarter of the memory bound goes to the hit collections and the
+ * rest to their hits. The hit collections are read in whole chunks.
+ ************************************************************************/
+herr_t
+h5fnal_open_hitcoll_cursor(h5fnal_vect_hitcoll_t *vector, size_t max_bytes, h5fnal_hitcoll_cursor_t *cursor)
+{
+    h5fnal_vect_hitcoll_data_t sizes;
+    hsize_t chunk_dim;
+    hsize_t hc_bytes;
+
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+    if (!cursor)
+        H5FNAL_PROGRAM_ERROR("cursor parameter cannot be NULL");
+
+    memset(cursor, 0, sizeof(h5fnal_hitcoll_cursor_t));
+    memset(&sizes, 0, sizeof(h5fnal_vect_hitcoll_data_t));
+
+    if (0 == max_bytes)
+        max_bytes = H5FNAL_DEFAULT_CURSOR_BYTES;
+
+    if (h5fnal_get_hitcoll_sizes(vector, &sizes) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit collection sizes");
+
+    cursor->vector = vector;
+    cursor->max_bytes = max_bytes;
+    cursor->n_hit_collections = sizes.n_hit_collections;
+
+    /* Whole chunks of hit collections, at least one */
+    chunk_dim = vector->hitcoll_buffer.chunk_dim;
+    cursor->window = ((max_bytes / 4) / sizeof(h5fnal_hitcoll_t) / chunk_dim) * chunk_dim;
+    if (cursor->window < chunk_dim)
+        cursor->window = chunk_dim;
+    hc_bytes = cursor->window * sizeof(h5fnal_hitcoll_t);
+
+    /* The rest of the bound goes to the hits */
+    cursor->max_hits = hc_bytes < max_bytes ? (max_bytes - hc_bytes) / sizeof(h5fnal_hit_t) : 0;
+
+    /* Don't allocate more than the data product holds */
+    cursor->batch.n_hit_collections = H5FNAL_MIN(cursor->window, sizes.n_hit_collections);
+    cursor->batch.n_hits = H5FNAL_MIN(cursor->max_hits, sizes.n_hits);
+    if (h5fnal_reserve_hitcoll_mem_data(&cursor->batch) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for cursor");
+    cursor->batch.n_hit_collections = 0;
+    cursor->batch.n_hits = 0;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (cursor)
+        h5fnal_free_hitcoll_mem_data(&cursor->batch);
+    return H5FNAL_FAILURE;
+} /* end h5fnal_open_hitcoll_cursor() */
+
+
+/************************************************************************
+ * h5fnal_next_hitcoll_batch()
+ *
+ * Reads the next batch of hit collections, along with their hits.
+ * *batch points at the cursor's data, which is overwritten by the next
+ * call. The start fields in the batch index into the batch's hits.
+ *
+ * The hit collections have to be in hit order (each one's hits after
+ * the previous one's), as h5fnal_append_hits() writes them when the
+ * caller's starts are in order. Anything else is an error.
+ *
+ * Returns TRUE if there was a batch and FALSE at the end of the data
+ * product.
+ ************************************************************************/
+htri_t
+h5fnal_next_hitcoll_batch(h5fnal_hitcoll_cursor_t *cursor, h5fnal_vect_hitcoll_data_t **batch)
+{
+    h5fnal_vect_hitcoll_data_t *data = NULL;
+    hsize_t chunk_dim;
+    hsize_t end;
+    hsize_t first_hit = 0;
+    hsize_t end_hit = 0;
+    hbool_t have_hits = FALSE;
+    hsize_t n_taken;
+    hsize_t u;
+
+    if (!cursor)
+        H5FNAL_PROGRAM_ERROR("cursor parameter cannot be NULL");
+    if (!batch)
+        H5FNAL_PROGRAM_ERROR("batch parameter cannot be NULL");
+
+    data = &cursor->batch;
+    data->n_hit_collections = 0;
+    data->n_hits = 0;
+    *batch = data;
+
+    if (cursor->next >= cursor->n_hit_collections)
+        return FALSE;
+
+    /* Read up to the end of a chunk of hit collections */
+    chunk_dim = cursor->vector->hitcoll_buffer.chunk_dim;
+    end = H5FNAL_MIN((cursor->next / chunk_dim) * chunk_dim + cursor->window, cursor->n_hit_collections);
+    if (h5fnal_read_hit_collections_range(cursor->vector, cursor->next, end - cursor->next, data->hit_collections) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collections");
+
+    /* Take hit collections until their hits don't fit. The first one is
+     * always taken, even if it alone is over the bound.
+     */
+    for (n_taken = 0; n_taken < end - cursor->next; n_taken++) {
+        h5fnal_hitcoll_t *hc = &data->hit_collections[n_taken];
+
+        if (0 == hc->count)
+            continue;
+        if (have_hits && hc->start < end_hit)
+            H5FNAL_PROGRAM_ERROR("hit collections are not in hit order");
+        if (have_hits && hc->start + hc->count - first_hit > cursor->max_hits)
+            break;
+        if (!have_hits) {
+            first_hit = hc->start;
+            have_hits = TRUE;
+        }
+        end_hit = hc->start + hc->count;
+    }
+
+    /* Read the hits (growing the buffer for an oversized hit collection) */
+    data->n_hit_collections = n_taken;
+    data->n_hits = end_hit - first_hit;
+    if (h5fnal_reserve_hitcoll_mem_data(data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for hits");
+    if (h5fnal_read_hits_range(cursor->vector, first_hit, data->n_hits, data->hits) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hits");
+
+    /* Make the hit collections index into this batch's hits */
+    for (u = 0; u < n_taken; u++)
+        if (data->hit_collections[u].count > 0)
+            data->hit_collections[u].start -= first_hit;
+
+    cursor->next += n_taken;
+
+    return TRUE;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_next_hitcoll_batch() */
+
+
+/************************************************************************
+ * h5fnal_close_hitcoll_cursor()
+ *
+ * Frees the cursor's memory. The data product is not closed.
+ ************************************************************************/
+herr_t
+h5fnal_close_hitcoll_cursor(h5fnal_hitcoll_cursor_t *cursor)
+{
+    if (!cursor)
+        H5FNAL_PROGRAM_ERROR("cursor parameter cannot be NULL");
+
+    if (h5fnal_free_hitcoll_mem_data(&cursor->batch) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free cursor memory");
+
+    memset(cursor, 0, sizeof(h5fnal_hitcoll_cursor_t));
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_close_hitcoll_cursor() */
+
 /************************************************************************
  * h5fnal_free_hitcoll_mem_data()
  *
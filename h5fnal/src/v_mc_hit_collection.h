@@ -25,6 +25,22 @@ typedef struct h5fnal_hit_t {
     int         part_track_id;
 } h5fnal_hit_t;
 
+/* Hit fields, for reading only some of them (see
+ * h5fnal_read_hit_projection_range()).
+ * Bit i is member i of the hit datatype. The channel is a field of the
+ * hit collection, not the hit.
+ */
+#define H5FNAL_HIT_SIGNAL_TIME      0x001U
+#define H5FNAL_HIT_SIGNAL_WIDTH     0x002U
+#define H5FNAL_HIT_PEAK_AMP         0x004U
+#define H5FNAL_HIT_CHARGE           0x008U
+#define H5FNAL_HIT_PART_VERTEX_X    0x010U
+#define H5FNAL_HIT_PART_VERTEX_Y    0x020U
+#define H5FNAL_HIT_PART_VERTEX_Z    0x040U
+#define H5FNAL_HIT_PART_ENERGY      0x080U
+#define H5FNAL_HIT_PART_TRACK_ID    0x100U
+#define H5FNAL_HIT_ALL_FIELDS       0x1FFU
+
 
 /* MC Hit Collection type
  *
@@ -49,19 +65,30 @@ typedef struct h5fnal_hitcoll_t {
  * Used to hold data when performing dataset I/O. Data packing
  * and unpacking to the vector<MCHitCollection> must be done
  * by the caller (presumably in a higher-level C++ library).
+ *
+ * The capacities are the number of elements the arrays can hold.
+ * h5fnal_read_all_hits_into() reads into the arrays without
+ * allocating them, so one set of arrays can be reused for every
+ * event in a file.
  */
 typedef struct h5fnal_vect_hitcoll_data_t {
     h5fnal_hit_t        *hits;
     hsize_t             n_hits;
     h5fnal_hitcoll_t    *hit_collections;
     hsize_t             n_hit_collections;
+    hsize_t             hits_capacity;
+    hsize_t             hit_collections_capacity;
 } h5fnal_vect_hitcoll_data_t;
 
 
 /* Vector of MC Hit Collection  HDF5 data and related
  *
  * Contains HDF5 IDs for file objects that are a part of this
- * data product.
+ * data product, along with the write-behind buffers used when
+ * appending to the datasets.
+ *
+ * With column storage the hits are kept in hit_columns instead of
+ * the hit dataset, which is never created, and hit_buffer is unused.
  */
 typedef struct h5fnal_vect_hitcoll_t {
     hid_t       top_level_group_id;
@@ -69,9 +96,35 @@ typedef struct h5fnal_vect_hitcoll_t {
     hid_t       hit_dtype_id;
     hid_t       hitcoll_dset_id;
     hid_t       hitcoll_dtype_id;
+    h5fnal_append_buffer_t  hit_buffer;
+    h5fnal_append_buffer_t  hitcoll_buffer;
+    h5fnal_storage_t        hit_storage;
+    h5fnal_column_set_t     hit_columns;
 } h5fnal_vect_hitcoll_t;
 
 
+/* Cursor over a Vector of MC Hit Collection
+ *
+ * Hands out the hit collections in consecutive batches, each with the
+ * hits it refers to, so a data product of any size can be processed
+ * in bounded memory (see h5fnal_open_hitcoll_cursor()).
+ */
+typedef struct h5fnal_hitcoll_cursor_t {
+    h5fnal_vect_hitcoll_t      *vector;
+    size_t                      max_bytes;          /* memory bound for a batch             */
+    hsize_t                     max_hits;           /* hits that fit in the bound           */
+    hsize_t                     window;             /* hit collections read at a time       */
+    hsize_t                     n_hit_collections;  /* in the data product                  */
+    hsize_t                     next;               /* next hit collection to hand out      */
+    h5fnal_vect_hitcoll_data_t  batch;
+} h5fnal_hitcoll_cursor_t;
+
+
+/* Event index slots for the datasets in this data product (flat layout) */
+#define H5FNAL_HITCOLL_RANGE_HIT_COLLECTIONS    0
+#define H5FNAL_HITCOLL_RANGE_HITS               1
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -79,13 +132,30 @@ extern "C" {
 hid_t h5fnal_create_hit_type(void);
 hid_t h5fnal_create_hitcoll_type(void);
 
-herr_t h5fnal_create_v_mc_hit_collection(hid_t loc_id, const char *name, h5fnal_vect_hitcoll_t *vector);
+herr_t h5fnal_create_v_mc_hit_collection(hid_t loc_id, const char *name, const h5fnal_create_options_t *options,
+        h5fnal_vect_hitcoll_t *vector);
 herr_t h5fnal_open_v_mc_hit_collection(hid_t loc_id, const char *name, h5fnal_vect_hitcoll_t *vector);
 herr_t h5fnal_close_v_mc_hit_collection(h5fnal_vect_hitcoll_t *vector);
 
 herr_t h5fnal_append_hits(h5fnal_vect_hitcoll_t *vector, h5fnal_vect_hitcoll_data_t *data);
 herr_t h5fnal_read_all_hits(h5fnal_vect_hitcoll_t *vector, h5fnal_vect_hitcoll_data_t *data);
-
+herr_t h5fnal_read_all_hits_into(h5fnal_vect_hitcoll_t *vector, h5fnal_vect_hitcoll_data_t *data);
+herr_t h5fnal_get_hitcoll_sizes(h5fnal_vect_hitcoll_t *vector, h5fnal_vect_hitcoll_data_t *data);
+herr_t h5fnal_read_hits_range(h5fnal_vect_hitcoll_t *vector, hsize_t start, hsize_t count, h5fnal_hit_t *buf);
+herr_t h5fnal_read_hit_projection_range(h5fnal_vect_hitcoll_t *vector, unsigned fields, hsize_t start, hsize_t count,
+        void *buf);
+herr_t h5fnal_read_hit_collections_range(h5fnal_vect_hitcoll_t *vector, hsize_t start, hsize_t count, h5fnal_hitcoll_t *buf);
+
+herr_t h5fnal_append_event_hits(h5fnal_vect_hitcoll_t *vector, h5fnal_event_index_t *index,
+        unsigned run, unsigned subrun, unsigned event, h5fnal_vect_hitcoll_data_t *data);
+herr_t h5fnal_read_event_hits(h5fnal_vect_hitcoll_t *vector, const h5fnal_event_entry_t *entry,
+        h5fnal_vect_hitcoll_data_t *data);
+
+herr_t h5fnal_open_hitcoll_cursor(h5fnal_vect_hitcoll_t *vector, size_t max_bytes, h5fnal_hitcoll_cursor_t *cursor);
+htri_t h5fnal_next_hitcoll_batch(h5fnal_hitcoll_cursor_t *cursor, h5fnal_vect_hitcoll_data_t **batch);
+herr_t h5fnal_close_hitcoll_cursor(h5fnal_hitcoll_cursor_t *cursor);
+
+herr_t h5fnal_reserve_hitcoll_mem_data(h5fnal_vect_hitcoll_data_t *data);
 herr_t h5fnal_free_hitcoll_mem_data(h5fnal_vect_hitcoll_data_t *data);
 
 #ifdef __cplusplus
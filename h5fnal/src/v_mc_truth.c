@@ -16,6 +16,28 @@
 #define H5FNAL_TRUTH_DAUGHTER_DATASET_NAME      "daughters"
 #define H5FNAL_TRUTH_TRAJECTORY_DATASET_NAME    "trajectories"
 
+/* Attributes on the trajectory dataset that record a delta encoding
+ * (see h5fnal_encoding_t) and the number of points in its blocks
+ */
+#define H5FNAL_TRUTH_ENCODING_ATTR_NAME         "encoding"
+#define H5FNAL_TRUTH_ENCODING_BLOCK_ATTR_NAME   "encoding block"
+
+/* Names of the trajectory encodings in the encoding attribute, in
+ * h5fnal_encoding_t order
+ */
+static const char *const h5fnal_encoding_names_g[] = {"plain", "delta", "delta_float32"};
+
+/* Names of the positions, times and momenta in trajectory points */
+static const char *const h5fnal_trajectory_value_names_g[H5FNAL_TRAJECTORY_N_VALUES] = {
+    "Vx", "Vy", "Vz", "T", "Px", "Py", "Pz", "E"
+};
+
+/* A delta coded trajectory point (see h5fnal_append_trajectories()) */
+typedef struct h5fnal_trajectory_code_t {
+    uint64_t    values[H5FNAL_TRAJECTORY_N_VALUES];
+    hsize_t     particle_index;
+} h5fnal_trajectory_code_t;
+
 /* Prototypes */
 
 hid_t
@@ -208,6 +230,72 @@ error:
     return H5FNAL_BAD_HID_T;
 } /* h5fnal_create_trajectory_type */
 
+/************************************************************************
+ * h5fnal_create_trajectory_delta_type()
+ *
+ * Memory (and delta encoding file) datatype for delta coded trajectory
+ * points: the coded positions, times and momenta as 64-bit unsigned
+ * integers, with the same names as in h5fnal_trajectory_t.
+ ************************************************************************/
+hid_t
+h5fnal_create_trajectory_delta_type(void)
+{
+    hid_t tid = H5FNAL_BAD_HID_T;
+    unsigned u;
+
+    if ((tid = H5Tcreate(H5T_COMPOUND, sizeof(h5fnal_trajectory_code_t))) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    for (u = 0; u < H5FNAL_TRAJECTORY_N_VALUES; u++)
+        if (H5Tinsert(tid, h5fnal_trajectory_value_names_g[u],
+                HOFFSET(h5fnal_trajectory_code_t, values) + u * sizeof(uint64_t), H5T_NATIVE_UINT64) < 0)
+            H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "particle_index", HOFFSET(h5fnal_trajectory_code_t, particle_index), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return tid;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Tclose(tid);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_create_trajectory_delta_type() */
+
+/************************************************************************
+ * h5fnal_create_trajectory_delta_float32_type()
+ *
+ * File datatype for the delta_float32 encoding: the coded positions,
+ * times and momenta (rounded to floats first) as 32-bit unsigned
+ * integers, packed. HDF5 converts it to and from the delta coded
+ * memory datatype.
+ ************************************************************************/
+hid_t
+h5fnal_create_trajectory_delta_float32_type(void)
+{
+    hid_t tid = H5FNAL_BAD_HID_T;
+    unsigned u;
+
+    if ((tid = H5Tcreate(H5T_COMPOUND, H5FNAL_TRAJECTORY_N_VALUES * sizeof(uint32_t) + sizeof(hsize_t))) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    for (u = 0; u < H5FNAL_TRAJECTORY_N_VALUES; u++)
+        if (H5Tinsert(tid, h5fnal_trajectory_value_names_g[u], u * sizeof(uint32_t), H5T_NATIVE_UINT32) < 0)
+            H5FNAL_HDF5_ERROR;
+    if (H5Tinsert(tid, "particle_index", H5FNAL_TRAJECTORY_N_VALUES * sizeof(uint32_t), H5T_NATIVE_HSIZE) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return tid;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Tclose(tid);
+    } H5E_END_TRY;
+
+    return H5FNAL_BAD_HID_T;
+} /* end h5fnal_create_trajectory_delta_float32_type() */
+
 hid_t
 h5fnal_create_truth_type(void)
 {
@@ -247,26 +335,36 @@ h5fnal_close_vector_on_err(h5fnal_vect_truth_t *vector)
 {
     if (vector) {
         H5E_BEGIN_TRY {
-            H5Tclose(vector->origin_dtype_id);
+            h5fnal_release_type(vector->origin_dtype_id);
 
             H5Dclose(vector->neutrino_dset_id);
-            H5Tclose(vector->neutrino_dtype_id);
+            h5fnal_release_type(vector->neutrino_dtype_id);
 
             H5Dclose(vector->particle_dset_id);
-            H5Tclose(vector->particle_dtype_id);
+            h5fnal_release_type(vector->particle_dtype_id);
 
             H5Dclose(vector->daughter_dset_id);
-            H5Tclose(vector->daughter_dtype_id);
+            h5fnal_release_type(vector->daughter_dtype_id);
 
             H5Dclose(vector->trajectory_dset_id);
-            H5Tclose(vector->trajectory_dtype_id);
+            h5fnal_release_type(vector->trajectory_dtype_id);
+            h5fnal_release_type(vector->trajectory_code_dtype_id);
+            h5fnal_release_type(vector->trajectory_file_dtype_id);
 
             H5Dclose(vector->truth_dset_id);
-            H5Tclose(vector->truth_dtype_id);
+            h5fnal_release_type(vector->truth_dtype_id);
 
             H5Gclose(vector->top_level_group_id);
         } H5E_END_TRY;
 
+        h5fnal_free_append_buffer(&vector->neutrino_buffer);
+        h5fnal_free_append_buffer(&vector->particle_buffer);
+        h5fnal_free_append_buffer(&vector->daughter_buffer);
+        h5fnal_free_append_buffer(&vector->trajectory_buffer);
+        h5fnal_free_append_buffer(&vector->truth_buffer);
+        h5fnal_free_column_set(&vector->particle_columns);
+        h5fnal_free_graph_store(&vector->particle_graph);
+
         vector->origin_dtype_id     = H5FNAL_BAD_HID_T;
 
         vector->neutrino_dset_id    = H5FNAL_BAD_HID_T;
@@ -280,6 +378,8 @@ h5fnal_close_vector_on_err(h5fnal_vect_truth_t *vector)
 
         vector->trajectory_dset_id  = H5FNAL_BAD_HID_T;
         vector->trajectory_dtype_id = H5FNAL_BAD_HID_T;
+        vector->trajectory_code_dtype_id = H5FNAL_BAD_HID_T;
+        vector->trajectory_file_dtype_id = H5FNAL_BAD_HID_T;
 
         vector->truth_dset_id       = H5FNAL_BAD_HID_T;
         vector->truth_dtype_id      = H5FNAL_BAD_HID_T;
@@ -290,14 +390,296 @@ h5fnal_close_vector_on_err(h5fnal_vect_truth_t *vector)
     return;
 } /* end h5fnal_close_vector_on_err() */
 
+/************************************************************************
+ * h5fnal_set_trajectory_encoding()
+ *
+ * Picks the trajectory encoding for a new data product from the
+ * creation options (see h5fnal_encoding_t) and gets the datatypes it
+ * needs. The append buffers aren't set up yet.
+ ************************************************************************/
+static herr_t
+h5fnal_set_trajectory_encoding(h5fnal_vect_truth_t *vector, const h5fnal_create_options_t *options)
+{
+    vector->trajectory_encoding = options ? options->trajectory_encoding : H5FNAL_DEFAULT_TRAJECTORY_ENCODING;
+    vector->trajectory_have_last = FALSE;
+
+    switch (vector->trajectory_encoding) {
+        case H5FNAL_ENCODING_PLAIN:
+            return H5FNAL_SUCCESS;
+        case H5FNAL_ENCODING_DELTA_FLOAT32:
+            if ((vector->trajectory_file_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_TRAJECTORY_DELTA_FLOAT32)) < 0)
+                H5FNAL_PROGRAM_ERROR("could not get float32 trajectory datatype");
+            /* fall through */
+        case H5FNAL_ENCODING_DELTA:
+            if ((vector->trajectory_code_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_TRAJECTORY_DELTA)) < 0)
+                H5FNAL_PROGRAM_ERROR("could not get delta trajectory datatype");
+            break;
+        default:
+            H5FNAL_PROGRAM_ERROR("unknown trajectory encoding");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_set_trajectory_encoding() */
+
+/************************************************************************
+ * h5fnal_get_trajectory_encoding()
+ *
+ * Finds out how the trajectory points of a re-opened data product are
+ * encoded from the attributes on the trajectory dataset (see
+ * h5fnal_mark_trajectory_encoding()) and gets the datatypes the
+ * encoding needs. Datasets without them are plain.
+ ************************************************************************/
+static herr_t
+h5fnal_get_trajectory_encoding(h5fnal_vect_truth_t *vector)
+{
+    char *name = NULL;
+    htri_t exists;
+    int i;
+
+    vector->trajectory_encoding = H5FNAL_ENCODING_PLAIN;
+    vector->trajectory_have_last = FALSE;
+
+    if (vector->trajectory_dset_id < 0)
+        return H5FNAL_SUCCESS;
+    if ((exists = H5Aexists(vector->trajectory_dset_id, H5FNAL_TRUTH_ENCODING_ATTR_NAME)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (!exists)
+        return H5FNAL_SUCCESS;
+
+    if (h5fnal_get_string_attribute(vector->trajectory_dset_id, H5FNAL_TRUTH_ENCODING_ATTR_NAME, &name) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read trajectory encoding attribute");
+    for (i = (int)H5FNAL_ENCODING_DELTA; i <= (int)H5FNAL_ENCODING_DELTA_FLOAT32; i++)
+        if (0 == strcmp(name, h5fnal_encoding_names_g[i]))
+            break;
+    if (i > (int)H5FNAL_ENCODING_DELTA_FLOAT32)
+        H5FNAL_PROGRAM_ERROR("unknown trajectory encoding");
+    free(name);
+    name = NULL;
+    vector->trajectory_encoding = (h5fnal_encoding_t)i;
+
+    if (h5fnal_get_hsize_attribute(vector->trajectory_dset_id, H5FNAL_TRUTH_ENCODING_BLOCK_ATTR_NAME, 1,
+            &vector->trajectory_block) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read trajectory encoding block attribute");
+    if (0 == vector->trajectory_block)
+        H5FNAL_PROGRAM_ERROR("trajectory encoding block size cannot be zero");
+
+    /* HDF5 converts the float32 file datatype on its own */
+    if ((vector->trajectory_code_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_TRAJECTORY_DELTA)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get delta trajectory datatype");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    free(name);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_get_trajectory_encoding() */
+
+/************************************************************************
+ * h5fnal_mark_trajectory_encoding()
+ *
+ * Records a delta encoding, and the number of points in its blocks, in
+ * attributes on the trajectory dataset unless they are already there.
+ * This is done when the data product is closed, since the dataset may
+ * not be created before then. Plain trajectories aren't marked.
+ ************************************************************************/
+static herr_t
+h5fnal_mark_trajectory_encoding(h5fnal_vect_truth_t *vector)
+{
+    hid_t did = H5FNAL_BAD_HID_T;
+    htri_t exists;
+
+    if (H5FNAL_ENCODING_PLAIN == vector->trajectory_encoding)
+        return H5FNAL_SUCCESS;
+
+    if ((exists = H5Lexists(vector->top_level_group_id, H5FNAL_TRUTH_TRAJECTORY_DATASET_NAME, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (!exists)
+        return H5FNAL_SUCCESS;
+
+    if ((did = H5Dopen2(vector->top_level_group_id, H5FNAL_TRUTH_TRAJECTORY_DATASET_NAME, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((exists = H5Aexists(did, H5FNAL_TRUTH_ENCODING_ATTR_NAME)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (!exists) {
+        if (h5fnal_add_string_attribute(did, H5FNAL_TRUTH_ENCODING_ATTR_NAME,
+                h5fnal_encoding_names_g[vector->trajectory_encoding]) < 0)
+            H5FNAL_PROGRAM_ERROR("could not add trajectory encoding attribute");
+        if (h5fnal_add_hsize_attribute(did, H5FNAL_TRUTH_ENCODING_BLOCK_ATTR_NAME, 1, &vector->trajectory_block) < 0)
+            H5FNAL_PROGRAM_ERROR("could not add trajectory encoding block attribute");
+    }
+    if (H5Dclose(did) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Dclose(did);
+    } H5E_END_TRY;
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_mark_trajectory_encoding() */
+
+/************************************************************************
+ * h5fnal_init_truth_buffers()
+ *
+ * Sets up the write-behind append buffers, and the particle column set
+ * with column storage. For a new data product (create is TRUE) none of
+ * the datasets exist yet and each one is created when there are
+ * elements to write. Otherwise the datasets that exist have been
+ * opened.
+ ************************************************************************/
+static herr_t
+h5fnal_init_truth_buffers(h5fnal_vect_truth_t *vector, hbool_t create, const h5fnal_create_options_t *options)
+{
+    struct {
+        const char             *name;
+        hid_t                   did;
+        hid_t                   tid;
+        h5fnal_append_buffer_t *buffer;
+    } dsets[5];
+    int i;
+
+    dsets[0].name = H5FNAL_TRUTH_NEUTRINO_DATASET_NAME;
+    dsets[0].did = vector->neutrino_dset_id;
+    dsets[0].tid = vector->neutrino_dtype_id;
+    dsets[0].buffer = &vector->neutrino_buffer;
+    dsets[1].name = H5FNAL_TRUTH_PARTICLE_DATASET_NAME;
+    dsets[1].did = vector->particle_dset_id;
+    dsets[1].tid = vector->particle_dtype_id;
+    dsets[1].buffer = &vector->particle_buffer;
+    dsets[2].name = H5FNAL_TRUTH_DAUGHTER_DATASET_NAME;
+    dsets[2].did = vector->daughter_dset_id;
+    dsets[2].tid = vector->daughter_dtype_id;
+    dsets[2].buffer = &vector->daughter_buffer;
+    dsets[3].name = H5FNAL_TRUTH_TRAJECTORY_DATASET_NAME;
+    dsets[3].did = vector->trajectory_dset_id;
+    dsets[3].tid = vector->trajectory_code_dtype_id >= 0 ? vector->trajectory_code_dtype_id : vector->trajectory_dtype_id;
+    dsets[3].buffer = &vector->trajectory_buffer;
+    dsets[4].name = H5FNAL_TRUTH_TRUTH_DATASET_NAME;
+    dsets[4].did = vector->truth_dset_id;
+    dsets[4].tid = vector->truth_dtype_id;
+    dsets[4].buffer = &vector->truth_buffer;
+
+    /* Particles stored as columns go through their column set */
+    if (H5FNAL_STORAGE_COLUMNS == vector->particle_storage) {
+        vector->particle_buffer.did = H5FNAL_BAD_HID_T;
+        vector->particle_buffer.tid = H5FNAL_BAD_HID_T;
+
+        if (create) {
+            if (h5fnal_create_column_set(vector->top_level_group_id, H5FNAL_TRUTH_PARTICLE_DATASET_NAME,
+                    vector->particle_dtype_id, options, &vector->particle_columns) < 0)
+                H5FNAL_PROGRAM_ERROR("could not create particle columns");
+        }
+        else {
+            if (h5fnal_open_column_set(vector->top_level_group_id, H5FNAL_TRUTH_PARTICLE_DATASET_NAME,
+                    vector->particle_dtype_id, &vector->particle_columns) < 0)
+                H5FNAL_PROGRAM_ERROR("could not open particle columns");
+        }
+    }
+
+    for (i = 0; i < 5; i++) {
+        if (dsets[i].buffer == &vector->particle_buffer && H5FNAL_STORAGE_COLUMNS == vector->particle_storage)
+            continue;
+
+        if (create) {
+            if (h5fnal_defer_append_buffer(vector->top_level_group_id, dsets[i].name, dsets[i].tid,
+                    options, dsets[i].buffer) < 0)
+                H5FNAL_PROGRAM_ERROR("could not set up append buffer");
+        }
+        else {
+            if (h5fnal_open_append_buffer(vector->top_level_group_id, dsets[i].name, dsets[i].did,
+                    dsets[i].tid, dsets[i].buffer) < 0)
+                H5FNAL_PROGRAM_ERROR("could not set up append buffer");
+        }
+    }
+
+    /* Delta coding restarts at every chunk, so a range read only has
+     * to decode the chunks it reads anyway
+     */
+    if (create && H5FNAL_ENCODING_PLAIN != vector->trajectory_encoding) {
+        if (vector->trajectory_file_dtype_id >= 0)
+            if (h5fnal_set_deferred_file_type(&vector->trajectory_buffer, vector->trajectory_file_dtype_id) < 0)
+                H5FNAL_PROGRAM_ERROR("could not set trajectory file datatype");
+        vector->trajectory_block = vector->trajectory_buffer.chunk_dim;
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_init_truth_buffers() */
+
+/************************************************************************
+ * h5fnal_get_n_particles()
+ *
+ * Returns the number of particles in the data product, including
+ * particles that are still in the append buffers.
+ ************************************************************************/
+static hsize_t
+h5fnal_get_n_particles(const h5fnal_vect_truth_t *vector)
+{
+    if (H5FNAL_STORAGE_COLUMNS == vector->particle_storage)
+        return h5fnal_get_column_set_size(&vector->particle_columns);
+
+    return h5fnal_get_buffered_size(&vector->particle_buffer);
+} /* end h5fnal_get_n_particles() */
+
+/************************************************************************
+ * h5fnal_sync_particles()
+ *
+ * Makes sure any appended particles are in the file.
+ ************************************************************************/
+static herr_t
+h5fnal_sync_particles(h5fnal_vect_truth_t *vector)
+{
+    if (H5FNAL_STORAGE_COLUMNS == vector->particle_storage) {
+        if (h5fnal_sync_column_set(&vector->particle_columns) < 0)
+            H5FNAL_PROGRAM_ERROR("could not flush particle columns");
+    }
+    else if (h5fnal_sync_append_buffer(&vector->particle_buffer, &vector->particle_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush particle append buffer");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_sync_particles() */
+
+/************************************************************************
+ * h5fnal_flush_truth_buffers()
+ *
+ * Writes anything still in the append buffers to the datasets.
+ ************************************************************************/
+static herr_t
+h5fnal_flush_truth_buffers(h5fnal_vect_truth_t *vector)
+{
+    if (h5fnal_sync_append_buffer(&vector->neutrino_buffer, &vector->neutrino_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush neutrino append buffer");
+    if (h5fnal_sync_particles(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush particles");
+    if (h5fnal_sync_append_buffer(&vector->daughter_buffer, &vector->daughter_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush daughter append buffer");
+    if (h5fnal_sync_append_buffer(&vector->trajectory_buffer, &vector->trajectory_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush trajectory append buffer");
+    if (h5fnal_sync_append_buffer(&vector->truth_buffer, &vector->truth_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush truth append buffer");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_flush_truth_buffers() */
+
 herr_t
-h5fnal_create_v_mc_truth(hid_t loc_id, const char *name, h5fnal_vect_truth_t *vector)
+h5fnal_create_v_mc_truth(hid_t loc_id, const char *name, const h5fnal_create_options_t *options,
+        h5fnal_vect_truth_t *vector)
 {
-    hid_t dcpl_id = -1;
-    hid_t sid = -1;
-    hsize_t chunk_dims[1];
-    hsize_t init_dims[1];
-    hsize_t max_dims[1];
+    hsize_t count = 0;
 
     if (loc_id < 0)
         H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
@@ -314,69 +696,57 @@ h5fnal_create_v_mc_truth(hid_t loc_id, const char *name, h5fnal_vect_truth_t *ve
         H5FNAL_HDF5_ERROR
 
     /* Create the datatypes */
-    if ((vector->origin_dtype_id = h5fnal_create_origin_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-    if ((vector->neutrino_dtype_id = h5fnal_create_neutrino_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-    if ((vector->particle_dtype_id = h5fnal_create_particle_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-    if ((vector->daughter_dtype_id = h5fnal_create_daughter_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-    if ((vector->trajectory_dtype_id = h5fnal_create_trajectory_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-    if ((vector->truth_dtype_id = h5fnal_create_truth_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-
-    /* Set up chunking (for all datasets, size is arbitrary for now) */
-    chunk_dims[0] = 1024;
-    if ((dcpl_id = H5Pcreate(H5P_DATASET_CREATE)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Pset_chunk(dcpl_id, 1, chunk_dims) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Turn on compession */
-    if (H5Pset_shuffle(dcpl_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Pset_deflate(dcpl_id, 6) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Create the dataspace (set of points describing the data size, etc.) */
-    init_dims[0] = 0;
-    max_dims[0] = H5S_UNLIMITED;
-    if ((sid = H5Screate_simple(1, init_dims, max_dims)) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* Create the datasets */
-    if ((vector->truth_dset_id = H5Dcreate2(vector->top_level_group_id, H5FNAL_TRUTH_TRUTH_DATASET_NAME,
-            vector->truth_dtype_id, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((vector->neutrino_dset_id = H5Dcreate2(vector->top_level_group_id, H5FNAL_TRUTH_NEUTRINO_DATASET_NAME,
-            vector->neutrino_dtype_id, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((vector->particle_dset_id = H5Dcreate2(vector->top_level_group_id, H5FNAL_TRUTH_PARTICLE_DATASET_NAME,
-            vector->particle_dtype_id, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((vector->daughter_dset_id = H5Dcreate2(vector->top_level_group_id, H5FNAL_TRUTH_DAUGHTER_DATASET_NAME,
-            vector->daughter_dtype_id, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((vector->trajectory_dset_id = H5Dcreate2(vector->top_level_group_id, H5FNAL_TRUTH_TRAJECTORY_DATASET_NAME,
-            vector->trajectory_dtype_id, sid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-
-    /* close everything */
-    if (H5Pclose(dcpl_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Sclose(sid) < 0)
-        H5FNAL_HDF5_ERROR;
+    if ((vector->origin_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_ORIGIN)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get origin datatype");
+    if ((vector->neutrino_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_NEUTRINO)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get neutrino datatype");
+    if ((vector->particle_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_PARTICLE)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get particle datatype");
+    if ((vector->daughter_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_DAUGHTER)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get daughter datatype");
+    if ((vector->trajectory_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_TRAJECTORY)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get trajectory datatype");
+    if ((vector->truth_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_TRUTH)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get truth datatype");
+
+    /* Set up the append buffers. The datasets aren't created until
+     * there are elements to write, so the often empty neutrino and
+     * daughter datasets usually don't exist at all.
+     */
+    vector->truth_dset_id = H5FNAL_BAD_HID_T;
+    vector->neutrino_dset_id = H5FNAL_BAD_HID_T;
+    vector->particle_dset_id = H5FNAL_BAD_HID_T;
+    vector->daughter_dset_id = H5FNAL_BAD_HID_T;
+    vector->trajectory_dset_id = H5FNAL_BAD_HID_T;
+    vector->trajectory_code_dtype_id = H5FNAL_BAD_HID_T;
+    vector->trajectory_file_dtype_id = H5FNAL_BAD_HID_T;
+    vector->particle_columns.gid = H5FNAL_BAD_HID_T;
+    vector->particle_storage = options ? options->storage : H5FNAL_DEFAULT_STORAGE;
+    if (h5fnal_set_trajectory_encoding(vector, options) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up trajectory encoding");
+    if (h5fnal_init_truth_buffers(vector, TRUE, options) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up append buffers");
+    if (h5fnal_create_graph_store(vector->top_level_group_id, options, &vector->particle_graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up particle graph");
+
+    /* No truths yet */
+    if (h5fnal_set_hsize_attribute(vector->top_level_group_id, H5FNAL_COUNT_ATTR_NAME, 1, &count) < 0)
+        H5FNAL_PROGRAM_ERROR("could not add count attribute");
+
+    /* Compress the large datasets in parallel if asked to (column sets
+     * take care of this themselves)
+     */
+    if (options && options->parallel_compression) {
+        if (H5FNAL_STORAGE_ROWS == vector->particle_storage)
+            if (h5fnal_use_compression_pool(&vector->particle_buffer) < 0)
+                H5FNAL_PROGRAM_ERROR("could not set up parallel compression");
+        if (h5fnal_use_compression_pool(&vector->trajectory_buffer) < 0)
+            H5FNAL_PROGRAM_ERROR("could not set up parallel compression");
+    }
 
     return H5FNAL_SUCCESS;
 
 error:
-    H5E_BEGIN_TRY {
-        H5Sclose(sid);
-        H5Pclose(dcpl_id);
-    } H5E_END_TRY;
-
     if (vector)
         h5fnal_close_vector_on_err(vector);
 
@@ -386,6 +756,7 @@ error:
 herr_t
 h5fnal_open_v_mc_truth(hid_t loc_id, const char *name, h5fnal_vect_truth_t *vector)
 {
+    htri_t is_columns;
 
     if (loc_id < 0)
         H5FNAL_PROGRAM_ERROR("invalid loc_id parameter");
@@ -397,35 +768,61 @@ h5fnal_open_v_mc_truth(hid_t loc_id, const char *name, h5fnal_vect_truth_t *vect
     /* Initialize the data product struct */
     memset(vector, 0, sizeof(h5fnal_vect_truth_t));
 
+    /* Make sure the in-tree compression filters are there for reads */
+    if (h5fnal_register_filters() < 0)
+        H5FNAL_PROGRAM_ERROR("could not register compression filters");
+
     /* Open top-level group */
     if ((vector->top_level_group_id = H5Gopen2(loc_id, name, H5P_DEFAULT)) < 0)
         H5FNAL_HDF5_ERROR;
 
     /* Create the datatypes */
-    if ((vector->origin_dtype_id = h5fnal_create_origin_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-    if ((vector->neutrino_dtype_id = h5fnal_create_neutrino_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-    if ((vector->particle_dtype_id = h5fnal_create_particle_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-    if ((vector->daughter_dtype_id = h5fnal_create_daughter_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-    if ((vector->trajectory_dtype_id = h5fnal_create_trajectory_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-    if ((vector->truth_dtype_id = h5fnal_create_truth_type()) < 0)
-        H5FNAL_PROGRAM_ERROR("could not create datatype");
-
-    /* Open the datasets */
-    if ((vector->truth_dset_id = H5Dopen2(vector->top_level_group_id, H5FNAL_TRUTH_TRUTH_DATASET_NAME, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((vector->neutrino_dset_id = H5Dopen2(vector->top_level_group_id, H5FNAL_TRUTH_NEUTRINO_DATASET_NAME, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((vector->particle_dset_id = H5Dopen2(vector->top_level_group_id, H5FNAL_TRUTH_PARTICLE_DATASET_NAME, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((vector->daughter_dset_id = H5Dopen2(vector->top_level_group_id, H5FNAL_TRUTH_DAUGHTER_DATASET_NAME, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
-    if ((vector->trajectory_dset_id = H5Dopen2(vector->top_level_group_id, H5FNAL_TRUTH_TRAJECTORY_DATASET_NAME, H5P_DEFAULT)) < 0)
-        H5FNAL_HDF5_ERROR;
+    if ((vector->origin_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_ORIGIN)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get origin datatype");
+    if ((vector->neutrino_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_NEUTRINO)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get neutrino datatype");
+    if ((vector->particle_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_PARTICLE)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get particle datatype");
+    if ((vector->daughter_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_DAUGHTER)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get daughter datatype");
+    if ((vector->trajectory_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_TRAJECTORY)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get trajectory datatype");
+    if ((vector->truth_dtype_id = h5fnal_acquire_type(H5FNAL_TYPE_TRUTH)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get truth datatype");
+
+    /* Re-opened float32 trajectories are converted from the file's datatype */
+    vector->trajectory_code_dtype_id = H5FNAL_BAD_HID_T;
+    vector->trajectory_file_dtype_id = H5FNAL_BAD_HID_T;
+
+    /* Particles stored as columns are in a group instead of a dataset */
+    vector->particle_dset_id = H5FNAL_BAD_HID_T;
+    vector->particle_columns.gid = H5FNAL_BAD_HID_T;
+    if ((is_columns = h5fnal_is_column_set(vector->top_level_group_id, H5FNAL_TRUTH_PARTICLE_DATASET_NAME)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not check particle storage");
+    vector->particle_storage = is_columns ? H5FNAL_STORAGE_COLUMNS : H5FNAL_STORAGE_ROWS;
+
+    /* Open the datasets (any that never got elements don't exist) */
+    if (h5fnal_open_optional_dset(vector->top_level_group_id, H5FNAL_TRUTH_TRUTH_DATASET_NAME, &vector->truth_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open truth dataset");
+    if (h5fnal_open_optional_dset(vector->top_level_group_id, H5FNAL_TRUTH_NEUTRINO_DATASET_NAME, &vector->neutrino_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open neutrino dataset");
+    if (H5FNAL_STORAGE_ROWS == vector->particle_storage)
+        if (h5fnal_open_optional_dset(vector->top_level_group_id, H5FNAL_TRUTH_PARTICLE_DATASET_NAME, &vector->particle_dset_id) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open particle dataset");
+    if (h5fnal_open_optional_dset(vector->top_level_group_id, H5FNAL_TRUTH_DAUGHTER_DATASET_NAME, &vector->daughter_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open daughter dataset");
+    if (h5fnal_open_optional_dset(vector->top_level_group_id, H5FNAL_TRUTH_TRAJECTORY_DATASET_NAME, &vector->trajectory_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open trajectory dataset");
+    if (h5fnal_get_trajectory_encoding(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get trajectory encoding");
+
+    /* Set up the append buffers */
+    if (h5fnal_init_truth_buffers(vector, FALSE, NULL) < 0)
+        H5FNAL_PROGRAM_ERROR("could not set up append buffers");
+
+    /* Older data products don't have a particle graph */
+    if (h5fnal_open_graph_store(vector->top_level_group_id, &vector->particle_graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open particle graph");
 
     return H5FNAL_SUCCESS;
 
@@ -442,35 +839,74 @@ h5fnal_close_v_mc_truth(h5fnal_vect_truth_t *vector)
     if (NULL == vector)
         H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
 
+    /* Keep the element count up to date */
+    if (h5fnal_update_count_attribute(vector->top_level_group_id, &vector->truth_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not update count attribute");
+
+    /* Write out anything still in the append buffers */
+    if (h5fnal_close_append_buffer(&vector->neutrino_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close append buffer");
+    if (h5fnal_close_append_buffer(&vector->particle_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close append buffer");
+    if (h5fnal_close_append_buffer(&vector->daughter_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close append buffer");
+    if (h5fnal_close_append_buffer(&vector->trajectory_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close append buffer");
+    if (h5fnal_mark_trajectory_encoding(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not record trajectory encoding");
+    if (h5fnal_close_append_buffer(&vector->truth_buffer) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close append buffer");
+    if (h5fnal_close_column_set(&vector->particle_columns) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close particle columns");
+    if (h5fnal_close_graph_store(&vector->particle_graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close particle graph");
+
     /* Top-level group */
     if (H5Gclose(vector->top_level_group_id) < 0)
         H5FNAL_HDF5_ERROR;
 
     /* Datatypes */
-    if (H5Tclose(vector->origin_dtype_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Tclose(vector->neutrino_dtype_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Tclose(vector->particle_dtype_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Tclose(vector->daughter_dtype_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Tclose(vector->trajectory_dtype_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Tclose(vector->truth_dtype_id) < 0)
-        H5FNAL_HDF5_ERROR;
+    if (h5fnal_release_type(vector->origin_dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    vector->origin_dtype_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_release_type(vector->neutrino_dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    vector->neutrino_dtype_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_release_type(vector->particle_dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    vector->particle_dtype_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_release_type(vector->daughter_dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    vector->daughter_dtype_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_release_type(vector->trajectory_dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    vector->trajectory_dtype_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_release_type(vector->trajectory_code_dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    vector->trajectory_code_dtype_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_release_type(vector->trajectory_file_dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    vector->trajectory_file_dtype_id = H5FNAL_BAD_HID_T;
+    if (h5fnal_release_type(vector->truth_dtype_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release datatype");
+    vector->truth_dtype_id = H5FNAL_BAD_HID_T;
 
     /* Datasets */
-    if (H5Dclose(vector->neutrino_dset_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Dclose(vector->particle_dset_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Dclose(vector->daughter_dset_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Dclose(vector->trajectory_dset_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Dclose(vector->truth_dset_id) < 0)
-        H5FNAL_HDF5_ERROR;
+    if (vector->neutrino_dset_id >= 0)
+        if (H5Dclose(vector->neutrino_dset_id) < 0)
+            H5FNAL_HDF5_ERROR;
+    if (vector->particle_dset_id >= 0)
+        if (H5Dclose(vector->particle_dset_id) < 0)
+            H5FNAL_HDF5_ERROR;
+    if (vector->daughter_dset_id >= 0)
+        if (H5Dclose(vector->daughter_dset_id) < 0)
+            H5FNAL_HDF5_ERROR;
+    if (vector->trajectory_dset_id >= 0)
+        if (H5Dclose(vector->trajectory_dset_id) < 0)
+            H5FNAL_HDF5_ERROR;
+    if (vector->truth_dset_id >= 0)
+        if (H5Dclose(vector->truth_dset_id) < 0)
+            H5FNAL_HDF5_ERROR;
 
     /* Set IDs to bad values */
     vector->origin_dtype_id     = H5FNAL_BAD_HID_T;
@@ -486,6 +922,8 @@ h5fnal_close_v_mc_truth(h5fnal_vect_truth_t *vector)
 
     vector->trajectory_dset_id  = H5FNAL_BAD_HID_T;
     vector->trajectory_dtype_id = H5FNAL_BAD_HID_T;
+    vector->trajectory_code_dtype_id = H5FNAL_BAD_HID_T;
+    vector->trajectory_file_dtype_id = H5FNAL_BAD_HID_T;
 
     vector->truth_dset_id       = H5FNAL_BAD_HID_T;
     vector->truth_dtype_id      = H5FNAL_BAD_HID_T;
@@ -501,86 +939,481 @@ error:
     return H5FNAL_FAILURE;
 } /* h5fnal_close_v_mc_truth */
 
+/************************************************************************
+ * h5fnal_get_trajectory_bits()
+ *
+ * Gets the bit patterns of a trajectory point's positions, times and
+ * momenta, as doubles or as floats (rounded to nearest).
+ ************************************************************************/
+static void
+h5fnal_get_trajectory_bits(hbool_t float32, const h5fnal_trajectory_t *point, uint64_t *bits)
+{
+    const double values[H5FNAL_TRAJECTORY_N_VALUES] = {point->Vx, point->Vy, point->Vz, point->T,
+            point->Px, point->Py, point->Pz, point->E};
+    unsigned u;
+
+    for (u = 0; u < H5FNAL_TRAJECTORY_N_VALUES; u++) {
+        if (float32) {
+            float f = (float)values[u];
+            uint32_t f_bits;
+
+            memcpy(&f_bits, &f, sizeof(f_bits));
+            bits[u] = f_bits;
+        }
+        else
+            memcpy(&bits[u], &values[u], sizeof(bits[u]));
+    }
+
+    return;
+} /* end h5fnal_get_trajectory_bits() */
+
+/************************************************************************
+ * h5fnal_set_trajectory_values()
+ *
+ * Sets a trajectory point's positions, times and momenta from their
+ * bit patterns (see h5fnal_get_trajectory_bits()).
+ ************************************************************************/
+static void
+h5fnal_set_trajectory_values(hbool_t float32, const uint64_t *bits, h5fnal_trajectory_t *point)
+{
+    double values[H5FNAL_TRAJECTORY_N_VALUES];
+    unsigned u;
+
+    for (u = 0; u < H5FNAL_TRAJECTORY_N_VALUES; u++) {
+        if (float32) {
+            uint32_t f_bits = (uint32_t)bits[u];
+            float f;
+
+            memcpy(&f, &f_bits, sizeof(f));
+            values[u] = (double)f;
+        }
+        else
+            memcpy(&values[u], &bits[u], sizeof(values[u]));
+    }
+
+    point->Vx = values[0];
+    point->Vy = values[1];
+    point->Vz = values[2];
+    point->T = values[3];
+    point->Px = values[4];
+    point->Py = values[5];
+    point->Pz = values[6];
+    point->E = values[7];
+
+    return;
+} /* end h5fnal_set_trajectory_values() */
+
+/************************************************************************
+ * h5fnal_read_trajectory_points()
+ *
+ * Reads count trajectory points, starting at element start, into buf,
+ * decoding delta coded points (see h5fnal_append_trajectories()). The
+ * coded points are read a block at a time, starting with the block
+ * that start is in. The append buffer has to have been synced.
+ ************************************************************************/
+static herr_t
+h5fnal_read_trajectory_points(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count, h5fnal_trajectory_t *buf)
+{
+    h5fnal_trajectory_code_t *codes = NULL;
+    hbool_t float32 = H5FNAL_ENCODING_DELTA_FLOAT32 == vector->trajectory_encoding;
+    uint64_t mask = float32 ? (uint64_t)0xFFFFFFFFU : ~(uint64_t)0;
+    uint64_t bits[H5FNAL_TRAJECTORY_N_VALUES];
+    hsize_t block = vector->trajectory_block;
+    hsize_t end = start + count;
+    hsize_t first;
+    hsize_t n_read;
+    hsize_t i;
+    unsigned u;
+
+    if (H5FNAL_ENCODING_PLAIN == vector->trajectory_encoding)
+        return h5fnal_read_data_range(vector->trajectory_dset_id, vector->trajectory_dtype_id, start, count, buf);
+
+    if (0 == count)
+        return H5FNAL_SUCCESS;
+
+    first = start - start % block;
+    if (NULL == (codes = (h5fnal_trajectory_code_t *)malloc((size_t)H5FNAL_MIN(block, end - first)
+            * sizeof(h5fnal_trajectory_code_t))))
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for coded trajectory points");
+
+    memset(bits, 0, sizeof(bits));
+    for (; first < end; first += n_read) {
+        n_read = H5FNAL_MIN(block, end - first);
+        if (h5fnal_read_data_range(vector->trajectory_dset_id, vector->trajectory_code_dtype_id, first, n_read,
+                codes) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read coded trajectory points");
+
+        /* first is always at the start of a block */
+        for (i = 0; i < n_read; i++) {
+            for (u = 0; u < H5FNAL_TRAJECTORY_N_VALUES; u++)
+                bits[u] = 0 == i ? codes[i].values[u] : (bits[u] + codes[i].values[u]) & mask;
+            if (first + i < start)
+                continue;
+            h5fnal_set_trajectory_values(float32, bits, &buf[first + i - start]);
+            buf[first + i - start].particle_index = codes[i].particle_index;
+        }
+    }
+
+    free(codes);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    free(codes);
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_trajectory_points() */
+
+/************************************************************************
+ * h5fnal_append_trajectories()
+ *
+ * Appends trajectory points through the trajectory buffer, delta
+ * coding them first unless the encoding is plain. Each position, time
+ * and momentum is stored as the difference between its bit pattern
+ * and that of the same value in the point before it, as an unsigned
+ * integer (modulo 2^64, or 2^32 for floats). The first point of each
+ * block of trajectory_block points is stored as it is, so decoding a
+ * range can start at the block it begins in.
+ ************************************************************************/
+static herr_t
+h5fnal_append_trajectories(h5fnal_vect_truth_t *vector, hsize_t n, const h5fnal_trajectory_t *points)
+{
+    h5fnal_trajectory_code_t *codes = NULL;
+    h5fnal_trajectory_t last;
+    hbool_t float32 = H5FNAL_ENCODING_DELTA_FLOAT32 == vector->trajectory_encoding;
+    uint64_t mask = float32 ? (uint64_t)0xFFFFFFFFU : ~(uint64_t)0;
+    uint64_t bits[H5FNAL_TRAJECTORY_N_VALUES];
+    hsize_t block = vector->trajectory_block;
+    hsize_t row;
+    hsize_t n_coded;
+    hsize_t i;
+    hsize_t j;
+    unsigned u;
+
+    if (H5FNAL_ENCODING_PLAIN == vector->trajectory_encoding)
+        return h5fnal_buffered_append(&vector->trajectory_buffer, n, (const void *)points);
+
+    if (0 == n)
+        return H5FNAL_SUCCESS;
+
+    row = h5fnal_get_buffered_size(&vector->trajectory_buffer);
+
+    /* The first points appended to a re-opened data product are coded
+     * against the last point in the file
+     */
+    if (!vector->trajectory_have_last && row % block != 0) {
+        if (h5fnal_read_trajectories_range(vector, row - 1, 1, &last) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read last trajectory point");
+        h5fnal_get_trajectory_bits(float32, &last, vector->trajectory_last);
+        vector->trajectory_have_last = TRUE;
+    }
+
+    if (NULL == (codes = (h5fnal_trajectory_code_t *)malloc((size_t)H5FNAL_MIN(block, n)
+            * sizeof(h5fnal_trajectory_code_t))))
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for coded trajectory points");
+
+    for (i = 0; i < n; i += n_coded) {
+        n_coded = H5FNAL_MIN(block, n - i);
+        for (j = 0; j < n_coded; j++, row++) {
+            h5fnal_get_trajectory_bits(float32, &points[i + j], bits);
+            for (u = 0; u < H5FNAL_TRAJECTORY_N_VALUES; u++) {
+                codes[j].values[u] = 0 == row % block ? bits[u] : (bits[u] - vector->trajectory_last[u]) & mask;
+                vector->trajectory_last[u] = bits[u];
+            }
+            codes[j].particle_index = points[i + j].particle_index;
+        }
+        vector->trajectory_have_last = TRUE;
+
+        if (h5fnal_buffered_append(&vector->trajectory_buffer, n_coded, (const void *)codes) < 0)
+            H5FNAL_PROGRAM_ERROR("could not append coded trajectory points");
+    }
+
+    free(codes);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    free(codes);
+
+    /* The coding state no longer matches what is in the buffer */
+    vector->trajectory_have_last = FALSE;
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_append_trajectories() */
+
+/************************************************************************
+ * h5fnal_shift_truth_indices()
+ *
+ * Adds the given offsets to the indices that the truths, particles and
+ * trajectory points in data hold into the neutrino, particle,
+ * trajectory and daughter arrays. Indices of -1 (nothing stored) are
+ * left alone.
+ ************************************************************************/
+static void
+h5fnal_shift_truth_indices(h5fnal_vect_truth_data_t *data, hssize_t nu_offset, hssize_t p_offset,
+        hssize_t t_offset, hssize_t d_offset)
+{
+    hsize_t u;
+
+    for (u = 0; u < data->n_truths; u++) {
+        h5fnal_truth_t *t = &data->truths[u];
+
+        if (t->neutrino_index >= 0)
+            t->neutrino_index += nu_offset;
+        if (t->particle_start_index >= 0) {
+            t->particle_start_index += p_offset;
+            t->particle_end_index += p_offset;
+        }
+    }
+    for (u = 0; u < data->n_particles; u++) {
+        h5fnal_particle_t *p = &data->particles[u];
+
+        if (p->trajectory_start_index >= 0) {
+            p->trajectory_start_index += t_offset;
+            p->trajectory_end_index += t_offset;
+        }
+        if (p->daughter_start_index >= 0) {
+            p->daughter_start_index += d_offset;
+            p->daughter_end_index += d_offset;
+        }
+    }
+    for (u = 0; u < data->n_trajectories; u++)
+        data->trajectories[u].particle_index = (hsize_t)((hssize_t)data->trajectories[u].particle_index + p_offset);
+
+    return;
+} /* end h5fnal_shift_truth_indices() */
+
 herr_t
 h5fnal_append_truths(h5fnal_vect_truth_t *vector, h5fnal_vect_truth_data_t *data)
 {
+    hsize_t nu_offset;
+    hsize_t p_offset;
+    hsize_t t_offset;
+    hsize_t d_offset;
+
     if (!vector)
         H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
     if (!data)
         H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
 
-    /* XXX: Fixup datasets for multiple appends here */
-
     /* Trivial case of zero truths to append */
     if (0 == data->n_truths)
         return H5FNAL_SUCCESS;
 
+    /* The particle graph is built from the indices as they come in,
+     * relative to data's own arrays
+     */
+    if (h5fnal_append_graph(&vector->particle_graph, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not append particle graph");
+
+    /* Index fixup.
+     *
+     * When appending to non-empty datasets, the indices in the incoming
+     * data (truth -> neutrino and particles, particle -> trajectory
+     * points and daughters, trajectory point -> particle) will have to
+     * be moved so that they refer to the correct elements in the
+     * datasets. Elements that are still in the append buffers count
+     * towards the offsets.
+     */
+    nu_offset = h5fnal_get_buffered_size(&vector->neutrino_buffer);
+    p_offset = h5fnal_get_n_particles(vector);
+    t_offset = h5fnal_get_buffered_size(&vector->trajectory_buffer);
+    d_offset = h5fnal_get_buffered_size(&vector->daughter_buffer);
+    if (nu_offset > 0 || p_offset > 0 || t_offset > 0 || d_offset > 0)
+        h5fnal_shift_truth_indices(data, (hssize_t)nu_offset, (hssize_t)p_offset, (hssize_t)t_offset,
+                (hssize_t)d_offset);
+
     /* append data to all the datasets */
-    if (h5fnal_append_data(vector->truth_dset_id, vector->truth_dtype_id, data->n_truths, (const void *)(data->truths)) < 0)
+    if (h5fnal_buffered_append(&vector->truth_buffer, data->n_truths, (const void *)(data->truths)) < 0)
         H5FNAL_PROGRAM_ERROR("could not append truth data");
-    if (h5fnal_append_data(vector->trajectory_dset_id, vector->trajectory_dtype_id, data->n_trajectories, (const void *)(data->trajectories)) < 0)
+    if (h5fnal_append_trajectories(vector, data->n_trajectories, data->trajectories) < 0)
         H5FNAL_PROGRAM_ERROR("could not append trajectory data");
-    if (h5fnal_append_data(vector->daughter_dset_id, vector->daughter_dtype_id, data->n_daughters, (const void *)(data->daughters)) < 0)
+    if (h5fnal_buffered_append(&vector->daughter_buffer, data->n_daughters, (const void *)(data->daughters)) < 0)
         H5FNAL_PROGRAM_ERROR("could not append daughter data");
-    if (h5fnal_append_data(vector->particle_dset_id, vector->particle_dtype_id, data->n_particles, (const void *)(data->particles)) < 0)
+    if (H5FNAL_STORAGE_COLUMNS == vector->particle_storage) {
+        if (h5fnal_append_columns(&vector->particle_columns, data->n_particles, (const void *)(data->particles)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not append particle data");
+    }
+    else if (h5fnal_buffered_append(&vector->particle_buffer, data->n_particles, (const void *)(data->particles)) < 0)
         H5FNAL_PROGRAM_ERROR("could not append particle data");
-    if (h5fnal_append_data(vector->neutrino_dset_id, vector->neutrino_dtype_id, data->n_neutrinos, (const void *)(data->neutrinos)) < 0)
+    if (h5fnal_buffered_append(&vector->neutrino_buffer, data->n_neutrinos, (const void *)(data->neutrinos)) < 0)
         H5FNAL_PROGRAM_ERROR("could not append neutrino data");
 
+    /* Pick up the datasets if the appends created them */
+    if (h5fnal_claim_deferred_dset(&vector->truth_buffer, &vector->truth_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get truth dataset");
+    if (h5fnal_claim_deferred_dset(&vector->trajectory_buffer, &vector->trajectory_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get trajectory dataset");
+    if (h5fnal_claim_deferred_dset(&vector->daughter_buffer, &vector->daughter_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get daughter dataset");
+    if (h5fnal_claim_deferred_dset(&vector->particle_buffer, &vector->particle_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get particle dataset");
+    if (h5fnal_claim_deferred_dset(&vector->neutrino_buffer, &vector->neutrino_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get neutrino dataset");
+
     return H5FNAL_SUCCESS;
 
 error:
     return H5FNAL_FAILURE;
 } /* end h5fnal_append_truths() */
 
+/************************************************************************
+ * h5fnal_get_truth_sizes()
+ *
+ * Sets the n_* fields of data to the number of elements stored in each
+ * of the data product's datasets. The arrays and capacities are not
+ * touched.
+ ************************************************************************/
 herr_t
-h5fnal_read_all_truths(h5fnal_vect_truth_t *vector, h5fnal_vect_truth_data_t *data)
+h5fnal_get_truth_sizes(h5fnal_vect_truth_t *vector, h5fnal_vect_truth_data_t *data)
 {
     if (!vector)
         H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
     if (!data)
         H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
 
-    /* Initialize the data struct */
-    memset(data, 0, sizeof(h5fnal_vect_truth_data_t));
+    /* Make sure any appended data is in the file */
+    if (h5fnal_flush_truth_buffers(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush append buffers");
 
-    /* Get dataset sizes and allocate memory */
-    if ((data->n_truths = h5fnal_get_dset_size(vector->truth_dset_id)) < 0)
-        H5FNAL_PROGRAM_ERROR("could not get dataset size");
-    if (NULL == (data->truths = (h5fnal_truth_t *)calloc(data->n_truths, sizeof(h5fnal_truth_t))))
-        H5FNAL_PROGRAM_ERROR("could not allocate memory");
+    /* The buffers know the dataset sizes, including for datasets
+     * that don't exist
+     */
+    data->n_truths = h5fnal_get_buffered_size(&vector->truth_buffer);
+    data->n_trajectories = h5fnal_get_buffered_size(&vector->trajectory_buffer);
+    data->n_daughters = h5fnal_get_buffered_size(&vector->daughter_buffer);
+    data->n_particles = h5fnal_get_n_particles(vector);
+    data->n_neutrinos = h5fnal_get_buffered_size(&vector->neutrino_buffer);
 
-    if ((data->n_trajectories = h5fnal_get_dset_size(vector->trajectory_dset_id)) < 0)
-        H5FNAL_PROGRAM_ERROR("could not get dataset size");
-    if (NULL == (data->trajectories = (h5fnal_trajectory_t *)calloc(data->n_trajectories, sizeof(h5fnal_trajectory_t))))
-        H5FNAL_PROGRAM_ERROR("could not allocate memory");
+    return H5FNAL_SUCCESS;
 
-    if ((data->n_daughters = h5fnal_get_dset_size(vector->daughter_dset_id)) < 0)
-        H5FNAL_PROGRAM_ERROR("could not get dataset size");
-    if (NULL == (data->daughters = (h5fnal_daughter_t *)calloc(data->n_daughters, sizeof(h5fnal_daughter_t))))
-        H5FNAL_PROGRAM_ERROR("could not allocate memory");
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_get_truth_sizes() */
 
-    if ((data->n_particles = h5fnal_get_dset_size(vector->particle_dset_id)) < 0)
-        H5FNAL_PROGRAM_ERROR("could not get dataset size");
-    if (NULL == (data->particles = (h5fnal_particle_t *)calloc(data->n_particles, sizeof(h5fnal_particle_t))))
-        H5FNAL_PROGRAM_ERROR("could not allocate memory");
+/************************************************************************
+ * h5fnal_reserve_truth_mem_data()
+ *
+ * Makes sure each array in data can hold the number of elements in the
+ * matching n_* field (e.g. as set by h5fnal_get_truth_sizes()). Arrays
+ * that are already large enough are left alone. The arrays must have
+ * been allocated by the library (or be NULL).
+ ************************************************************************/
+herr_t
+h5fnal_reserve_truth_mem_data(h5fnal_vect_truth_data_t *data)
+{
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    if (data->n_truths > data->truths_capacity) {
+        free(data->truths);
+        data->truths_capacity = 0;
+        if (NULL == (data->truths = (h5fnal_truth_t *)calloc(data->n_truths, sizeof(h5fnal_truth_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for truths");
+        data->truths_capacity = data->n_truths;
+    }
+    if (data->n_trajectories > data->trajectories_capacity) {
+        free(data->trajectories);
+        data->trajectories_capacity = 0;
+        if (NULL == (data->trajectories = (h5fnal_trajectory_t *)calloc(data->n_trajectories, sizeof(h5fnal_trajectory_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for trajectories");
+        data->trajectories_capacity = data->n_trajectories;
+    }
+    if (data->n_daughters > data->daughters_capacity) {
+        free(data->daughters);
+        data->daughters_capacity = 0;
+        if (NULL == (data->daughters = (h5fnal_daughter_t *)calloc(data->n_daughters, sizeof(h5fnal_daughter_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for daughters");
+        data->daughters_capacity = data->n_daughters;
+    }
+    if (data->n_particles > data->particles_capacity) {
+        free(data->particles);
+        data->particles_capacity = 0;
+        if (NULL == (data->particles = (h5fnal_particle_t *)calloc(data->n_particles, sizeof(h5fnal_particle_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for particles");
+        data->particles_capacity = data->n_particles;
+    }
+    if (data->n_neutrinos > data->neutrinos_capacity) {
+        free(data->neutrinos);
+        data->neutrinos_capacity = 0;
+        if (NULL == (data->neutrinos = (h5fnal_neutrino_t *)calloc(data->n_neutrinos, sizeof(h5fnal_neutrino_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for neutrinos");
+        data->neutrinos_capacity = data->n_neutrinos;
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_reserve_truth_mem_data() */
+
+/************************************************************************
+ * h5fnal_read_all_truths_into()
+ *
+ * Reads all the data product's data into the arrays in data, which must
+ * be large enough to hold it (see the capacity fields). Nothing is
+ * allocated or freed.
+ *
+ * On return, the n_* fields hold the number of elements in each
+ * dataset. If an array is too small, this fails without reading
+ * anything.
+ ************************************************************************/
+herr_t
+h5fnal_read_all_truths_into(h5fnal_vect_truth_t *vector, h5fnal_vect_truth_data_t *data)
+{
+    if (h5fnal_get_truth_sizes(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset sizes");
+
+    if (data->n_truths > data->truths_capacity
+            || data->n_trajectories > data->trajectories_capacity
+            || data->n_daughters > data->daughters_capacity
+            || data->n_particles > data->particles_capacity
+            || data->n_neutrinos > data->neutrinos_capacity)
+        H5FNAL_PROGRAM_ERROR("truth data arrays are too small");
 
-    if ((data->n_neutrinos = h5fnal_get_dset_size(vector->neutrino_dset_id)) < 0)
-        H5FNAL_PROGRAM_ERROR("could not get dataset size");
-    if (NULL == (data->neutrinos = (h5fnal_neutrino_t *)calloc(data->n_neutrinos, sizeof(h5fnal_neutrino_t))))
+    /* Read data */
+    if (h5fnal_read_data(vector->truth_dset_id, vector->truth_dtype_id, data->n_truths, data->truths) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read truths");
+    if (h5fnal_read_trajectory_points(vector, 0, data->n_trajectories, data->trajectories) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read trajectories");
+    if (h5fnal_read_data(vector->daughter_dset_id, vector->daughter_dtype_id, data->n_daughters, data->daughters) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read daughters");
+    if (H5FNAL_STORAGE_COLUMNS == vector->particle_storage) {
+        if (h5fnal_read_columns_range(&vector->particle_columns, H5FNAL_ALL_MEMBERS, 0, data->n_particles,
+                data->particles) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read particles");
+    }
+    else if (h5fnal_read_data(vector->particle_dset_id, vector->particle_dtype_id, data->n_particles, data->particles) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read particles");
+    if (h5fnal_read_data(vector->neutrino_dset_id, vector->neutrino_dtype_id, data->n_neutrinos, data->neutrinos) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read neutrinos");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_all_truths_into() */
+
+herr_t
+h5fnal_read_all_truths(h5fnal_vect_truth_t *vector, h5fnal_vect_truth_data_t *data)
+{
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    /* Initialize the data struct */
+    memset(data, 0, sizeof(h5fnal_vect_truth_data_t));
+
+    /* Get dataset sizes and allocate memory */
+    if (h5fnal_get_truth_sizes(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset sizes");
+    if (h5fnal_reserve_truth_mem_data(data) < 0)
         H5FNAL_PROGRAM_ERROR("could not allocate memory");
 
     /* Read data */
-    if (H5Dread(vector->truth_dset_id, vector->truth_dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data->truths) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Dread(vector->trajectory_dset_id, vector->trajectory_dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data->trajectories) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Dread(vector->daughter_dset_id, vector->daughter_dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data->daughters) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Dread(vector->particle_dset_id, vector->particle_dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data->particles) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Dread(vector->neutrino_dset_id, vector->neutrino_dtype_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data->neutrinos) < 0)
-        H5FNAL_HDF5_ERROR;
+    if (h5fnal_read_all_truths_into(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read truth data");
 
     return H5FNAL_SUCCESS;
 
@@ -590,6 +1423,608 @@ error:
     return H5FNAL_FAILURE;
 } /* end h5fnal_read_all_truths() */
 
+/************************************************************************
+ * h5fnal_read_truths_range()
+ *
+ * Reads count truths, starting at element start, into buf.
+ ************************************************************************/
+herr_t
+h5fnal_read_truths_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count, h5fnal_truth_t *buf)
+{
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_append_buffer(&vector->truth_buffer, &vector->truth_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush append buffer");
+
+    if (h5fnal_read_data_range(vector->truth_dset_id, vector->truth_dtype_id, start, count, buf) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read truths");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_truths_range() */
+
+/************************************************************************
+ * h5fnal_read_trajectories_range()
+ *
+ * Reads count trajectory points, starting at element start, into buf.
+ ************************************************************************/
+herr_t
+h5fnal_read_trajectories_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count, h5fnal_trajectory_t *buf)
+{
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_append_buffer(&vector->trajectory_buffer, &vector->trajectory_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush append buffer");
+
+    if (h5fnal_read_trajectory_points(vector, start, count, buf) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read trajectory points");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_trajectories_range() */
+
+/************************************************************************
+ * h5fnal_read_daughters_range()
+ *
+ * Reads count daughters, starting at element start, into buf.
+ ************************************************************************/
+herr_t
+h5fnal_read_daughters_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count, h5fnal_daughter_t *buf)
+{
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_append_buffer(&vector->daughter_buffer, &vector->daughter_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush append buffer");
+
+    if (h5fnal_read_data_range(vector->daughter_dset_id, vector->daughter_dtype_id, start, count, buf) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read daughters");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_daughters_range() */
+
+/************************************************************************
+ * h5fnal_read_particles_range()
+ *
+ * Reads count particles, starting at element start, into buf.
+ ************************************************************************/
+herr_t
+h5fnal_read_particles_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count, h5fnal_particle_t *buf)
+{
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_particles(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush particles");
+
+    if (H5FNAL_STORAGE_COLUMNS == vector->particle_storage) {
+        if (h5fnal_read_columns_range(&vector->particle_columns, H5FNAL_ALL_MEMBERS, start, count, buf) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read particle columns");
+    }
+    else {
+        if (h5fnal_read_data_range(vector->particle_dset_id, vector->particle_dtype_id, start, count, buf) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read particles");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_particles_range() */
+
+/************************************************************************
+ * h5fnal_read_particle_projection_range()
+ *
+ * Reads the fields in the fields mask of count particles, starting at
+ * element start, into buf, an array of compact structs that declare
+ * only those fields, in h5fnal_particle_t order (e.g. struct { int pdg_code; int mother; } for
+ * H5FNAL_PARTICLE_PDG_CODE | H5FNAL_PARTICLE_MOTHER).
+ * Only the selected fields are converted and stored, so buf can be
+ * much smaller than an array of h5fnal_particle_t.
+ ************************************************************************/
+herr_t
+h5fnal_read_particle_projection_range(h5fnal_vect_truth_t *vector, unsigned fields, hsize_t start, hsize_t count,
+        void *buf)
+{
+    hid_t tid = H5FNAL_BAD_HID_T;
+
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+    if (0 == (fields & H5FNAL_PARTICLE_ALL_FIELDS))
+        H5FNAL_PROGRAM_ERROR("no particle fields selected");
+    fields &= H5FNAL_PARTICLE_ALL_FIELDS;
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_particles(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush particles");
+
+    if (H5FNAL_STORAGE_COLUMNS == vector->particle_storage) {
+        if (h5fnal_read_columns_projected(&vector->particle_columns, fields, start, count, buf) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read particle columns");
+    }
+    else {
+        /* HDF5 converts just the members in the projection type */
+        if ((tid = h5fnal_create_projection_type(vector->particle_dtype_id, fields)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create particle projection datatype");
+        if (h5fnal_read_data_range(vector->particle_dset_id, tid, start, count, buf) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read particles");
+        if (H5Tclose(tid) < 0)
+            H5FNAL_HDF5_ERROR;
+        tid = H5FNAL_BAD_HID_T;
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Tclose(tid);
+    } H5E_END_TRY;
+
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_particle_projection_range() */
+
+/************************************************************************
+ * h5fnal_read_neutrinos_range()
+ *
+ * Reads count neutrinos, starting at element start, into buf.
+ ************************************************************************/
+herr_t
+h5fnal_read_neutrinos_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count, h5fnal_neutrino_t *buf)
+{
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+
+    /* Make sure any appended data is in the file */
+    if (h5fnal_sync_append_buffer(&vector->neutrino_buffer, &vector->neutrino_dset_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush append buffer");
+
+    if (h5fnal_read_data_range(vector->neutrino_dset_id, vector->neutrino_dtype_id, start, count, buf) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read neutrinos");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_neutrinos_range() */
+
+
+/************************************************************************
+ * h5fnal_read_particle_graph_range()
+ *
+ * Reads the parent/daughter index of count particles, starting at
+ * element start, into graph (see particle_graph.h). The rows in the
+ * graph are relative to start. The range has to hold whole truths,
+ * e.g. all the particles in the data product or, in the flat layout,
+ * an event's particles (the H5FNAL_TRUTH_RANGE_PARTICLES range of its
+ * event index entry).
+ *
+ * The index is only stored for data products created with the
+ * particle_graph option. Returns FALSE, leaving graph alone, for the
+ * others (and ones written before the index was added). Their graphs
+ * can be built from the truths and particles with
+ * h5fnal_build_particle_graph().
+ ************************************************************************/
+htri_t
+h5fnal_read_particle_graph_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count,
+        h5fnal_particle_graph_t *graph)
+{
+    htri_t found;
+
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+
+    if ((found = h5fnal_read_graph_range(&vector->particle_graph, start, count, graph)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read particle graph");
+
+    return found;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_particle_graph_range() */
+
+/************************************************************************
+ * h5fnal_append_event_truths()
+ *
+ * Flat layout append. Appends one event's truths, and everything they
+ * refer to, to a data product that holds every event in the file and
+ * adds the rows they went into to the event index.
+ *
+ * The indices in data are relative to the event's own arrays. Like any
+ * append, h5fnal_append_truths() moves them to where the event lands in
+ * the datasets (so data is modified).
+ ************************************************************************/
+herr_t
+h5fnal_append_event_truths(h5fnal_vect_truth_t *vector, h5fnal_event_index_t *index,
+        unsigned run, unsigned subrun, unsigned event, h5fnal_vect_truth_data_t *data)
+{
+    h5fnal_event_entry_t entry;
+
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+    if (!index)
+        H5FNAL_PROGRAM_ERROR("index parameter cannot be NULL");
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    memset(&entry, 0, sizeof(h5fnal_event_entry_t));
+    entry.run = run;
+    entry.subrun = subrun;
+    entry.event = event;
+    entry.start[H5FNAL_TRUTH_RANGE_TRUTHS] = h5fnal_get_buffered_size(&vector->truth_buffer);
+    entry.count[H5FNAL_TRUTH_RANGE_TRUTHS] = data->n_truths;
+    entry.start[H5FNAL_TRUTH_RANGE_NEUTRINOS] = h5fnal_get_buffered_size(&vector->neutrino_buffer);
+    entry.count[H5FNAL_TRUTH_RANGE_NEUTRINOS] = data->n_neutrinos;
+    entry.start[H5FNAL_TRUTH_RANGE_PARTICLES] = h5fnal_get_n_particles(vector);
+    entry.count[H5FNAL_TRUTH_RANGE_PARTICLES] = data->n_particles;
+    entry.start[H5FNAL_TRUTH_RANGE_TRAJECTORIES] = h5fnal_get_buffered_size(&vector->trajectory_buffer);
+    entry.count[H5FNAL_TRUTH_RANGE_TRAJECTORIES] = data->n_trajectories;
+    entry.start[H5FNAL_TRUTH_RANGE_DAUGHTERS] = h5fnal_get_buffered_size(&vector->daughter_buffer);
+    entry.count[H5FNAL_TRUTH_RANGE_DAUGHTERS] = data->n_daughters;
+
+    if (h5fnal_append_truths(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not append truth data");
+    if (h5fnal_add_event_entry(index, &entry) < 0)
+        H5FNAL_PROGRAM_ERROR("could not add event index entry");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_append_event_truths() */
+
+
+/************************************************************************
+ * h5fnal_read_event_truths()
+ *
+ * Flat layout read. Reads one event's truths and everything they refer
+ * to (as found with h5fnal_find_event()) into data, growing its arrays
+ * if needed. The indices are made relative to the event's arrays again.
+ ************************************************************************/
+herr_t
+h5fnal_read_event_truths(h5fnal_vect_truth_t *vector, const h5fnal_event_entry_t *entry,
+        h5fnal_vect_truth_data_t *data)
+{
+    const hsize_t *start;
+
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+    if (!entry)
+        H5FNAL_PROGRAM_ERROR("entry parameter cannot be NULL");
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    start = entry->start;
+    data->n_truths = entry->count[H5FNAL_TRUTH_RANGE_TRUTHS];
+    data->n_neutrinos = entry->count[H5FNAL_TRUTH_RANGE_NEUTRINOS];
+    data->n_particles = entry->count[H5FNAL_TRUTH_RANGE_PARTICLES];
+    data->n_trajectories = entry->count[H5FNAL_TRUTH_RANGE_TRAJECTORIES];
+    data->n_daughters = entry->count[H5FNAL_TRUTH_RANGE_DAUGHTERS];
+    if (h5fnal_reserve_truth_mem_data(data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for truth data");
+
+    if (h5fnal_read_truths_range(vector, start[H5FNAL_TRUTH_RANGE_TRUTHS], data->n_truths, data->truths) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read truths");
+    if (h5fnal_read_neutrinos_range(vector, start[H5FNAL_TRUTH_RANGE_NEUTRINOS], data->n_neutrinos, data->neutrinos) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read neutrinos");
+    if (h5fnal_read_particles_range(vector, start[H5FNAL_TRUTH_RANGE_PARTICLES], data->n_particles, data->particles) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read particles");
+    if (h5fnal_read_trajectories_range(vector, start[H5FNAL_TRUTH_RANGE_TRAJECTORIES], data->n_trajectories,
+            data->trajectories) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read trajectories");
+    if (h5fnal_read_daughters_range(vector, start[H5FNAL_TRUTH_RANGE_DAUGHTERS], data->n_daughters, data->daughters) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read daughters");
+
+    h5fnal_shift_truth_indices(data,
+            -(hssize_t)start[H5FNAL_TRUTH_RANGE_NEUTRINOS],
+            -(hssize_t)start[H5FNAL_TRUTH_RANGE_PARTICLES],
+            -(hssize_t)start[H5FNAL_TRUTH_RANGE_TRAJECTORIES],
+            -(hssize_t)start[H5FNAL_TRUTH_RANGE_DAUGHTERS]);
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_read_event_truths() */
+
+/************************************************************************
+ * h5fnal_open_truth_cursor()
+ *
+ * Sets up a cursor over the truths in a data product. A max_bytes of
+ * zero uses H5FNAL_DEFAULT_CURSOR_BYTES.
+ *
+ * An eighth of the memory bound goes to the truths, which are read in
+ * whole chunks, and the rest to the neutrinos, particles, trajectory
+ * points and daughters they refer to.
+ ************************************************************************/
+herr_t
+h5fnal_open_truth_cursor(h5fnal_vect_truth_t *vector, size_t max_bytes, h5fnal_truth_cursor_t *cursor)
+{
+    h5fnal_vect_truth_data_t sizes;
+    hsize_t chunk_dim;
+    hsize_t truth_bytes;
+
+    if (!vector)
+        H5FNAL_PROGRAM_ERROR("vector parameter cannot be NULL");
+    if (!cursor)
+        H5FNAL_PROGRAM_ERROR("cursor parameter cannot be NULL");
+
+    memset(cursor, 0, sizeof(h5fnal_truth_cursor_t));
+    memset(&sizes, 0, sizeof(h5fnal_vect_truth_data_t));
+
+    if (0 == max_bytes)
+        max_bytes = H5FNAL_DEFAULT_CURSOR_BYTES;
+
+    if (h5fnal_get_truth_sizes(vector, &sizes) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset sizes");
+
+    cursor->vector = vector;
+    cursor->max_bytes = max_bytes;
+    cursor->n_truths = sizes.n_truths;
+
+    /* Whole chunks of truths, at least one */
+    chunk_dim = vector->truth_buffer.chunk_dim;
+    cursor->window = ((max_bytes / 8) / sizeof(h5fnal_truth_t) / chunk_dim) * chunk_dim;
+    if (cursor->window < chunk_dim)
+        cursor->window = chunk_dim;
+    truth_bytes = cursor->window * sizeof(h5fnal_truth_t);
+    cursor->max_related_bytes = truth_bytes < max_bytes ? max_bytes - truth_bytes : 0;
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_open_truth_cursor() */
+
+/************************************************************************
+ * h5fnal_reserve_truth_batch()
+ *
+ * Grows the cursor's arrays for the next read. If that would take the
+ * arrays over the memory bound, the arrays that aren't holding data we
+ * still need are freed first, so they are reallocated at the size this
+ * batch needs instead of the largest size seen so far.
+ ************************************************************************/
+static herr_t
+h5fnal_reserve_truth_batch(h5fnal_truth_cursor_t *cursor, hbool_t keep_particles)
+{
+    h5fnal_vect_truth_data_t *data = &cursor->batch;
+    hsize_t bytes;
+
+    bytes = H5FNAL_MAX(data->truths_capacity, data->n_truths) * sizeof(h5fnal_truth_t)
+        + H5FNAL_MAX(data->neutrinos_capacity, data->n_neutrinos) * sizeof(h5fnal_neutrino_t)
+        + H5FNAL_MAX(data->particles_capacity, data->n_particles) * sizeof(h5fnal_particle_t)
+        + H5FNAL_MAX(data->trajectories_capacity, data->n_trajectories) * sizeof(h5fnal_trajectory_t)
+        + H5FNAL_MAX(data->daughters_capacity, data->n_daughters) * sizeof(h5fnal_daughter_t);
+
+    if (bytes > cursor->max_bytes) {
+        free(data->trajectories);
+        free(data->daughters);
+        data->trajectories = NULL;
+        data->daughters = NULL;
+        data->trajectories_capacity = 0;
+        data->daughters_capacity = 0;
+        if (!keep_particles) {
+            free(data->neutrinos);
+            free(data->particles);
+            data->neutrinos = NULL;
+            data->particles = NULL;
+            data->neutrinos_capacity = 0;
+            data->particles_capacity = 0;
+        }
+    }
+
+    if (h5fnal_reserve_truth_mem_data(data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_reserve_truth_batch() */
+
+/************************************************************************
+ * h5fnal_next_truth_batch()
+ *
+ * Reads the next batch of truths, along with the neutrinos, particles,
+ * trajectory points and daughters they refer to. *batch points at the
+ * cursor's data, which is overwritten by the next call. All the indices
+ * in the batch are rebased to index into the batch's arrays.
+ *
+ * This relies on the related elements of consecutive truths (and
+ * particles) being stored in the same order, which is how they are
+ * appended. A batch always has at least one truth, even if that truth
+ * alone is over the memory bound.
+ *
+ * Returns TRUE if there was a batch and FALSE at the end of the data
+ * product.
+ ************************************************************************/
+htri_t
+h5fnal_next_truth_batch(h5fnal_truth_cursor_t *cursor, h5fnal_vect_truth_data_t **batch)
+{
+    h5fnal_vect_truth_data_t *data = NULL;
+    hsize_t chunk_dim;
+    hsize_t n_read;
+    hsize_t n_taken;
+    hsize_t bytes;
+    hsize_t u;
+    hssize_t v;
+
+    /* First element and one past the last element of each related
+     * dataset used by the batch (first == end means none).
+     */
+    hsize_t nu_first = 0, nu_end = 0;
+    hsize_t p_first = 0, p_end = 0;
+    hsize_t t_first = 0, t_end = 0;
+    hsize_t d_first = 0, d_end = 0;
+
+    if (!cursor)
+        H5FNAL_PROGRAM_ERROR("cursor parameter cannot be NULL");
+    if (!batch)
+        H5FNAL_PROGRAM_ERROR("batch parameter cannot be NULL");
+
+    data = &cursor->batch;
+    data->n_truths = 0;
+    data->n_neutrinos = 0;
+    data->n_particles = 0;
+    data->n_trajectories = 0;
+    data->n_daughters = 0;
+    *batch = data;
+
+    if (cursor->next >= cursor->n_truths)
+        return FALSE;
+
+    /* Read up to the end of a chunk of truths */
+    chunk_dim = cursor->vector->truth_buffer.chunk_dim;
+    n_read = H5FNAL_MIN((cursor->next / chunk_dim) * chunk_dim + cursor->window, cursor->n_truths) - cursor->next;
+    data->n_truths = n_read;
+    if (h5fnal_reserve_truth_batch(cursor, FALSE) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for truths");
+    if (h5fnal_read_truths_range(cursor->vector, cursor->next, n_read, data->truths) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read truths");
+
+    /* Take truths until their neutrinos and particles don't fit */
+    for (n_taken = 0; n_taken < n_read; n_taken++) {
+        h5fnal_truth_t *t = &data->truths[n_taken];
+        hsize_t new_nu_first = nu_first, new_nu_end = nu_end;
+        hsize_t new_p_first = p_first, new_p_end = p_end;
+
+        if (t->neutrino_index >= 0) {
+            if (new_nu_first == new_nu_end)
+                new_nu_first = (hsize_t)t->neutrino_index;
+            new_nu_end = H5FNAL_MAX(new_nu_end, (hsize_t)t->neutrino_index + 1);
+        }
+        if (t->particle_start_index >= 0) {
+            if (new_p_first == new_p_end)
+                new_p_first = (hsize_t)t->particle_start_index;
+            new_p_end = H5FNAL_MAX(new_p_end, (hsize_t)t->particle_end_index + 1);
+        }
+
+        bytes = (new_nu_end - new_nu_first) * sizeof(h5fnal_neutrino_t)
+            + (new_p_end - new_p_first) * sizeof(h5fnal_particle_t);
+        if (n_taken > 0 && bytes > cursor->max_related_bytes)
+            break;
+
+        nu_first = new_nu_first;
+        nu_end = new_nu_end;
+        p_first = new_p_first;
+        p_end = new_p_end;
+    }
+
+    data->n_neutrinos = nu_end - nu_first;
+    data->n_particles = p_end - p_first;
+    if (h5fnal_reserve_truth_batch(cursor, FALSE) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for particles");
+    if (h5fnal_read_neutrinos_range(cursor->vector, nu_first, data->n_neutrinos, data->neutrinos) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read neutrinos");
+    if (h5fnal_read_particles_range(cursor->vector, p_first, data->n_particles, data->particles) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read particles");
+
+    /* Now that we have the particles, drop any truths whose trajectory
+     * points and daughters don't fit. The neutrinos and particles we
+     * already read are trimmed to match.
+     */
+    nu_end = nu_first;
+    p_end = p_first;
+    for (u = 0; u < n_taken; u++) {
+        h5fnal_truth_t *t = &data->truths[u];
+        hsize_t new_t_first = t_first, new_t_end = t_end;
+        hsize_t new_d_first = d_first, new_d_end = d_end;
+        hsize_t new_nu_end = nu_end;
+        hsize_t new_p_end = p_end;
+
+        if (t->neutrino_index >= 0)
+            new_nu_end = H5FNAL_MAX(new_nu_end, (hsize_t)t->neutrino_index + 1);
+        if (t->particle_start_index >= 0) {
+            new_p_end = H5FNAL_MAX(new_p_end, (hsize_t)t->particle_end_index + 1);
+            for (v = t->particle_start_index; v <= t->particle_end_index; v++) {
+                h5fnal_particle_t *p = &data->particles[(hsize_t)v - p_first];
+
+                if (p->trajectory_start_index >= 0) {
+                    if (new_t_first == new_t_end)
+                        new_t_first = (hsize_t)p->trajectory_start_index;
+                    new_t_end = H5FNAL_MAX(new_t_end, (hsize_t)p->trajectory_end_index + 1);
+                }
+                if (p->daughter_start_index >= 0) {
+                    if (new_d_first == new_d_end)
+                        new_d_first = (hsize_t)p->daughter_start_index;
+                    new_d_end = H5FNAL_MAX(new_d_end, (hsize_t)p->daughter_end_index + 1);
+                }
+            }
+        }
+
+        bytes = (new_nu_end - nu_first) * sizeof(h5fnal_neutrino_t)
+            + (new_p_end - p_first) * sizeof(h5fnal_particle_t)
+            + (new_t_end - new_t_first) * sizeof(h5fnal_trajectory_t)
+            + (new_d_end - new_d_first) * sizeof(h5fnal_daughter_t);
+        if (u > 0 && bytes > cursor->max_related_bytes)
+            break;
+
+        t_first = new_t_first;
+        t_end = new_t_end;
+        d_first = new_d_first;
+        d_end = new_d_end;
+        nu_end = new_nu_end;
+        p_end = new_p_end;
+    }
+    n_taken = u;
+
+    data->n_truths = n_taken;
+    data->n_neutrinos = nu_end - nu_first;
+    data->n_particles = p_end - p_first;
+    data->n_trajectories = t_end - t_first;
+    data->n_daughters = d_end - d_first;
+    if (h5fnal_reserve_truth_batch(cursor, TRUE) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for trajectories");
+    if (h5fnal_read_trajectories_range(cursor->vector, t_first, data->n_trajectories, data->trajectories) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read trajectories");
+    if (h5fnal_read_daughters_range(cursor->vector, d_first, data->n_daughters, data->daughters) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read daughters");
+
+    /* Make the indices point into this batch's arrays */
+    h5fnal_shift_truth_indices(data, -(hssize_t)nu_first, -(hssize_t)p_first, -(hssize_t)t_first, -(hssize_t)d_first);
+
+    cursor->next += n_taken;
+
+    return TRUE;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_next_truth_batch() */
+
+/************************************************************************
+ * h5fnal_close_truth_cursor()
+ *
+ * Frees the cursor's memory. The data product is not closed.
+ ************************************************************************/
+herr_t
+h5fnal_close_truth_cursor(h5fnal_truth_cursor_t *cursor)
+{
+    if (!cursor)
+        H5FNAL_PROGRAM_ERROR("cursor parameter cannot be NULL");
+
+    if (h5fnal_free_truth_mem_data(&cursor->batch) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free cursor memory");
+
+    memset(cursor, 0, sizeof(h5fnal_truth_cursor_t));
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end h5fnal_close_truth_cursor() */
+
 /* Important in case the library and application use a different
  * memory allocator.
  */
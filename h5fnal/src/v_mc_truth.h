@@ -63,6 +63,32 @@ typedef struct h5fnal_particle_t {
     hssize_t    daughter_end_index;
 } h5fnal_particle_t;
 
+/* Particle fields, for reading only some of them (see
+ * h5fnal_read_particle_projection_range()). Bit i is member i of the
+ * particle datatype.
+ */
+#define H5FNAL_PARTICLE_STATUS                  0x00001U
+#define H5FNAL_PARTICLE_TRACK_ID                0x00002U
+#define H5FNAL_PARTICLE_PDG_CODE                0x00004U
+#define H5FNAL_PARTICLE_MOTHER                  0x00008U
+#define H5FNAL_PARTICLE_PROCESS_INDEX           0x00010U
+#define H5FNAL_PARTICLE_ENDPROCESS_INDEX        0x00020U
+#define H5FNAL_PARTICLE_MASS                    0x00040U
+#define H5FNAL_PARTICLE_POLARIZATION_X          0x00080U
+#define H5FNAL_PARTICLE_POLARIZATION_Y          0x00100U
+#define H5FNAL_PARTICLE_POLARIZATION_Z          0x00200U
+#define H5FNAL_PARTICLE_WEIGHT                  0x00400U
+#define H5FNAL_PARTICLE_GVTX_X                  0x00800U
+#define H5FNAL_PARTICLE_GVTX_Y                  0x01000U
+#define H5FNAL_PARTICLE_GVTX_Z                  0x02000U
+#define H5FNAL_PARTICLE_GVTX_T                  0x04000U
+#define H5FNAL_PARTICLE_RESCATTER               0x08000U
+#define H5FNAL_PARTICLE_TRAJECTORY_START_INDEX  0x10000U
+#define H5FNAL_PARTICLE_TRAJECTORY_END_INDEX    0x20000U
+#define H5FNAL_PARTICLE_DAUGHTER_START_INDEX    0x40000U
+#define H5FNAL_PARTICLE_DAUGHTER_END_INDEX      0x80000U
+#define H5FNAL_PARTICLE_ALL_FIELDS              0xFFFFFU
+
 /* Daughters type (for parent-child relationships)
  * (this struct used to have more fields and could probably
  * just be a single int now)
@@ -84,6 +110,9 @@ typedef struct h5fnal_trajectory_t {
     hsize_t     particle_index;
 } h5fnal_trajectory_t;
 
+/* Number of positions, times and momenta in a trajectory point */
+#define H5FNAL_TRAJECTORY_N_VALUES  8
+
 /* MC Truth Type
  * -1 values mean nothing stored
  */
@@ -94,7 +123,22 @@ typedef struct h5fnal_truth_t {
     hssize_t    particle_end_index;
 } h5fnal_truth_t;
 
-/* Vector of MC Truth Type */
+/* Vector of MC Truth Type
+ *
+ * With column storage the particles are kept in particle_columns
+ * instead of the particle dataset, which is never created, and
+ * particle_buffer is unused.
+ *
+ * particle_graph holds the parent/daughter index (see
+ * particle_graph.h), which is unused for data products created without
+ * the particle_graph option.
+ *
+ * With a delta trajectory encoding (see h5fnal_encoding_t) the
+ * trajectory buffer holds delta coded points, of the
+ * trajectory_code_dtype_id datatype. trajectory_last holds the bit
+ * patterns of the last point appended, which the next one is coded
+ * against.
+ */
 typedef struct h5fnal_vect_truth_t {
     hid_t       top_level_group_id;
 
@@ -111,14 +155,38 @@ typedef struct h5fnal_vect_truth_t {
 
     hid_t       trajectory_dtype_id;
     hid_t       trajectory_dset_id;
+    hid_t       trajectory_code_dtype_id;   /* delta encodings only         */
+    hid_t       trajectory_file_dtype_id;   /* delta_float32 encoding only  */
+    h5fnal_encoding_t trajectory_encoding;
+    hsize_t     trajectory_block;           /* points per delta coded block */
+    uint64_t    trajectory_last[H5FNAL_TRAJECTORY_N_VALUES];
+    hbool_t     trajectory_have_last;
 
     hid_t       truth_dtype_id;
     hid_t       truth_dset_id;
 
+    /* Write-behind buffers for appends */
+    h5fnal_append_buffer_t  neutrino_buffer;
+    h5fnal_append_buffer_t  particle_buffer;
+    h5fnal_append_buffer_t  daughter_buffer;
+    h5fnal_append_buffer_t  trajectory_buffer;
+    h5fnal_append_buffer_t  truth_buffer;
+
+    h5fnal_storage_t        particle_storage;
+    h5fnal_column_set_t     particle_columns;
+
+    h5fnal_graph_store_t    particle_graph;
+
     string_dictionary_t dict;
 } h5fnal_vect_truth_t;
 
-/* In-memory data container for I/O calls */
+/* In-memory data container for I/O calls
+ *
+ * The capacities are the number of elements each array can hold.
+ * h5fnal_read_all_truths_into() reads into the arrays without
+ * allocating them, so one set of arrays can be reused for every
+ * event in a file.
+ */
 typedef struct h5fnal_vect_truth_data_t {
     hsize_t                 n_truths;
     hsize_t                 n_trajectories;
@@ -131,8 +199,37 @@ typedef struct h5fnal_vect_truth_data_t {
     h5fnal_particle_t      *particles;
     h5fnal_neutrino_t      *neutrinos;
     h5fnal_truth_strings_t *truth_strings;
+    hsize_t                 truths_capacity;
+    hsize_t                 trajectories_capacity;
+    hsize_t                 daughters_capacity;
+    hsize_t                 particles_capacity;
+    hsize_t                 neutrinos_capacity;
 } h5fnal_vect_truth_data_t;
 
+/* Cursor over a Vector of MC Truth
+ *
+ * Hands out the truths in consecutive batches, each with the
+ * neutrinos, particles, trajectory points and daughters it refers to,
+ * so a data product of any size can be processed in bounded memory
+ * (see h5fnal_open_truth_cursor()).
+ */
+typedef struct h5fnal_truth_cursor_t {
+    h5fnal_vect_truth_t        *vector;
+    size_t                      max_bytes;          /* memory bound for a batch         */
+    hsize_t                     max_related_bytes;  /* bound for all but the truths     */
+    hsize_t                     window;             /* truths read at a time            */
+    hsize_t                     n_truths;           /* in the data product              */
+    hsize_t                     next;               /* next truth to hand out           */
+    h5fnal_vect_truth_data_t    batch;
+} h5fnal_truth_cursor_t;
+
+/* Event index slots for the datasets in this data product (flat layout) */
+#define H5FNAL_TRUTH_RANGE_TRUTHS           0
+#define H5FNAL_TRUTH_RANGE_NEUTRINOS        1
+#define H5FNAL_TRUTH_RANGE_PARTICLES        2
+#define H5FNAL_TRUTH_RANGE_TRAJECTORIES     3
+#define H5FNAL_TRUTH_RANGE_DAUGHTERS        4
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -142,15 +239,39 @@ hid_t h5fnal_create_neutrino_type(void);
 hid_t h5fnal_create_particle_type(void);
 hid_t h5fnal_create_daughter_type(void);
 hid_t h5fnal_create_trajectory_type(void);
+hid_t h5fnal_create_trajectory_delta_type(void);
+hid_t h5fnal_create_trajectory_delta_float32_type(void);
 hid_t h5fnal_create_truth_type(void);
 
-herr_t h5fnal_create_v_mc_truth(hid_t loc_id, const char *name, h5fnal_vect_truth_t *vector);
+herr_t h5fnal_create_v_mc_truth(hid_t loc_id, const char *name, const h5fnal_create_options_t *options,
+        h5fnal_vect_truth_t *vector);
 herr_t h5fnal_open_v_mc_truth(hid_t loc_id, const char *name, h5fnal_vect_truth_t *vector);
 herr_t h5fnal_close_v_mc_truth(h5fnal_vect_truth_t *vector);
 
 herr_t h5fnal_append_truths(h5fnal_vect_truth_t *vector, h5fnal_vect_truth_data_t *data);
 herr_t h5fnal_read_all_truths(h5fnal_vect_truth_t *vector, h5fnal_vect_truth_data_t *data);
+herr_t h5fnal_read_all_truths_into(h5fnal_vect_truth_t *vector, h5fnal_vect_truth_data_t *data);
+herr_t h5fnal_get_truth_sizes(h5fnal_vect_truth_t *vector, h5fnal_vect_truth_data_t *data);
+herr_t h5fnal_read_truths_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count, h5fnal_truth_t *buf);
+herr_t h5fnal_read_trajectories_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count, h5fnal_trajectory_t *buf);
+herr_t h5fnal_read_daughters_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count, h5fnal_daughter_t *buf);
+herr_t h5fnal_read_particles_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count, h5fnal_particle_t *buf);
+herr_t h5fnal_read_particle_projection_range(h5fnal_vect_truth_t *vector, unsigned fields, hsize_t start, hsize_t count,
+        void *buf);
+herr_t h5fnal_read_neutrinos_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count, h5fnal_neutrino_t *buf);
+htri_t h5fnal_read_particle_graph_range(h5fnal_vect_truth_t *vector, hsize_t start, hsize_t count,
+        h5fnal_particle_graph_t *graph);
+
+herr_t h5fnal_append_event_truths(h5fnal_vect_truth_t *vector, h5fnal_event_index_t *index,
+        unsigned run, unsigned subrun, unsigned event, h5fnal_vect_truth_data_t *data);
+herr_t h5fnal_read_event_truths(h5fnal_vect_truth_t *vector, const h5fnal_event_entry_t *entry,
+        h5fnal_vect_truth_data_t *data);
+
+herr_t h5fnal_open_truth_cursor(h5fnal_vect_truth_t *vector, size_t max_bytes, h5fnal_truth_cursor_t *cursor);
+htri_t h5fnal_next_truth_batch(h5fnal_truth_cursor_t *cursor, h5fnal_vect_truth_data_t **batch);
+herr_t h5fnal_close_truth_cursor(h5fnal_truth_cursor_t *cursor);
 
+herr_t h5fnal_reserve_truth_mem_data(h5fnal_vect_truth_data_t *data);
 herr_t h5fnal_free_truth_mem_data(h5fnal_vect_truth_data_t *data);
 
 #ifdef __cplusplus
@@ -0,0 +1,114 @@
+/* Microbenchmark for string dictionary lookups
+ *
+ * Builds dictionaries of increasing size and times lookups of strings
+ * that are in them and strings that aren't. The time per lookup should
+ * stay about the same as the dictionary grows, apart from cache misses
+ * once the dictionary no longer fits in the CPU caches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "h5fnal.h"
+#include "string_dictionary.h"
+
+#define FILE_NAME   "bench_string_dictionary.h5"
+
+#define N_LOOKUPS   1000000
+#define MAX_STRINGS 1000000
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + 1.0e-9 * (double)ts.tv_nsec;
+} /* end now() */
+
+int
+main(void)
+{
+    hid_t   fid = -1;
+    hid_t   gid = -1;
+    string_dictionary_t dict;
+    hbool_t found;
+    unsigned index;
+    unsigned n_strings;
+    unsigned n_found;
+    unsigned u;
+    char name[64];
+    double start;
+    double hit_ns;
+    double miss_ns;
+
+    memset(&dict, 0, sizeof(string_dictionary_t));
+
+    if ((fid = H5Fcreate(FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    printf("%12s %16s %16s\n", "strings", "found (ns)", "not found (ns)");
+
+    for (n_strings = 10; n_strings <= MAX_STRINGS; n_strings *= 10) {
+        snprintf(name, sizeof(name), "%u", n_strings);
+        if ((gid = H5Gcreate2(fid, name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (create_string_dictionary(gid, NULL, &dict) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create string dictionary");
+
+        /* Strings like the process names in MC truth data */
+        for (u = 0; u < n_strings; u++) {
+            snprintf(name, sizeof(name), "process_%u", u);
+            if (add_string_to_dictionary(name, &dict) < 0)
+                H5FNAL_PROGRAM_ERROR("could not add string to dictionary");
+        }
+
+        n_found = 0;
+        start = now();
+        for (u = 0; u < N_LOOKUPS; u++) {
+            snprintf(name, sizeof(name), "process_%u", (u * 7919U) % n_strings);
+            if (get_string_index(name, &dict, &found, &index) < 0)
+                H5FNAL_PROGRAM_ERROR("problem checking for string");
+            n_found += found ? 1 : 0;
+        }
+        hit_ns = 1.0e9 * (now() - start) / N_LOOKUPS;
+        if (n_found != N_LOOKUPS)
+            H5FNAL_PROGRAM_ERROR("strings missing from dictionary");
+
+        start = now();
+        for (u = 0; u < N_LOOKUPS; u++) {
+            snprintf(name, sizeof(name), "missing_%u", u);
+            if (get_string_index(name, &dict, &found, &index) < 0)
+                H5FNAL_PROGRAM_ERROR("problem checking for string");
+            n_found += found ? 1 : 0;
+        }
+        miss_ns = 1.0e9 * (now() - start) / N_LOOKUPS;
+        if (n_found != N_LOOKUPS)
+            H5FNAL_PROGRAM_ERROR("found strings that aren't in the dictionary");
+
+        printf("%12u %16.1f %16.1f\n", n_strings, hit_ns, miss_ns);
+
+        if (close_string_dictionary(&dict) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close string dictionary");
+        if (H5Gclose(gid) < 0)
+            H5FNAL_HDF5_ERROR;
+        gid = -1;
+    }
+
+    if (H5Fclose(fid) < 0)
+        H5FNAL_HDF5_ERROR;
+    remove(FILE_NAME);
+
+    exit(EXIT_SUCCESS);
+
+error:
+    H5E_BEGIN_TRY {
+        H5Gclose(gid);
+        H5Fclose(fid);
+    } H5E_END_TRY;
+
+    exit(EXIT_FAILURE);
+}
@@ -13,6 +13,9 @@
 #define EVENT_NAME          "testevent"
 #define ASSNS_NAME          "assns"
 #define ASSNS_DATA_NAME     "assns_data"
+#define EMPTY_DATA_NAME     "assns_data_empty"
+#define FLAT_NAME           "assns_flat"
+#define N_EVENTS            4
 #define LEFT_NAME           "left_data_product"
 #define RIGHT_NAME          "right_data_product"
 
@@ -91,8 +94,17 @@ main(void)
     /* Data */
     h5fnal_assns_data_t    *data = NULL;
     h5fnal_assns_data_t    *data_out = NULL;
+    h5fnal_assns_data_t     few;
     size_t                  size;
 
+    /* Flat layout */
+    h5fnal_event_index_t    index;
+    h5fnal_event_entry_t    entry;
+    hsize_t                 event_sizes[N_EVENTS] = {1000, 0, 3000, 517};
+    hsize_t                 start;
+    htri_t                  found;
+    int                     i;
+
     printf("Testing Assns operations... ");
 
     /********************/
@@ -122,13 +134,13 @@ main(void)
     /* Create the assns data product */
     if (NULL == (assns = calloc(1, sizeof(h5fnal_assns_t))))
         H5FNAL_PROGRAM_ERROR("could not get memory for assns");
-    if (h5fnal_create_assns(event_id, ASSNS_NAME, LEFT_NAME, RIGHT_NAME, H5FNAL_BAD_HID_T, assns) < 0)
+    if (h5fnal_create_assns(event_id, ASSNS_NAME, LEFT_NAME, RIGHT_NAME, H5FNAL_BAD_HID_T, NULL, assns) < 0)
         H5FNAL_PROGRAM_ERROR("could not create assns data product");
 
     /* Create the assns data product that uses 'extra' data */
     if (NULL == (assns_data = calloc(1, sizeof(h5fnal_assns_t))))
         H5FNAL_PROGRAM_ERROR("could not get memory for assns_data");
-    if (h5fnal_create_assns(event_id, ASSNS_DATA_NAME, LEFT_NAME, RIGHT_NAME, H5T_STD_I64LE, assns_data) < 0)
+    if (h5fnal_create_assns(event_id, ASSNS_DATA_NAME, LEFT_NAME, RIGHT_NAME, H5T_STD_I64LE, NULL, assns_data) < 0)
         H5FNAL_PROGRAM_ERROR("could not create assns_data data product");
 
     /* Make sure we are getting the names of the left and right data products out */
@@ -297,6 +309,107 @@ main(void)
     if (h5fnal_free_assns_mem_data(data_out) < 0)
         H5FNAL_PROGRAM_ERROR("could not free assns memory");
 
+    /*************************************/
+    /* APPEND TO A RE-OPENED EMPTY ASSNS */
+    /*************************************/
+
+    /* An empty data product has no data dataset, but it still has to
+     * know its data type when re-opened or the appended pairs would get
+     * no data.
+     */
+    if (h5fnal_close_assns(assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close assns_data");
+    if (h5fnal_create_assns(event_id, EMPTY_DATA_NAME, LEFT_NAME, RIGHT_NAME, H5T_STD_I64LE, NULL, assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create empty assns_data data product");
+    if (h5fnal_close_assns(assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close empty assns_data");
+    if (h5fnal_open_assns(event_id, EMPTY_DATA_NAME, assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open empty assns_data data product");
+    if (assns_data->data_dtype_id < 0)
+        H5FNAL_PROGRAM_ERROR("empty assns_data lost its data type");
+    if (H5Tequal(assns_data->data_dtype_id, H5T_STD_I64LE) <= 0)
+        H5FNAL_PROGRAM_ERROR("empty assns_data has the wrong data type");
+
+    few = *data;
+    few.n = 100;
+    if (h5fnal_append_assns(assns_data, &few) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write assns (w/ data) to the re-opened data product");
+    if (h5fnal_close_assns(assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close empty assns_data");
+    if (h5fnal_open_assns(event_id, EMPTY_DATA_NAME, assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open empty assns_data data product");
+
+    if (h5fnal_read_all_assns(assns_data, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read assns from the file");
+    if (data_out->n != few.n || NULL == data_out->data)
+        H5FNAL_PROGRAM_ERROR("got wrong number of Assns from re-opened data product");
+    if (0 != memcmp(few.pairs, data_out->pairs, few.n * sizeof(h5fnal_pair_t)))
+        H5FNAL_PROGRAM_ERROR("Assns pair buffer incorrect after re-open");
+    if (0 != memcmp(few.data, data_out->data, few.n * sizeof(int64_t)))
+        H5FNAL_PROGRAM_ERROR("Assns data buffer incorrect after re-open");
+    if (h5fnal_free_assns_mem_data(data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free assns memory");
+
+    /***************/
+    /* FLAT LAYOUT */
+    /***************/
+
+    /* One data product for several events of different sizes (one of
+     * them empty), added in reverse event order and read back through
+     * the event index.
+     */
+    if (h5fnal_close_assns(assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close assns_data");
+    if (h5fnal_create_assns(subrun_id, FLAT_NAME, LEFT_NAME, RIGHT_NAME, H5T_STD_I64LE, NULL, assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create flat assns_data data product");
+    if (h5fnal_create_event_index(assns_data->top_level_group_id, NULL, &index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create event index");
+    start = 0;
+    for (i = 0; i < N_EVENTS; i++) {
+        few.pairs = data->pairs + start;
+        few.data = (int64_t *)data->data + start;
+        few.n = event_sizes[i];
+        if (h5fnal_append_event_assns(assns_data, &index, 1, 2, (unsigned)(N_EVENTS - i), &few) < 0)
+            H5FNAL_PROGRAM_ERROR("could not append event assns");
+        start += event_sizes[i];
+    }
+    if (h5fnal_close_event_index(&index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close event index");
+    if (h5fnal_close_assns(assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close flat assns_data");
+
+    if (h5fnal_open_assns(subrun_id, FLAT_NAME, assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open flat assns_data data product");
+    if (h5fnal_open_event_index(assns_data->top_level_group_id, &index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open event index");
+    if (index.n_entries != N_EVENTS || !index.sorted)
+        H5FNAL_PROGRAM_ERROR("bad event index");
+    start = 0;
+    for (i = 0; i < N_EVENTS; i++) {
+        if ((found = h5fnal_find_event(&index, 1, 2, (unsigned)(N_EVENTS - i), &entry)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not look up event");
+        if (!found)
+            H5FNAL_PROGRAM_ERROR("event missing from event index");
+        if (entry.start[H5FNAL_ASSNS_RANGE_PAIRS] != start || entry.count[H5FNAL_ASSNS_RANGE_PAIRS] != event_sizes[i])
+            H5FNAL_PROGRAM_ERROR("wrong event index range");
+
+        if (h5fnal_read_event_assns(assns_data, &entry, data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read event assns");
+        if (data_out->n != event_sizes[i])
+            H5FNAL_PROGRAM_ERROR("got wrong number of Assns for event");
+        if (0 != memcmp(data->pairs + start, data_out->pairs, data_out->n * sizeof(h5fnal_pair_t)))
+            H5FNAL_PROGRAM_ERROR("Assns pair buffer incorrect for event");
+        if (0 != memcmp((int64_t *)data->data + start, data_out->data, data_out->n * sizeof(int64_t)))
+            H5FNAL_PROGRAM_ERROR("Assns data buffer incorrect for event");
+        start += event_sizes[i];
+    }
+    if ((found = h5fnal_find_event(&index, 1, 2, N_EVENTS + 1, &entry)) != FALSE)
+        H5FNAL_PROGRAM_ERROR("found an event that isn't there");
+    if (h5fnal_close_event_index(&index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close event index");
+    if (h5fnal_free_assns_mem_data(data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free assns memory");
+
     /********************/
     /* CLOSE EVERYTHING */
     /********************/
@@ -14,16 +14,28 @@
 #define STRING_EMPTY        ""
 #define STRING_SHORT        "foo"
 #define STRING_LONG         "This is a longer string with spaces!\n"
+#define STRING_APPENDED     "added after re-opening"
+
+/* Enough strings to make the hash index grow a few times */
+#define GROUP_NAME          "many_strings"
+#define N_MANY_STRINGS      1000
 
 int
 main(void)
 {
     hid_t   fid = -1;
     hid_t   fapl_id = -1;
+    hid_t   gid = -1;
     string_dictionary_t *dict = NULL;
     hbool_t found;
     unsigned index;
     char *s = NULL;
+    const char *view;
+    h5fnal_create_options_t options;
+    size_t len;
+    char name[64];
+    unsigned u;
+    int pass;
 
     printf("Testing string dictionary operations... ");
 
@@ -38,7 +50,7 @@ main(void)
     /* Create a string dictionary */
     if (NULL == (dict = (string_dictionary_t *)calloc(1, sizeof(string_dictionary_t))))
         H5FNAL_PROGRAM_ERROR("could not get memory for dictionary");
-    if (create_string_dictionary(fid, dict) < 0)
+    if (create_string_dictionary(fid, NULL, dict) < 0)
         H5FNAL_PROGRAM_ERROR("could not create string dictionary");
 
     /* Add some strings */
@@ -94,10 +106,135 @@ main(void)
     if (strcmp(STRING_LONG, s))
         H5FNAL_PROGRAM_ERROR("wrong string returned");
     free(s);
+    s = NULL;
+
+    /* Views point into the dictionary instead of copying */
+    if (get_string_view(dict, 0, &view, &len) < 0)
+        H5FNAL_PROGRAM_ERROR("problem getting string view");
+    if (len != 0 || strcmp(STRING_EMPTY, view))
+        H5FNAL_PROGRAM_ERROR("wrong string view returned");
+    if (get_string_view(dict, 2, &view, &len) < 0)
+        H5FNAL_PROGRAM_ERROR("problem getting string view");
+    if (len != strlen(STRING_LONG) || strcmp(STRING_LONG, view))
+        H5FNAL_PROGRAM_ERROR("wrong string view returned");
+    if (view != dict->concat_strings + dict->indices[2].start)
+        H5FNAL_PROGRAM_ERROR("string view is a copy");
+
+    if(close_string_dictionary(dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close string dictionary");
+
+    /* Look up a lot of strings, before and after re-opening. A string
+     * that is added twice is found at its first index.
+     */
+    if ((gid = H5Gcreate2(fid, GROUP_NAME, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    /* (Small chunks, so the strings are read in many blocks) */
+    if (h5fnal_init_create_options(&options) < 0)
+        H5FNAL_PROGRAM_ERROR("could not initialize creation options");
+    options.chunk_policy.target_bytes = 256;
+    if (create_string_dictionary(gid, &options, dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create string dictionary");
+    for (u = 0; u < N_MANY_STRINGS; u++) {
+        snprintf(name, sizeof(name), "string %u", u);
+        if (add_string_to_dictionary(name, dict) < 0)
+            H5FNAL_PROGRAM_ERROR("could not add string to dictionary");
+    }
+    if (add_string_to_dictionary("string 0", dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not add string to dictionary");
+
+    for (pass = 0; pass < 2; pass++) {
+        if (1 == pass) {
+            if(close_string_dictionary(dict) < 0)
+                H5FNAL_PROGRAM_ERROR("could not close string dictionary");
+            if (open_string_dictionary(gid, dict) < 0)
+                H5FNAL_PROGRAM_ERROR("could not open string dictionary");
+        }
+        if (dict->n_strings != N_MANY_STRINGS + 2)
+            H5FNAL_PROGRAM_ERROR("wrong number of strings");
+        for (u = 0; u < N_MANY_STRINGS; u++) {
+            snprintf(name, sizeof(name), "string %u", u);
+            if (get_string_index(name, dict, &found, &index) < 0)
+                H5FNAL_PROGRAM_ERROR("problem checking for string");
+            if(!found || index != u + 1)
+                H5FNAL_PROGRAM_ERROR("wrong string index returned");
+        }
+        if (get_string_index(STRING_NOT_FOUND, dict, &found, &index) < 0)
+            H5FNAL_PROGRAM_ERROR("problem checking for string");
+        if(found || index != dict->n_strings)
+            H5FNAL_PROGRAM_ERROR("should not have found this string");
+        if (get_string_index(STRING_EMPTY, dict, &found, &index) < 0)
+            H5FNAL_PROGRAM_ERROR("problem checking for string");
+        if(!found || index != 0)
+            H5FNAL_PROGRAM_ERROR("wrong string index returned");
+    }
+
+    /* The file was opened read-write, so the re-opened dictionary can
+     * gain strings. A flush writes only the new ones.
+     */
+    if (!dict->save_on_close)
+        H5FNAL_PROGRAM_ERROR("dictionary in a read-write file is read-only");
+    if (add_string_to_dictionary(STRING_APPENDED, dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not add string to dictionary");
+    if (flush_string_dictionary(dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush string dictionary");
+    if (h5fnal_get_dset_size(dict->indices_dset_id) != N_MANY_STRINGS + 3
+            || h5fnal_get_dset_size(dict->strings_dset_id) != (hssize_t)dict->total_string_size)
+        H5FNAL_PROGRAM_ERROR("flush did not write the new string");
+    if (flush_string_dictionary(dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not flush string dictionary");
+    if (add_string_to_dictionary(STRING_SHORT, dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not add string to dictionary");
+    if(close_string_dictionary(dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close string dictionary");
+    if (H5Gclose(gid) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Fclose(fid) < 0)
+        H5FNAL_HDF5_ERROR;
+
+    /* Re-open the file read-only and check the appended strings */
+    if ((fid = H5Fopen(FILE_NAME, H5F_ACC_RDONLY, fapl_id)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((gid = H5Gopen2(fid, GROUP_NAME, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (open_string_dictionary(gid, dict) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open string dictionary");
+    if (dict->save_on_close)
+        H5FNAL_PROGRAM_ERROR("dictionary in a read-only file is writable");
+
+    /* Opening reads nothing, getting a string reads only the indices
+     * and the string's block, and a lookup by string reads the rest
+     */
+    if (dict->indices != NULL || dict->hash_slots != NULL || dict->blocks_loaded == NULL)
+        H5FNAL_PROGRAM_ERROR("dictionary was read at open");
+    if (get_string_view(dict, N_MANY_STRINGS + 2, &view, &len) < 0)
+        H5FNAL_PROGRAM_ERROR("problem getting string view");
+    if (len != strlen(STRING_APPENDED) || strcmp(STRING_APPENDED, view))
+        H5FNAL_PROGRAM_ERROR("wrong string view returned");
+    if (dict->indices == NULL || dict->hash_slots != NULL || dict->blocks_loaded == NULL
+            || dict->block_size != 256 || dict->blocks_loaded[0])
+        H5FNAL_PROGRAM_ERROR("getting a string read the whole dictionary");
+    if (dict->n_strings != N_MANY_STRINGS + 4)
+        H5FNAL_PROGRAM_ERROR("wrong number of strings");
+    if (get_string_index(STRING_APPENDED, dict, &found, &index) < 0)
+        H5FNAL_PROGRAM_ERROR("problem checking for string");
+    if(!found || index != N_MANY_STRINGS + 2)
+        H5FNAL_PROGRAM_ERROR("wrong string index returned");
+    if (get_string_index(STRING_SHORT, dict, &found, &index) < 0)
+        H5FNAL_PROGRAM_ERROR("problem checking for string");
+    if(!found || index != N_MANY_STRINGS + 3)
+        H5FNAL_PROGRAM_ERROR("wrong string index returned");
+    if (get_string_index("string 7", dict, &found, &index) < 0)
+        H5FNAL_PROGRAM_ERROR("problem checking for string");
+    if(!found || index != 8)
+        H5FNAL_PROGRAM_ERROR("wrong string index returned");
+    if (dict->hash_slots == NULL || dict->blocks_loaded != NULL)
+        H5FNAL_PROGRAM_ERROR("lookup did not read the whole dictionary");
 
     /* Close everything */
     if(close_string_dictionary(dict) < 0)
         H5FNAL_PROGRAM_ERROR("could not close string dictionary");
+    if (H5Gclose(gid) < 0)
+        H5FNAL_HDF5_ERROR;
 
     if (H5Pclose(fapl_id) < 0)
         H5FNAL_HDF5_ERROR;
@@ -111,6 +248,7 @@ main(void)
 
 error:
     H5E_BEGIN_TRY {
+        H5Gclose(gid);
         H5Pclose(fapl_id);
         H5Fclose(fid);
     } H5E_END_TRY;
@@ -8,10 +8,26 @@
 #include "h5fnal.h"
 
 #define FILE_NAME   "vmchc.h5"
+#define FILE_NAME_2 "vmchc_default.h5"
 #define RUN_NAME    "test_run"
 #define SUBRUN_NAME "test_subrun"
 #define EVENT_NAME  "test_event"
 #define VECTOR_NAME "test_hit_collection"
+#define MULTI_NAME  "test_hit_collection_multi"
+#define COMP_NAME   "test_hit_collection_compression"
+#define POOL_NAME   "test_hit_collection_parallel"
+#define EMPTY_NAME  "test_hit_collection_empty"
+#define SMALL_NAME  "test_hit_collection_small"
+#define REOPEN_NAME "test_hit_collection_reopen"
+#define FLAT_NAME   "test_hit_collection_flat"
+#define COLUMN_NAME "test_hit_collection_columns"
+
+/* Compact struct for projected reads */
+typedef struct compact_hit_t {
+    float   signal_time;
+    float   charge;
+    int     part_track_id;
+} compact_hit_t;
 
 h5fnal_vect_hitcoll_data_t *
 generate_test_hit_collections(hsize_t n_hit_collections)
@@ -102,24 +118,89 @@ int
 main(void)
 {
     hid_t   fid = -1;
-    hid_t   fapl_id = -1;
+    hid_t   fcpl_id = -1;
     hid_t   run_id = -1;
     hid_t   subrun_id = -1;
     hid_t   event_id = -1;
     h5fnal_vect_hitcoll_t *vector = NULL;
     hsize_t n_hit_collections;
+    hsize_t u;
     h5fnal_vect_hitcoll_data_t *data = NULL;
     h5fnal_vect_hitcoll_data_t *data_out = NULL;
+    h5fnal_hit_t *hits_out = NULL;
+    compact_hit_t *compact = NULL;
+    h5fnal_hitcoll_cursor_t cursor;
+    h5fnal_vect_hitcoll_data_t *batch = NULL;
+    h5fnal_vect_hitcoll_data_t empty;
+    h5fnal_event_index_t index;
+    h5fnal_event_entry_t entry;
+    htri_t found;
+    h5fnal_event_lookup_t lookup;
+    h5fnal_summary_table_t summaries;
+    h5fnal_event_summary_t summary;
+    h5fnal_skim_criteria_t criteria;
+    h5fnal_event_summary_t *selected = NULL;
+    double total_charge;
+    float min_time;
+    float max_time;
+    hid_t   event_id_out = -1;
+    h5fnal_group_cache_t group_cache;
+    hid_t   cached_id = -1;
+    hid_t   cached_run_id = -1;
+    hid_t   cached_subrun_id = -1;
+    ssize_t n_open;
+    hsize_t count;
+    hsize_t n_batches;
+    h5fnal_vect_hitcoll_data_t reopen;
+    h5fnal_hitcoll_t reopen_hc;
+    htri_t more;
+    h5fnal_create_options_t options;
+    hid_t   dcpl_id = -1;
+    hid_t   did = -1;
+    hid_t   column_tid = -1;
+    hid_t   tid = -1;
+    hid_t   sid = -1;
+    hid_t   dcpl_ids[2] = {-1, -1};
+    herr_t  ret;
+    hsize_t chunk_dim;
+    h5fnal_file_settings_t settings;
+    H5F_fspace_strategy_t strategy;
+    hsize_t page_size;
+    hsize_t policy[3];
+    H5D_layout_t layout;
+    hsize_t dims[1];
+    hsize_t max_dims[1];
+    h5fnal_compression_method_t methods[] = {H5FNAL_COMPRESSION_NONE, H5FNAL_COMPRESSION_DEFLATE,
+        H5FNAL_COMPRESSION_LZ4, H5FNAL_COMPRESSION_ZSTD};
+    char name[64];
+    int n_filters;
+    int i;
 
     printf("Testing Vector of MC Hit Collection operations... ");
 
+    memset(&cursor, 0, sizeof(h5fnal_hitcoll_cursor_t));
+    memset(&empty, 0, sizeof(h5fnal_vect_hitcoll_data_t));
+    memset(&group_cache, 0, sizeof(h5fnal_group_cache_t));
+    memset(&summaries, 0, sizeof(h5fnal_summary_table_t));
+
     /* Create the file */
-    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+    if ((fid = h5fnal_create_file(FILE_NAME, H5FNAL_PROFILE_STREAMING_WRITE)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create file");
+
+    /* The streaming write profile uses paged file space */
+    if ((fcpl_id = H5Fget_create_plist(fid)) < 0)
         H5FNAL_HDF5_ERROR;
-    if (H5Pset_libver_bounds(fapl_id, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST) < 0)
+    if (H5Pget_file_space_strategy(fcpl_id, &strategy, NULL, NULL) < 0)
         H5FNAL_HDF5_ERROR;
-    if ((fid = H5Fcreate(FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, fapl_id)) < 0)
+    if (H5Pget_file_space_page_size(fcpl_id, &page_size) < 0)
         H5FNAL_HDF5_ERROR;
+    if (H5Pclose(fcpl_id) < 0)
+        H5FNAL_HDF5_ERROR;
+    fcpl_id = -1;
+    if (h5fnal_get_file_settings(H5FNAL_PROFILE_STREAMING_WRITE, &settings) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get file settings");
+    if (strategy != H5F_FSPACE_STRATEGY_PAGE || page_size != settings.page_size)
+        H5FNAL_PROGRAM_ERROR("file profile was not applied");
 
     /* Create the run, sub-run, and event */
     if ((run_id = h5fnal_create_run(fid, RUN_NAME, FALSE)) < 0)
@@ -132,7 +213,7 @@ main(void)
     /* Create the vector of MC hit collection data product */
     if (NULL == (vector = (h5fnal_vect_hitcoll_t *)calloc(1, sizeof(h5fnal_vect_hitcoll_t))))
         H5FNAL_PROGRAM_ERROR("could not get memory for vector");
-    if (h5fnal_create_v_mc_hit_collection(event_id, VECTOR_NAME, vector) < 0)
+    if (h5fnal_create_v_mc_hit_collection(event_id, VECTOR_NAME, NULL, vector) < 0)
         H5FNAL_PROGRAM_ERROR("could not create vector of mc hit collection");
 
     /* Generate some test data */
@@ -164,6 +245,35 @@ main(void)
     if (h5fnal_open_v_mc_hit_collection(event_id, VECTOR_NAME, vector) < 0)
         H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
 
+    /* The datatypes come from the registry, so they are shared and locked */
+    if ((tid = h5fnal_acquire_type(H5FNAL_TYPE_HIT)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit datatype");
+    if (tid != vector->hit_dtype_id)
+        H5FNAL_PROGRAM_ERROR("hit datatype is not shared");
+    H5E_BEGIN_TRY {
+        ret = H5Tinsert(tid, "extra", 0, H5T_NATIVE_INT);
+    } H5E_END_TRY;
+    if (ret >= 0)
+        H5FNAL_PROGRAM_ERROR("shared hit datatype could be modified");
+    if (h5fnal_release_type(tid) < 0)
+        H5FNAL_PROGRAM_ERROR("could not release hit datatype");
+    tid = -1;
+
+    /* Matching dataset creation property lists are shared, too */
+    if (h5fnal_init_create_options(&options) < 0)
+        H5FNAL_PROGRAM_ERROR("could not initialize create options");
+    if ((dcpl_ids[0] = h5fnal_acquire_dcpl(512, sizeof(h5fnal_hit_t), &options.compression)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset creation property list");
+    if ((dcpl_ids[1] = h5fnal_acquire_dcpl(512, sizeof(h5fnal_hit_t), &options.compression)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get dataset creation property list");
+    if (dcpl_ids[0] != dcpl_ids[1])
+        H5FNAL_PROGRAM_ERROR("dataset creation property list is not shared");
+    for (i = 0; i < 2; i++) {
+        if (h5fnal_release_dcpl(dcpl_ids[i]) < 0)
+            H5FNAL_PROGRAM_ERROR("could not release dataset creation property list");
+        dcpl_ids[i] = -1;
+    }
+
     /* Re-read the hits */
     if (h5fnal_free_hitcoll_mem_data(data_out) < 0)
         H5FNAL_PROGRAM_ERROR("could not free in-memory hit collection data");
@@ -176,10 +286,780 @@ main(void)
     if (memcmp(data->hit_collections, data_out->hit_collections, data->n_hit_collections * sizeof(h5fnal_hitcoll_t)) != 0)
         H5FNAL_PROGRAM_ERROR("bad read data (hit collections)");
 
+    /* Read a single hit collection and its hits with range reads */
+    for (u = 0; u < data->n_hit_collections; u += 37) {
+        h5fnal_hitcoll_t hc;
+
+        memset(&hc, 0, sizeof(h5fnal_hitcoll_t));
+        if (h5fnal_read_hit_collections_range(vector, u, 1, &hc) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read hit collection range");
+        if (memcmp(&hc, &data->hit_collections[u], sizeof(h5fnal_hitcoll_t)) != 0)
+            H5FNAL_PROGRAM_ERROR("bad hit collection range read");
+        memset(data_out->hits, 0, hc.count * sizeof(h5fnal_hit_t));
+        if (h5fnal_read_hits_range(vector, hc.start, hc.count, data_out->hits) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read hit range");
+        if (memcmp(data_out->hits, data->hits + hc.start, hc.count * sizeof(h5fnal_hit_t)) != 0)
+            H5FNAL_PROGRAM_ERROR("bad hit range read");
+    }
+
     /* Close the vector */
     if(h5fnal_close_v_mc_hit_collection(vector) < 0)
         H5FNAL_PROGRAM_ERROR("could not close vector");
 
+    /* Write the same data again, one hit collection per append.
+     *
+     * The small appends go through the write-behind buffers and the
+     * start indices are fixed up as we go, so the result should be
+     * the same as the single large append.
+     *
+     * Use small chunks here so the appends cross a lot of chunk
+     * boundaries.
+     */
+    if (h5fnal_init_create_options(&options) < 0)
+        H5FNAL_PROGRAM_ERROR("could not initialize creation options");
+    options.chunk_policy.target_bytes = 32 * sizeof(h5fnal_hit_t);
+    if (h5fnal_create_v_mc_hit_collection(event_id, MULTI_NAME, &options, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create vector of mc hit collection");
+
+    /* The datasets aren't created until something is appended */
+    if (vector->hit_dset_id >= 0 || H5Lexists(vector->top_level_group_id, "hits", H5P_DEFAULT) != 0)
+        H5FNAL_PROGRAM_ERROR("hit dataset created before any appends");
+
+    /* An element count hint caps the chunk size */
+    options.chunk_policy.expected_elements = 8;
+    if (h5fnal_get_chunk_dim(&options.chunk_policy, sizeof(h5fnal_hit_t)) != 8)
+        H5FNAL_PROGRAM_ERROR("chunk size hint was not used");
+
+    for (u = 0; u < data->n_hit_collections; u++) {
+        h5fnal_hitcoll_t hc = data->hit_collections[u];
+        h5fnal_vect_hitcoll_data_t one;
+
+        one.hits = data->hits + hc.start;
+        one.n_hits = hc.count;
+        hc.start = 0;
+        one.hit_collections = &hc;
+        one.n_hit_collections = 1;
+
+        if (h5fnal_append_hits(vector, &one) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write hit collection to the file");
+    }
+
+    /* Check that the chunk policy was followed and recorded */
+    if ((dcpl_id = H5Dget_create_plist(vector->hit_dset_id)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Pget_chunk(dcpl_id, 1, &chunk_dim) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Pclose(dcpl_id) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (chunk_dim != 32)
+        H5FNAL_PROGRAM_ERROR("wrong chunk size for hit dataset");
+    if (h5fnal_get_hsize_attribute(vector->hit_dset_id, "chunk policy", 3, policy) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read chunk policy attribute");
+    if (policy[0] != options.chunk_policy.target_bytes || policy[1] != 0 || policy[2] != chunk_dim)
+        H5FNAL_PROGRAM_ERROR("wrong chunk policy attribute values");
+
+    /* Read and compare before and after closing the vector */
+    if (h5fnal_free_hitcoll_mem_data(data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free in-memory hit collection data");
+    if (h5fnal_read_all_hits(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collections from the file");
+    if (data_out->n_hits != data->n_hits || data_out->n_hit_collections != data->n_hit_collections)
+        H5FNAL_PROGRAM_ERROR("wrong number of elements after multiple appends");
+    if (memcmp(data->hits, data_out->hits, data->n_hits * sizeof(h5fnal_hit_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad read data after multiple appends (hits)");
+    if (memcmp(data->hit_collections, data_out->hit_collections, data->n_hit_collections * sizeof(h5fnal_hitcoll_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad read data after multiple appends (hit collections)");
+
+    /* The extent grew geometrically, so it can run ahead of the data
+     * until the vector is closed.
+     */
+    if (h5fnal_get_dset_extent(vector->hit_dset_id) < (hssize_t)data->n_hits)
+        H5FNAL_PROGRAM_ERROR("hit dataset extent is too small");
+    if (h5fnal_get_dset_size(vector->hit_dset_id) != (hssize_t)data->n_hits)
+        H5FNAL_PROGRAM_ERROR("wrong hit dataset size");
+
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+    if (h5fnal_open_v_mc_hit_collection(event_id, MULTI_NAME, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
+
+    /* Closing trims the extent and removes the logical size */
+    if (h5fnal_get_dset_extent(vector->hit_dset_id) != (hssize_t)data->n_hits)
+        H5FNAL_PROGRAM_ERROR("hit dataset extent was not trimmed");
+    if (H5Aexists(vector->hit_dset_id, "logical size") != 0)
+        H5FNAL_PROGRAM_ERROR("logical size attribute was not removed");
+
+    if (h5fnal_free_hitcoll_mem_data(data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free in-memory hit collection data");
+    if (h5fnal_read_all_hits(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collections from the file");
+    if (memcmp(data->hits, data_out->hits, data->n_hits * sizeof(h5fnal_hit_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad re-read data after multiple appends (hits)");
+    if (memcmp(data->hit_collections, data_out->hit_collections, data->n_hit_collections * sizeof(h5fnal_hitcoll_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad re-read data after multiple appends (hit collections)");
+
+    /* Walk the data product with a cursor. The memory bound is small
+     * enough that some hit collections don't fit in it on their own,
+     * so the data product has to come back in several batches.
+     */
+    if (h5fnal_open_hitcoll_cursor(vector, 2048, &cursor) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open hit collection cursor");
+    u = 0;
+    n_batches = 0;
+    while ((more = h5fnal_next_hitcoll_batch(&cursor, &batch)) > 0) {
+        hsize_t v;
+
+        n_batches++;
+        if (0 == batch->n_hit_collections)
+            H5FNAL_PROGRAM_ERROR("empty cursor batch");
+        for (v = 0; v < batch->n_hit_collections; v++, u++) {
+            h5fnal_hitcoll_t *hc = &batch->hit_collections[v];
+
+            if (hc->channel != data->hit_collections[u].channel || hc->count != data->hit_collections[u].count)
+                H5FNAL_PROGRAM_ERROR("bad hit collection from cursor");
+            if (hc->count > 0 && memcmp(batch->hits + hc->start, data->hits + data->hit_collections[u].start,
+                        hc->count * sizeof(h5fnal_hit_t)) != 0)
+                H5FNAL_PROGRAM_ERROR("bad hits from cursor");
+        }
+    }
+    if (more < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit collection batch");
+    if (u != data->n_hit_collections)
+        H5FNAL_PROGRAM_ERROR("cursor did not return all the hit collections");
+    if (n_batches < 2)
+        H5FNAL_PROGRAM_ERROR("cursor returned everything in one batch");
+    if (h5fnal_close_hitcoll_cursor(&cursor) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close hit collection cursor");
+
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    /* Write and re-read the data with each compression method. LZ4
+     * and Zstandard fall back to deflate when they aren't available.
+     */
+    for (i = 0; i < (int)(sizeof(methods) / sizeof(methods[0])); i++) {
+        if (h5fnal_init_create_options(&options) < 0)
+            H5FNAL_PROGRAM_ERROR("could not initialize creation options");
+        options.compression.method = methods[i];
+        options.compression.level = 1;
+        options.compression.shuffle = (i % 2) ? TRUE : FALSE;
+
+        sprintf(name, "%s_%d", COMP_NAME, (int)methods[i]);
+        if (h5fnal_create_v_mc_hit_collection(event_id, name, &options, vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create vector of mc hit collection");
+        if (h5fnal_append_hits(vector, data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write hit collections to the file");
+
+        /* No compression means no filters at all */
+        if ((dcpl_id = H5Dget_create_plist(vector->hit_dset_id)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if ((n_filters = H5Pget_nfilters(dcpl_id)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (H5Pclose(dcpl_id) < 0)
+            H5FNAL_HDF5_ERROR;
+        if ((H5FNAL_COMPRESSION_NONE == methods[i]) != (0 == n_filters))
+            H5FNAL_PROGRAM_ERROR("wrong filters for compression method");
+
+        if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close vector");
+        if (h5fnal_open_v_mc_hit_collection(event_id, name, vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
+
+        /* Re-use the read buffers from the last pass (they are already
+         * large enough, so nothing should be reallocated)
+         */
+        hits_out = data_out->hits;
+        if (h5fnal_get_hitcoll_sizes(vector, data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not get hit collection sizes");
+        if (h5fnal_reserve_hitcoll_mem_data(data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not reserve in-memory hit collection data");
+        if (data_out->hits != hits_out)
+            H5FNAL_PROGRAM_ERROR("hit array was reallocated");
+        if (h5fnal_read_all_hits_into(vector, data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read hit collections from the file");
+        if (data_out->n_hits != data->n_hits || data_out->n_hit_collections != data->n_hit_collections)
+            H5FNAL_PROGRAM_ERROR("wrong number of elements with compression");
+        if (memcmp(data->hits, data_out->hits, data->n_hits * sizeof(h5fnal_hit_t)) != 0)
+            H5FNAL_PROGRAM_ERROR("bad read data with compression (hits)");
+        if (memcmp(data->hit_collections, data_out->hit_collections, data->n_hit_collections * sizeof(h5fnal_hitcoll_t)) != 0)
+            H5FNAL_PROGRAM_ERROR("bad read data with compression (hit collections)");
+
+        if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close vector");
+    }
+
+    /* Write the data again with parallel compression and direct chunk
+     * writes. The data is read back through the normal HDF5 filter
+     * pipeline.
+     */
+    if (h5fnal_start_compression_pool(4) < 0)
+        H5FNAL_PROGRAM_ERROR("could not start compression pool");
+    if (h5fnal_init_create_options(&options) < 0)
+        H5FNAL_PROGRAM_ERROR("could not initialize creation options");
+    options.chunk_policy.target_bytes = 16 * sizeof(h5fnal_hit_t);
+    options.parallel_compression = TRUE;
+    options.growth = H5FNAL_GROWTH_EXACT;
+    if (h5fnal_create_v_mc_hit_collection(event_id, POOL_NAME, &options, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create vector of mc hit collection");
+    if (!vector->hit_buffer.use_pool)
+        H5FNAL_PROGRAM_ERROR("parallel compression was not set up");
+    for (u = 0; u < data->n_hit_collections; u++) {
+        h5fnal_hitcoll_t hc = data->hit_collections[u];
+        h5fnal_vect_hitcoll_data_t one;
+
+        one.hits = data->hits + hc.start;
+        one.n_hits = hc.count;
+        hc.start = 0;
+        one.hit_collections = &hc;
+        one.n_hit_collections = 1;
+
+        if (h5fnal_append_hits(vector, &one) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write hit collection to the file");
+    }
+    if (NULL == vector->hit_buffer.writer)
+        H5FNAL_PROGRAM_ERROR("parallel compression was not set up with the dataset");
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+    if (h5fnal_stop_compression_pool() < 0)
+        H5FNAL_PROGRAM_ERROR("could not stop compression pool");
+
+    /* An empty data product has no datasets, only a count of zero,
+     * and reads back as empty
+     */
+    if (h5fnal_create_v_mc_hit_collection(event_id, EMPTY_NAME, NULL, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create vector of mc hit collection");
+    if (h5fnal_append_hits(vector, &empty) < 0)
+        H5FNAL_PROGRAM_ERROR("could not append empty data");
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+    if (h5fnal_get_product_count(event_id, EMPTY_NAME, &count) < 0 || count != 0)
+        H5FNAL_PROGRAM_ERROR("wrong count for empty data product");
+    if (h5fnal_open_v_mc_hit_collection(event_id, EMPTY_NAME, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open empty vector of mc hit collection");
+    if (vector->hit_dset_id >= 0 || vector->hitcoll_dset_id >= 0)
+        H5FNAL_PROGRAM_ERROR("empty data product has datasets");
+    if (h5fnal_read_all_hits_into(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read empty vector of mc hit collection");
+    if (data_out->n_hits != 0 || data_out->n_hit_collections != 0)
+        H5FNAL_PROGRAM_ERROR("empty data product is not empty");
+
+    /* Appending after re-opening creates the datasets */
+    if (h5fnal_append_hits(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write hit collections to the file");
+    if (vector->hit_dset_id < 0 || vector->hitcoll_dset_id < 0)
+        H5FNAL_PROGRAM_ERROR("datasets were not created by append");
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+    if (h5fnal_get_product_count(event_id, EMPTY_NAME, &count) < 0 || count != data->n_hit_collections)
+        H5FNAL_PROGRAM_ERROR("wrong count after appending");
+
+    /* With the default options, a small data product can be appended
+     * to again after it is re-opened
+     */
+    if (data->n_hits < 10)
+        H5FNAL_PROGRAM_ERROR("not enough hits for the re-open test");
+    memset(&reopen_hc, 0, sizeof(h5fnal_hitcoll_t));
+    reopen_hc.channel = 1;
+    reopen_hc.count = 10;
+    reopen.hits = data->hits;
+    reopen.n_hits = 10;
+    reopen.hit_collections = &reopen_hc;
+    reopen.n_hit_collections = 1;
+
+    if (h5fnal_create_v_mc_hit_collection(event_id, REOPEN_NAME, NULL, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create vector of mc hit collection");
+    if (h5fnal_append_hits(vector, &reopen) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write hit collection to the file");
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+    if (h5fnal_open_v_mc_hit_collection(event_id, REOPEN_NAME, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
+    if (h5fnal_append_hits(vector, &reopen) < 0)
+        H5FNAL_PROGRAM_ERROR("could not append to re-opened vector of mc hit collection");
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    if (h5fnal_open_v_mc_hit_collection(event_id, REOPEN_NAME, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
+    if (h5fnal_read_all_hits_into(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read re-opened vector of mc hit collection");
+    if (data_out->n_hits != 20 || data_out->n_hit_collections != 2)
+        H5FNAL_PROGRAM_ERROR("wrong sizes after appending to a re-opened data product");
+    if (memcmp(data->hits, data_out->hits, 10 * sizeof(h5fnal_hit_t)) != 0
+            || memcmp(data->hits, data_out->hits + 10, 10 * sizeof(h5fnal_hit_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad hits after appending to a re-opened data product");
+    if (data_out->hit_collections[1].start != 10 || data_out->hit_collections[1].count != 10)
+        H5FNAL_PROGRAM_ERROR("bad hit collection after appending to a re-opened data product");
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    /* Datasets that fit in the append buffer get a layout that suits
+     * their final size when the vector is closed: compact for a few
+     * hits, contiguous for more uncompressed hits and a single chunk
+     * for more compressed hits. The chunked layout always chunks.
+     */
+    if (data->n_hits < 512)
+        H5FNAL_PROGRAM_ERROR("not enough hits for the layout tests");
+    for (i = 0; i < 4; i++) {
+        static const struct {
+            h5fnal_layout_t             layout;
+            h5fnal_compression_method_t method;
+            hsize_t                     n_hits;
+            H5D_layout_t                expected;
+        } cases[4] = {
+            {H5FNAL_LAYOUT_AUTO,    H5FNAL_COMPRESSION_DEFLATE, 3,   H5D_COMPACT},
+            {H5FNAL_LAYOUT_AUTO,    H5FNAL_COMPRESSION_NONE,    512, H5D_CONTIGUOUS},
+            {H5FNAL_LAYOUT_AUTO,    H5FNAL_COMPRESSION_DEFLATE, 512, H5D_CHUNKED},
+            {H5FNAL_LAYOUT_CHUNKED, H5FNAL_COMPRESSION_DEFLATE, 3,   H5D_CHUNKED}
+        };
+        h5fnal_vect_hitcoll_data_t few;
+        h5fnal_hitcoll_t hc;
+
+        if (h5fnal_init_create_options(&options) < 0)
+            H5FNAL_PROGRAM_ERROR("could not initialize creation options");
+        options.layout = cases[i].layout;
+        options.compression.method = cases[i].method;
+
+        memset(&hc, 0, sizeof(h5fnal_hitcoll_t));
+        hc.channel = 1;
+        hc.start = 0;
+        hc.count = cases[i].n_hits;
+        few.hits = data->hits;
+        few.n_hits = cases[i].n_hits;
+        few.hit_collections = &hc;
+        few.n_hit_collections = 1;
+
+        sprintf(name, "%s_%d", SMALL_NAME, i);
+        if (h5fnal_create_v_mc_hit_collection(event_id, name, &options, vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create vector of mc hit collection");
+        if (h5fnal_append_hits(vector, &few) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write hit collection to the file");
+        if ((vector->hit_dset_id >= 0) != (H5FNAL_LAYOUT_CHUNKED == cases[i].layout))
+            H5FNAL_PROGRAM_ERROR("small hit dataset created at the wrong time");
+        if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close vector");
+
+        if (h5fnal_open_v_mc_hit_collection(event_id, name, vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
+        if ((dcpl_id = H5Dget_create_plist(vector->hit_dset_id)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if ((layout = H5Pget_layout(dcpl_id)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (H5Pclose(dcpl_id) < 0)
+            H5FNAL_HDF5_ERROR;
+        dcpl_id = -1;
+        if (layout != cases[i].expected)
+            H5FNAL_PROGRAM_ERROR("wrong layout for small hit dataset");
+
+        /* Only the chunked layout leaves the dataset extendible */
+        if ((sid = H5Dget_space(vector->hit_dset_id)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (H5Sget_simple_extent_dims(sid, dims, max_dims) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (H5Sclose(sid) < 0)
+            H5FNAL_HDF5_ERROR;
+        sid = -1;
+        if (dims[0] != cases[i].n_hits || (H5S_UNLIMITED == max_dims[0]) != (H5FNAL_LAYOUT_CHUNKED == cases[i].layout))
+            H5FNAL_PROGRAM_ERROR("wrong dimensions for small hit dataset");
+
+        if (h5fnal_free_hitcoll_mem_data(data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not free in-memory hit collection data");
+        if (h5fnal_read_all_hits(vector, data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read hit collections from the file");
+        if (data_out->n_hits != cases[i].n_hits || data_out->n_hit_collections != 1)
+            H5FNAL_PROGRAM_ERROR("wrong number of elements in small vector");
+        if (memcmp(data->hits, data_out->hits, cases[i].n_hits * sizeof(h5fnal_hit_t)) != 0)
+            H5FNAL_PROGRAM_ERROR("bad read data from small vector (hits)");
+        if (memcmp(&hc, data_out->hit_collections, sizeof(h5fnal_hitcoll_t)) != 0)
+            H5FNAL_PROGRAM_ERROR("bad read data from small vector (hit collections)");
+        if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close vector");
+    }
+
+    if (h5fnal_open_v_mc_hit_collection(event_id, POOL_NAME, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
+    if (h5fnal_free_hitcoll_mem_data(data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free in-memory hit collection data");
+    if (h5fnal_read_all_hits(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collections from the file");
+    if (data_out->n_hits != data->n_hits || data_out->n_hit_collections != data->n_hit_collections)
+        H5FNAL_PROGRAM_ERROR("wrong number of elements with parallel compression");
+    if (h5fnal_get_dset_extent(vector->hit_dset_id) != (hssize_t)data->n_hits)
+        H5FNAL_PROGRAM_ERROR("wrong hit dataset extent with exact growth");
+    if (memcmp(data->hits, data_out->hits, data->n_hits * sizeof(h5fnal_hit_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad read data with parallel compression (hits)");
+    if (memcmp(data->hit_collections, data_out->hit_collections, data->n_hit_collections * sizeof(h5fnal_hitcoll_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad read data with parallel compression (hit collections)");
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    /* Column storage: each hit field is its own dataset. Use small
+     * chunks so the one-at-a-time appends cross chunk boundaries.
+     */
+    if (h5fnal_init_create_options(&options) < 0)
+        H5FNAL_PROGRAM_ERROR("could not initialize creation options");
+    options.chunk_policy.target_bytes = 32 * sizeof(float);
+    options.storage = H5FNAL_STORAGE_COLUMNS;
+    if (h5fnal_create_v_mc_hit_collection(event_id, COLUMN_NAME, &options, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create vector of mc hit collection");
+    for (u = 0; u < data->n_hit_collections; u++) {
+        h5fnal_hitcoll_t hc = data->hit_collections[u];
+        h5fnal_vect_hitcoll_data_t one;
+
+        one.hits = data->hits + hc.start;
+        one.n_hits = hc.count;
+        hc.start = 0;
+        one.hit_collections = &hc;
+        one.n_hit_collections = 1;
+
+        if (h5fnal_append_hits(vector, &one) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write hit collection to the file");
+    }
+    if (h5fnal_free_hitcoll_mem_data(data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free in-memory hit collection data");
+    if (h5fnal_read_all_hits(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collections from the file");
+    if (data_out->n_hits != data->n_hits || data_out->n_hit_collections != data->n_hit_collections)
+        H5FNAL_PROGRAM_ERROR("wrong number of elements with column storage");
+    if (memcmp(data->hits, data_out->hits, data->n_hits * sizeof(h5fnal_hit_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad read data with column storage (hits)");
+    if (memcmp(data->hit_collections, data_out->hit_collections, data->n_hit_collections * sizeof(h5fnal_hitcoll_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad read data with column storage (hit collections)");
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    /* The storage is picked up from the file */
+    if (h5fnal_open_v_mc_hit_collection(event_id, COLUMN_NAME, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
+    if (vector->hit_storage != H5FNAL_STORAGE_COLUMNS || vector->hit_dset_id >= 0)
+        H5FNAL_PROGRAM_ERROR("column storage was not detected");
+    if ((did = H5Dopen2(vector->top_level_group_id, "hits/fCharge", H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if ((column_tid = H5Dget_type(did)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (H5Tequal(column_tid, H5T_NATIVE_FLOAT) <= 0)
+        H5FNAL_PROGRAM_ERROR("hit charge column is not a float dataset");
+    if (H5Tclose(column_tid) < 0)
+        H5FNAL_HDF5_ERROR;
+    column_tid = -1;
+    if (h5fnal_get_dset_size(did) != (hssize_t)data->n_hits)
+        H5FNAL_PROGRAM_ERROR("wrong hit charge column size");
+    if (H5Dclose(did) < 0)
+        H5FNAL_HDF5_ERROR;
+    did = -1;
+
+    if (h5fnal_free_hitcoll_mem_data(data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free in-memory hit collection data");
+    if (h5fnal_read_all_hits(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collections from the file");
+    if (memcmp(data->hits, data_out->hits, data->n_hits * sizeof(h5fnal_hit_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad re-read data with column storage (hits)");
+
+    /* Appending after re-opening goes to the columns, too */
+    if (h5fnal_append_hits(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write hit collections to the file");
+    if (h5fnal_get_hitcoll_sizes(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit collection sizes");
+    if (data_out->n_hits != 2 * data->n_hits || data_out->n_hit_collections != 2 * data->n_hit_collections)
+        H5FNAL_PROGRAM_ERROR("wrong number of elements after appending to columns");
+    for (u = 0; u < data->n_hit_collections; u++)
+        if (data->hit_collections[u].count > 0)
+            data->hit_collections[u].start -= data->n_hits;
+
+    /* Projected reads fill in compact structs, from either storage */
+    if (NULL == (compact = (compact_hit_t *)calloc(data->n_hits, sizeof(compact_hit_t))))
+        H5FNAL_PROGRAM_ERROR("could not allocate memory for hits");
+    for (i = 0; i < 2; i++) {
+        if (1 == i) {
+            if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+                H5FNAL_PROGRAM_ERROR("could not close vector");
+            if (h5fnal_open_v_mc_hit_collection(event_id, MULTI_NAME, vector) < 0)
+                H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
+            if (vector->hit_storage != H5FNAL_STORAGE_ROWS)
+                H5FNAL_PROGRAM_ERROR("row storage was not detected");
+        }
+
+        memset(compact, 0, data->n_hits * sizeof(compact_hit_t));
+        if (h5fnal_read_hit_projection_range(vector,
+                    H5FNAL_HIT_SIGNAL_TIME | H5FNAL_HIT_CHARGE | H5FNAL_HIT_PART_TRACK_ID,
+                    0, data->n_hits, compact) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read hit projection");
+        for (u = 0; u < data->n_hits; u++)
+            if (compact[u].signal_time != data->hits[u].signal_time
+                    || compact[u].charge != data->hits[u].charge
+                    || compact[u].part_track_id != data->hits[u].part_track_id)
+                H5FNAL_PROGRAM_ERROR("bad projected hit read");
+    }
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+    free(compact);
+    compact = NULL;
+
+    /* Flat layout: one data product for several events, with each
+     * hit collection appended as its own event. Pairs of events are
+     * swapped so the index has to be sorted.
+     */
+    if (h5fnal_create_v_mc_hit_collection(subrun_id, FLAT_NAME, NULL, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create vector of mc hit collection");
+    if (h5fnal_create_event_index(vector->top_level_group_id, NULL, &index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create event index");
+    for (u = 0; u < data->n_hit_collections; u++) {
+        h5fnal_hitcoll_t hc = data->hit_collections[u];
+        h5fnal_vect_hitcoll_data_t one;
+
+        one.hits = data->hits + hc.start;
+        one.n_hits = hc.count;
+        hc.start = 0;
+        one.hit_collections = &hc;
+        one.n_hit_collections = 1;
+
+        if (h5fnal_append_event_hits(vector, &index, 1, 2, (unsigned)(u ^ 1), &one) < 0)
+            H5FNAL_PROGRAM_ERROR("could not append event hits");
+    }
+    if (h5fnal_close_event_index(&index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close event index");
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    if (h5fnal_open_v_mc_hit_collection(subrun_id, FLAT_NAME, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
+    if (h5fnal_open_event_index(vector->top_level_group_id, &index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open event index");
+    if (index.n_entries != data->n_hit_collections)
+        H5FNAL_PROGRAM_ERROR("wrong number of event index entries");
+    if (!index.sorted)
+        H5FNAL_PROGRAM_ERROR("event index was not stored sorted");
+    for (u = data->n_hit_collections; u > 0; u--) {
+        h5fnal_hitcoll_t *hc = &data->hit_collections[u - 1];
+
+        if (index.entries[u - 1].event != (unsigned)(u - 1))
+            H5FNAL_PROGRAM_ERROR("event index entries out of order");
+        if ((found = h5fnal_find_event(&index, 1, 2, (unsigned)((u - 1) ^ 1), &entry)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not look up event");
+        if (!found)
+            H5FNAL_PROGRAM_ERROR("event missing from event index");
+        if (h5fnal_read_event_hits(vector, &entry, data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read event hits");
+        if (data_out->n_hit_collections != 1 || data_out->n_hits != hc->count)
+            H5FNAL_PROGRAM_ERROR("wrong number of elements in event");
+        if (data_out->hit_collections[0].channel != hc->channel || data_out->hit_collections[0].count != hc->count
+                || (hc->count > 0 && data_out->hit_collections[0].start != 0))
+            H5FNAL_PROGRAM_ERROR("bad event hit collection");
+        if (memcmp(data->hits + hc->start, data_out->hits, hc->count * sizeof(h5fnal_hit_t)) != 0)
+            H5FNAL_PROGRAM_ERROR("bad event hits");
+    }
+    if ((found = h5fnal_find_event(&index, 1, 3, 0, &entry)) != FALSE)
+        H5FNAL_PROGRAM_ERROR("found an event that isn't there");
+    if (h5fnal_close_event_index(&index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close event index");
+    if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    /* Event lookup: events created out of order are opened by number */
+    if (h5fnal_create_event_lookup(run_id, &lookup) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create event lookup");
+    for (i = 3; i > 0; i--) {
+        hid_t lookup_event_id;
+
+        snprintf(name, sizeof(name), "lookup_event_%d", i);
+        if ((lookup_event_id = h5fnal_create_event(subrun_id, name, FALSE)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create event");
+        if (h5fnal_add_event_to_lookup(&lookup, 1, 2, (unsigned)i, lookup_event_id) < 0)
+            H5FNAL_PROGRAM_ERROR("could not add event to lookup");
+        if (h5fnal_close_event(lookup_event_id) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close event");
+    }
+    if (h5fnal_close_event_lookup(&lookup) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close event lookup");
+
+    if (h5fnal_open_event_lookup(run_id, &lookup) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open event lookup");
+    if (lookup.n_entries != 3 || lookup.entries[0].event != 1 || lookup.entries[2].event != 3)
+        H5FNAL_PROGRAM_ERROR("bad event lookup entries");
+    for (i = 1; i <= 3; i++) {
+        char path[64];
+        hid_t lookup_event_id;
+
+        if ((found = h5fnal_open_event_by_number(&lookup, 1, 2, (unsigned)i, &lookup_event_id)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open event by number");
+        if (!found)
+            H5FNAL_PROGRAM_ERROR("event missing from event lookup");
+        if (H5Iget_name(lookup_event_id, path, sizeof(path)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (h5fnal_close_event(lookup_event_id) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close event");
+        snprintf(name, sizeof(name), "/%s/%s/lookup_event_%d", RUN_NAME, SUBRUN_NAME, i);
+        if (strcmp(path, name) != 0)
+            H5FNAL_PROGRAM_ERROR("opened the wrong event");
+    }
+    if ((found = h5fnal_open_event_by_number(&lookup, 1, 2, 4, &event_id_out)) != FALSE)
+        H5FNAL_PROGRAM_ERROR("found an event that isn't there");
+    if (h5fnal_close_event_lookup(&lookup) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close event lookup");
+
+    /* Event summaries: built from the data products and skimmed
+     * without reading them back
+     */
+    if (h5fnal_create_summary_table(run_id, &summaries) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create summary table");
+    for (i = 3; i > 0; i--) {
+        if (h5fnal_init_event_summary(&summary, 1, 2, (unsigned)i) < 0)
+            H5FNAL_PROGRAM_ERROR("could not initialize event summary");
+        /* Event 1 has the hits twice, event 2 has none */
+        if (i != 2 && h5fnal_summarize_hits(&summary, data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not summarize hits");
+        if (1 == i && h5fnal_summarize_hits(&summary, data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not summarize hits");
+        if (h5fnal_add_event_summary(&summaries, &summary) < 0)
+            H5FNAL_PROGRAM_ERROR("could not add event summary");
+    }
+    /* Adding an event again replaces its summary */
+    summary.origin_mask = 1U << COSMIC_RAY;
+    if (h5fnal_add_event_summary(&summaries, &summary) < 0)
+        H5FNAL_PROGRAM_ERROR("could not add event summary");
+    if (h5fnal_close_summary_table(&summaries) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close summary table");
+
+    if (h5fnal_open_summary_table(run_id, &summaries) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open summary table");
+    if (summaries.n_entries != 3 || summaries.entries[0].event != 1 || summaries.entries[2].event != 3)
+        H5FNAL_PROGRAM_ERROR("bad summary table entries");
+    if ((found = h5fnal_find_event_summary(&summaries, 1, 2, 1, &summary)) != TRUE)
+        H5FNAL_PROGRAM_ERROR("event missing from summary table");
+    if (summary.n_hits != 2 * data->n_hits || summary.n_hit_collections != 2 * data->n_hit_collections
+            || summary.origin_mask != 1U << COSMIC_RAY)
+        H5FNAL_PROGRAM_ERROR("bad event summary");
+    total_charge = 0.0;
+    min_time = max_time = data->hits[0].signal_time;
+    for (u = 0; u < data->n_hits; u++) {
+        total_charge += data->hits[u].charge;
+        min_time = H5FNAL_MIN(min_time, data->hits[u].signal_time);
+        max_time = H5FNAL_MAX(max_time, data->hits[u].signal_time);
+    }
+    if (summary.min_hit_time != min_time || summary.max_hit_time != max_time
+            || summary.total_charge < 2.0 * total_charge * (1.0 - 1.0e-9)
+            || summary.total_charge > 2.0 * total_charge * (1.0 + 1.0e-9))
+        H5FNAL_PROGRAM_ERROR("bad event summary hit values");
+    if ((found = h5fnal_find_event_summary(&summaries, 1, 2, 2, &summary)) != TRUE)
+        H5FNAL_PROGRAM_ERROR("event missing from summary table");
+    if (summary.n_hits != 0 || summary.total_charge != 0.0)
+        H5FNAL_PROGRAM_ERROR("bad event summary");
+    if ((found = h5fnal_find_event_summary(&summaries, 1, 2, 4, &summary)) != FALSE)
+        H5FNAL_PROGRAM_ERROR("found an event summary that isn't there");
+
+    /* Skims */
+    if (h5fnal_init_skim_criteria(&criteria) < 0)
+        H5FNAL_PROGRAM_ERROR("could not initialize skim criteria");
+    if (h5fnal_skim_events(&summaries, &criteria, &selected, &count) < 0)
+        H5FNAL_PROGRAM_ERROR("could not skim events");
+    if (count != 3)
+        H5FNAL_PROGRAM_ERROR("default skim criteria rejected events");
+    free(selected);
+    selected = NULL;
+
+    criteria.min_hits = 1;
+    criteria.max_hits = data->n_hits;
+    if (h5fnal_skim_events(&summaries, &criteria, &selected, &count) < 0)
+        H5FNAL_PROGRAM_ERROR("could not skim events");
+    if (count != 1 || selected[0].event != 3)
+        H5FNAL_PROGRAM_ERROR("bad hit count skim");
+    free(selected);
+    selected = NULL;
+
+    if (h5fnal_init_skim_criteria(&criteria) < 0)
+        H5FNAL_PROGRAM_ERROR("could not initialize skim criteria");
+    criteria.min_hit_time = 2.0f * max_time + 1.0f;
+    if (h5fnal_skim_events(&summaries, &criteria, &selected, &count) < 0)
+        H5FNAL_PROGRAM_ERROR("could not skim events");
+    if (count != 0 || selected != NULL)
+        H5FNAL_PROGRAM_ERROR("bad hit time skim");
+    criteria.min_hit_time = min_time;
+    criteria.max_hit_time = min_time;
+    if (h5fnal_skim_events(&summaries, &criteria, &selected, &count) < 0)
+        H5FNAL_PROGRAM_ERROR("could not skim events");
+    if (count != 2 || selected[0].event != 1 || selected[1].event != 3)
+        H5FNAL_PROGRAM_ERROR("bad hit time skim");
+    free(selected);
+    selected = NULL;
+
+    if (h5fnal_init_skim_criteria(&criteria) < 0)
+        H5FNAL_PROGRAM_ERROR("could not initialize skim criteria");
+    summaries.entries[2].n_neutrinos = 1;
+    summaries.entries[2].origin_mask = 1U << BEAM_NEUTRINO;
+    criteria.neutrino = H5FNAL_SKIM_WITH_NEUTRINO;
+    if (h5fnal_skim_events(&summaries, &criteria, &selected, &count) < 0)
+        H5FNAL_PROGRAM_ERROR("could not skim events");
+    if (count != 1 || selected[0].event != 3)
+        H5FNAL_PROGRAM_ERROR("bad neutrino skim");
+    free(selected);
+    selected = NULL;
+    criteria.neutrino = H5FNAL_SKIM_ANY_NEUTRINO;
+    criteria.origin_mask = (1U << COSMIC_RAY) | (1U << SUPERNOVA_NEUTRINO);
+    if (h5fnal_skim_events(&summaries, &criteria, &selected, &count) < 0)
+        H5FNAL_PROGRAM_ERROR("could not skim events");
+    if (count != 1 || selected[0].event != 1)
+        H5FNAL_PROGRAM_ERROR("bad origin skim");
+    free(selected);
+    selected = NULL;
+
+    /* Nothing was added, so closing leaves the table as it was */
+    if (h5fnal_close_summary_table(&summaries) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close summary table");
+    if (h5fnal_open_summary_table(run_id, &summaries) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open summary table");
+    if (summaries.n_entries != 3 || summaries.entries[2].n_neutrinos != 0)
+        H5FNAL_PROGRAM_ERROR("summary table was rewritten");
+    if (h5fnal_close_summary_table(&summaries) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close summary table");
+
+    /* Group cache: consecutive events in a sub-run share its handle */
+    if ((cached_run_id = h5fnal_create_run(fid, "7", FALSE)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create run");
+    if ((cached_subrun_id = h5fnal_create_run(cached_run_id, "8", FALSE)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create sub-run");
+    for (i = 0; i < 3; i++) {
+        snprintf(name, sizeof(name), "%d", i);
+        if ((event_id_out = h5fnal_create_event(cached_subrun_id, name, FALSE)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create event");
+        if (h5fnal_close_event(event_id_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close event");
+    }
+    if (h5fnal_close_run(cached_subrun_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close run");
+    if (h5fnal_close_run(cached_run_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close run");
+    cached_run_id = cached_subrun_id = event_id_out = -1;
+
+    if ((n_open = H5Fget_obj_count(fid, H5F_OBJ_GROUP)) < 0)
+        H5FNAL_HDF5_ERROR;
+    if (h5fnal_create_group_cache(fid, 2, &group_cache) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create group cache");
+    for (i = 0; i < 6; i++) {
+        if ((event_id_out = h5fnal_open_cached_event(&group_cache, 7, 8, (unsigned)(i % 3))) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open cached event");
+        if (h5fnal_close_event(event_id_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close event");
+        event_id_out = -1;
+    }
+    if (group_cache.misses != 2 || group_cache.hits != 5)
+        H5FNAL_PROGRAM_ERROR("groups were not reused");
+
+    if (h5fnal_close_group_cache(&group_cache) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close group cache");
+
+    /* A one-group cache evicts the run when its sub-run is opened */
+    if (h5fnal_create_group_cache(fid, 1, &group_cache) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create group cache");
+    if ((cached_id = h5fnal_get_cached_group(&group_cache, "7/8")) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get cached group");
+    if (group_cache.n_groups != 1 || strcmp(group_cache.groups[0].path, "7/8") != 0)
+        H5FNAL_PROGRAM_ERROR("bad group cache contents");
+    if (h5fnal_close_group_cache(&group_cache) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close group cache");
+    cached_id = -1;
+    if (H5Fget_obj_count(fid, H5F_OBJ_GROUP) != n_open)
+        H5FNAL_PROGRAM_ERROR("group cache leaked handles");
+
     /* Close everything */
     if (h5fnal_close_run(run_id) < 0)
         H5FNAL_PROGRAM_ERROR("could not close run");
@@ -187,10 +1067,47 @@ main(void)
         H5FNAL_PROGRAM_ERROR("could not close run");
     if (h5fnal_close_event(event_id) < 0)
         H5FNAL_PROGRAM_ERROR("could not close event");
-    if (H5Pclose(fapl_id) < 0)
-        H5FNAL_HDF5_ERROR;
-    if (H5Fclose(fid) < 0)
-        H5FNAL_HDF5_ERROR;
+    event_id = -1;
+    if (h5fnal_close_file(fid) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close file");
+    fid = -1;
+
+    /* Re-read the file with the read profiles */
+    for (i = H5FNAL_PROFILE_BULK_READ; i <= H5FNAL_PROFILE_RANDOM_READ; i++) {
+        if ((fid = h5fnal_open_file(FILE_NAME, H5F_ACC_RDONLY, (h5fnal_file_profile_t)i)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open file");
+        if ((event_id = h5fnal_open_event(fid, RUN_NAME "/" SUBRUN_NAME "/" EVENT_NAME)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open event");
+        if (h5fnal_open_v_mc_hit_collection(event_id, VECTOR_NAME, vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
+        if (h5fnal_free_hitcoll_mem_data(data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not free in-memory hit collection data");
+        if (h5fnal_read_all_hits(vector, data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read hit collections from the file");
+        if (memcmp(data->hits, data_out->hits, data->n_hits * sizeof(h5fnal_hit_t)) != 0)
+            H5FNAL_PROGRAM_ERROR("bad read data (hits)");
+        if (h5fnal_close_v_mc_hit_collection(vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close vector");
+        if (h5fnal_close_event(event_id) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close event");
+        event_id = -1;
+        if (h5fnal_close_file(fid) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close file");
+        fid = -1;
+    }
+
+    /* Files without paged file space can be opened with a page buffer
+     * profile
+     */
+    if ((fid = h5fnal_create_file(FILE_NAME_2, H5FNAL_PROFILE_DEFAULT)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create file");
+    if (h5fnal_close_file(fid) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close file");
+    if ((fid = h5fnal_open_file(FILE_NAME_2, H5F_ACC_RDONLY, H5FNAL_PROFILE_RANDOM_READ)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open file");
+    if (h5fnal_close_file(fid) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close file");
+    fid = -1;
     if (h5fnal_free_hitcoll_mem_data(data) < 0)
         H5FNAL_PROGRAM_ERROR("could not free in-memory hit collection data");
     if (h5fnal_free_hitcoll_mem_data(data_out) < 0)
@@ -204,8 +1121,28 @@ main(void)
     exit(EXIT_SUCCESS);
 
 error:
+    h5fnal_stop_compression_pool();
+    h5fnal_close_hitcoll_cursor(&cursor);
+    H5E_BEGIN_TRY {
+        h5fnal_close_group_cache(&group_cache);
+        H5Gclose(cached_run_id);
+        H5Gclose(cached_subrun_id);
+        H5Gclose(event_id_out);
+    } H5E_END_TRY;
+    free(selected);
+    free(summaries.entries);
+    free(compact);
+    H5E_BEGIN_TRY {
+        H5Dclose(did);
+        H5Tclose(column_tid);
+    } H5E_END_TRY;
+    h5fnal_release_type(tid);
+    h5fnal_release_dcpl(dcpl_ids[0]);
+    h5fnal_release_dcpl(dcpl_ids[1]);
     H5E_BEGIN_TRY {
-        H5Pclose(fapl_id);
+        H5Sclose(sid);
+        H5Pclose(dcpl_id);
+        H5Pclose(fcpl_id);
         H5Fclose(fid);
     } H5E_END_TRY;
     if(vector)
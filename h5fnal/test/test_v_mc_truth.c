@@ -1,5 +1,6 @@
 /* Test the vector of MC Truth API */
 
+#include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,10 +13,29 @@
 #define SUBRUN_NAME "testsubrun"
 #define EVENT_NAME  "testevent"
 #define VECTOR_NAME "vomct"
+#define LINKED_NAME "vomct_linked"
+#define MULTI_NAME  "vomct_multi"
+#define COLUMN_NAME "vomct_columns"
+#define DELTA_NAME  "vomct_delta"
+#define FLOAT_NAME  "vomct_float32"
+#define GRAPH_NAME  "vomct_graph"
+#define FLAT_NAME   "vomct_flat"
+
+#define N_BATCHES           3
+#define N_BATCH_TRUTHS      40
 
 #define STRING_1    "string 1"
 #define STRING_2    "string 2"
 
+/* Compact struct for projected reads, with padding before the mass
+ * and after the rescatter flag
+ */
+typedef struct compact_particle_t {
+    int     pdg_code;
+    double  mass;
+    int     rescatter;
+} compact_particle_t;
+
 
 /* generates random MC Truth data for testing */
 static herr_t
@@ -131,6 +151,450 @@ error:
 
 } /* end generate_test_truths() */
 
+/* Generates MC Truth data with valid indices between the datasets,
+ * for testing the cursor. Every other truth has a neutrino, each truth
+ * has three particles, each particle has two trajectory points and
+ * every other particle has a daughter.
+ */
+static herr_t
+generate_linked_truths(hsize_t n_truths, h5fnal_vect_truth_data_t *data)
+{
+    hsize_t u;
+
+    if (!data)
+        H5FNAL_PROGRAM_ERROR("data parameter cannot be NULL");
+
+    memset(data, 0, sizeof(h5fnal_vect_truth_data_t));
+
+    data->n_truths = n_truths;
+    data->n_neutrinos = (n_truths + 1) / 2;
+    data->n_particles = 3 * n_truths;
+    data->n_trajectories = 2 * data->n_particles;
+    data->n_daughters = (data->n_particles + 1) / 2;
+
+    if (h5fnal_reserve_truth_mem_data(data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not allocate memory");
+
+    for (u = 0; u < data->n_neutrinos; u++) {
+        data->neutrinos[u].mode = (int)rand();
+        data->neutrinos[u].w    = (double)rand();
+    }
+    for (u = 0; u < data->n_particles; u++) {
+        data->particles[u].track_id = (int)u;
+        data->particles[u].pdg_code = (int)rand();
+        data->particles[u].mass     = (double)rand();
+        data->particles[u].rescatter = (int)rand();
+        data->particles[u].trajectory_start_index = (hssize_t)(2 * u);
+        data->particles[u].trajectory_end_index = (hssize_t)(2 * u + 1);
+        if (0 == u % 2) {
+            data->particles[u].daughter_start_index = (hssize_t)(u / 2);
+            data->particles[u].daughter_end_index = (hssize_t)(u / 2);
+        }
+        else {
+            data->particles[u].daughter_start_index = -1;
+            data->particles[u].daughter_end_index = -1;
+        }
+    }
+    for (u = 0; u < data->n_daughters; u++)
+        data->daughters[u].track_id = (int)rand();
+    for (u = 0; u < data->n_trajectories; u++) {
+        data->trajectories[u].E = (double)rand();
+        data->trajectories[u].particle_index = u / 2;
+    }
+    for (u = 0; u < n_truths; u++) {
+        data->truths[u].origin = (h5fnal_origin_t)(u % 5);
+        data->truths[u].neutrino_index = (0 == u % 2) ? (hssize_t)(u / 2) : -1;
+        data->truths[u].particle_start_index = (hssize_t)(3 * u);
+        data->truths[u].particle_end_index = (hssize_t)(3 * u + 2);
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    if (data)
+        h5fnal_free_truth_mem_data(data);
+
+    return H5FNAL_FAILURE;
+} /* end generate_linked_truths() */
+
+/* Checks that data has the indices that generate_linked_truths() gives
+ * n_truths truths
+ */
+static herr_t
+check_linked_indices(const h5fnal_vect_truth_data_t *data, hsize_t n_truths)
+{
+    hsize_t u;
+
+    if (data->n_truths != n_truths || data->n_neutrinos != (n_truths + 1) / 2 || data->n_particles != 3 * n_truths
+            || data->n_trajectories != 6 * n_truths || data->n_daughters != (3 * n_truths + 1) / 2)
+        H5FNAL_PROGRAM_ERROR("wrong number of elements");
+
+    for (u = 0; u < data->n_truths; u++) {
+        const h5fnal_truth_t *t = &data->truths[u];
+
+        if (t->neutrino_index != ((0 == u % 2) ? (hssize_t)(u / 2) : -1))
+            H5FNAL_PROGRAM_ERROR("wrong neutrino index");
+        if (t->particle_start_index != (hssize_t)(3 * u) || t->particle_end_index != (hssize_t)(3 * u + 2))
+            H5FNAL_PROGRAM_ERROR("wrong particle indices");
+    }
+    for (u = 0; u < data->n_particles; u++) {
+        const h5fnal_particle_t *p = &data->particles[u];
+
+        if (p->trajectory_start_index != (hssize_t)(2 * u) || p->trajectory_end_index != (hssize_t)(2 * u + 1))
+            H5FNAL_PROGRAM_ERROR("wrong trajectory indices");
+        if (p->daughter_start_index != ((0 == u % 2) ? (hssize_t)(u / 2) : -1))
+            H5FNAL_PROGRAM_ERROR("wrong daughter indices");
+    }
+    for (u = 0; u < data->n_trajectories; u++)
+        if (data->trajectories[u].particle_index != u / 2)
+            H5FNAL_PROGRAM_ERROR("wrong trajectory particle index");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end check_linked_indices() */
+
+/* Checks one event's truths, read with h5fnal_read_event_truths(),
+ * against the same rows of the whole flat data product. The event's
+ * indices are relative to its own arrays, so they have to be the data
+ * product's indices less the starts in the event's index entry.
+ */
+static herr_t
+check_event_truths(const h5fnal_vect_truth_data_t *event, const h5fnal_vect_truth_data_t *all,
+        const h5fnal_event_entry_t *entry)
+{
+    const hsize_t *start = entry->start;
+    hsize_t u;
+
+    if (event->n_truths != entry->count[H5FNAL_TRUTH_RANGE_TRUTHS]
+            || event->n_neutrinos != entry->count[H5FNAL_TRUTH_RANGE_NEUTRINOS]
+            || event->n_particles != entry->count[H5FNAL_TRUTH_RANGE_PARTICLES]
+            || event->n_trajectories != entry->count[H5FNAL_TRUTH_RANGE_TRAJECTORIES]
+            || event->n_daughters != entry->count[H5FNAL_TRUTH_RANGE_DAUGHTERS])
+        H5FNAL_PROGRAM_ERROR("event sizes don't match the event index entry");
+    if (check_linked_indices(event, event->n_truths) < 0)
+        H5FNAL_PROGRAM_ERROR("event indices are not relative to the event");
+
+    for (u = 0; u < event->n_truths; u++) {
+        const h5fnal_truth_t *e = &event->truths[u];
+        const h5fnal_truth_t *a = &all->truths[start[H5FNAL_TRUTH_RANGE_TRUTHS] + u];
+
+        if (e->origin != a->origin)
+            H5FNAL_PROGRAM_ERROR("bad event truth");
+        if (e->neutrino_index < 0 ? a->neutrino_index != -1
+                : a->neutrino_index != e->neutrino_index + (hssize_t)start[H5FNAL_TRUTH_RANGE_NEUTRINOS])
+            H5FNAL_PROGRAM_ERROR("bad event truth neutrino index");
+        if (a->particle_start_index != e->particle_start_index + (hssize_t)start[H5FNAL_TRUTH_RANGE_PARTICLES]
+                || a->particle_end_index != e->particle_end_index + (hssize_t)start[H5FNAL_TRUTH_RANGE_PARTICLES])
+            H5FNAL_PROGRAM_ERROR("bad event truth particle indices");
+    }
+    for (u = 0; u < event->n_particles; u++) {
+        const h5fnal_particle_t *e = &event->particles[u];
+        const h5fnal_particle_t *a = &all->particles[start[H5FNAL_TRUTH_RANGE_PARTICLES] + u];
+
+        if (e->track_id != a->track_id || e->pdg_code != a->pdg_code || e->mass != a->mass)
+            H5FNAL_PROGRAM_ERROR("bad event particle");
+        if (a->trajectory_start_index != e->trajectory_start_index + (hssize_t)start[H5FNAL_TRUTH_RANGE_TRAJECTORIES]
+                || a->trajectory_end_index != e->trajectory_end_index
+                    + (hssize_t)start[H5FNAL_TRUTH_RANGE_TRAJECTORIES])
+            H5FNAL_PROGRAM_ERROR("bad event particle trajectory indices");
+        if (e->daughter_start_index < 0 ? a->daughter_start_index != -1
+                : a->daughter_start_index != e->daughter_start_index + (hssize_t)start[H5FNAL_TRUTH_RANGE_DAUGHTERS])
+            H5FNAL_PROGRAM_ERROR("bad event particle daughter indices");
+    }
+    for (u = 0; u < event->n_trajectories; u++) {
+        const h5fnal_trajectory_t *e = &event->trajectories[u];
+        const h5fnal_trajectory_t *a = &all->trajectories[start[H5FNAL_TRUTH_RANGE_TRAJECTORIES] + u];
+
+        if (e->E != a->E || a->particle_index != e->particle_index + start[H5FNAL_TRUTH_RANGE_PARTICLES])
+            H5FNAL_PROGRAM_ERROR("bad event trajectory point");
+    }
+    if (memcmp(event->neutrinos, all->neutrinos + start[H5FNAL_TRUTH_RANGE_NEUTRINOS],
+                event->n_neutrinos * sizeof(h5fnal_neutrino_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad event neutrinos");
+    if (memcmp(event->daughters, all->daughters + start[H5FNAL_TRUTH_RANGE_DAUGHTERS],
+                event->n_daughters * sizeof(h5fnal_daughter_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad event daughters");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end check_event_truths() */
+
+/* Gives each truth made by generate_linked_truths() a chain of
+ * particles: the first is the primary, the second its daughter and the
+ * third its granddaughter
+ */
+static void
+chain_particles(h5fnal_vect_truth_data_t *data)
+{
+    hsize_t u;
+
+    for (u = 0; u < data->n_particles; u++)
+        data->particles[u].mother = (0 == u % 3) ? -1 : data->particles[u].track_id - 1;
+
+    return;
+} /* end chain_particles() */
+
+/* Checks the graph of the particles given by chain_particles(), using
+ * the truths and particles in data (which start at the graph's row 0)
+ */
+static herr_t
+check_particle_chains(const h5fnal_particle_graph_t *graph, const h5fnal_vect_truth_data_t *data)
+{
+    const hsize_t *rows;
+    hsize_t ancestors[2];
+    hsize_t found;
+    hsize_t n;
+    hsize_t r;
+    hsize_t u;
+
+    if (graph->n_particles != data->n_particles || graph->n_links != 2 * data->n_truths)
+        H5FNAL_PROGRAM_ERROR("wrong graph size");
+
+    for (u = 0; u < data->n_truths; u++) {
+        r = 3 * u;
+
+        if (h5fnal_get_mother_row(graph, r) != -1 || h5fnal_get_mother_row(graph, r + 1) != (hssize_t)r
+                || h5fnal_get_mother_row(graph, r + 2) != (hssize_t)(r + 1))
+            H5FNAL_PROGRAM_ERROR("wrong mother row");
+        if (h5fnal_get_primary_row(graph, r + 2) != (hssize_t)r || h5fnal_get_primary_row(graph, r) != (hssize_t)r)
+            H5FNAL_PROGRAM_ERROR("wrong primary row");
+
+        rows = h5fnal_get_daughter_rows(graph, r, &n);
+        if (n != 1 || rows[0] != r + 1)
+            H5FNAL_PROGRAM_ERROR("wrong daughter rows");
+        rows = h5fnal_get_descendant_rows(graph, r, &n);
+        if (n != 2 || rows[0] != r + 1 || rows[1] != r + 2)
+            H5FNAL_PROGRAM_ERROR("wrong descendant rows");
+        if (h5fnal_get_ancestor_rows(graph, r + 2, ancestors, 2) != 2 || ancestors[0] != r + 1 || ancestors[1] != r)
+            H5FNAL_PROGRAM_ERROR("wrong ancestor rows");
+        if (!h5fnal_is_descendant(graph, r + 2, r) || h5fnal_is_descendant(graph, r, r + 2)
+                || h5fnal_is_descendant(graph, r, r))
+            H5FNAL_PROGRAM_ERROR("wrong descendant check");
+        if (u > 0 && h5fnal_is_descendant(graph, r, r - 3))
+            H5FNAL_PROGRAM_ERROR("particle descends from another truth");
+
+        if (h5fnal_find_particle_row(graph, &data->truths[u], data->particles[r + 1].track_id, &found) != TRUE
+                || found != r + 1)
+            H5FNAL_PROGRAM_ERROR("could not find particle by track ID");
+        if (h5fnal_find_particle_row(graph, &data->truths[u], -1, &found) != FALSE)
+            H5FNAL_PROGRAM_ERROR("found a particle that isn't there");
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end check_particle_chains() */
+
+/* Builds a small graph with branches, a mother loop and a mother in
+ * another truth, and checks it
+ */
+static herr_t
+check_built_graph(void)
+{
+    /* track IDs and mothers of the particles in two truths */
+    static const int track_ids[7] = {10, 20, 30, 40, 50, 60, 70};
+    static const int mothers[7] = {-1, 10, 10, 30, 60, 50, 10};
+    static const hsize_t descendants[3] = {1, 2, 3};
+    h5fnal_vect_truth_data_t data;
+    h5fnal_particle_graph_t graph;
+    h5fnal_truth_t truths[2];
+    h5fnal_particle_t particles[7];
+    const hsize_t *rows;
+    hsize_t n;
+    hsize_t u;
+
+    memset(&data, 0, sizeof(h5fnal_vect_truth_data_t));
+    memset(&graph, 0, sizeof(h5fnal_particle_graph_t));
+    memset(truths, 0, sizeof(truths));
+    memset(particles, 0, sizeof(particles));
+
+    for (u = 0; u < 7; u++) {
+        particles[u].track_id = track_ids[u];
+        particles[u].mother = mothers[u];
+    }
+    truths[0].particle_start_index = 0;
+    truths[0].particle_end_index = 5;
+    truths[1].particle_start_index = 6;
+    truths[1].particle_end_index = 6;
+    data.n_truths = 2;
+    data.truths = truths;
+    data.n_particles = 7;
+    data.particles = particles;
+
+    if (h5fnal_build_particle_graph(&data, &graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not build particle graph");
+
+    rows = h5fnal_get_daughter_rows(&graph, 0, &n);
+    if (n != 2 || rows[0] != 1 || rows[1] != 2)
+        H5FNAL_PROGRAM_ERROR("wrong daughters in built graph");
+    rows = h5fnal_get_descendant_rows(&graph, 0, &n);
+    if (n != 3 || memcmp(rows, descendants, sizeof(descendants)) != 0)
+        H5FNAL_PROGRAM_ERROR("wrong descendants in built graph");
+    if (h5fnal_get_primary_row(&graph, 3) != 0 || h5fnal_get_ancestor_rows(&graph, 3, NULL, 0) != 2)
+        H5FNAL_PROGRAM_ERROR("wrong ancestry in built graph");
+
+    /* The loop is broken at the last particle followed */
+    if (h5fnal_get_mother_row(&graph, 5) != -1 || h5fnal_get_mother_row(&graph, 4) != 5)
+        H5FNAL_PROGRAM_ERROR("mother loop was not broken");
+
+    /* Mothers are only looked for in the same truth */
+    if (h5fnal_get_mother_row(&graph, 6) != -1 || h5fnal_get_primary_row(&graph, 6) != 6)
+        H5FNAL_PROGRAM_ERROR("mother found in another truth");
+
+    if (h5fnal_get_mother_row(&graph, 7) != -1 || h5fnal_get_descendant_rows(&graph, 7, &n) != NULL || n != 0)
+        H5FNAL_PROGRAM_ERROR("particle found outside the graph");
+
+    if (h5fnal_free_particle_graph(&graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free particle graph");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    h5fnal_free_particle_graph(&graph);
+    return H5FNAL_FAILURE;
+} /* end check_built_graph() */
+
+/* Makes the trajectory points in data smooth, like real tracks */
+static void
+smooth_trajectories(h5fnal_vect_truth_data_t *data)
+{
+    hsize_t u;
+
+    for (u = 0; u < data->n_trajectories; u++) {
+        h5fnal_trajectory_t *t = &data->trajectories[u];
+        double step = (double)u + (double)rand() / RAND_MAX;
+
+        t->Vx = 120.5 + 0.3 * step;
+        t->Vy = -42.25 - 0.1 * step;
+        t->Vz = 512.0 + 0.7 * step;
+        t->T = 1.0e3 + 0.03 * step;
+        t->Px = 0.25 - 1.0e-4 * step;
+        t->Py = 1.0e-3 * step;
+        t->Pz = 1.5 - 2.0e-4 * step;
+        t->E = 1.6 - 2.0e-4 * step;
+    }
+
+    return;
+} /* end smooth_trajectories() */
+
+/* Checks trajectory points read back from an encoded dataset, which
+ * have to be exact unless they were stored as floats, when they have
+ * to be within the float rounding error
+ */
+static herr_t
+check_encoded_trajectories(const h5fnal_trajectory_t *in, const h5fnal_trajectory_t *out, hsize_t n, hbool_t exact)
+{
+    hsize_t u;
+    int j;
+
+    for (u = 0; u < n; u++) {
+        const h5fnal_trajectory_t *a = &in[u];
+        const h5fnal_trajectory_t *b = &out[u];
+        const double va[8] = {a->Vx, a->Vy, a->Vz, a->T, a->Px, a->Py, a->Pz, a->E};
+        const double vb[8] = {b->Vx, b->Vy, b->Vz, b->T, b->Px, b->Py, b->Pz, b->E};
+
+        if (a->particle_index != b->particle_index)
+            H5FNAL_PROGRAM_ERROR("wrong trajectory particle index");
+
+        for (j = 0; j < 8; j++) {
+            double error = va[j] > vb[j] ? va[j] - vb[j] : vb[j] - va[j];
+            double bound = (va[j] < 0.0 ? -va[j] : va[j]) * (FLT_EPSILON / 2.0);
+
+            if (exact ? va[j] != vb[j] : error > bound)
+                H5FNAL_PROGRAM_ERROR("bad trajectory point value");
+        }
+    }
+
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+} /* end check_encoded_trajectories() */
+
+/* Walks a vector of MC Truth with a cursor and checks the batches
+ * against the data that was written.
+ */
+static herr_t
+check_truth_cursor(h5fnal_vect_truth_t *vector, size_t max_bytes, const h5fnal_vect_truth_data_t *data)
+{
+    h5fnal_truth_cursor_t cursor;
+    h5fnal_vect_truth_data_t *batch = NULL;
+    htri_t more;
+    hsize_t n_batches = 0;
+    hsize_t g = 0;
+    hsize_t u;
+    hssize_t v;
+    hssize_t w;
+
+    memset(&cursor, 0, sizeof(h5fnal_truth_cursor_t));
+
+    if (h5fnal_open_truth_cursor(vector, max_bytes, &cursor) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open truth cursor");
+
+    while ((more = h5fnal_next_truth_batch(&cursor, &batch)) > 0) {
+        n_batches++;
+        if (0 == batch->n_truths)
+            H5FNAL_PROGRAM_ERROR("empty cursor batch");
+
+        for (u = 0; u < batch->n_truths; u++, g++) {
+            const h5fnal_truth_t *bt = &batch->truths[u];
+            const h5fnal_truth_t *dt = &data->truths[g];
+
+            if (bt->origin != dt->origin)
+                H5FNAL_PROGRAM_ERROR("bad truth from cursor");
+            if ((bt->neutrino_index < 0) != (dt->neutrino_index < 0))
+                H5FNAL_PROGRAM_ERROR("bad neutrino index from cursor");
+            if (bt->neutrino_index >= 0 && memcmp(&batch->neutrinos[bt->neutrino_index],
+                        &data->neutrinos[dt->neutrino_index], sizeof(h5fnal_neutrino_t)) != 0)
+                H5FNAL_PROGRAM_ERROR("bad neutrino from cursor");
+            if (bt->particle_end_index - bt->particle_start_index != dt->particle_end_index - dt->particle_start_index)
+                H5FNAL_PROGRAM_ERROR("wrong number of particles from cursor");
+
+            for (v = 0; v <= bt->particle_end_index - bt->particle_start_index; v++) {
+                const h5fnal_particle_t *bp = &batch->particles[bt->particle_start_index + v];
+                const h5fnal_particle_t *dp = &data->particles[dt->particle_start_index + v];
+
+                if (bp->track_id != dp->track_id || bp->mass != dp->mass)
+                    H5FNAL_PROGRAM_ERROR("bad particle from cursor");
+                for (w = 0; w <= bp->trajectory_end_index - bp->trajectory_start_index; w++) {
+                    const h5fnal_trajectory_t *btp = &batch->trajectories[bp->trajectory_start_index + w];
+
+                    if (btp->E != data->trajectories[dp->trajectory_start_index + w].E)
+                        H5FNAL_PROGRAM_ERROR("bad trajectory point from cursor");
+                    if (btp->particle_index != (hsize_t)(bt->particle_start_index + v))
+                        H5FNAL_PROGRAM_ERROR("bad trajectory particle index from cursor");
+                }
+                if ((bp->daughter_start_index < 0) != (dp->daughter_start_index < 0))
+                    H5FNAL_PROGRAM_ERROR("bad daughter index from cursor");
+                if (bp->daughter_start_index >= 0
+                        && batch->daughters[bp->daughter_start_index].track_id
+                        != data->daughters[dp->daughter_start_index].track_id)
+                    H5FNAL_PROGRAM_ERROR("bad daughter from cursor");
+            }
+        }
+    }
+    if (more < 0)
+        H5FNAL_PROGRAM_ERROR("could not get truth batch");
+    if (g != data->n_truths)
+        H5FNAL_PROGRAM_ERROR("cursor did not return all the truths");
+    if (n_batches < 2)
+        H5FNAL_PROGRAM_ERROR("cursor did not split the truths into batches");
+
+    if (h5fnal_close_truth_cursor(&cursor) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close truth cursor");
+
+    return H5FNAL_SUCCESS;
+
+error:
+    h5fnal_close_truth_cursor(&cursor);
+    return H5FNAL_FAILURE;
+} /* end check_truth_cursor() */
+
 int
 main(void)
 {
@@ -142,9 +606,29 @@ main(void)
     h5fnal_vect_truth_t *vector = NULL;
     h5fnal_vect_truth_data_t *data = NULL;
     h5fnal_vect_truth_data_t *data_out = NULL;
+    h5fnal_create_options_t options;
+    h5fnal_event_summary_t summary;
+    h5fnal_particle_graph_t graph;
+    h5fnal_event_index_t index;
+    h5fnal_event_entry_t entry;
+    htri_t found;
+    hsize_t n_truths;
+    compact_particle_t *compact = NULL;
+    const char *names[2] = {COLUMN_NAME, MULTI_NAME};
+    const char *encoded_names[2] = {DELTA_NAME, FLOAT_NAME};
+    hid_t   did = -1;
+    hid_t   dcpl_id = -1;
+    hid_t   file_tid = -1;
+    char   *encoding = NULL;
+    int n_filters;
+    hsize_t u;
+    int i;
+    int j;
 
     printf("Testing vector of MC Truth operations... ");
 
+    memset(&graph, 0, sizeof(h5fnal_particle_graph_t));
+
     /* Create the file */
     if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
         H5FNAL_HDF5_ERROR;
@@ -164,7 +648,7 @@ main(void)
     /* Create the vector of MC truth data product */
     if (NULL == (vector = (h5fnal_vect_truth_t *)calloc(1, sizeof(h5fnal_vect_truth_t))))
         H5FNAL_PROGRAM_ERROR("could not get memory for vector");
-    if (h5fnal_create_v_mc_truth(event_id, VECTOR_NAME, vector) < 0)
+    if (h5fnal_create_v_mc_truth(event_id, VECTOR_NAME, NULL, vector) < 0)
         H5FNAL_PROGRAM_ERROR("could not create vector of mc truth");
 
     /* Generate some test data */
@@ -192,8 +676,6 @@ main(void)
         H5FNAL_PROGRAM_ERROR("could not open vector of mc truth");
 
     /* Re-read the truths */
-    if (h5fnal_free_truth_mem_data(data) < 0)
-        H5FNAL_PROGRAM_ERROR("could not clean up test data");
     if (h5fnal_read_all_truths(vector, data_out) < 0)
         H5FNAL_PROGRAM_ERROR("could not read truths from the file");
 
@@ -208,11 +690,326 @@ main(void)
         H5FNAL_PROGRAM_ERROR("bad read data (particles)");
     if (memcmp(data->neutrinos, data_out->neutrinos, data->n_neutrinos * sizeof(h5fnal_neutrino_t)) != 0)
         H5FNAL_PROGRAM_ERROR("bad read data (neutrinos)");
+    if (h5fnal_free_truth_mem_data(data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not clean up test data");
 
     /* Close the vector */
     if (h5fnal_close_v_mc_truth(vector) < 0)
         H5FNAL_PROGRAM_ERROR("could not close vector");
 
+    /* Write truths with valid indices, in small chunks, and walk them
+     * with a cursor.
+     */
+    if (h5fnal_init_create_options(&options) < 0)
+        H5FNAL_PROGRAM_ERROR("could not initialize creation options");
+    options.chunk_policy.target_bytes = 8 * sizeof(h5fnal_truth_t);
+    if (h5fnal_create_v_mc_truth(event_id, LINKED_NAME, &options, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create vector of mc truth");
+    if (generate_linked_truths(100, data) < 0)
+        H5FNAL_PROGRAM_ERROR("problem generating data for testing");
+    if (h5fnal_append_truths(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write truths to the file");
+    if (check_truth_cursor(vector, 4096, data) < 0)
+        H5FNAL_PROGRAM_ERROR("bad truth cursor results");
+    if (check_truth_cursor(vector, 1, data) < 0)
+        H5FNAL_PROGRAM_ERROR("bad truth cursor results with a tiny memory bound");
+    if (h5fnal_close_v_mc_truth(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    /* Summarize the truths */
+    if (h5fnal_init_event_summary(&summary, 1, 2, 3) < 0)
+        H5FNAL_PROGRAM_ERROR("could not initialize event summary");
+    if (h5fnal_summarize_truths(&summary, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not summarize truths");
+    if (summary.n_truths != 100 || summary.n_particles != 300 || summary.n_neutrinos != 50
+            || summary.origin_mask != 0x1f || summary.n_hits != 0)
+        H5FNAL_PROGRAM_ERROR("bad truth summary");
+
+    /* Append linked truths in batches, with the datasets' chunks small
+     * enough that some of each batch is written and some is buffered.
+     * Each batch's indices are relative to the batch and the appends
+     * move them, so the result is the same as one big append.
+     */
+    if (h5fnal_create_v_mc_truth(event_id, MULTI_NAME, &options, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create vector of mc truth");
+    for (i = 0; i < N_BATCHES; i++) {
+        if (h5fnal_free_truth_mem_data(data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not clean up test data");
+        if (generate_linked_truths(N_BATCH_TRUTHS, data) < 0)
+            H5FNAL_PROGRAM_ERROR("problem generating data for testing");
+        if (h5fnal_append_truths(vector, data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write truths to the file");
+    }
+    if (h5fnal_free_truth_mem_data(data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not clean up read data");
+    if (h5fnal_read_all_truths(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read truths from the file");
+    if (check_linked_indices(data_out, N_BATCHES * N_BATCH_TRUTHS) < 0)
+        H5FNAL_PROGRAM_ERROR("bad indices after several appends");
+    if (check_truth_cursor(vector, 4096, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("bad truth cursor results after several appends");
+    if (h5fnal_close_v_mc_truth(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    /* The same with column storage for the particles */
+    options.storage = H5FNAL_STORAGE_COLUMNS;
+    if (h5fnal_create_v_mc_truth(event_id, COLUMN_NAME, &options, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create vector of mc truth");
+    for (i = 0; i < N_BATCHES; i++) {
+        if (h5fnal_free_truth_mem_data(data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not clean up test data");
+        if (generate_linked_truths(N_BATCH_TRUTHS, data) < 0)
+            H5FNAL_PROGRAM_ERROR("problem generating data for testing");
+        if (h5fnal_append_truths(vector, data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write truths to the file");
+    }
+    if (h5fnal_free_truth_mem_data(data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not clean up read data");
+    if (h5fnal_read_all_truths(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read truths from the file");
+    if (check_linked_indices(data_out, N_BATCHES * N_BATCH_TRUTHS) < 0)
+        H5FNAL_PROGRAM_ERROR("bad indices with column storage");
+    if (memcmp(data->particles, data_out->particles + (N_BATCHES - 1) * data->n_particles,
+                data->n_particles * sizeof(h5fnal_particle_t)) != 0)
+        H5FNAL_PROGRAM_ERROR("bad read data with column storage (particles)");
+    if (check_truth_cursor(vector, 4096, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("bad truth cursor results with column storage");
+    if (h5fnal_close_v_mc_truth(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    /* Projected reads fill in compact structs, from either storage */
+    for (i = 0; i < 2; i++) {
+        if (h5fnal_open_v_mc_truth(event_id, names[i], vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open vector of mc truth");
+        if (vector->particle_storage != (0 == i ? H5FNAL_STORAGE_COLUMNS : H5FNAL_STORAGE_ROWS))
+            H5FNAL_PROGRAM_ERROR("particle storage was not detected");
+        if (h5fnal_free_truth_mem_data(data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not clean up read data");
+        if (h5fnal_read_all_truths(vector, data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read truths from the file");
+
+        if (NULL == (compact = (compact_particle_t *)calloc(data_out->n_particles, sizeof(compact_particle_t))))
+            H5FNAL_PROGRAM_ERROR("could not allocate memory for particles");
+        if (h5fnal_read_particle_projection_range(vector,
+                    H5FNAL_PARTICLE_PDG_CODE | H5FNAL_PARTICLE_MASS | H5FNAL_PARTICLE_RESCATTER,
+                    0, data_out->n_particles, compact) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read particle projection");
+        for (u = 0; u < data_out->n_particles; u++)
+            if (compact[u].pdg_code != data_out->particles[u].pdg_code
+                    || compact[u].mass != data_out->particles[u].mass
+                    || compact[u].rescatter != data_out->particles[u].rescatter)
+                H5FNAL_PROGRAM_ERROR("bad projected particle read");
+        free(compact);
+        compact = NULL;
+
+        if (h5fnal_close_v_mc_truth(vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close vector");
+    }
+
+    /* Encoded trajectories read back as h5fnal_trajectory_t, exactly
+     * with the delta encoding and to float precision with float32. The
+     * small chunks put many block boundaries in each batch, and the
+     * last batch is appended after the data product is re-opened, in
+     * the middle of a block.
+     */
+    options.storage = H5FNAL_STORAGE_ROWS;
+    options.chunk_policy.target_bytes = 11 * sizeof(h5fnal_trajectory_t);
+    for (i = 0; i < 2; i++) {
+        options.trajectory_encoding = 0 == i ? H5FNAL_ENCODING_DELTA : H5FNAL_ENCODING_DELTA_FLOAT32;
+        if (h5fnal_create_v_mc_truth(event_id, encoded_names[i], &options, vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not create vector of mc truth");
+        for (j = 0; j < N_BATCHES; j++) {
+            if (N_BATCHES - 1 == j) {
+                if (h5fnal_close_v_mc_truth(vector) < 0)
+                    H5FNAL_PROGRAM_ERROR("could not close vector");
+                if (h5fnal_open_v_mc_truth(event_id, encoded_names[i], vector) < 0)
+                    H5FNAL_PROGRAM_ERROR("could not open vector of mc truth");
+            }
+            if (h5fnal_free_truth_mem_data(data) < 0)
+                H5FNAL_PROGRAM_ERROR("could not clean up test data");
+            if (generate_linked_truths(N_BATCH_TRUTHS, data) < 0)
+                H5FNAL_PROGRAM_ERROR("problem generating data for testing");
+            smooth_trajectories(data);
+            if (h5fnal_append_truths(vector, data) < 0)
+                H5FNAL_PROGRAM_ERROR("could not write truths to the file");
+        }
+        if (h5fnal_close_v_mc_truth(vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close vector");
+
+        if (h5fnal_open_v_mc_truth(event_id, encoded_names[i], vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open vector of mc truth");
+        if (h5fnal_free_truth_mem_data(data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not clean up read data");
+        if (h5fnal_read_all_truths(vector, data_out) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read truths from the file");
+        if (check_linked_indices(data_out, N_BATCHES * N_BATCH_TRUTHS) < 0)
+            H5FNAL_PROGRAM_ERROR("bad indices with encoded trajectories");
+        if (check_encoded_trajectories(data->trajectories,
+                    data_out->trajectories + data_out->n_trajectories - data->n_trajectories,
+                    data->n_trajectories, 0 == i) < 0)
+            H5FNAL_PROGRAM_ERROR("bad encoded trajectories");
+
+        /* Range reads decode from the start of a block */
+        if (h5fnal_read_trajectories_range(vector, data_out->n_trajectories - data->n_trajectories,
+                    data->n_trajectories, data_out->trajectories) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read trajectory points");
+        if (check_encoded_trajectories(data->trajectories, data_out->trajectories, data->n_trajectories, 0 == i) < 0)
+            H5FNAL_PROGRAM_ERROR("bad encoded trajectory range");
+
+        /* The dataset is a plain one with the standard filters, and
+         * the encoding is named in an attribute
+         */
+        if ((did = H5Dopen2(vector->top_level_group_id, "trajectories", H5P_DEFAULT)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (h5fnal_get_string_attribute(did, "encoding", &encoding) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read encoding attribute");
+        if (strcmp(encoding, 0 == i ? "delta" : "delta_float32") != 0)
+            H5FNAL_PROGRAM_ERROR("wrong encoding attribute");
+        free(encoding);
+        encoding = NULL;
+        if ((file_tid = H5Dget_type(did)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if (H5Tget_size(file_tid) != (0 == i ? sizeof(h5fnal_trajectory_t) : 8 * sizeof(float) + sizeof(hsize_t)))
+            H5FNAL_PROGRAM_ERROR("wrong trajectory file datatype");
+        if ((dcpl_id = H5Dget_create_plist(did)) < 0)
+            H5FNAL_HDF5_ERROR;
+        if ((n_filters = H5Pget_nfilters(dcpl_id)) < 0)
+            H5FNAL_HDF5_ERROR;
+        for (j = 0; j < n_filters; j++) {
+            H5Z_filter_t filter;
+
+            if ((filter = H5Pget_filter2(dcpl_id, (unsigned)j, NULL, NULL, NULL, 0, NULL, NULL)) < 0)
+                H5FNAL_HDF5_ERROR;
+            if (filter != H5Z_FILTER_SHUFFLE && filter != H5Z_FILTER_DEFLATE
+                    && filter != H5FNAL_FILTER_LZ4 && filter != H5FNAL_FILTER_ZSTD)
+                H5FNAL_PROGRAM_ERROR("trajectory dataset has a non-standard filter");
+        }
+        if (H5Pclose(dcpl_id) < 0)
+            H5FNAL_HDF5_ERROR;
+        dcpl_id = -1;
+        if (H5Tclose(file_tid) < 0)
+            H5FNAL_HDF5_ERROR;
+        file_tid = -1;
+        if (H5Dclose(did) < 0)
+            H5FNAL_HDF5_ERROR;
+        did = -1;
+
+        if (h5fnal_close_v_mc_truth(vector) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close vector");
+    }
+    options.chunk_policy.target_bytes = 8 * sizeof(h5fnal_truth_t);
+
+    /* The writer stores the particle graph when asked to. Read it for
+     * the whole data product and for one batch (like an event in the
+     * flat layout).
+     */
+    if (check_built_graph() < 0)
+        H5FNAL_PROGRAM_ERROR("bad built particle graph");
+    options.particle_graph = TRUE;
+    if (h5fnal_create_v_mc_truth(event_id, GRAPH_NAME, &options, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create vector of mc truth");
+    for (i = 0; i < N_BATCHES; i++) {
+        if (h5fnal_free_truth_mem_data(data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not clean up test data");
+        if (generate_linked_truths(N_BATCH_TRUTHS, data) < 0)
+            H5FNAL_PROGRAM_ERROR("problem generating data for testing");
+        chain_particles(data);
+        if (h5fnal_append_truths(vector, data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not write truths to the file");
+    }
+    if (h5fnal_close_v_mc_truth(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    if (h5fnal_open_v_mc_truth(event_id, GRAPH_NAME, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open vector of mc truth");
+    if (h5fnal_free_truth_mem_data(data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not clean up read data");
+    if (h5fnal_read_all_truths(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read truths from the file");
+    if (h5fnal_read_particle_graph_range(vector, 0, data_out->n_particles, &graph) != TRUE)
+        H5FNAL_PROGRAM_ERROR("could not read particle graph");
+    if (check_particle_chains(&graph, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("bad particle graph");
+
+    /* The last batch, read on its own, matches the last append */
+    for (u = 0; u < data->n_truths; u++) {
+        data->truths[u].particle_start_index -= (hssize_t)((N_BATCHES - 1) * data->n_particles);
+        data->truths[u].particle_end_index -= (hssize_t)((N_BATCHES - 1) * data->n_particles);
+    }
+    if (h5fnal_read_particle_graph_range(vector, (N_BATCHES - 1) * data->n_particles, data->n_particles, &graph) != TRUE)
+        H5FNAL_PROGRAM_ERROR("could not read particle graph range");
+    if (check_particle_chains(&graph, data) < 0)
+        H5FNAL_PROGRAM_ERROR("bad particle graph range");
+
+    if (h5fnal_close_v_mc_truth(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+    if (h5fnal_free_particle_graph(&graph) < 0)
+        H5FNAL_PROGRAM_ERROR("could not free particle graph");
+
+    /* Flat layout: one data product for several events of different
+     * sizes, added in reverse event order. Each event's indices are
+     * relative to the event when appended and when read back.
+     */
+    if (h5fnal_create_v_mc_truth(subrun_id, FLAT_NAME, NULL, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create vector of mc truth");
+    if (h5fnal_create_event_index(vector->top_level_group_id, NULL, &index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create event index");
+    for (i = 0; i < N_BATCHES; i++) {
+        if (h5fnal_free_truth_mem_data(data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not clean up test data");
+        if (generate_linked_truths(N_BATCH_TRUTHS + 7 * i, data) < 0)
+            H5FNAL_PROGRAM_ERROR("problem generating data for testing");
+        if (h5fnal_append_event_truths(vector, &index, 1, 2, (unsigned)(N_BATCHES - i), data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not append event truths");
+    }
+    if (h5fnal_close_event_index(&index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close event index");
+    if (h5fnal_close_v_mc_truth(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
+    if (h5fnal_open_v_mc_truth(subrun_id, FLAT_NAME, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open vector of mc truth");
+    if (h5fnal_open_event_index(vector->top_level_group_id, &index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open event index");
+    if (index.n_entries != N_BATCHES || !index.sorted)
+        H5FNAL_PROGRAM_ERROR("bad event index");
+    if (h5fnal_free_truth_mem_data(data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not clean up read data");
+    if (h5fnal_read_all_truths(vector, data_out) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read truths from the file");
+    n_truths = 0;
+    for (i = 0; i < N_BATCHES; i++) {
+        if ((found = h5fnal_find_event(&index, 1, 2, (unsigned)(N_BATCHES - i), &entry)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not look up event");
+        if (!found)
+            H5FNAL_PROGRAM_ERROR("event missing from event index");
+        if (entry.start[H5FNAL_TRUTH_RANGE_TRUTHS] != n_truths
+                || entry.count[H5FNAL_TRUTH_RANGE_TRUTHS] != (hsize_t)(N_BATCH_TRUTHS + 7 * i)
+                || entry.start[H5FNAL_TRUTH_RANGE_PARTICLES] != 3 * n_truths
+                || entry.start[H5FNAL_TRUTH_RANGE_TRAJECTORIES] != 6 * n_truths)
+            H5FNAL_PROGRAM_ERROR("wrong event index ranges");
+        n_truths += entry.count[H5FNAL_TRUTH_RANGE_TRUTHS];
+
+        if (h5fnal_read_event_truths(vector, &entry, data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read event truths");
+        if (check_event_truths(data, data_out, &entry) < 0)
+            H5FNAL_PROGRAM_ERROR("bad event truths");
+    }
+    if (n_truths != data_out->n_truths)
+        H5FNAL_PROGRAM_ERROR("event index doesn't cover the data product");
+
+    /* The default options don't store a particle graph */
+    if (H5Lexists(vector->top_level_group_id, H5FNAL_PARTICLE_GRAPH_GROUP_NAME, H5P_DEFAULT) != 0)
+        H5FNAL_PROGRAM_ERROR("particle graph stored without being asked for");
+    if (h5fnal_read_particle_graph_range(vector, 0, data_out->n_particles, &graph) != FALSE)
+        H5FNAL_PROGRAM_ERROR("particle graph reported for a data product without one");
+    if ((found = h5fnal_find_event(&index, 1, 2, N_BATCHES + 1, &entry)) != FALSE)
+        H5FNAL_PROGRAM_ERROR("found an event that isn't there");
+    if (h5fnal_close_event_index(&index) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close event index");
+    if (h5fnal_close_v_mc_truth(vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close vector");
+
     /* Close everything else */
     free(vector);
 
@@ -240,7 +1037,13 @@ main(void)
     exit(EXIT_SUCCESS);
 
 error:
+    free(compact);
+    free(encoding);
+    h5fnal_free_particle_graph(&graph);
     H5E_BEGIN_TRY {
+        H5Pclose(dcpl_id);
+        H5Tclose(file_tid);
+        H5Dclose(did);
         if (vector) {
             h5fnal_close_v_mc_truth(vector);
             free(vector);
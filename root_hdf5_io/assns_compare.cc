@@ -27,45 +27,13 @@ using namespace art;
 using namespace std;
 using namespace std::chrono;
 
-/* We can't do simple compare here since gallery can't create Ptrs. Instead,
- * we'll just compare the individual data fields.
- */
-hbool_t
-compare_hdf5_assns(hid_t loc_id, unsigned run, unsigned subrun, unsigned event, 
-        art::Assns<recob::Cluster, recob::Hit> root_assns)
+/* Compares the pairs read from the HDF5 file with the Root Assns */
+static hbool_t
+same_pairs(const h5fnal_assns_data_t *data, const art::Assns<recob::Cluster, recob::Hit> &root_assns)
 {
-    string  run_name = std::to_string(run);
-    string  subrun_name = std::to_string(subrun);
-    string  event_name = std::to_string(event);
-    hid_t   run_id = -1;
-    hid_t   subrun_id = -1;
-    hid_t   event_id = -1;
-    h5fnal_assns_t *assns = NULL;
-    h5fnal_assns_data_t *data = NULL;
     hsize_t u;
     hbool_t same = TRUE;
 
-    // Open run, sub-run, and event
-    if ((run_id = h5fnal_open_run(loc_id, run_name.c_str())) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open run")
-    if ((subrun_id = h5fnal_open_run(run_id, subrun_name.c_str())) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open sub-run")
-    if ((event_id = h5fnal_open_event(subrun_id, event_name.c_str())) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open event")
-
-    // Open the data product
-    if (NULL == (assns = (h5fnal_assns_t *)calloc(1, sizeof(h5fnal_assns_t))))
-        H5FNAL_PROGRAM_ERROR("could not get memory for assns")
-    if (h5fnal_open_assns(event_id, BADNAME, assns) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open assns")
-
-    // Read all the data
-    if (NULL == (data = (h5fnal_assns_data_t *)calloc(1, sizeof(h5fnal_assns_data_t))))
-        H5FNAL_PROGRAM_ERROR("could not get memory for assns data")
-    if (h5fnal_read_all_assns(assns, data) < 0)
-        H5FNAL_PROGRAM_ERROR("could not read assns data from the file")
-
-    // Compare with Root Assns
     if (data->n != root_assns.size())
         same = FALSE;
     else {
@@ -92,41 +60,114 @@ compare_hdf5_assns(hid_t loc_id, unsigned run, unsigned subrun, unsigned event,
     }
 #endif
 
+    return same;
+}
+
+/* We can't do simple compare here since gallery can't create Ptrs. Instead,
+ * we'll just compare the individual data fields.
+ */
+hbool_t
+compare_hdf5_assns(h5fnal_group_cache_t *groups, const h5fnal_event_lookup_t *lookup, unsigned run, unsigned subrun,
+        unsigned event, h5fnal_assns_data_t *data, art::Assns<recob::Cluster, recob::Hit> root_assns)
+{
+    hid_t   event_id = -1;
+    htri_t  found;
+    h5fnal_assns_t *assns = NULL;
+    htri_t  exists;
+    hbool_t same = TRUE;
+
+    // Open the event directly if the file has an event lookup, otherwise
+    // by name, with the run and sub-run coming from the group cache
+    if (lookup->n_entries > 0) {
+        if ((found = h5fnal_open_event_by_number(lookup, run, subrun, event, &event_id)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open event")
+        if (!found)
+            H5FNAL_PROGRAM_ERROR("event is not in the event lookup")
+    }
+    else if ((event_id = h5fnal_open_cached_event(groups, run, subrun, event)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open event")
+
+    // Empty Assns aren't written at all
+    if ((exists = H5Lexists(event_id, BADNAME, H5P_DEFAULT)) < 0)
+        H5FNAL_HDF5_ERROR
+    data->n = 0;
+
+    if (exists) {
+        // Open the data product
+        if (NULL == (assns = (h5fnal_assns_t *)calloc(1, sizeof(h5fnal_assns_t))))
+            H5FNAL_PROGRAM_ERROR("could not get memory for assns")
+        if (h5fnal_open_assns(event_id, BADNAME, assns) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open assns")
+
+        // Read all the data into the caller's buffers, growing them if needed
+        if (h5fnal_get_assns_sizes(assns, data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not get assns sizes")
+        if (h5fnal_reserve_assns_mem_data(assns, data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not get memory for assns data")
+        if (h5fnal_read_all_assns_into(assns, data) < 0)
+            H5FNAL_PROGRAM_ERROR("could not read assns data from the file")
+    }
+
+    // Compare with Root Assns
+    same = same_pairs(data, root_assns);
+
     // Close everything
-    if (h5fnal_close_run(run_id) < 0)
-        H5FNAL_PROGRAM_ERROR("could not close run")
-    if (h5fnal_close_run(subrun_id) < 0)
-        H5FNAL_PROGRAM_ERROR("could not close run")
     if (h5fnal_close_event(event_id) < 0)
         H5FNAL_PROGRAM_ERROR("could not close event")
-    if (h5fnal_close_assns(assns) < 0)
-        H5FNAL_PROGRAM_ERROR("could not close assns")
-    if (h5fnal_free_assns_mem_data(data) < 0)
-        H5FNAL_PROGRAM_ERROR("could not free assns data");
+    if (assns)
+        if (h5fnal_close_assns(assns) < 0)
+            H5FNAL_PROGRAM_ERROR("could not close assns")
     free(assns);
-    free(data);
 
     return same;
 
 error:
     H5E_BEGIN_TRY {
-        h5fnal_close_run(run_id);
-        h5fnal_close_run(subrun_id);
         h5fnal_close_event(event_id);
-        h5fnal_close_assns(assns);
+        if (assns)
+            h5fnal_close_assns(assns);
     } H5E_END_TRY;
-    if (data )
-        h5fnal_free_assns_mem_data(data);
     free(assns);
-    free(data);
 
     return FALSE;
 }
 
+/* Flat layout version of compare_hdf5_assns(). The data product and its
+ * event index are opened once for the whole file.
+ */
+hbool_t
+compare_flat_hdf5_assns(h5fnal_assns_t *assns, const h5fnal_event_index_t *index, unsigned run, unsigned subrun,
+        unsigned event, h5fnal_assns_data_t *data, art::Assns<recob::Cluster, recob::Hit> root_assns)
+{
+    h5fnal_event_entry_t entry;
+    htri_t found;
+
+    if ((found = h5fnal_find_event(index, run, subrun, event, &entry)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not look up event")
+    if (!found)
+        H5FNAL_PROGRAM_ERROR("event is not in the event index")
+
+    if (h5fnal_read_event_assns(assns, &entry, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read assns data from the file")
+
+    return same_pairs(data, root_assns);
+
+error:
+    return FALSE;
+}
+
 int main(int argc, char* argv[]) {
 
   hid_t   fid 		= H5FNAL_BAD_HID_T;
   hid_t   master_id = H5FNAL_BAD_HID_T;
+  htri_t  flat      = FALSE;
+  h5fnal_assns_t flat_assns {};
+  h5fnal_event_index_t index {};
+  h5fnal_event_lookup_t lookup {};
+  h5fnal_group_cache_t groups {};
+
+  // Read buffers, reused for every event
+  h5fnal_assns_data_t hdf5_data {};
  
   InputTag mchits_tag { "mchitfinder" };
   InputTag vertex_tag { "linecluster" };
@@ -147,13 +188,31 @@ int main(int argc, char* argv[]) {
   /* Open the HDF5 file */
   string h5FileName = filenames.back();
   filenames.pop_back();
-  if ((fid = H5Fopen(h5FileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT)) < 0)
-    H5FNAL_HDF5_ERROR;
+  if ((fid = h5fnal_open_file(h5FileName.c_str(), H5F_ACC_RDONLY, H5FNAL_PROFILE_BULK_READ)) < 0)
+    H5FNAL_PROGRAM_ERROR("could not open HDF5 file");
 
   /* Open the master run container */
   if ((master_id = h5fnal_open_run(fid, MASTER_RUN_CONTAINER)) < 0)
     H5FNAL_PROGRAM_ERROR("could not open master run containing group");
 
+  /* Files written with the flat layout have a single data product in
+   * the master run container, with an event index
+   */
+  if ((flat = H5Lexists(master_id, BADNAME, H5P_DEFAULT)) < 0)
+    H5FNAL_HDF5_ERROR;
+  if (flat) {
+    if (h5fnal_open_assns(master_id, BADNAME, &flat_assns) < 0)
+      H5FNAL_PROGRAM_ERROR("could not open assns");
+    if (h5fnal_open_event_index(flat_assns.top_level_group_id, &index) < 0)
+      H5FNAL_PROGRAM_ERROR("could not open event index");
+  }
+  else {
+    if (h5fnal_open_event_lookup(master_id, &lookup) < 0)
+      H5FNAL_PROGRAM_ERROR("could not open event lookup");
+    if (h5fnal_create_group_cache(master_id, 0, &groups) < 0)
+      H5FNAL_PROGRAM_ERROR("could not create group cache");
+  }
+
   // The gallery::Event object acts as a cursor into the stream of events.
   // A newly-constructed gallery::Event is at the start if its stream.
   // Use gallery::Event::atEnd() to check if you've reached the end of the stream.
@@ -181,7 +240,11 @@ int main(int argc, char* argv[]) {
     auto const t1 = system_clock::now();
 
     // Open the data product in the event in the HDF5 file and compare the data with the Root data.
-    same = compare_hdf5_assns(master_id, aux.run(), aux.subRun(), aux.event(), root_clusters_hits);
+    if (flat)
+      same = compare_flat_hdf5_assns(&flat_assns, &index, aux.run(), aux.subRun(), aux.event(), &hdf5_data,
+              root_clusters_hits);
+    else
+      same = compare_hdf5_assns(&groups, &lookup, aux.run(), aux.subRun(), aux.event(), &hdf5_data, root_clusters_hits);
 
     auto const t2 = system_clock::now();
 
@@ -195,8 +258,22 @@ int main(int argc, char* argv[]) {
   }
 
   /* Clean up */
-  if (H5Fclose(fid) < 0)
-    H5FNAL_HDF5_ERROR;
+  if (flat) {
+    if (h5fnal_close_event_index(&index) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close event index");
+    if (h5fnal_close_assns(&flat_assns) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close assns");
+  }
+  else {
+    if (h5fnal_close_event_lookup(&lookup) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close event lookup");
+    if (h5fnal_close_group_cache(&groups) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close group cache");
+  }
+  if (h5fnal_free_assns_mem_data(&hdf5_data) < 0)
+    H5FNAL_PROGRAM_ERROR("could not free assns data");
+  if (h5fnal_close_file(fid) < 0)
+    H5FNAL_PROGRAM_ERROR("could not close HDF5 file");
   if (h5fnal_close_run(master_id) < 0)
     H5FNAL_PROGRAM_ERROR("could not close master run container")
 
@@ -213,9 +290,15 @@ int main(int argc, char* argv[]) {
 error:
 
   H5E_BEGIN_TRY {
+    if (flat > 0) {
+      h5fnal_close_event_index(&index);
+      h5fnal_close_assns(&flat_assns);
+    }
+    h5fnal_close_group_cache(&groups);
     H5Fclose(fid);
     h5fnal_close_run(master_id);
   } H5E_END_TRY;
+  free(lookup.entries);
 
   std::cout << "*** FAILURE ***\n";
   exit(EXIT_FAILURE);
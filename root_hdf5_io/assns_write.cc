@@ -27,7 +27,6 @@ int main(int argc, char* argv[]) {
 
   size_t totalHits = 0L;
   hid_t   fid 		= H5FNAL_BAD_HID_T;
-  hid_t   fapl_id 	= H5FNAL_BAD_HID_T;
   hid_t   master_id = H5FNAL_BAD_HID_T;
   hid_t   run_id 	= H5FNAL_BAD_HID_T;
   hid_t   subrun_id = H5FNAL_BAD_HID_T;
@@ -35,26 +34,34 @@ int main(int argc, char* argv[]) {
   int prevRun 		= -1;
   int prevSubRun 	= -1;
   h5fnal_assns_t *h5assns = NULL;
+  h5fnal_event_index_t index {};
+  h5fnal_event_lookup_t lookup {};
+  h5fnal_summary_table_t summaries {};
+  h5fnal_event_summary_t summary;
+  bool flat = false;
  
   InputTag mchits_tag { "mchitfinder" };
   InputTag vertex_tag { "linecluster" };
   InputTag assns_tag  { "linecluster" };
 
+  // With --flat, all the events go into a single data product in the
+  // master run container, along with an event index, instead of one
+  // data product per event.
   vector<string> filenames { argv+1, argv+argc }; // filenames from command line
+  if (!filenames.empty() && filenames.front() == "--flat") {
+    flat = true;
+    filenames.erase(filenames.begin());
+  }
   if (2 != filenames.size()) {
-    std::cerr << "Please supply input and output filenames\n";
+    std::cerr << "Please supply input and output filenames (and optionally --flat first)\n";
     exit(EXIT_FAILURE);
   }
 
   /* Create the HDF5 file */
   string h5FileName = filenames.back();
   filenames.pop_back();
-  if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
-    H5FNAL_HDF5_ERROR;
-  if (H5Pset_libver_bounds(fapl_id, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST) < 0)
-    H5FNAL_HDF5_ERROR;
-  if ((fid = H5Fcreate(h5FileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl_id)) < 0)
-    H5FNAL_HDF5_ERROR;
+  if ((fid = h5fnal_create_file(h5FileName.c_str(), H5FNAL_PROFILE_STREAMING_WRITE)) < 0)
+    H5FNAL_PROGRAM_ERROR("could not create HDF5 file");
 
   /* Create a top-level containing group in which creation order is tracked and indexed.
    * There is no way to do this in the root group, so we can't use that.
@@ -70,6 +77,23 @@ int main(int argc, char* argv[]) {
   if (NULL == (h5assns = (h5fnal_assns_t *)calloc(1, sizeof(h5fnal_assns_t))))
     H5FNAL_PROGRAM_ERROR("could not get memory for HDF5 data product struct");
 
+  /* The flat layout has one data product for the whole file */
+  if (flat) {
+    if (h5fnal_create_assns(master_id, BADNAME, "recob::Cluster", "recob:Hit", -1, NULL, h5assns) < 0)
+      H5FNAL_PROGRAM_ERROR("could not create HDF5 data product");
+    if (h5fnal_create_event_index(h5assns->top_level_group_id, NULL, &index) < 0)
+      H5FNAL_PROGRAM_ERROR("could not create event index");
+  }
+  else {
+    // Events are opened by number through the lookup
+    if (h5fnal_create_event_lookup(master_id, &lookup) < 0)
+      H5FNAL_PROGRAM_ERROR("could not create event lookup");
+  }
+
+  // Per-event summaries, for skimming without reading the assns
+  if (h5fnal_create_summary_table(master_id, &summaries) < 0)
+    H5FNAL_PROGRAM_ERROR("could not create summary table");
+
   // The gallery::Event object acts as a cursor into the stream of events.
   // A newly-constructed gallery::Event is at the start if its stream.
   // Use gallery::Event::atEnd() to check if you've reached the end of the stream.
@@ -89,7 +113,10 @@ int main(int argc, char* argv[]) {
     unsigned int currentRun = aux.run();
     unsigned int currentSubRun = aux.subRun();
 
-    if ((int)currentRun != prevRun) {
+    if (flat) {
+      // No groups, the event index records where the event's data goes
+    }
+    else if ((int)currentRun != prevRun) {
       // Create a new run (create name from the integer ID)
       if (run_id != H5FNAL_BAD_HID_T)
         if (h5fnal_close_run(run_id) < 0)
@@ -123,21 +150,16 @@ int main(int argc, char* argv[]) {
 
     // Create a new event (create name from the integer ID)
     unsigned int currentEvent = aux.event();
-    if ((event_id = h5fnal_create_event(subrun_id, std::to_string(currentEvent).c_str(), FALSE)) < 0)
+    if (!flat && (event_id = h5fnal_create_event(subrun_id, std::to_string(currentEvent).c_str(), FALSE)) < 0)
       H5FNAL_PROGRAM_ERROR("could not create event");
+    if (!flat && h5fnal_add_event_to_lookup(&lookup, currentRun, currentSubRun, currentEvent, event_id) < 0)
+      H5FNAL_PROGRAM_ERROR("could not add event to lookup");
    
     // getValidHandle() is preferred to getByLabel(), for both art and
     // gallery use. It does not require in-your-face error handling.
     // art::Assns<recob::Cluster, recob::Hit> const& clusters_hits = *ev.getValidHandle<art::Assns<recob::Cluster, recob::Hit>>(assns_tag); 
     auto const& clusters_hits =  *ev.getValidHandle<art::Assns<recob::Cluster, recob::Hit>>(assns_tag); 
 
-    // Create the Assns via h5fnal.
-    // The empty string following the 2nd underscore indicates and empty 'product instance name'.
-    // There is no need to represent the 'process name' because that is a top-level of the file entity -- in the root group.
-    // TODO: Update the name (using a cheap, hard-coded name for now)
-    if (h5fnal_create_assns(event_id, BADNAME, "recob::Cluster", "recob:Hit", -1, h5assns) < 0)
-      H5FNAL_PROGRAM_ERROR("could not create HDF5 data product");
-
     // Process all data in the Assns
     for (auto const& p : clusters_hits) {
         // p.first is an art::Ptr<recob::Cluster>
@@ -161,31 +183,63 @@ int main(int argc, char* argv[]) {
     h5assns_data.data = NULL;
     h5assns_data.n = h5pairs.size();
 
-    /* Write flattened Assns data to the HDF5 file */
+    /* Write flattened Assns data to the HDF5 file. Empty Assns are
+     * skipped entirely (readers treat a missing product as empty),
+     * except in the flat layout, where every event gets an index entry.
+     */
     cout << " (" << h5pairs.size() << " Assns elements)" << endl;
-    if (h5pairs.size() > 0)
-        if (h5fnal_append_assns(h5assns, &h5assns_data) < 0)
-            H5FNAL_PROGRAM_ERROR("could not write assns to the HDF5 file");
+    if (flat) {
+      if (h5fnal_append_event_assns(h5assns, &index, currentRun, currentSubRun, currentEvent, &h5assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write assns to the HDF5 file");
+    }
+    else if (h5pairs.size() > 0) {
+      // Create the Assns via h5fnal.
+      // The empty string following the 2nd underscore indicates and empty 'product instance name'.
+      // There is no need to represent the 'process name' because that is a top-level of the file entity -- in the root group.
+      // TODO: Update the name (using a cheap, hard-coded name for now)
+      if (h5fnal_create_assns(event_id, BADNAME, "recob::Cluster", "recob:Hit", -1, NULL, h5assns) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create HDF5 data product");
+      if (h5fnal_append_assns(h5assns, &h5assns_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write assns to the HDF5 file");
+      if (h5fnal_close_assns(h5assns) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close HDF5 data product");
+    }
 
-    /* Close the event and HDF5 data product */
-    if (h5fnal_close_assns(h5assns) < 0)
-      H5FNAL_PROGRAM_ERROR("could not close HDF5 data product");
-    if (h5fnal_close_event(event_id) < 0)
+    if (h5fnal_init_event_summary(&summary, currentRun, currentSubRun, currentEvent) < 0)
+      H5FNAL_PROGRAM_ERROR("could not initialize event summary");
+    if (h5fnal_summarize_assns(&summary, &h5assns_data) < 0)
+      H5FNAL_PROGRAM_ERROR("could not summarize assns");
+    if (h5fnal_add_event_summary(&summaries, &summary) < 0)
+      H5FNAL_PROGRAM_ERROR("could not add event summary");
+
+    /* Close the event */
+    if (!flat && h5fnal_close_event(event_id) < 0)
       H5FNAL_PROGRAM_ERROR("could not close event");
   } /* End of loop over events */
 
+  if (flat) {
+    if (h5fnal_close_event_index(&index) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close event index");
+    if (h5fnal_close_assns(h5assns) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close HDF5 data product");
+  }
+  else if (h5fnal_close_event_lookup(&lookup) < 0)
+    H5FNAL_PROGRAM_ERROR("could not close event lookup");
+  if (h5fnal_close_summary_table(&summaries) < 0)
+    H5FNAL_PROGRAM_ERROR("could not close summary table");
+
   /* Clean up */
-  if (H5Pclose(fapl_id) < 0)
-    H5FNAL_HDF5_ERROR;
-  if (H5Fclose(fid) < 0)
-    H5FNAL_HDF5_ERROR;
+  if (h5fnal_close_file(fid) < 0)
+    H5FNAL_PROGRAM_ERROR("could not close HDF5 file");
   if (h5fnal_close_run(master_id) < 0)
     H5FNAL_PROGRAM_ERROR("could not close master run container")
   // These will still be open after the loop.
-  if (h5fnal_close_run(run_id) < 0)
-    H5FNAL_PROGRAM_ERROR("could not close run")
-  if (h5fnal_close_run(subrun_id) < 0)
-    H5FNAL_PROGRAM_ERROR("could not close sub-run")
+  if (!flat) {
+    if (h5fnal_close_run(run_id) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close run")
+    if (h5fnal_close_run(subrun_id) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close sub-run")
+  }
 
   free(h5assns);
 
@@ -196,7 +250,6 @@ int main(int argc, char* argv[]) {
 error:
 
   H5E_BEGIN_TRY {
-    H5Pclose(fapl_id);
     H5Fclose(fid);
     h5fnal_close_run(run_id);
     h5fnal_close_run(subrun_id);
@@ -26,40 +26,13 @@ using namespace art;
 using namespace std;
 using namespace std::chrono;
 
+// Converts the hits and hit collections in data to MCHitCollections
+// and adds them to the vector
 void
-get_hdf5_hits(hid_t loc_id, unsigned run, unsigned subrun, unsigned event, std::vector<sim::MCHitCollection> &hdf5_mchits)
+convert_hits(const h5fnal_vect_hitcoll_data_t *data, std::vector<sim::MCHitCollection> &hdf5_mchits)
 {
-    string  run_name = std::to_string(run);
-    string  subrun_name = std::to_string(subrun);
-    string  event_name = std::to_string(event);
-    hid_t   run_id = -1;
-    hid_t   subrun_id = -1;
-    hid_t   event_id = -1;
-    h5fnal_vect_hitcoll_t *vector = NULL;
-    h5fnal_vect_hitcoll_data_t *data = NULL;
     hsize_t hc;
 
-    // Open run, sub-run, and event
-    if ((run_id = h5fnal_open_run(loc_id, run_name.c_str())) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open run")
-    if ((subrun_id = h5fnal_open_run(run_id, subrun_name.c_str())) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open sub-run")
-    if ((event_id = h5fnal_open_event(subrun_id, event_name.c_str())) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open event")
-
-    // Open the data product
-    if (NULL == (vector = (h5fnal_vect_hitcoll_t *)calloc(1, sizeof(h5fnal_vect_hitcoll_t))))
-        H5FNAL_PROGRAM_ERROR("could not get memory for vector")
-    if (h5fnal_open_v_mc_hit_collection(event_id, BADNAME, vector) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection")
-
-    // Read all the data
-    if (NULL == (data = (h5fnal_vect_hitcoll_data_t *)calloc(1, sizeof(h5fnal_vect_hitcoll_data_t))))
-        H5FNAL_PROGRAM_ERROR("could not get memory for hit collection data")
-    if (h5fnal_read_all_hits(vector, data) < 0)
-        H5FNAL_PROGRAM_ERROR("could not read hit collection data from the file")
-
-    // Convert to MCHitCollections and add to the vector
     for (hc = 0; hc < data->n_hit_collections; hc++)
     {
         hsize_t start;
@@ -85,42 +58,100 @@ get_hdf5_hits(hid_t loc_id, unsigned run, unsigned subrun, unsigned event, std::
             hdf5_mchits.back().push_back(hit);
         } // end loop over his
     } // end loop over hit collections
+}
+
+void
+get_hdf5_hits(h5fnal_group_cache_t *groups, const h5fnal_event_lookup_t *lookup, unsigned run, unsigned subrun,
+        unsigned event, h5fnal_vect_hitcoll_data_t *data, std::vector<sim::MCHitCollection> &hdf5_mchits)
+{
+    hid_t   event_id = -1;
+    htri_t  found;
+    h5fnal_vect_hitcoll_t *vector = NULL;
+
+    // Open the event directly if the file has an event lookup, otherwise
+    // by name, with the run and sub-run coming from the group cache
+    if (lookup->n_entries > 0) {
+        if ((found = h5fnal_open_event_by_number(lookup, run, subrun, event, &event_id)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open event")
+        if (!found)
+            H5FNAL_PROGRAM_ERROR("event is not in the event lookup")
+    }
+    else if ((event_id = h5fnal_open_cached_event(groups, run, subrun, event)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open event")
+
+    // Open the data product
+    if (NULL == (vector = (h5fnal_vect_hitcoll_t *)calloc(1, sizeof(h5fnal_vect_hitcoll_t))))
+        H5FNAL_PROGRAM_ERROR("could not get memory for vector")
+    if (h5fnal_open_v_mc_hit_collection(event_id, BADNAME, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection")
+
+    // Read all the data into the caller's buffers, growing them if needed
+    if (h5fnal_get_hitcoll_sizes(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get hit collection sizes")
+    if (h5fnal_reserve_hitcoll_mem_data(data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get memory for hit collection data")
+    if (h5fnal_read_all_hits_into(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collection data from the file")
+
+    // Convert to MCHitCollections and add to the vector
+    convert_hits(data, hdf5_mchits);
 
     // Close everything
-    if (h5fnal_close_run(run_id) < 0)
-        H5FNAL_PROGRAM_ERROR("could not close run")
-    if (h5fnal_close_run(subrun_id) < 0)
-        H5FNAL_PROGRAM_ERROR("could not close run")
     if (h5fnal_close_event(event_id) < 0)
         H5FNAL_PROGRAM_ERROR("could not close event")
     if (h5fnal_close_v_mc_hit_collection(vector) < 0)
         H5FNAL_PROGRAM_ERROR("could not close vector")
-    if (h5fnal_free_hitcoll_mem_data(data) < 0)
-        H5FNAL_PROGRAM_ERROR("could not free in-memory hit collection data");
     free(vector);
-    free(data);
 
     return;
 
 error:
     H5E_BEGIN_TRY {
-        h5fnal_close_run(run_id);
-        h5fnal_close_run(subrun_id);
         h5fnal_close_event(event_id);
         h5fnal_close_v_mc_hit_collection(vector);
     } H5E_END_TRY;
-    if (data )
-        h5fnal_free_hitcoll_mem_data(data);
     free(vector);
-    free(data);
 
     return;
 }
 
+// Flat layout version of get_hdf5_hits(). The data product and its
+// event index are opened once for the whole file.
+void
+get_flat_hdf5_hits(h5fnal_vect_hitcoll_t *vector, const h5fnal_event_index_t *index, unsigned run, unsigned subrun,
+        unsigned event, h5fnal_vect_hitcoll_data_t *data, std::vector<sim::MCHitCollection> &hdf5_mchits)
+{
+    h5fnal_event_entry_t entry;
+    htri_t found;
+
+    if ((found = h5fnal_find_event(index, run, subrun, event, &entry)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not look up event")
+    if (!found)
+        H5FNAL_PROGRAM_ERROR("event is not in the event index")
+
+    if (h5fnal_read_event_hits(vector, &entry, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read hit collection data from the file")
+
+    convert_hits(data, hdf5_mchits);
+
+    return;
+
+error:
+    return;
+}
+
 int main(int argc, char* argv[]) {
 
   hid_t   fid 		= H5FNAL_BAD_HID_T;
   hid_t   master_id = H5FNAL_BAD_HID_T;
+  htri_t  flat      = FALSE;
+  h5fnal_vect_hitcoll_t flat_vector {};
+  h5fnal_event_index_t index {};
+  h5fnal_event_lookup_t lookup {};
+  h5fnal_group_cache_t groups {};
+
+  // Read buffers, reused for every event
+  h5fnal_vect_hitcoll_data_t hdf5_data {};
  
   InputTag mchits_tag { "mchitfinder" };
   InputTag vertex_tag { "linecluster" };
@@ -141,13 +172,31 @@ int main(int argc, char* argv[]) {
   /* Open the HDF5 file */
   string h5FileName = filenames.back();
   filenames.pop_back();
-  if ((fid = H5Fopen(h5FileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT)) < 0)
-    H5FNAL_HDF5_ERROR;
+  if ((fid = h5fnal_open_file(h5FileName.c_str(), H5F_ACC_RDONLY, H5FNAL_PROFILE_BULK_READ)) < 0)
+    H5FNAL_PROGRAM_ERROR("could not open HDF5 file");
 
   /* Open the master run container */
   if ((master_id = h5fnal_open_run(fid, MASTER_RUN_CONTAINER)) < 0)
     H5FNAL_PROGRAM_ERROR("could not open master run containing group");
 
+  /* Files written with the flat layout have a single data product in
+   * the master run container, with an event index
+   */
+  if ((flat = H5Lexists(master_id, BADNAME, H5P_DEFAULT)) < 0)
+    H5FNAL_HDF5_ERROR;
+  if (flat) {
+    if (h5fnal_open_v_mc_hit_collection(master_id, BADNAME, &flat_vector) < 0)
+      H5FNAL_PROGRAM_ERROR("could not open vector of mc hit collection");
+    if (h5fnal_open_event_index(flat_vector.top_level_group_id, &index) < 0)
+      H5FNAL_PROGRAM_ERROR("could not open event index");
+  }
+  else {
+    if (h5fnal_open_event_lookup(master_id, &lookup) < 0)
+      H5FNAL_PROGRAM_ERROR("could not open event lookup");
+    if (h5fnal_create_group_cache(master_id, 0, &groups) < 0)
+      H5FNAL_PROGRAM_ERROR("could not create group cache");
+  }
+
   // The gallery::Event object acts as a cursor into the stream of events.
   // A newly-constructed gallery::Event is at the start if its stream.
   // Use gallery::Event::atEnd() to check if you've reached the end of the stream.
@@ -176,7 +225,10 @@ int main(int argc, char* argv[]) {
     // Open the data product in the event in the HDF5 file and get all
     // the data out.
     std::vector<sim::MCHitCollection> hdf5_mchits;
-    get_hdf5_hits(master_id, aux.run(), aux.subRun(), aux.event(), hdf5_mchits);
+    if (flat)
+      get_flat_hdf5_hits(&flat_vector, &index, aux.run(), aux.subRun(), aux.event(), &hdf5_data, hdf5_mchits);
+    else
+      get_hdf5_hits(&groups, &lookup, aux.run(), aux.subRun(), aux.event(), &hdf5_data, hdf5_mchits);
 
     auto const t2 = system_clock::now();
 
@@ -190,8 +242,22 @@ int main(int argc, char* argv[]) {
   }
 
   /* Clean up */
-  if (H5Fclose(fid) < 0)
-    H5FNAL_HDF5_ERROR;
+  if (flat) {
+    if (h5fnal_close_event_index(&index) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close event index");
+    if (h5fnal_close_v_mc_hit_collection(&flat_vector) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close vector");
+  }
+  else {
+    if (h5fnal_close_event_lookup(&lookup) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close event lookup");
+    if (h5fnal_close_group_cache(&groups) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close group cache");
+  }
+  if (h5fnal_free_hitcoll_mem_data(&hdf5_data) < 0)
+    H5FNAL_PROGRAM_ERROR("could not free in-memory hit collection data");
+  if (h5fnal_close_file(fid) < 0)
+    H5FNAL_PROGRAM_ERROR("could not close HDF5 file");
   if (h5fnal_close_run(master_id) < 0)
     H5FNAL_PROGRAM_ERROR("could not close master run container")
 
@@ -208,9 +274,15 @@ int main(int argc, char* argv[]) {
 error:
 
   H5E_BEGIN_TRY {
+    if (flat > 0) {
+      h5fnal_close_event_index(&index);
+      h5fnal_close_v_mc_hit_collection(&flat_vector);
+    }
+    h5fnal_close_group_cache(&groups);
     H5Fclose(fid);
     h5fnal_close_run(master_id);
   } H5E_END_TRY;
+  free(lookup.entries);
 
   std::cout << "*** FAILURE ***\n";
   exit(EXIT_FAILURE);
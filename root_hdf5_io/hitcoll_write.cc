@@ -26,7 +26,6 @@ int main(int argc, char* argv[]) {
 
   size_t totalHits = 0L;
   hid_t   fid 		= H5FNAL_BAD_HID_T;
-  hid_t   fapl_id 	= H5FNAL_BAD_HID_T;
   hid_t   master_id = H5FNAL_BAD_HID_T;
   hid_t   run_id 	= H5FNAL_BAD_HID_T;
   hid_t   subrun_id = H5FNAL_BAD_HID_T;
@@ -34,26 +33,41 @@ int main(int argc, char* argv[]) {
   int prevRun 		= -1;
   int prevSubRun 	= -1;
   h5fnal_vect_hitcoll_t *h5vmchc = NULL;
+  h5fnal_event_index_t index {};
+  h5fnal_event_lookup_t lookup {};
+  h5fnal_summary_table_t summaries {};
+  h5fnal_event_summary_t summary;
+  bool flat = false;
+  h5fnal_create_options_t options;
  
   InputTag mchits_tag { "mchitfinder" };
   InputTag vertex_tag { "linecluster" };
   InputTag assns_tag  { "linecluster" };
 
+  // With --flat, all the events go into a single data product in the
+  // master run container, along with an event index, instead of one
+  // data product per event. With --columns, each hit field is stored
+  // as its own dataset.
+  if (h5fnal_init_create_options(&options) < 0)
+    H5FNAL_PROGRAM_ERROR("could not initialize creation options");
   vector<string> filenames { argv+1, argv+argc }; // filenames from command line
+  while (!filenames.empty() && (filenames.front() == "--flat" || filenames.front() == "--columns")) {
+    if (filenames.front() == "--flat")
+      flat = true;
+    else
+      options.storage = H5FNAL_STORAGE_COLUMNS;
+    filenames.erase(filenames.begin());
+  }
   if (2 != filenames.size()) {
-    std::cerr << "Please supply input and output filenames\n";
+    std::cerr << "Please supply input and output filenames (and optionally --flat and --columns first)\n";
     exit(EXIT_FAILURE);
   }
 
   /* Create the HDF5 file */
   string h5FileName = filenames.back();
   filenames.pop_back();
-  if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
-    H5FNAL_HDF5_ERROR;
-  if (H5Pset_libver_bounds(fapl_id, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST) < 0)
-    H5FNAL_HDF5_ERROR;
-  if ((fid = H5Fcreate(h5FileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl_id)) < 0)
-    H5FNAL_HDF5_ERROR;
+  if ((fid = h5fnal_create_file(h5FileName.c_str(), H5FNAL_PROFILE_STREAMING_WRITE)) < 0)
+    H5FNAL_PROGRAM_ERROR("could not create HDF5 file");
 
   /* Create a top-level containing group in which creation order is tracked and indexed.
    * There is no way to do this in the root group, so we can't use that.
@@ -69,6 +83,23 @@ int main(int argc, char* argv[]) {
   if (NULL == (h5vmchc = (h5fnal_vect_hitcoll_t *)calloc(1, sizeof(h5fnal_vect_hitcoll_t))))
     H5FNAL_PROGRAM_ERROR("could not get memory for HDF5 data product struct");
 
+  /* The flat layout has one data product for the whole file */
+  if (flat) {
+    if (h5fnal_create_v_mc_hit_collection(master_id, BADNAME, &options, h5vmchc) < 0)
+      H5FNAL_PROGRAM_ERROR("could not create HDF5 data product");
+    if (h5fnal_create_event_index(h5vmchc->top_level_group_id, NULL, &index) < 0)
+      H5FNAL_PROGRAM_ERROR("could not create event index");
+  }
+  else {
+    // Events are opened by number through the lookup
+    if (h5fnal_create_event_lookup(master_id, &lookup) < 0)
+      H5FNAL_PROGRAM_ERROR("could not create event lookup");
+  }
+
+  // Per-event summaries, for skimming without reading the hits
+  if (h5fnal_create_summary_table(master_id, &summaries) < 0)
+    H5FNAL_PROGRAM_ERROR("could not create summary table");
+
   // The gallery::Event object acts as a cursor into the stream of events.
   // A newly-constructed gallery::Event is at the start if its stream.
   // Use gallery::Event::atEnd() to check if you've reached the end of the stream.
@@ -90,7 +121,10 @@ int main(int argc, char* argv[]) {
     unsigned int currentRun = aux.run();
     unsigned int currentSubRun = aux.subRun();
 
-    if ((int)currentRun != prevRun) {
+    if (flat) {
+      // No groups, the event index records where the event's data goes
+    }
+    else if ((int)currentRun != prevRun) {
       // Create a new run (create name from the integer ID)
       if (run_id != H5FNAL_BAD_HID_T)
         if (h5fnal_close_run(run_id) < 0)
@@ -124,8 +158,10 @@ int main(int argc, char* argv[]) {
 
     // Create a new event (create name from the integer ID)
     unsigned int currentEvent = aux.event();
-    if ((event_id = h5fnal_create_event(subrun_id, std::to_string(currentEvent).c_str(), FALSE)) < 0)
+    if (!flat && (event_id = h5fnal_create_event(subrun_id, std::to_string(currentEvent).c_str(), FALSE)) < 0)
       H5FNAL_PROGRAM_ERROR("could not create event");
+    if (!flat && h5fnal_add_event_to_lookup(&lookup, currentRun, currentSubRun, currentEvent, event_id) < 0)
+      H5FNAL_PROGRAM_ERROR("could not add event to lookup");
    
     // getValidHandle() is preferred to getByLabel(), for both art and
     // gallery use. It does not require in-your-face error handling.
@@ -137,8 +173,9 @@ int main(int argc, char* argv[]) {
     // The empty string following the 2nd underscore indicates and empty 'product instance name'.
     // There is no need to represent the 'process name' because that is a top-level of the file entity -- in the root group.
     // TODO: Update the name (using a cheap, hard-coded name for now)
-    if (h5fnal_create_v_mc_hit_collection(event_id, BADNAME, h5vmchc) < 0)
-      H5FNAL_PROGRAM_ERROR("could not create HDF5 data product");
+    if (!flat)
+      if (h5fnal_create_v_mc_hit_collection(event_id, BADNAME, &options, h5vmchc) < 0)
+        H5FNAL_PROGRAM_ERROR("could not create HDF5 data product");
 
     // Process all MC Hit Collections
     first_hit = 0;
@@ -179,31 +216,55 @@ int main(int argc, char* argv[]) {
     hc_data.hits = &hits[0];
     hc_data.hit_collections = &hit_collections[0];
 
-    if (h5fnal_append_hits(h5vmchc, &hc_data) < 0)
+    if (flat) {
+      if (h5fnal_append_event_hits(h5vmchc, &index, currentRun, currentSubRun, currentEvent, &hc_data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not write hits to the HDF5 data product");
+    }
+    else if (h5fnal_append_hits(h5vmchc, &hc_data) < 0)
       H5FNAL_PROGRAM_ERROR("could not write hits to the HDF5 data product");
 
+    if (h5fnal_init_event_summary(&summary, currentRun, currentSubRun, currentEvent) < 0)
+      H5FNAL_PROGRAM_ERROR("could not initialize event summary");
+    if (h5fnal_summarize_hits(&summary, &hc_data) < 0)
+      H5FNAL_PROGRAM_ERROR("could not summarize hits");
+    if (h5fnal_add_event_summary(&summaries, &summary) < 0)
+      H5FNAL_PROGRAM_ERROR("could not add event summary");
+
     totalHits += hits.size();
     cout << "Wrote " << hits.size() << " hits to the HDF5 file." << endl;
 
     /* Close the event and HDF5 data product */
+    if (!flat) {
+      if (h5fnal_close_v_mc_hit_collection(h5vmchc) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close HDF5 data product");
+      if (h5fnal_close_event(event_id) < 0)
+        H5FNAL_PROGRAM_ERROR("could not close event");
+    }
+  }
+
+  if (flat) {
+    if (h5fnal_close_event_index(&index) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close event index");
     if (h5fnal_close_v_mc_hit_collection(h5vmchc) < 0)
       H5FNAL_PROGRAM_ERROR("could not close HDF5 data product");
-    if (h5fnal_close_event(event_id) < 0)
-      H5FNAL_PROGRAM_ERROR("could not close event");
   }
+  else if (h5fnal_close_event_lookup(&lookup) < 0)
+    H5FNAL_PROGRAM_ERROR("could not close event lookup");
+  if (h5fnal_close_summary_table(&summaries) < 0)
+    H5FNAL_PROGRAM_ERROR("could not close summary table");
 
   /* Clean up */
-  if (H5Pclose(fapl_id) < 0)
-    H5FNAL_HDF5_ERROR;
-  if (H5Fclose(fid) < 0)
-    H5FNAL_HDF5_ERROR;
+  if (h5fnal_close_file(fid) < 0)
+    H5FNAL_PROGRAM_ERROR("could not close HDF5 file");
   if (h5fnal_close_run(master_id) < 0)
     H5FNAL_PROGRAM_ERROR("could not close master run container")
   // These will still be open after the loop.
-  if (h5fnal_close_run(run_id) < 0)
-    H5FNAL_PROGRAM_ERROR("could not close run")
-  if (h5fnal_close_run(subrun_id) < 0)
-    H5FNAL_PROGRAM_ERROR("could not close sub-run")
+  if (!flat) {
+    if (h5fnal_close_run(run_id) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close run")
+    if (h5fnal_close_run(subrun_id) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close sub-run")
+  }
 
   free(h5vmchc);
 
@@ -214,7 +275,6 @@ int main(int argc, char* argv[]) {
 error:
 
   H5E_BEGIN_TRY {
-    H5Pclose(fapl_id);
     H5Fclose(fid);
     h5fnal_close_run(run_id);
     h5fnal_close_run(subrun_id);
@@ -4,6 +4,7 @@
 #include <iterator>
 #include <numeric>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "canvas/Utilities/InputTag.h"
@@ -28,39 +29,10 @@ using namespace std;
 using namespace simb;
 using namespace std::chrono;
 
-static void
-get_hdf5_truths(hid_t loc_id, unsigned run, unsigned subrun, unsigned event, string_dictionary_t *dict, std::vector<simb::MCTruth> &hdf5_truths)
+// Converts the truth data to MCTruths and adds them to the vector
+static herr_t
+convert_truths(string_dictionary_t *dict, const h5fnal_vect_truth_data_t *data, std::vector<simb::MCTruth> &hdf5_truths)
 {
-    string  run_name = std::to_string(run);
-    string  subrun_name = std::to_string(subrun);
-    string  event_name = std::to_string(event);
-    hid_t   run_id = -1;
-    hid_t   subrun_id = -1;
-    hid_t   event_id = -1;
-    h5fnal_vect_truth_t *vector = NULL;
-    h5fnal_vect_truth_data_t *data = NULL;
-
-    // Open run, sub-run, and event
-    if ((run_id = h5fnal_open_run(loc_id, run_name.c_str())) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open run")
-    if ((subrun_id = h5fnal_open_run(run_id, subrun_name.c_str())) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open sub-run")
-    if ((event_id = h5fnal_open_event(subrun_id, event_name.c_str())) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open event")
-
-    // Open the data product
-    if (NULL == (vector = (h5fnal_vect_truth_t *)calloc(1, sizeof(h5fnal_vect_truth_t))))
-        H5FNAL_PROGRAM_ERROR("could not get memory for vector")
-    if (h5fnal_open_v_mc_truth(event_id, BADNAME, vector) < 0)
-        H5FNAL_PROGRAM_ERROR("could not open Vector of MCTruth")
-
-    // Read all the data
-    if (NULL == (data = (h5fnal_vect_truth_data_t *)calloc(1, sizeof(h5fnal_vect_truth_data_t))))
-        H5FNAL_PROGRAM_ERROR("could not get memory for truth data")
-    if (h5fnal_read_all_truths(vector, data) < 0)
-        H5FNAL_PROGRAM_ERROR("could not read truth data from the file")
-
-    // Convert to MCTruth and add to the vector
     for (hsize_t u = 0; u < data->n_truths; u++)
     {
         simb::MCTruth newTruth;
@@ -80,17 +52,17 @@ get_hdf5_truths(hid_t loc_id, unsigned run, unsigned subrun, unsigned event, str
                 h5fnal_particle_t p = data->particles[v];
                 hssize_t start;
                 hssize_t end;
-                char *s = NULL;
+                std::string_view s;
 
-                /* Get the Process string from the dictionary */
-                if (get_string(dict, p.process_index, &s) < 0)
+                /* Get the Process string from the dictionary (no copy) */
+                if (get_string_view(dict, p.process_index, &s) < 0)
                     H5FNAL_PROGRAM_ERROR("error getting process string");
 
                 /* ctor */
                 simb::MCParticle newParticle(
                     p.track_id,
                     p.pdg_code,
-                    s,
+                    std::string(s),
                     p.mother,
                     p.mass,
                     p.status);
@@ -99,9 +71,9 @@ get_hdf5_truths(hid_t loc_id, unsigned run, unsigned subrun, unsigned event, str
                 newParticle.SetWeight(p.weight);
 
                 /* Set end process */
-                if (get_string(dict, p.endprocess_index, &s) < 0)
+                if (get_string_view(dict, p.endprocess_index, &s) < 0)
                     H5FNAL_PROGRAM_ERROR("error getting end process string");
-                newParticle.SetEndProcess(s);
+                newParticle.SetEndProcess(std::string(s));
 
                 /* set polarization */
                 TVector3 pol(p.polarization_x, p.polarization_y, p.polarization_z);
@@ -165,45 +137,111 @@ get_hdf5_truths(hid_t loc_id, unsigned run, unsigned subrun, unsigned event, str
 
     } // end loop over truths
 
+    return H5FNAL_SUCCESS;
+
+error:
+    return H5FNAL_FAILURE;
+}
+
+static void
+get_hdf5_truths(h5fnal_group_cache_t *groups, const h5fnal_event_lookup_t *lookup, unsigned run, unsigned subrun,
+        unsigned event, string_dictionary_t *dict, h5fnal_vect_truth_data_t *data,
+        std::vector<simb::MCTruth> &hdf5_truths)
+{
+    hid_t   event_id = -1;
+    htri_t  found;
+    h5fnal_vect_truth_t *vector = NULL;
+
+    // Open the event directly if the file has an event lookup, otherwise
+    // by name, with the run and sub-run coming from the group cache
+    if (lookup->n_entries > 0) {
+        if ((found = h5fnal_open_event_by_number(lookup, run, subrun, event, &event_id)) < 0)
+            H5FNAL_PROGRAM_ERROR("could not open event")
+        if (!found)
+            H5FNAL_PROGRAM_ERROR("event is not in the event lookup")
+    }
+    else if ((event_id = h5fnal_open_cached_event(groups, run, subrun, event)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open event")
+
+    // Open the data product
+    if (NULL == (vector = (h5fnal_vect_truth_t *)calloc(1, sizeof(h5fnal_vect_truth_t))))
+        H5FNAL_PROGRAM_ERROR("could not get memory for vector")
+    if (h5fnal_open_v_mc_truth(event_id, BADNAME, vector) < 0)
+        H5FNAL_PROGRAM_ERROR("could not open Vector of MCTruth")
+
+    // Read all the data into the caller's buffers, growing them if needed
+    if (h5fnal_get_truth_sizes(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get truth data sizes")
+    if (h5fnal_reserve_truth_mem_data(data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not get memory for truth data")
+    if (h5fnal_read_all_truths_into(vector, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read truth data from the file")
+
+    // Convert to MCTruth and add to the vector
+    if (convert_truths(dict, data, hdf5_truths) < 0)
+        H5FNAL_PROGRAM_ERROR("could not convert truth data")
+
     // Close everything
-    if (h5fnal_close_run(run_id) < 0)
-        H5FNAL_PROGRAM_ERROR("could not close run")
-    if (h5fnal_close_run(subrun_id) < 0)
-        H5FNAL_PROGRAM_ERROR("could not close run")
     if (h5fnal_close_event(event_id) < 0)
         H5FNAL_PROGRAM_ERROR("could not close event")
     if (h5fnal_close_v_mc_truth(vector) < 0)
         H5FNAL_PROGRAM_ERROR("could not close vector")
-    if (h5fnal_free_truth_mem_data(data) < 0)
-        H5FNAL_PROGRAM_ERROR("could not free in-memory truth data");
     free(vector);
-    free(data);
 
     return;
 
 error:
     H5E_BEGIN_TRY {
-        h5fnal_close_run(run_id);
-        h5fnal_close_run(subrun_id);
         h5fnal_close_event(event_id);
         h5fnal_close_v_mc_truth(vector);
     } H5E_END_TRY;
-    if (data )
-        h5fnal_free_truth_mem_data(data);
     free(vector);
-    free(data);
 
     return;
 }
 
+// Flat layout version of get_hdf5_truths(). The data product and its
+// event index are opened once for the whole file.
+static void
+get_flat_hdf5_truths(h5fnal_vect_truth_t *vector, const h5fnal_event_index_t *index, unsigned run, unsigned subrun,
+        unsigned event, string_dictionary_t *dict, h5fnal_vect_truth_data_t *data, std::vector<simb::MCTruth> &hdf5_truths)
+{
+    h5fnal_event_entry_t entry;
+    htri_t found;
+
+    if ((found = h5fnal_find_event(index, run, subrun, event, &entry)) < 0)
+        H5FNAL_PROGRAM_ERROR("could not look up event")
+    if (!found)
+        H5FNAL_PROGRAM_ERROR("event is not in the event index")
+
+    if (h5fnal_read_event_truths(vector, &entry, data) < 0)
+        H5FNAL_PROGRAM_ERROR("could not read truth data from the file")
+
+    if (convert_truths(dict, data, hdf5_truths) < 0)
+        H5FNAL_PROGRAM_ERROR("could not convert truth data")
+
+    return;
+
+error:
+    return;
+}
+
 int main(int argc, char* argv[]) {
 
   hid_t   fid 		= H5FNAL_BAD_HID_T;
   hid_t   dict_id 	= H5FNAL_BAD_HID_T;
   hid_t   master_id = H5FNAL_BAD_HID_T;
+  htri_t  flat      = FALSE;
+  h5fnal_vect_truth_t flat_vector {};
+  h5fnal_event_index_t index {};
+  h5fnal_event_lookup_t lookup {};
+  h5fnal_group_cache_t groups {};
 
   string_dictionary_t *dict = NULL;
 
+  // Read buffers, reused for every event
+  h5fnal_vect_truth_data_t hdf5_data {};
+
   InputTag mchits_tag { "mchitfinder" };
   InputTag vertex_tag { "linecluster" };
   InputTag assns_tag  { "linecluster" };
@@ -224,8 +262,8 @@ int main(int argc, char* argv[]) {
   /* Open the HDF5 file */
   string h5FileName = filenames.back();
   filenames.pop_back();
-  if ((fid = H5Fopen(h5FileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT)) < 0)
-    H5FNAL_HDF5_ERROR;
+  if ((fid = h5fnal_open_file(h5FileName.c_str(), H5F_ACC_RDONLY, H5FNAL_PROFILE_BULK_READ)) < 0)
+    H5FNAL_PROGRAM_ERROR("could not open HDF5 file");
 
   /* Open the file-wide string dictionary */
   if (NULL == (dict = (string_dictionary_t *)calloc(1, sizeof(string_dictionary_t))))
@@ -237,6 +275,24 @@ int main(int argc, char* argv[]) {
   if ((master_id = h5fnal_open_run(fid, MASTER_RUN_CONTAINER)) < 0)
     H5FNAL_PROGRAM_ERROR("could not open master run containing group");
 
+  /* Files written with the flat layout have a single data product in
+   * the master run container, with an event index
+   */
+  if ((flat = H5Lexists(master_id, BADNAME, H5P_DEFAULT)) < 0)
+    H5FNAL_HDF5_ERROR;
+  if (flat) {
+    if (h5fnal_open_v_mc_truth(master_id, BADNAME, &flat_vector) < 0)
+      H5FNAL_PROGRAM_ERROR("could not open Vector of MCTruth");
+    if (h5fnal_open_event_index(flat_vector.top_level_group_id, &index) < 0)
+      H5FNAL_PROGRAM_ERROR("could not open event index");
+  }
+  else {
+    if (h5fnal_open_event_lookup(master_id, &lookup) < 0)
+      H5FNAL_PROGRAM_ERROR("could not open event lookup");
+    if (h5fnal_create_group_cache(master_id, 0, &groups) < 0)
+      H5FNAL_PROGRAM_ERROR("could not create group cache");
+  }
+
   // The gallery::Event object acts as a cursor into the stream of events.
   // A newly-constructed gallery::Event is at the start if its stream.
   // Use gallery::Event::atEnd() to check if you've reached the end of the stream.
@@ -264,7 +320,10 @@ int main(int argc, char* argv[]) {
 
     // Open the data product in the event in the HDF5 file and get all the data out.
     std::vector<simb::MCTruth> hdf5_truths;
-    get_hdf5_truths(master_id, aux.run(), aux.subRun(), aux.event(), dict, hdf5_truths);
+    if (flat)
+      get_flat_hdf5_truths(&flat_vector, &index, aux.run(), aux.subRun(), aux.event(), dict, &hdf5_data, hdf5_truths);
+    else
+      get_hdf5_truths(&groups, &lookup, aux.run(), aux.subRun(), aux.event(), dict, &hdf5_data, hdf5_truths);
 
     auto const t2 = system_clock::now();
 
@@ -281,12 +340,28 @@ int main(int argc, char* argv[]) {
   }
 
   /* Clean up */
+  if (flat) {
+    if (h5fnal_close_event_index(&index) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close event index");
+    if (h5fnal_close_v_mc_truth(&flat_vector) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close vector");
+  }
+  else {
+    if (h5fnal_close_event_lookup(&lookup) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close event lookup");
+    if (h5fnal_close_group_cache(&groups) < 0)
+      H5FNAL_PROGRAM_ERROR("could not close group cache");
+  }
+  if (h5fnal_free_truth_mem_data(&hdf5_data) < 0)
+    H5FNAL_PROGRAM_ERROR("could not free in-memory truth data");
   if (close_string_dictionary(dict) < 0)
     H5FNAL_PROGRAM_ERROR("could not close string dictionary")
+  free(dict);
+  dict = NULL;
   if (h5fnal_close_run(master_id) < 0)
     H5FNAL_PROGRAM_ERROR("could not close master run container")
-  if (H5Fclose(fid) < 0)
-    H5FNAL_HDF5_ERROR;
+  if (h5fnal_close_file(fid) < 0)
+    H5FNAL_PROGRAM_ERROR("could not close HDF5 file");
 
   // Write out the times to a standard output, in a way easily
   // readable with R (or many other tools).
@@ -301,11 +376,18 @@ int main(int argc, char* argv[]) {
 error:
 
   H5E_BEGIN_TRY {
+    if (flat > 0) {
+      h5fnal_close_event_index(&index);
+      h5fnal_close_v_mc_truth(&flat_vector);
+    }
+    h5fnal_close_group_cache(&groups);
     H5Fclose(fid);
     h5fnal_close_run(master_id);
     if (dict)
       close_string_dictionary(dict);
   } H5E_END_TRY;
+  free(dict);
+  free(lookup.entries);
 
   std::cout << "*** FAILURE ***\n";
   exit(EXIT_FAILURE);